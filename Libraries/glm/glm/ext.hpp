@@ -60,6 +60,7 @@
 #endif
 
 #include "./gtx/associated_min_max.hpp"
+#include "./gtx/batch.hpp"
 #include "./gtx/bit.hpp"
 #include "./gtx/closest_point.hpp"
 #include "./gtx/color_space.hpp"
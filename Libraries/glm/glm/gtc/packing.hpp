@@ -15,6 +15,7 @@
 
 // Dependency:
 #include "type_precision.hpp"
+#include <cstddef>
 
 #if GLM_MESSAGES == GLM_MESSAGES_ENABLED && !defined(GLM_EXT_INCLUDED)
 #	pragma message("GLM: GLM_GTC_packing extension included")
@@ -304,6 +305,25 @@ namespace glm
 	/// @see <a href="http://www.opengl.org/registry/doc/GLSLangSpec.4.20.8.pdf">GLSL 4.20.8 specification, section 8.4 Floating-Point Pack and Unpack Functions</a>
 	GLM_FUNC_DECL vec4 unpackHalf4x16(uint64 p);
 
+	/// Converts count floats to 16-bit floating-point values, out[i] is packHalf1x16(in[i]) except
+	/// that ties round to even (packHalf1x16 rounds them away from zero) and NaN keep their payload,
+	/// as the F16C instructions do. Uses AVX-512 or F16C when GLM_ARCH and the compiler allow,
+	/// an SSE2 bit manipulation otherwise. in and out must not overlap.
+	///
+	/// @see gtc_packing
+	/// @see void unpackHalfArray(uint16 const * in, float * out, std::size_t count)
+	/// @see uint16 packHalf1x16(float const & v)
+	GLM_FUNC_DECL void packHalfArray(float const * in, uint16 * out, std::size_t count);
+
+	/// Converts count 16-bit floating-point values to floats, out[i] is unpackHalf1x16(in[i])
+	/// except that signaling NaN come out quiet, as the F16C instructions do. Exact, denormals
+	/// included whatever the DAZ / FTZ state. in and out must not overlap.
+	///
+	/// @see gtc_packing
+	/// @see void packHalfArray(float const * in, uint16 * out, std::size_t count)
+	/// @see float unpackHalf1x16(uint16 const & v)
+	GLM_FUNC_DECL void unpackHalfArray(uint16 const * in, float * out, std::size_t count);
+
 	/// Returns an unsigned integer obtained by converting the components of a four-component signed integer vector 
 	/// to the 10-10-10-2-bit signed integer representation found in the OpenGL Specification, 
 	/// and then packing these four values into a 32-bit unsigned integer.
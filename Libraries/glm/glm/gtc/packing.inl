@@ -6,9 +6,23 @@
 #include "../vec3.hpp"
 #include "../vec4.hpp"
 #include "../detail/type_half.hpp"
+#include "../simd/packing.h"
 #include <cstring>
 #include <limits>
 
+// GLM_ARCH_AVX512_BIT shares its value with GLM_ARCH_ARM_BIT, x86 has to be checked as well
+#if (GLM_ARCH & GLM_ARCH_AVX512_BIT) && (GLM_ARCH & GLM_ARCH_X86_BIT)
+#	define GLM_PACKING_AVX512 1
+#else
+#	define GLM_PACKING_AVX512 0
+#endif
+// Every AVX2 CPU has F16C, Visual C++ doesn't say when it may use it
+#if (GLM_ARCH & GLM_ARCH_AVX_BIT) && (defined(__F16C__) || ((GLM_COMPILER & GLM_COMPILER_VC) && (GLM_ARCH & GLM_ARCH_AVX2_BIT)))
+#	define GLM_PACKING_F16C 1
+#else
+#	define GLM_PACKING_F16C 0
+#endif
+
 namespace glm{
 namespace detail
 {
@@ -113,6 +127,55 @@ namespace detail
 		return ((h & 0x8000) << 16) | ((( h & 0x7c00) + 0x1C000) << 13) | ((h & 0x03FF) << 13);
 	}
 
+	// Scalar twins of glm_vec4_to_half and glm_vec4_from_half, bit for bit: round to nearest even,
+	// quiet NaN keeping their payload, denormals in both directions.
+	GLM_FUNC_QUALIFIER glm::uint16 float2halfRoundEven(glm::uint32 f)
+	{
+		glm::uint32 const Sign = f & 0x80000000u;
+		glm::uint32 const Abs = f ^ Sign;
+
+		glm::uint32 Half;
+		if(Abs >= ((127u + 16u) << 23)) // infinity or NaN
+			Half = Abs > 0x7f800000u ? 0x7e00 | ((Abs >> 13) & 0x03ff) : 0x7c00;
+		else if(Abs < ((127u - 14u) << 23)) // denormal, the FPU rounds when adding the magic number
+		{
+			glm::uint32 const Magic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+			float AbsFloat, MagicFloat;
+			memcpy(&AbsFloat, &Abs, sizeof(AbsFloat));
+			memcpy(&MagicFloat, &Magic, sizeof(MagicFloat));
+			float const Sum = AbsFloat + MagicFloat;
+			memcpy(&Half, &Sum, sizeof(Half));
+			Half -= Magic;
+		}
+		else
+			Half = (Abs + 0xfff - ((127u - 15u) << 23) + ((Abs >> 13) & 1)) >> 13;
+
+		return static_cast<glm::uint16>(Half | (Sign >> 16));
+	}
+
+	GLM_FUNC_QUALIFIER glm::uint32 half2floatExact(glm::uint16 h)
+	{
+		glm::uint32 const Sign = static_cast<glm::uint32>(h & 0x8000) << 16;
+		glm::uint32 const Abs = h & 0x7fff;
+		glm::uint32 const Rebiased = (Abs << 13) + ((127u - 15u) << 23);
+
+		if((Abs & 0x7c00) == 0x7c00) // infinity or NaN, made quiet
+			return Sign | (Rebiased + ((128u - 16u) << 23)) | (Abs > 0x7c00 ? 0x00400000u : 0u);
+		if((Abs & 0x7c00) == 0) // zero or denormal, subtract the implicit one back out
+		{
+			glm::uint32 const Magic = 113u << 23;
+			glm::uint32 const Implicit = Rebiased + (1u << 23);
+			float ImplicitFloat, MagicFloat;
+			memcpy(&ImplicitFloat, &Implicit, sizeof(ImplicitFloat));
+			memcpy(&MagicFloat, &Magic, sizeof(MagicFloat));
+			float const Difference = ImplicitFloat - MagicFloat;
+			glm::uint32 Result;
+			memcpy(&Result, &Difference, sizeof(Result));
+			return Sign | Result;
+		}
+		return Sign | Rebiased;
+	}
+
 	GLM_FUNC_QUALIFIER glm::uint floatTo11bit(float x)
 	{
 		if(x == 0.0f)
@@ -487,6 +550,61 @@ namespace detail
 		return detail::toFloat32(Unpack);
 	}
 
+	GLM_FUNC_QUALIFIER void packHalfArray(float const * in, uint16 * out, std::size_t count)
+	{
+		std::size_t i = 0;
+
+#		if GLM_PACKING_AVX512
+			for(; i + 16 <= count; i += 16)
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm512_cvtps_ph(_mm512_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+#		endif
+#		if GLM_PACKING_F16C
+			for(; i + 8 <= count; i += 8)
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+#		elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+			for(; i + 8 <= count; i += 8)
+			{
+				glm_ivec4 const Low = glm_vec4_to_half(_mm_loadu_ps(in + i));
+				glm_ivec4 const High = glm_vec4_to_half(_mm_loadu_ps(in + i + 4));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(Low, High));
+			}
+#		endif
+
+		for(; i < count; ++i)
+		{
+			uint32 Bits = 0;
+			memcpy(&Bits, in + i, sizeof(Bits));
+			out[i] = detail::float2halfRoundEven(Bits);
+		}
+	}
+
+	GLM_FUNC_QUALIFIER void unpackHalfArray(uint16 const * in, float * out, std::size_t count)
+	{
+		std::size_t i = 0;
+
+#		if GLM_PACKING_AVX512
+			for(; i + 16 <= count; i += 16)
+				_mm512_storeu_ps(out + i, _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(in + i))));
+#		endif
+#		if GLM_PACKING_F16C
+			for(; i + 8 <= count; i += 8)
+				_mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<__m128i const*>(in + i))));
+#		elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+			for(; i + 8 <= count; i += 8)
+			{
+				glm_ivec4 const Halves = _mm_loadu_si128(reinterpret_cast<__m128i const*>(in + i));
+				_mm_storeu_ps(out + i, glm_vec4_from_half(_mm_unpacklo_epi16(Halves, _mm_setzero_si128())));
+				_mm_storeu_ps(out + i + 4, glm_vec4_from_half(_mm_unpackhi_epi16(Halves, _mm_setzero_si128())));
+			}
+#		endif
+
+		for(; i < count; ++i)
+		{
+			uint32 const Bits = detail::half2floatExact(in[i]);
+			memcpy(out + i, &Bits, sizeof(Bits));
+		}
+	}
+
 	GLM_FUNC_QUALIFIER uint64 packHalf4x16(glm::vec4 const & v)
 	{
 		i16vec4 const Unpack(
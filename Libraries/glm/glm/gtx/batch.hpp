@@ -0,0 +1,85 @@
+/// @ref gtx_batch
+/// @file glm/gtx/batch.hpp
+///
+/// @see core (dependence)
+/// @see gtc_quaternion (dependence)
+///
+/// @defgroup gtx_batch GLM_GTX_batch
+/// @ingroup gtx
+///
+/// @brief Transform many points, matrices and quaternions with one call.
+///
+/// Points are structure of arrays (separate x, y and z arrays), matrices and quaternions are
+/// plain arrays of glm types. Each function runs the widest kernel GLM_ARCH allows, AVX-512
+/// (16 floats), AVX / AVX2 (8), SSE2 and up (4), then finishes the remainder with the scalar
+/// glm code, which is also the whole implementation with GLM_FORCE_PURE. The results match the
+/// scalar functions to a few ulp; they differ only where fused multiply-adds round once.
+///
+/// <glm/gtx/batch.hpp> need to be included to use these functionalities.
+
+#pragma once
+
+// Dependency:
+#include <cstddef>
+#include "../glm.hpp"
+#include "../gtc/quaternion.hpp"
+
+#if GLM_MESSAGES == GLM_MESSAGES_ENABLED && !defined(GLM_EXT_INCLUDED)
+#	pragma message("GLM: GLM_GTX_batch extension included")
+#endif
+
+namespace glm{
+namespace batch
+{
+	/// @addtogroup gtx_batch
+	/// @{
+
+	/// n points or vectors as three arrays, x[i], y[i], z[i] is element i.
+	struct soa_vec3
+	{
+		float * x;
+		float * y;
+		float * z;
+	};
+
+	/// Read only soa_vec3, a soa_vec3 converts to it.
+	struct const_soa_vec3
+	{
+		const_soa_vec3(float const * X, float const * Y, float const * Z) : x(X), y(Y), z(Z) {}
+		const_soa_vec3(soa_vec3 const & v) : x(v.x), y(v.y), z(v.z) {}
+
+		float const * x;
+		float const * y;
+		float const * z;
+	};
+
+	/// out[i] = vec3(m * vec4(in[i], 1)), no perspective divide. in and out may be the same arrays.
+	/// From GLM_GTX_batch extension.
+	template <precision P>
+	GLM_FUNC_DECL void transform_points(tmat4x4<float, P> const & m, const_soa_vec3 in, soa_vec3 out, std::size_t n);
+
+	/// out[i] = vec3(m * vec4(in[i], 0)). in and out may be the same arrays.
+	/// From GLM_GTX_batch extension.
+	template <precision P>
+	GLM_FUNC_DECL void transform_vectors(tmat4x4<float, P> const & m, const_soa_vec3 in, soa_vec3 out, std::size_t n);
+
+	/// out[i] = a[i] * b[i]. out may be a or b.
+	/// From GLM_GTX_batch extension.
+	template <precision P>
+	GLM_FUNC_DECL void mul(tmat4x4<float, P> const * a, tmat4x4<float, P> const * b, tmat4x4<float, P> * out, std::size_t n);
+
+	/// out[i] = a * b[i], a parent applied to its children. out may be b.
+	/// From GLM_GTX_batch extension.
+	template <precision P>
+	GLM_FUNC_DECL void mul(tmat4x4<float, P> const & a, tmat4x4<float, P> const * b, tmat4x4<float, P> * out, std::size_t n);
+
+	/// out[i] = mat4_cast(q[i]).
+	/// From GLM_GTX_batch extension.
+	template <precision P>
+	GLM_FUNC_DECL void mat4_cast(tquat<float, P> const * q, tmat4x4<float, P> * out, std::size_t n);
+
+	/// @}
+}//namespace batch
+}//namespace glm
+
+#include "batch.inl"
@@ -0,0 +1,423 @@
+/// @ref gtx_batch
+/// @file glm/gtx/batch.inl
+
+// GLM_ARCH_AVX512_BIT shares its value with GLM_ARCH_ARM_BIT, x86 has to be checked as well
+#if (GLM_ARCH & GLM_ARCH_AVX512_BIT) && (GLM_ARCH & GLM_ARCH_X86_BIT)
+#	define GLM_BATCH_AVX512 1
+#else
+#	define GLM_BATCH_AVX512 0
+#endif
+#if (GLM_ARCH & GLM_ARCH_AVX_BIT) && (defined(__FMA__) || ((GLM_COMPILER & GLM_COMPILER_VC) && (GLM_ARCH & GLM_ARCH_AVX2_BIT)))
+#	define GLM_BATCH_FMA 1
+#else
+#	define GLM_BATCH_FMA 0
+#endif
+
+namespace glm{
+namespace detail
+{
+	// Every kernel is written once against these: a vector of width floats and what the kernels
+	// do with it. transpose4 transposes each group of 4 floats across the 4 registers, the
+	// quaternion and matrix loads / stores are built so that's the only shuffle they need.
+	// Comparisons give a mask, all ones lanes or an AVX-512 mask register, false for NaN;
+	// min / max return b when either is NaN, like a < b ? a : b.
+#	if GLM_ARCH & GLM_ARCH_SSE2_BIT
+	struct batch_sse
+	{
+		typedef __m128 type;
+		static std::size_t const width = 4;
+
+		GLM_FUNC_QUALIFIER static type load(float const * p) { return _mm_loadu_ps(p); }
+		GLM_FUNC_QUALIFIER static void store(float * p, type v) { _mm_storeu_ps(p, v); }
+		GLM_FUNC_QUALIFIER static type set1(float s) { return _mm_set1_ps(s); }
+		GLM_FUNC_QUALIFIER static type add(type a, type b) { return _mm_add_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type sub(type a, type b) { return _mm_sub_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type mul(type a, type b) { return _mm_mul_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type madd(type a, type b, type c)
+		{
+#			if GLM_BATCH_FMA
+				return _mm_fmadd_ps(a, b, c);
+#			else
+				return _mm_add_ps(_mm_mul_ps(a, b), c);
+#			endif
+		}
+		GLM_FUNC_QUALIFIER static type column3(float s) { return _mm_setr_ps(0, 0, 0, s); }
+
+		typedef __m128 mask;
+		GLM_FUNC_QUALIFIER static type div(type a, type b) { return _mm_div_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type abs(type a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+		GLM_FUNC_QUALIFIER static type min(type a, type b) { return _mm_min_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type max(type a, type b) { return _mm_max_ps(a, b); }
+		GLM_FUNC_QUALIFIER static mask less(type a, type b) { return _mm_cmplt_ps(a, b); }
+		GLM_FUNC_QUALIFIER static mask less_equal(type a, type b) { return _mm_cmple_ps(a, b); }
+		GLM_FUNC_QUALIFIER static mask greater(type a, type b) { return _mm_cmpgt_ps(a, b); }
+		GLM_FUNC_QUALIFIER static mask greater_equal(type a, type b) { return _mm_cmpge_ps(a, b); }
+		GLM_FUNC_QUALIFIER static mask equal(type a, type b) { return _mm_cmpeq_ps(a, b); }
+		GLM_FUNC_QUALIFIER static mask mask_and(mask a, mask b) { return _mm_and_ps(a, b); }
+		GLM_FUNC_QUALIFIER static mask mask_or(mask a, mask b) { return _mm_or_ps(a, b); }
+		GLM_FUNC_QUALIFIER static mask mask_andnot(mask a, mask b) { return _mm_andnot_ps(a, b); } // ~a & b
+		GLM_FUNC_QUALIFIER static unsigned bits(mask m) { return static_cast<unsigned>(_mm_movemask_ps(m)); }
+
+		GLM_FUNC_QUALIFIER static void transpose4(type & r0, type & r1, type & r2, type & r3)
+		{
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		}
+
+		// width / 4 matrices, c0 to c3 hold their columns in the same lanes
+		GLM_FUNC_QUALIFIER static void store_columns(float * out, type c0, type c1, type c2, type c3)
+		{
+			_mm_storeu_ps(out + 0, c0);
+			_mm_storeu_ps(out + 4, c1);
+			_mm_storeu_ps(out + 8, c2);
+			_mm_storeu_ps(out + 12, c3);
+		}
+
+		// out = a * b, a column of out at a time
+		GLM_FUNC_QUALIFIER static void mul_mat4(float const * a, float const * b, float * out)
+		{
+			__m128 const a0 = _mm_loadu_ps(a + 0), a1 = _mm_loadu_ps(a + 4), a2 = _mm_loadu_ps(a + 8), a3 = _mm_loadu_ps(a + 12);
+			__m128 b_[4];
+			for(int c = 0; c < 4; ++c)
+				b_[c] = _mm_loadu_ps(b + c * 4);
+			for(int c = 0; c < 4; ++c)
+			{
+				__m128 column = _mm_mul_ps(a0, _mm_shuffle_ps(b_[c], b_[c], _MM_SHUFFLE(0, 0, 0, 0)));
+				column = madd(a1, _mm_shuffle_ps(b_[c], b_[c], _MM_SHUFFLE(1, 1, 1, 1)), column);
+				column = madd(a2, _mm_shuffle_ps(b_[c], b_[c], _MM_SHUFFLE(2, 2, 2, 2)), column);
+				column = madd(a3, _mm_shuffle_ps(b_[c], b_[c], _MM_SHUFFLE(3, 3, 3, 3)), column);
+				_mm_storeu_ps(out + c * 4, column);
+			}
+		}
+	};
+#	endif//GLM_ARCH & GLM_ARCH_SSE2_BIT
+
+#	if GLM_ARCH & GLM_ARCH_AVX_BIT
+	struct batch_avx
+	{
+		typedef __m256 type;
+		static std::size_t const width = 8;
+
+		GLM_FUNC_QUALIFIER static type load(float const * p) { return _mm256_loadu_ps(p); }
+		GLM_FUNC_QUALIFIER static void store(float * p, type v) { _mm256_storeu_ps(p, v); }
+		GLM_FUNC_QUALIFIER static type set1(float s) { return _mm256_set1_ps(s); }
+		GLM_FUNC_QUALIFIER static type add(type a, type b) { return _mm256_add_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type sub(type a, type b) { return _mm256_sub_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type mul(type a, type b) { return _mm256_mul_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type madd(type a, type b, type c)
+		{
+#			if GLM_BATCH_FMA
+				return _mm256_fmadd_ps(a, b, c);
+#			else
+				return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#			endif
+		}
+		GLM_FUNC_QUALIFIER static type column3(float s) { return _mm256_setr_ps(0, 0, 0, s, 0, 0, 0, s); }
+
+		typedef __m256 mask;
+		GLM_FUNC_QUALIFIER static type div(type a, type b) { return _mm256_div_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type abs(type a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+		GLM_FUNC_QUALIFIER static type min(type a, type b) { return _mm256_min_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type max(type a, type b) { return _mm256_max_ps(a, b); }
+		GLM_FUNC_QUALIFIER static mask less(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+		GLM_FUNC_QUALIFIER static mask less_equal(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+		GLM_FUNC_QUALIFIER static mask greater(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+		GLM_FUNC_QUALIFIER static mask greater_equal(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+		GLM_FUNC_QUALIFIER static mask equal(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+		GLM_FUNC_QUALIFIER static mask mask_and(mask a, mask b) { return _mm256_and_ps(a, b); }
+		GLM_FUNC_QUALIFIER static mask mask_or(mask a, mask b) { return _mm256_or_ps(a, b); }
+		GLM_FUNC_QUALIFIER static mask mask_andnot(mask a, mask b) { return _mm256_andnot_ps(a, b); }
+		GLM_FUNC_QUALIFIER static unsigned bits(mask m) { return static_cast<unsigned>(_mm256_movemask_ps(m)); }
+
+		GLM_FUNC_QUALIFIER static void transpose4(type & r0, type & r1, type & r2, type & r3)
+		{
+			__m256 const t0 = _mm256_unpacklo_ps(r0, r1);
+			__m256 const t1 = _mm256_unpacklo_ps(r2, r3);
+			__m256 const t2 = _mm256_unpackhi_ps(r0, r1);
+			__m256 const t3 = _mm256_unpackhi_ps(r2, r3);
+			r0 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+			r1 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+			r2 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+			r3 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+		}
+
+		GLM_FUNC_QUALIFIER static void store_columns(float * out, type c0, type c1, type c2, type c3)
+		{
+			_mm256_storeu_ps(out + 0, _mm256_permute2f128_ps(c0, c1, 0x20));
+			_mm256_storeu_ps(out + 8, _mm256_permute2f128_ps(c2, c3, 0x20));
+			_mm256_storeu_ps(out + 16, _mm256_permute2f128_ps(c0, c1, 0x31));
+			_mm256_storeu_ps(out + 24, _mm256_permute2f128_ps(c2, c3, 0x31));
+		}
+
+		// two columns of out at a time, a's columns in both halves
+		GLM_FUNC_QUALIFIER static void mul_mat4(float const * a, float const * b, float * out)
+		{
+			__m256 const a0 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(a + 0));
+			__m256 const a1 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(a + 4));
+			__m256 const a2 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(a + 8));
+			__m256 const a3 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(a + 12));
+			__m256 const b01 = _mm256_loadu_ps(b + 0), b23 = _mm256_loadu_ps(b + 8);
+
+			__m256 c01 = _mm256_mul_ps(a0, _mm256_permute_ps(b01, 0x00));
+			__m256 c23 = _mm256_mul_ps(a0, _mm256_permute_ps(b23, 0x00));
+			c01 = madd(a1, _mm256_permute_ps(b01, 0x55), c01);
+			c23 = madd(a1, _mm256_permute_ps(b23, 0x55), c23);
+			c01 = madd(a2, _mm256_permute_ps(b01, 0xAA), c01);
+			c23 = madd(a2, _mm256_permute_ps(b23, 0xAA), c23);
+			c01 = madd(a3, _mm256_permute_ps(b01, 0xFF), c01);
+			c23 = madd(a3, _mm256_permute_ps(b23, 0xFF), c23);
+			_mm256_storeu_ps(out + 0, c01);
+			_mm256_storeu_ps(out + 8, c23);
+		}
+	};
+#	endif//GLM_ARCH & GLM_ARCH_AVX_BIT
+
+#	if GLM_BATCH_AVX512
+	struct batch_avx512
+	{
+		typedef __m512 type;
+		static std::size_t const width = 16;
+
+		GLM_FUNC_QUALIFIER static type load(float const * p) { return _mm512_loadu_ps(p); }
+		GLM_FUNC_QUALIFIER static void store(float * p, type v) { _mm512_storeu_ps(p, v); }
+		GLM_FUNC_QUALIFIER static type set1(float s) { return _mm512_set1_ps(s); }
+		GLM_FUNC_QUALIFIER static type add(type a, type b) { return _mm512_add_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type sub(type a, type b) { return _mm512_sub_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type mul(type a, type b) { return _mm512_mul_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type madd(type a, type b, type c) { return _mm512_fmadd_ps(a, b, c); }
+		GLM_FUNC_QUALIFIER static type column3(float s) { return _mm512_broadcast_f32x4(_mm_setr_ps(0, 0, 0, s)); }
+
+		typedef __mmask16 mask;
+		GLM_FUNC_QUALIFIER static type div(type a, type b) { return _mm512_div_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type abs(type a) { return _mm512_abs_ps(a); }
+		GLM_FUNC_QUALIFIER static type min(type a, type b) { return _mm512_min_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type max(type a, type b) { return _mm512_max_ps(a, b); }
+		GLM_FUNC_QUALIFIER static mask less(type a, type b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+		GLM_FUNC_QUALIFIER static mask less_equal(type a, type b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+		GLM_FUNC_QUALIFIER static mask greater(type a, type b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+		GLM_FUNC_QUALIFIER static mask greater_equal(type a, type b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+		GLM_FUNC_QUALIFIER static mask equal(type a, type b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+		GLM_FUNC_QUALIFIER static mask mask_and(mask a, mask b) { return static_cast<mask>(a & b); }
+		GLM_FUNC_QUALIFIER static mask mask_or(mask a, mask b) { return static_cast<mask>(a | b); }
+		GLM_FUNC_QUALIFIER static mask mask_andnot(mask a, mask b) { return static_cast<mask>(~a & b); }
+		GLM_FUNC_QUALIFIER static unsigned bits(mask m) { return static_cast<unsigned>(m); }
+
+		GLM_FUNC_QUALIFIER static void transpose4(type & r0, type & r1, type & r2, type & r3)
+		{
+			__m512 const t0 = _mm512_unpacklo_ps(r0, r1);
+			__m512 const t1 = _mm512_unpacklo_ps(r2, r3);
+			__m512 const t2 = _mm512_unpackhi_ps(r0, r1);
+			__m512 const t3 = _mm512_unpackhi_ps(r2, r3);
+			r0 = _mm512_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+			r1 = _mm512_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+			r2 = _mm512_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+			r3 = _mm512_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+		}
+
+		// the same 4x4 transpose, of 128 bit lanes: lane j of every column goes to matrix j
+		GLM_FUNC_QUALIFIER static void store_columns(float * out, type c0, type c1, type c2, type c3)
+		{
+			__m512 const t0 = _mm512_shuffle_f32x4(c0, c1, _MM_SHUFFLE(1, 0, 1, 0));
+			__m512 const t1 = _mm512_shuffle_f32x4(c2, c3, _MM_SHUFFLE(1, 0, 1, 0));
+			__m512 const t2 = _mm512_shuffle_f32x4(c0, c1, _MM_SHUFFLE(3, 2, 3, 2));
+			__m512 const t3 = _mm512_shuffle_f32x4(c2, c3, _MM_SHUFFLE(3, 2, 3, 2));
+			_mm512_storeu_ps(out + 0, _mm512_shuffle_f32x4(t0, t1, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm512_storeu_ps(out + 16, _mm512_shuffle_f32x4(t0, t1, _MM_SHUFFLE(3, 1, 3, 1)));
+			_mm512_storeu_ps(out + 32, _mm512_shuffle_f32x4(t2, t3, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm512_storeu_ps(out + 48, _mm512_shuffle_f32x4(t2, t3, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+
+		// all four columns of out at once
+		GLM_FUNC_QUALIFIER static void mul_mat4(float const * a, float const * b, float * out)
+		{
+			__m512 const a0 = _mm512_broadcast_f32x4(_mm_loadu_ps(a + 0));
+			__m512 const a1 = _mm512_broadcast_f32x4(_mm_loadu_ps(a + 4));
+			__m512 const a2 = _mm512_broadcast_f32x4(_mm_loadu_ps(a + 8));
+			__m512 const a3 = _mm512_broadcast_f32x4(_mm_loadu_ps(a + 12));
+			__m512 const m = _mm512_loadu_ps(b);
+
+			__m512 c = _mm512_mul_ps(a0, _mm512_permute_ps(m, 0x00));
+			c = _mm512_fmadd_ps(a1, _mm512_permute_ps(m, 0x55), c);
+			c = _mm512_fmadd_ps(a2, _mm512_permute_ps(m, 0xAA), c);
+			c = _mm512_fmadd_ps(a3, _mm512_permute_ps(m, 0xFF), c);
+			_mm512_storeu_ps(out, c);
+		}
+	};
+#	endif//GLM_BATCH_AVX512
+
+	// [first, n) in whole vectors, returns where it stopped
+	template <typename simd>
+	GLM_FUNC_QUALIFIER std::size_t batch_transform(float const * m, bool translate, batch::const_soa_vec3 in, batch::soa_vec3 out, std::size_t first, std::size_t n)
+	{
+		typedef typename simd::type vec;
+		vec const m00 = simd::set1(m[0]), m01 = simd::set1(m[1]), m02 = simd::set1(m[2]);
+		vec const m10 = simd::set1(m[4]), m11 = simd::set1(m[5]), m12 = simd::set1(m[6]);
+		vec const m20 = simd::set1(m[8]), m21 = simd::set1(m[9]), m22 = simd::set1(m[10]);
+		vec const m30 = simd::set1(translate ? m[12] : 0.0f), m31 = simd::set1(translate ? m[13] : 0.0f), m32 = simd::set1(translate ? m[14] : 0.0f);
+
+		std::size_t i = first;
+		for(; i + simd::width <= n; i += simd::width)
+		{
+			vec const x = simd::load(in.x + i);
+			vec const y = simd::load(in.y + i);
+			vec const z = simd::load(in.z + i);
+			simd::store(out.x + i, simd::madd(m00, x, simd::madd(m10, y, simd::madd(m20, z, m30))));
+			simd::store(out.y + i, simd::madd(m01, x, simd::madd(m11, y, simd::madd(m21, z, m31))));
+			simd::store(out.z + i, simd::madd(m02, x, simd::madd(m12, y, simd::madd(m22, z, m32))));
+		}
+		return i;
+	}
+
+	template <typename simd>
+	GLM_FUNC_QUALIFIER std::size_t batch_mul(float const * a, std::size_t aStride, float const * b, float * out, std::size_t first, std::size_t n)
+	{
+		std::size_t i = first;
+		for(; i < n; ++i)
+			simd::mul_mat4(a + i * aStride, b + i * 16, out + i * 16);
+		return i;
+	}
+
+	// width quaternions at a time: four loads and a transpose make them x, y, z and w vectors,
+	// the rotation is worked out like mat3_cast and transposed back one column at a time
+	template <typename simd>
+	GLM_FUNC_QUALIFIER std::size_t batch_mat4_cast(float const * q, float * out, std::size_t first, std::size_t n)
+	{
+		typedef typename simd::type vec;
+		std::size_t const width = simd::width;
+		vec const one = simd::set1(1.0f), two = simd::set1(2.0f), zero = simd::set1(0.0f);
+		vec const column3 = simd::column3(1.0f);
+
+		std::size_t i = first;
+		for(; i + width <= n; i += width)
+		{
+			float const * block = q + i * 4;
+			vec x = simd::load(block), y = simd::load(block + width), z = simd::load(block + 2 * width), w = simd::load(block + 3 * width);
+			simd::transpose4(x, y, z, w);
+
+			vec const qxx = simd::mul(x, x), qyy = simd::mul(y, y), qzz = simd::mul(z, z);
+			vec const qxz = simd::mul(x, z), qxy = simd::mul(x, y), qyz = simd::mul(y, z);
+			vec const qwx = simd::mul(w, x), qwy = simd::mul(w, y), qwz = simd::mul(w, z);
+
+			vec c0[4] = {simd::sub(one, simd::mul(two, simd::add(qyy, qzz))), simd::mul(two, simd::add(qxy, qwz)), simd::mul(two, simd::sub(qxz, qwy)), zero};
+			vec c1[4] = {simd::mul(two, simd::sub(qxy, qwz)), simd::sub(one, simd::mul(two, simd::add(qxx, qzz))), simd::mul(two, simd::add(qyz, qwx)), zero};
+			vec c2[4] = {simd::mul(two, simd::add(qxz, qwy)), simd::mul(two, simd::sub(qyz, qwx)), simd::sub(one, simd::mul(two, simd::add(qxx, qyy))), zero};
+			simd::transpose4(c0[0], c0[1], c0[2], c0[3]);
+			simd::transpose4(c1[0], c1[1], c1[2], c1[3]);
+			simd::transpose4(c2[0], c2[1], c2[2], c2[3]);
+
+			// register k holds quaternions k * width / 4 and up
+			float * matrices = out + i * 16;
+			for(std::size_t k = 0; k < 4; ++k)
+				simd::store_columns(matrices + k * width * 4, c0[k], c1[k], c2[k], column3);
+		}
+		return i;
+	}
+}//namespace detail
+
+namespace batch
+{
+	template <precision P>
+	GLM_FUNC_QUALIFIER void transform_points(tmat4x4<float, P> const & m, const_soa_vec3 in, soa_vec3 out, std::size_t n)
+	{
+		std::size_t i = 0;
+#		if GLM_ARCH & GLM_ARCH_SSE2_BIT
+			float const * const matrix = &m[0][0];
+#			if GLM_BATCH_AVX512
+				i = detail::batch_transform<detail::batch_avx512>(matrix, true, in, out, i, n);
+#			endif
+#			if GLM_ARCH & GLM_ARCH_AVX_BIT
+				i = detail::batch_transform<detail::batch_avx>(matrix, true, in, out, i, n);
+#			endif
+			i = detail::batch_transform<detail::batch_sse>(matrix, true, in, out, i, n);
+#		endif
+		for(; i < n; ++i)
+		{
+			tvec4<float, P> const p = m * tvec4<float, P>(in.x[i], in.y[i], in.z[i], 1.0f);
+			out.x[i] = p.x;
+			out.y[i] = p.y;
+			out.z[i] = p.z;
+		}
+	}
+
+	template <precision P>
+	GLM_FUNC_QUALIFIER void transform_vectors(tmat4x4<float, P> const & m, const_soa_vec3 in, soa_vec3 out, std::size_t n)
+	{
+		std::size_t i = 0;
+#		if GLM_ARCH & GLM_ARCH_SSE2_BIT
+			float const * const matrix = &m[0][0];
+#			if GLM_BATCH_AVX512
+				i = detail::batch_transform<detail::batch_avx512>(matrix, false, in, out, i, n);
+#			endif
+#			if GLM_ARCH & GLM_ARCH_AVX_BIT
+				i = detail::batch_transform<detail::batch_avx>(matrix, false, in, out, i, n);
+#			endif
+			i = detail::batch_transform<detail::batch_sse>(matrix, false, in, out, i, n);
+#		endif
+		for(; i < n; ++i)
+		{
+			tvec4<float, P> const v = m * tvec4<float, P>(in.x[i], in.y[i], in.z[i], 0.0f);
+			out.x[i] = v.x;
+			out.y[i] = v.y;
+			out.z[i] = v.z;
+		}
+	}
+
+	template <precision P>
+	GLM_FUNC_QUALIFIER void mul(tmat4x4<float, P> const * a, tmat4x4<float, P> const * b, tmat4x4<float, P> * out, std::size_t n)
+	{
+		std::size_t i = 0;
+#		if GLM_ARCH & GLM_ARCH_SSE2_BIT
+			float const * const A = n > 0 ? &a[0][0][0] : 0;
+			float const * const B = n > 0 ? &b[0][0][0] : 0;
+			float * const Out = n > 0 ? &out[0][0][0] : 0;
+#			if GLM_BATCH_AVX512
+				i = detail::batch_mul<detail::batch_avx512>(A, 16, B, Out, i, n);
+#			elif GLM_ARCH & GLM_ARCH_AVX_BIT
+				i = detail::batch_mul<detail::batch_avx>(A, 16, B, Out, i, n);
+#			else
+				i = detail::batch_mul<detail::batch_sse>(A, 16, B, Out, i, n);
+#			endif
+#		endif
+		for(; i < n; ++i)
+			out[i] = a[i] * b[i];
+	}
+
+	template <precision P>
+	GLM_FUNC_QUALIFIER void mul(tmat4x4<float, P> const & a, tmat4x4<float, P> const * b, tmat4x4<float, P> * out, std::size_t n)
+	{
+		std::size_t i = 0;
+#		if GLM_ARCH & GLM_ARCH_SSE2_BIT
+			float const * const A = &a[0][0];
+			float const * const B = n > 0 ? &b[0][0][0] : 0;
+			float * const Out = n > 0 ? &out[0][0][0] : 0;
+#			if GLM_BATCH_AVX512
+				i = detail::batch_mul<detail::batch_avx512>(A, 0, B, Out, i, n);
+#			elif GLM_ARCH & GLM_ARCH_AVX_BIT
+				i = detail::batch_mul<detail::batch_avx>(A, 0, B, Out, i, n);
+#			else
+				i = detail::batch_mul<detail::batch_sse>(A, 0, B, Out, i, n);
+#			endif
+#		endif
+		for(; i < n; ++i)
+			out[i] = a * b[i];
+	}
+
+	template <precision P>
+	GLM_FUNC_QUALIFIER void mat4_cast(tquat<float, P> const * q, tmat4x4<float, P> * out, std::size_t n)
+	{
+		std::size_t i = 0;
+#		if GLM_ARCH & GLM_ARCH_SSE2_BIT
+			float const * const Q = n > 0 ? &q[0].x : 0;
+			float * const Out = n > 0 ? &out[0][0][0] : 0;
+#			if GLM_BATCH_AVX512
+				i = detail::batch_mat4_cast<detail::batch_avx512>(Q, Out, i, n);
+#			endif
+#			if GLM_ARCH & GLM_ARCH_AVX_BIT
+				i = detail::batch_mat4_cast<detail::batch_avx>(Q, Out, i, n);
+#			endif
+			i = detail::batch_mat4_cast<detail::batch_sse>(Q, Out, i, n);
+#		endif
+		for(; i < n; ++i)
+			out[i] = glm::mat4_cast(q[i]);
+	}
+}//namespace batch
+}//namespace glm
@@ -9,10 +9,14 @@
 /// @brief Add std::hash support for glm types
 /// 
 /// <glm/gtx/hash.hpp> need to be included to use these functionalities.
+///
+/// Components are hashed wyhash style: packed into 64 bit words, two words at a time mixed with
+/// one 64x64->128 bit multiply. +0 and -0 compare equal, so they hash the same.
 
 #pragma once
 
 #include <functional>
+#include <cstring>
 
 #include "../vec2.hpp"
 #include "../vec3.hpp"
@@ -34,10 +38,65 @@
 #include "../mat4x3.hpp"
 #include "../mat4x4.hpp"
 
+#if (GLM_COMPILER & GLM_COMPILER_VC) && defined(_M_X64)
+#	include <intrin.h>
+#endif
+
 #if !GLM_HAS_CXX11_STL
 #	error "GLM_GTX_hash requires C++11 standard library support"
 #endif
 
+namespace glm
+{
+	/// @addtogroup gtx_hash
+	/// @{
+
+	/// Incremental 64 bit hash of scalars and glm values, add() them in order and take value().
+	/// Everything but the last partial word stays in registers, a vec3 is two multiplies.
+	class hash_state
+	{
+	public:
+		GLM_FUNC_DECL explicit hash_state(uint64 seed = 0);
+
+		template <typename T>
+		GLM_FUNC_DECL hash_state & add(T const & s);
+		template <typename T, precision P>
+		GLM_FUNC_DECL hash_state & add(tvec1<T, P> const & v);
+		template <typename T, precision P>
+		GLM_FUNC_DECL hash_state & add(tvec2<T, P> const & v);
+		template <typename T, precision P>
+		GLM_FUNC_DECL hash_state & add(tvec3<T, P> const & v);
+		template <typename T, precision P>
+		GLM_FUNC_DECL hash_state & add(tvec4<T, P> const & v);
+		template <typename T, precision P>
+		GLM_FUNC_DECL hash_state & add(tquat<T, P> const & q);
+		template <typename T, precision P>
+		GLM_FUNC_DECL hash_state & add(tdualquat<T, P> const & q);
+		template <template <typename, precision> class matType, typename T, precision P>
+		GLM_FUNC_DECL hash_state & add(matType<T, P> const & m);
+
+		GLM_FUNC_DECL uint64 value() const;
+
+	private:
+		GLM_FUNC_DECL void add_word(uint64 word);
+		GLM_FUNC_DECL void add_bits(uint32 bits);
+		GLM_FUNC_DECL void add_bits(uint64 bits);
+
+		uint64 seed;
+		uint64 bytes;
+		uint64 pending;			// first word of the next pair
+		uint32 low;				// first half of the next word
+		bool has_pending;
+		bool has_low;
+	};
+
+	/// 64 bit hash of one glm value or scalar, seed chains several of them
+	template <typename genType>
+	GLM_FUNC_DECL uint64 hash64(genType const & x, uint64 seed = 0);
+
+	/// @}
+}//namespace glm
+
 namespace std
 {
 	template <typename T, glm::precision P>
@@ -13,173 +13,268 @@
 namespace glm {
 namespace detail
 {
-	GLM_INLINE void hash_combine(size_t &seed, size_t hash)
+	// wyhash's constants
+	static const uint64 hash_secret0 = 0xa0761d6478bd642full;
+	static const uint64 hash_secret1 = 0xe7037ed1a0b428dbull;
+	static const uint64 hash_secret2 = 0x8ebc6af09c88c6e3ull;
+	static const uint64 hash_secret3 = 0x589965cc75374cc3ull;
+
+	// 64x64->128 bit multiply, both halves folded into one
+	GLM_FUNC_QUALIFIER uint64 hash_mix(uint64 a, uint64 b)
+	{
+#		if defined(__SIZEOF_INT128__)
+			__uint128_t const r = static_cast<__uint128_t>(a) * b;
+			return static_cast<uint64>(r) ^ static_cast<uint64>(r >> 64);
+#		elif GLM_COMPILER & GLM_COMPILER_VC && defined(_M_X64)
+			uint64 high;
+			uint64 const low = _umul128(a, b, &high);
+			return low ^ high;
+#		else
+			uint64 const aLow = a & 0xffffffffull, aHigh = a >> 32;
+			uint64 const bLow = b & 0xffffffffull, bHigh = b >> 32;
+			uint64 const lowLow = aLow * bLow, lowHigh = aLow * bHigh, highLow = aHigh * bLow, highHigh = aHigh * bHigh;
+			uint64 const middle = (lowLow >> 32) + (lowHigh & 0xffffffffull) + (highLow & 0xffffffffull);
+			uint64 const low = (lowLow & 0xffffffffull) | (middle << 32);
+			uint64 const high = highHigh + (lowHigh >> 32) + (highLow >> 32) + (middle >> 32);
+			return low ^ high;
+#		endif
+	}
+
+	// the key's bits with -0 turned into +0, types wider than 64 bits go through std::hash
+	template <typename T, bool Small = sizeof(T) <= 4, bool Wide = sizeof(T) <= 8>
+	struct hash_bits
+	{
+		GLM_FUNC_QUALIFIER static uint32 call(T const & s)
+		{
+			T const key = s == T(0) ? T(0) : s;
+			uint32 bits = 0;
+			std::memcpy(&bits, &key, sizeof(T));
+			return bits;
+		}
+	};
+
+	template <typename T>
+	struct hash_bits<T, false, true>
+	{
+		GLM_FUNC_QUALIFIER static uint64 call(T const & s)
+		{
+			T const key = s == T(0) ? T(0) : s;
+			uint64 bits = 0;
+			std::memcpy(&bits, &key, sizeof(T));
+			return bits;
+		}
+	};
+
+	template <typename T>
+	struct hash_bits<T, false, false>
+	{
+		GLM_FUNC_QUALIFIER static uint64 call(T const & s)
+		{
+			return static_cast<uint64>(std::hash<T>()(s == T(0) ? T(0) : s));
+		}
+	};
+
+	GLM_FUNC_QUALIFIER size_t hash_fold(uint64 h)
+	{
+		return sizeof(size_t) >= sizeof(uint64) ? static_cast<size_t>(h) : static_cast<size_t>(h ^ (h >> 32));
+	}
+}//namespace detail
+
+	GLM_FUNC_QUALIFIER hash_state::hash_state(uint64 s)
+		: seed(s ^ detail::hash_mix(s ^ detail::hash_secret0, detail::hash_secret1))
+		, bytes(0)
+		, pending(0)
+		, low(0)
+		, has_pending(false)
+		, has_low(false)
+	{}
+
+	GLM_FUNC_QUALIFIER void hash_state::add_word(uint64 word)
+	{
+		bytes += 8;
+		if(has_pending)
+			seed = detail::hash_mix(pending ^ detail::hash_secret1, word ^ seed);
+		else
+			pending = word;
+		has_pending = !has_pending;
+	}
+
+	GLM_FUNC_QUALIFIER void hash_state::add_bits(uint32 bits)
+	{
+		if(has_low)
+			add_word(static_cast<uint64>(low) | (static_cast<uint64>(bits) << 32));
+		else
+			low = bits;
+		has_low = !has_low;
+	}
+
+	GLM_FUNC_QUALIFIER void hash_state::add_bits(uint64 bits)
+	{
+		if(has_low)
+		{
+			add_word(low);
+			has_low = false;
+		}
+		add_word(bits);
+	}
+
+	template <typename T>
+	GLM_FUNC_QUALIFIER hash_state & hash_state::add(T const & s)
+	{
+		add_bits(detail::hash_bits<T>::call(s));
+		return *this;
+	}
+
+	template <typename T, precision P>
+	GLM_FUNC_QUALIFIER hash_state & hash_state::add(tvec1<T, P> const & v)
+	{
+		return add(v.x);
+	}
+
+	template <typename T, precision P>
+	GLM_FUNC_QUALIFIER hash_state & hash_state::add(tvec2<T, P> const & v)
+	{
+		return add(v.x).add(v.y);
+	}
+
+	template <typename T, precision P>
+	GLM_FUNC_QUALIFIER hash_state & hash_state::add(tvec3<T, P> const & v)
+	{
+		return add(v.x).add(v.y).add(v.z);
+	}
+
+	template <typename T, precision P>
+	GLM_FUNC_QUALIFIER hash_state & hash_state::add(tvec4<T, P> const & v)
+	{
+		return add(v.x).add(v.y).add(v.z).add(v.w);
+	}
+
+	template <typename T, precision P>
+	GLM_FUNC_QUALIFIER hash_state & hash_state::add(tquat<T, P> const & q)
+	{
+		return add(q.x).add(q.y).add(q.z).add(q.w);
+	}
+
+	template <typename T, precision P>
+	GLM_FUNC_QUALIFIER hash_state & hash_state::add(tdualquat<T, P> const & q)
+	{
+		return add(q.real).add(q.dual);
+	}
+
+	template <template <typename, precision> class matType, typename T, precision P>
+	GLM_FUNC_QUALIFIER hash_state & hash_state::add(matType<T, P> const & m)
+	{
+		for(length_t i = 0; i < m.length(); ++i)
+			add(m[i]);
+		return *this;
+	}
+
+	GLM_FUNC_QUALIFIER uint64 hash_state::value() const
+	{
+		hash_state last(*this);
+		if(last.has_low)
+			last.add_word(last.low);
+		uint64 const h = last.has_pending ? detail::hash_mix(last.pending ^ detail::hash_secret1, last.seed ^ detail::hash_secret2) : last.seed;
+		uint64 const length = bytes + (has_low ? 4 : 0);
+		return detail::hash_mix(length ^ detail::hash_secret1, h ^ detail::hash_secret0);
+	}
+
+	template <typename genType>
+	GLM_FUNC_QUALIFIER uint64 hash64(genType const & x, uint64 seed)
 	{
-		hash += 0x9e3779b9 + (seed << 6) + (seed >> 2);
-		seed ^= hash;
+		return hash_state(seed).add(x).value();
 	}
-}}
+}//namespace glm
 
 namespace std
 {
 	template <typename T, glm::precision P>
 	GLM_FUNC_QUALIFIER size_t hash<glm::tvec1<T, P>>::operator()(glm::tvec1<T, P> const & v) const
 	{
-		hash<T> hasher;
-		return hasher(v.x);
+		return glm::detail::hash_fold(glm::hash64(v));
 	}
 
 	template <typename T, glm::precision P>
 	GLM_FUNC_QUALIFIER size_t hash<glm::tvec2<T, P>>::operator()(glm::tvec2<T, P> const & v) const
 	{
-		size_t seed = 0;
-		hash<T> hasher;
-		glm::detail::hash_combine(seed, hasher(v.x));
-		glm::detail::hash_combine(seed, hasher(v.y));
-		return seed;
+		return glm::detail::hash_fold(glm::hash64(v));
 	}
 
 	template <typename T, glm::precision P>
 	GLM_FUNC_QUALIFIER size_t hash<glm::tvec3<T, P>>::operator()(glm::tvec3<T, P> const & v) const
 	{
-		size_t seed = 0;
-		hash<T> hasher;
-		glm::detail::hash_combine(seed, hasher(v.x));
-		glm::detail::hash_combine(seed, hasher(v.y));
-		glm::detail::hash_combine(seed, hasher(v.z));
-		return seed;
+		return glm::detail::hash_fold(glm::hash64(v));
 	}
 
 	template <typename T, glm::precision P>
 	GLM_FUNC_QUALIFIER size_t hash<glm::tvec4<T, P>>::operator()(glm::tvec4<T, P> const & v) const
 	{
-		size_t seed = 0;
-		hash<T> hasher;
-		glm::detail::hash_combine(seed, hasher(v.x));
-		glm::detail::hash_combine(seed, hasher(v.y));
-		glm::detail::hash_combine(seed, hasher(v.z));
-		glm::detail::hash_combine(seed, hasher(v.w));
-		return seed;
+		return glm::detail::hash_fold(glm::hash64(v));
 	}
 
 	template <typename T, glm::precision P>
 	GLM_FUNC_QUALIFIER size_t hash<glm::tquat<T, P>>::operator()(glm::tquat<T,P> const & q) const
 	{
-		size_t seed = 0;
-		hash<T> hasher;
-		glm::detail::hash_combine(seed, hasher(q.x));
-		glm::detail::hash_combine(seed, hasher(q.y));
-		glm::detail::hash_combine(seed, hasher(q.z));
-		glm::detail::hash_combine(seed, hasher(q.w));
-		return seed;
+		return glm::detail::hash_fold(glm::hash64(q));
 	}
 
 	template <typename T, glm::precision P>
 	GLM_FUNC_QUALIFIER size_t hash<glm::tdualquat<T, P>>::operator()(glm::tdualquat<T, P> const & q) const
 	{
-		size_t seed = 0;
-		hash<glm::tquat<T, P>> hasher;
-		glm::detail::hash_combine(seed, hasher(q.real));
-		glm::detail::hash_combine(seed, hasher(q.dual));
-		return seed;
+		return glm::detail::hash_fold(glm::hash64(q));
 	}
 
 	template <typename T, glm::precision P>
 	GLM_FUNC_QUALIFIER size_t hash<glm::tmat2x2<T, P>>::operator()(glm::tmat2x2<T, P> const & m) const
 	{
-		size_t seed = 0;
-		hash<glm::tvec2<T, P>> hasher;
-		glm::detail::hash_combine(seed, hasher(m[0]));
-		glm::detail::hash_combine(seed, hasher(m[1]));
-		return seed;
+		return glm::detail::hash_fold(glm::hash64(m));
 	}
 
 	template <typename T, glm::precision P>
 	GLM_FUNC_QUALIFIER size_t hash<glm::tmat2x3<T, P>>::operator()(glm::tmat2x3<T, P> const & m) const
 	{
-		size_t seed = 0;
-		hash<glm::tvec3<T, P>> hasher;
-		glm::detail::hash_combine(seed, hasher(m[0]));
-		glm::detail::hash_combine(seed, hasher(m[1]));
-		return seed;
+		return glm::detail::hash_fold(glm::hash64(m));
 	}
 
 	template <typename T, glm::precision P>
 	GLM_FUNC_QUALIFIER size_t hash<glm::tmat2x4<T, P>>::operator()(glm::tmat2x4<T, P> const & m) const
 	{
-		size_t seed = 0;
-		hash<glm::tvec4<T, P>> hasher;
-		glm::detail::hash_combine(seed, hasher(m[0]));
-		glm::detail::hash_combine(seed, hasher(m[1]));
-		return seed;
+		return glm::detail::hash_fold(glm::hash64(m));
 	}
 
 	template <typename T, glm::precision P>
 	GLM_FUNC_QUALIFIER size_t hash<glm::tmat3x2<T, P>>::operator()(glm::tmat3x2<T, P> const & m) const
 	{
-		size_t seed = 0;
-		hash<glm::tvec2<T, P>> hasher;
-		glm::detail::hash_combine(seed, hasher(m[0]));
-		glm::detail::hash_combine(seed, hasher(m[1]));
-		glm::detail::hash_combine(seed, hasher(m[2]));
-		return seed;
+		return glm::detail::hash_fold(glm::hash64(m));
 	}
 
 	template <typename T, glm::precision P>
 	GLM_FUNC_QUALIFIER size_t hash<glm::tmat3x3<T, P>>::operator()(glm::tmat3x3<T, P> const & m) const
 	{
-		size_t seed = 0;
-		hash<glm::tvec3<T, P>> hasher;
-		glm::detail::hash_combine(seed, hasher(m[0]));
-		glm::detail::hash_combine(seed, hasher(m[1]));
-		glm::detail::hash_combine(seed, hasher(m[2]));
-		return seed;
+		return glm::detail::hash_fold(glm::hash64(m));
 	}
 
 	template <typename T, glm::precision P>
 	GLM_FUNC_QUALIFIER size_t hash<glm::tmat3x4<T, P>>::operator()(glm::tmat3x4<T, P> const & m) const
 	{
-		size_t seed = 0;
-		hash<glm::tvec4<T, P>> hasher;
-		glm::detail::hash_combine(seed, hasher(m[0]));
-		glm::detail::hash_combine(seed, hasher(m[1]));
-		glm::detail::hash_combine(seed, hasher(m[2]));
-		return seed;
+		return glm::detail::hash_fold(glm::hash64(m));
 	}
 
 	template <typename T, glm::precision P>
 	GLM_FUNC_QUALIFIER size_t hash<glm::tmat4x2<T,P>>::operator()(glm::tmat4x2<T,P> const & m) const
 	{
-		size_t seed = 0;
-		hash<glm::tvec2<T, P>> hasher;
-		glm::detail::hash_combine(seed, hasher(m[0]));
-		glm::detail::hash_combine(seed, hasher(m[1]));
-		glm::detail::hash_combine(seed, hasher(m[2]));
-		glm::detail::hash_combine(seed, hasher(m[3]));
-		return seed;
+		return glm::detail::hash_fold(glm::hash64(m));
 	}
 
 	template <typename T, glm::precision P>
 	GLM_FUNC_QUALIFIER size_t hash<glm::tmat4x3<T,P>>::operator()(glm::tmat4x3<T,P> const & m) const
 	{
-		size_t seed = 0;
-		hash<glm::tvec3<T, P>> hasher;
-		glm::detail::hash_combine(seed, hasher(m[0]));
-		glm::detail::hash_combine(seed, hasher(m[1]));
-		glm::detail::hash_combine(seed, hasher(m[2]));
-		glm::detail::hash_combine(seed, hasher(m[3]));
-		return seed;
+		return glm::detail::hash_fold(glm::hash64(m));
 	}
 
 	template <typename T, glm::precision P>
 	GLM_FUNC_QUALIFIER size_t hash<glm::tmat4x4<T,P>>::operator()(glm::tmat4x4<T, P> const & m) const
 	{
-		size_t seed = 0;
-		hash<glm::tvec4<T, P>> hasher;
-		glm::detail::hash_combine(seed, hasher(m[0]));
-		glm::detail::hash_combine(seed, hasher(m[1]));
-		glm::detail::hash_combine(seed, hasher(m[2]));
-		glm::detail::hash_combine(seed, hasher(m[3]));
-		return seed;
+		return glm::detail::hash_fold(glm::hash64(m));
 	}
 }
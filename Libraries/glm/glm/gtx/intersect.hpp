@@ -3,21 +3,28 @@
 ///
 /// @see core (dependence)
 /// @see gtx_closest_point (dependence)
+/// @see gtx_batch (dependence)
 ///
 /// @defgroup gtx_intersect GLM_GTX_intersect
 /// @ingroup gtx
 ///
 /// @brief Add intersection functions
 ///
+/// The plural functions test one ray or frustum against n primitives given as GLM_GTX_batch
+/// structure of arrays, 16, 8 or 4 at a time as GLM_ARCH allows, and give the same answers as
+/// the scalar function of the same name for each primitive.
+///
 /// <glm/gtx/intersect.hpp> need to be included to use these functionalities.
 
 #pragma once
 
 // Dependency:
 #include <cfloat>
+#include <cstddef>
 #include <limits>
 #include "../glm.hpp"
 #include "../geometric.hpp"
+#include "../gtx/batch.hpp"
 #include "../gtx/closest_point.hpp"
 #include "../gtx/vector_query.hpp"
 
@@ -81,6 +88,70 @@ namespace glm
 		genType & intersectionPosition1, genType & intersectionNormal1, 
 		genType & intersectionPosition2 = genType(), genType & intersectionNormal2 = genType());
 
+	//! Compute the intersection of a ray and a triangle, leaving no gaps between triangles: a ray
+	//! through a shared edge or vertex hits at least one of the triangles sharing it.
+	//! Woop, Benthin and Wald, Watertight Ray/Triangle Intersection, JCGT 2013.
+	//! baryPosition is as for intersectRayTriangle, .x and .y weight vert1 and vert2, .z is the
+	//! distance along dir. Both faces are hit.
+	//! From GLM_GTX_intersect extension.
+	template <typename genType>
+	GLM_FUNC_DECL bool intersectRayTriangleWatertight(
+		genType const & orig, genType const & dir,
+		genType const & vert0, genType const & vert1, genType const & vert2,
+		genType & baryPosition);
+
+	//! Compute the intersection distance of a ray and an axis aligned box, 0 when the ray starts inside.
+	//! Components of dir may be zero. The far distance is widened by a few ulp so rounding never
+	//! loses a box the ray goes through, Ize, Robust BVH Ray Traversal, JCGT 2013.
+	//! From GLM_GTX_intersect extension.
+	template <typename genType>
+	GLM_FUNC_DECL bool intersectRayBox(
+		genType const & orig, genType const & dir,
+		genType const & boxMin, genType const & boxMax,
+		typename genType::value_type & intersectionDistance);
+
+	//! Returns true when a sphere is at least partly inside a frustum, given as its six planes with
+	//! unit length normals pointing inward: dot(vec3(plane), p) + plane.w >= 0 inside.
+	//! From GLM_GTX_intersect extension.
+	template <typename T, precision P>
+	GLM_FUNC_DECL bool intersectSphereFrustum(
+		tvec3<T, P> const & sphereCenter, T sphereRadius,
+		tvec4<T, P> const * frustumPlanes);
+
+	//! intersectRayTriangle for each of n triangles: hit[i] and baryPosition element i are its results
+	//! for triangle i, baryPosition is only meaningful where hit[i]. Returns the number of hits.
+	//! From GLM_GTX_intersect extension.
+	template <precision P>
+	GLM_FUNC_DECL std::size_t intersectRayTriangles(
+		tvec3<float, P> const & orig, tvec3<float, P> const & dir,
+		batch::const_soa_vec3 vert0, batch::const_soa_vec3 vert1, batch::const_soa_vec3 vert2, std::size_t n,
+		bool * hit, batch::soa_vec3 baryPosition);
+
+	//! intersectRayTriangleWatertight for each of n triangles, as intersectRayTriangles.
+	//! From GLM_GTX_intersect extension.
+	template <precision P>
+	GLM_FUNC_DECL std::size_t intersectRayTrianglesWatertight(
+		tvec3<float, P> const & orig, tvec3<float, P> const & dir,
+		batch::const_soa_vec3 vert0, batch::const_soa_vec3 vert1, batch::const_soa_vec3 vert2, std::size_t n,
+		bool * hit, batch::soa_vec3 baryPosition);
+
+	//! intersectRayBox for each of n boxes, the children of a wide BVH node for instance.
+	//! intersectionDistance[i] is only meaningful where hit[i]. Returns the number of hits.
+	//! From GLM_GTX_intersect extension.
+	template <precision P>
+	GLM_FUNC_DECL std::size_t intersectRayBoxes(
+		tvec3<float, P> const & orig, tvec3<float, P> const & dir,
+		batch::const_soa_vec3 boxMin, batch::const_soa_vec3 boxMax, std::size_t n,
+		bool * hit, float * intersectionDistance);
+
+	//! intersectSphereFrustum for each of n spheres, inside[i] for sphere i. Returns the number inside.
+	//! From GLM_GTX_intersect extension.
+	template <precision P>
+	GLM_FUNC_DECL std::size_t intersectSpheresFrustum(
+		batch::const_soa_vec3 sphereCenter, float const * sphereRadius, std::size_t n,
+		tvec4<float, P> const * frustumPlanes,
+		bool * inside);
+
 	/// @}
 }//namespace glm
 
@@ -1,8 +1,331 @@
 /// @ref gtx_intersect
 /// @file glm/gtx/intersect.inl
 
-namespace glm
+namespace glm{
+namespace detail
 {
+	// Rounds to T: with x87 a value left in an 80 bit register would give the same vertex different
+	// coordinates in each triangle that shares it, and the edge functions would no longer agree.
+	template <typename T>
+	GLM_FUNC_QUALIFIER T watertight_round(T x)
+	{
+		volatile T const Rounded = x;
+		return Rounded;
+	}
+
+	// The ray of a watertight test: the axis dir is longest along becomes z, and a shear takes
+	// the ray to the z axis so the triangle is tested in 2D, in the ray's own coordinates.
+	template <typename T>
+	struct watertight_ray
+	{
+		template <typename genType>
+		GLM_FUNC_QUALIFIER explicit watertight_ray(genType const & dir)
+		{
+			genType const Abs(abs(dir));
+			kz = Abs.x > Abs.y ? (Abs.x > Abs.z ? 0 : 2) : (Abs.y > Abs.z ? 1 : 2);
+			kx = kz == 2 ? 0 : kz + 1;
+			ky = kx == 2 ? 0 : kx + 1;
+			if(dir[kz] < static_cast<T>(0)) // keep the winding
+			{
+				length_t const Swap = kx;
+				kx = ky;
+				ky = Swap;
+			}
+			Sx = watertight_round(dir[kx] / dir[kz]);
+			Sy = watertight_round(dir[ky] / dir[kz]);
+			Sz = watertight_round(static_cast<T>(1) / dir[kz]);
+		}
+
+		length_t kx, ky, kz;
+		T Sx, Sy, Sz;
+	};
+
+	// Relative bound on the rounding of ax * by - ay * bx in float, fused multiply-add or not,
+	// the SIMD kernels send closer lanes to watertight_edge
+	template <typename T>
+	GLM_FUNC_QUALIFIER T watertight_edge_bound()
+	{
+		return std::numeric_limits<T>::epsilon() * static_cast<T>(4);
+	}
+
+	// ax * by - ay * bx, the 2D edge function, with its exact sign: neighbours agree on their shared
+	// edge whichever way round they compute it. Computed in double, where the products of floats are
+	// exact, so neither x87 excess precision nor a fused multiply-add can change the sign.
+	template <typename T>
+	GLM_FUNC_QUALIFIER T watertight_edge(T ax, T ay, T bx, T by)
+	{
+		return static_cast<T>(static_cast<double>(ax) * static_cast<double>(by) - static_cast<double>(ay) * static_cast<double>(bx));
+	}
+
+	template <typename T, typename genType>
+	GLM_FUNC_QUALIFIER bool intersect_watertight(watertight_ray<T> const & Ray, genType const & orig, genType const & vert0, genType const & vert1, genType const & vert2, genType & baryPosition)
+	{
+		// the vertices relative to the ray origin, each coordinate rounded as the SIMD kernels do
+		T const az = watertight_round(vert0[Ray.kz] - orig[Ray.kz]);
+		T const bz = watertight_round(vert1[Ray.kz] - orig[Ray.kz]);
+		T const cz = watertight_round(vert2[Ray.kz] - orig[Ray.kz]);
+		T const Ax = watertight_round(watertight_round(vert0[Ray.kx] - orig[Ray.kx]) - Ray.Sx * az);
+		T const Ay = watertight_round(watertight_round(vert0[Ray.ky] - orig[Ray.ky]) - Ray.Sy * az);
+		T const Bx = watertight_round(watertight_round(vert1[Ray.kx] - orig[Ray.kx]) - Ray.Sx * bz);
+		T const By = watertight_round(watertight_round(vert1[Ray.ky] - orig[Ray.ky]) - Ray.Sy * bz);
+		T const Cx = watertight_round(watertight_round(vert2[Ray.kx] - orig[Ray.kx]) - Ray.Sx * cz);
+		T const Cy = watertight_round(watertight_round(vert2[Ray.ky] - orig[Ray.ky]) - Ray.Sy * cz);
+
+		T const U = watertight_edge(Cx, Cy, Bx, By);
+		T const V = watertight_edge(Ax, Ay, Cx, Cy);
+		T const W = watertight_edge(Bx, By, Ax, Ay);
+
+		T const Zero(0);
+		if((U < Zero || V < Zero || W < Zero) && (U > Zero || V > Zero || W > Zero))
+			return false;
+
+		T const Det = U + V + W;
+		T const Distance = U * (Ray.Sz * az) + V * (Ray.Sz * bz) + W * (Ray.Sz * cz);
+		if(!((Det > Zero && Distance >= Zero) || (Det < Zero && Distance <= Zero)))
+			return false;
+
+		T const InvDet = static_cast<T>(1) / Det;
+		baryPosition = genType(V * InvDet, W * InvDet, Distance * InvDet);
+		return true;
+	}
+
+	// a < b ? a : b and a > b ? a : b, a NaN slab (0 * infinity) drops out against the running distance
+	template <typename T>
+	GLM_FUNC_QUALIFIER T slab_min(T a, T b)
+	{
+		return a < b ? a : b;
+	}
+
+	template <typename T>
+	GLM_FUNC_QUALIFIER T slab_max(T a, T b)
+	{
+		return a > b ? a : b;
+	}
+
+	// 1 + 2 gamma(3), the bound on the rounding of the far distance
+	template <typename T>
+	GLM_FUNC_QUALIFIER T slab_far_scale()
+	{
+		T const Unit = std::numeric_limits<T>::epsilon() * static_cast<T>(0.5);
+		return static_cast<T>(1) + static_cast<T>(2) * (static_cast<T>(3) * Unit) / (static_cast<T>(1) - static_cast<T>(3) * Unit);
+	}
+
+	template <typename genType>
+	GLM_FUNC_QUALIFIER bool intersect_box(genType const & orig, genType const & invDir, genType const & boxMin, genType const & boxMax, typename genType::value_type & distance)
+	{
+		typedef typename genType::value_type T;
+
+		T Near = static_cast<T>(0);
+		T Far = std::numeric_limits<T>::infinity();
+		for(length_t i = 0; i < invDir.length(); ++i)
+		{
+			T const t0 = (boxMin[i] - orig[i]) * invDir[i];
+			T const t1 = (boxMax[i] - orig[i]) * invDir[i];
+			Near = slab_max(slab_min(t0, t1), Near);
+			Far = slab_min(slab_max(t0, t1), Far);
+		}
+
+		distance = Near;
+		return Near <= Far * slab_far_scale<T>();
+	}
+
+	// bool per lane, returns how many are set
+	GLM_FUNC_QUALIFIER std::size_t intersect_store(bool * out, unsigned bits, std::size_t width)
+	{
+		std::size_t Count = 0;
+		for(std::size_t k = 0; k < width; ++k)
+		{
+			out[k] = ((bits >> k) & 1u) != 0;
+			Count += (bits >> k) & 1u;
+		}
+		return Count;
+	}
+
+	// The kernels work through [first, n) in whole vectors, return where they stopped and add their hits to count.
+	// Möller-Trumbore, in the same order as intersectRayTriangle.
+	template <typename simd>
+	GLM_FUNC_QUALIFIER std::size_t batch_intersect_triangles(float const * o, float const * d,
+		batch::const_soa_vec3 v0, batch::const_soa_vec3 v1, batch::const_soa_vec3 v2,
+		bool * hit, batch::soa_vec3 bary, std::size_t first, std::size_t n, std::size_t & count)
+	{
+		typedef typename simd::type vec;
+		typedef typename simd::mask mask;
+		vec const ox = simd::set1(o[0]), oy = simd::set1(o[1]), oz = simd::set1(o[2]);
+		vec const dx = simd::set1(d[0]), dy = simd::set1(d[1]), dz = simd::set1(d[2]);
+		vec const one = simd::set1(1.0f), zero = simd::set1(0.0f);
+		vec const epsilon = simd::set1(std::numeric_limits<float>::epsilon());
+		vec const negEpsilon = simd::set1(-std::numeric_limits<float>::epsilon());
+
+		std::size_t i = first;
+		for(; i + simd::width <= n; i += simd::width)
+		{
+			vec const ax = simd::load(v0.x + i), ay = simd::load(v0.y + i), az = simd::load(v0.z + i);
+			vec const e1x = simd::sub(simd::load(v1.x + i), ax), e1y = simd::sub(simd::load(v1.y + i), ay), e1z = simd::sub(simd::load(v1.z + i), az);
+			vec const e2x = simd::sub(simd::load(v2.x + i), ax), e2y = simd::sub(simd::load(v2.y + i), ay), e2z = simd::sub(simd::load(v2.z + i), az);
+
+			// p = cross(dir, e2), a = dot(e1, p)
+			vec const px = simd::sub(simd::mul(dy, e2z), simd::mul(dz, e2y));
+			vec const py = simd::sub(simd::mul(dz, e2x), simd::mul(dx, e2z));
+			vec const pz = simd::sub(simd::mul(dx, e2y), simd::mul(dy, e2x));
+			vec const a = simd::add(simd::add(simd::mul(e1x, px), simd::mul(e1y, py)), simd::mul(e1z, pz));
+			vec const f = simd::div(one, a);
+
+			// s = orig - v0, q = cross(s, e1)
+			vec const sx = simd::sub(ox, ax), sy = simd::sub(oy, ay), sz = simd::sub(oz, az);
+			vec const u = simd::mul(f, simd::add(simd::add(simd::mul(sx, px), simd::mul(sy, py)), simd::mul(sz, pz)));
+			vec const qx = simd::sub(simd::mul(sy, e1z), simd::mul(sz, e1y));
+			vec const qy = simd::sub(simd::mul(sz, e1x), simd::mul(sx, e1z));
+			vec const qz = simd::sub(simd::mul(sx, e1y), simd::mul(sy, e1x));
+			vec const v = simd::mul(f, simd::add(simd::add(simd::mul(dx, qx), simd::mul(dy, qy)), simd::mul(dz, qz)));
+			vec const t = simd::mul(f, simd::add(simd::add(simd::mul(e2x, qx), simd::mul(e2y, qy)), simd::mul(e2z, qz)));
+
+			mask Hit = simd::mask_or(simd::greater_equal(a, epsilon), simd::less_equal(a, negEpsilon));
+			Hit = simd::mask_and(Hit, simd::mask_and(simd::greater_equal(u, zero), simd::less_equal(u, one)));
+			Hit = simd::mask_and(Hit, simd::mask_and(simd::greater_equal(v, zero), simd::less_equal(simd::add(v, u), one)));
+			Hit = simd::mask_and(Hit, simd::greater_equal(t, zero));
+
+			simd::store(bary.x + i, u);
+			simd::store(bary.y + i, v);
+			simd::store(bary.z + i, t);
+			count += intersect_store(hit + i, simd::bits(Hit), simd::width);
+		}
+		return i;
+	}
+
+	// Woop et al., as intersect_watertight; v0, v1 and v2 are already permuted to the ray's kx, ky, kz
+	template <typename simd>
+	GLM_FUNC_QUALIFIER std::size_t batch_intersect_triangles_watertight(float const * o, watertight_ray<float> const & Ray,
+		float const * const * v0, float const * const * v1, float const * const * v2,
+		bool * hit, batch::soa_vec3 bary, std::size_t first, std::size_t n, std::size_t & count)
+	{
+		typedef typename simd::type vec;
+		typedef typename simd::mask mask;
+		vec const ox = simd::set1(o[0]), oy = simd::set1(o[1]), oz = simd::set1(o[2]);
+		vec const Sx = simd::set1(Ray.Sx), Sy = simd::set1(Ray.Sy), Sz = simd::set1(Ray.Sz);
+		vec const zero = simd::set1(0.0f), bound = simd::set1(watertight_edge_bound<float>());
+
+		std::size_t i = first;
+		for(; i + simd::width <= n; i += simd::width)
+		{
+			vec const az = simd::sub(simd::load(v0[2] + i), oz), bz = simd::sub(simd::load(v1[2] + i), oz), cz = simd::sub(simd::load(v2[2] + i), oz);
+			vec const Ax = simd::sub(simd::sub(simd::load(v0[0] + i), ox), simd::mul(Sx, az));
+			vec const Ay = simd::sub(simd::sub(simd::load(v0[1] + i), oy), simd::mul(Sy, az));
+			vec const Bx = simd::sub(simd::sub(simd::load(v1[0] + i), ox), simd::mul(Sx, bz));
+			vec const By = simd::sub(simd::sub(simd::load(v1[1] + i), oy), simd::mul(Sy, bz));
+			vec const Cx = simd::sub(simd::sub(simd::load(v2[0] + i), ox), simd::mul(Sx, cz));
+			vec const Cy = simd::sub(simd::sub(simd::load(v2[1] + i), oy), simd::mul(Sy, cz));
+
+			vec const CxBy = simd::mul(Cx, By), CyBx = simd::mul(Cy, Bx);
+			vec const AxCy = simd::mul(Ax, Cy), AyCx = simd::mul(Ay, Cx);
+			vec const BxAy = simd::mul(Bx, Ay), ByAx = simd::mul(By, Ax);
+			vec U = simd::sub(CxBy, CyBx);
+			vec V = simd::sub(AxCy, AyCx);
+			vec W = simd::sub(BxAy, ByAx);
+
+			// rare: an edge function within rounding of zero, those lanes go through watertight_edge
+			mask const Close = simd::mask_or(
+				simd::less_equal(simd::abs(U), simd::mul(bound, simd::add(simd::abs(CxBy), simd::abs(CyBx)))),
+				simd::mask_or(
+					simd::less_equal(simd::abs(V), simd::mul(bound, simd::add(simd::abs(AxCy), simd::abs(AyCx)))),
+					simd::less_equal(simd::abs(W), simd::mul(bound, simd::add(simd::abs(BxAy), simd::abs(ByAx))))));
+			if(simd::bits(Close))
+			{
+				float Lanes[9][16];
+				simd::store(Lanes[0], Ax); simd::store(Lanes[1], Ay);
+				simd::store(Lanes[2], Bx); simd::store(Lanes[3], By);
+				simd::store(Lanes[4], Cx); simd::store(Lanes[5], Cy);
+				simd::store(Lanes[6], U); simd::store(Lanes[7], V); simd::store(Lanes[8], W);
+				for(std::size_t k = 0; k < simd::width; ++k)
+				{
+					Lanes[6][k] = watertight_edge(Lanes[4][k], Lanes[5][k], Lanes[2][k], Lanes[3][k]);
+					Lanes[7][k] = watertight_edge(Lanes[0][k], Lanes[1][k], Lanes[4][k], Lanes[5][k]);
+					Lanes[8][k] = watertight_edge(Lanes[2][k], Lanes[3][k], Lanes[0][k], Lanes[1][k]);
+				}
+				U = simd::load(Lanes[6]);
+				V = simd::load(Lanes[7]);
+				W = simd::load(Lanes[8]);
+			}
+
+			mask const Negative = simd::mask_or(simd::less(U, zero), simd::mask_or(simd::less(V, zero), simd::less(W, zero)));
+			mask const Positive = simd::mask_or(simd::greater(U, zero), simd::mask_or(simd::greater(V, zero), simd::greater(W, zero)));
+
+			vec const Det = simd::add(simd::add(U, V), W);
+			vec const Distance = simd::add(simd::add(simd::mul(U, simd::mul(Sz, az)), simd::mul(V, simd::mul(Sz, bz))), simd::mul(W, simd::mul(Sz, cz)));
+			mask const Front = simd::mask_or(
+				simd::mask_and(simd::greater(Det, zero), simd::greater_equal(Distance, zero)),
+				simd::mask_and(simd::less(Det, zero), simd::less_equal(Distance, zero)));
+			mask const Hit = simd::mask_andnot(simd::mask_and(Negative, Positive), Front);
+
+			vec const InvDet = simd::div(simd::set1(1.0f), Det);
+			simd::store(bary.x + i, simd::mul(V, InvDet));
+			simd::store(bary.y + i, simd::mul(W, InvDet));
+			simd::store(bary.z + i, simd::mul(Distance, InvDet));
+			count += intersect_store(hit + i, simd::bits(Hit), simd::width);
+		}
+		return i;
+	}
+
+	template <typename simd>
+	GLM_FUNC_QUALIFIER std::size_t batch_intersect_boxes(float const * o, float const * invDir,
+		batch::const_soa_vec3 boxMin, batch::const_soa_vec3 boxMax,
+		bool * hit, float * distance, std::size_t first, std::size_t n, std::size_t & count)
+	{
+		typedef typename simd::type vec;
+		vec const ox = simd::set1(o[0]), oy = simd::set1(o[1]), oz = simd::set1(o[2]);
+		vec const ix = simd::set1(invDir[0]), iy = simd::set1(invDir[1]), iz = simd::set1(invDir[2]);
+		vec const zero = simd::set1(0.0f), infinity = simd::set1(std::numeric_limits<float>::infinity());
+		vec const farScale = simd::set1(slab_far_scale<float>());
+
+		std::size_t i = first;
+		for(; i + simd::width <= n; i += simd::width)
+		{
+			vec const x0 = simd::mul(simd::sub(simd::load(boxMin.x + i), ox), ix), x1 = simd::mul(simd::sub(simd::load(boxMax.x + i), ox), ix);
+			vec const y0 = simd::mul(simd::sub(simd::load(boxMin.y + i), oy), iy), y1 = simd::mul(simd::sub(simd::load(boxMax.y + i), oy), iy);
+			vec const z0 = simd::mul(simd::sub(simd::load(boxMin.z + i), oz), iz), z1 = simd::mul(simd::sub(simd::load(boxMax.z + i), oz), iz);
+
+			vec Near = simd::max(simd::min(x0, x1), zero);
+			vec Far = simd::min(simd::max(x0, x1), infinity);
+			Near = simd::max(simd::min(y0, y1), Near);
+			Far = simd::min(simd::max(y0, y1), Far);
+			Near = simd::max(simd::min(z0, z1), Near);
+			Far = simd::min(simd::max(z0, z1), Far);
+
+			simd::store(distance + i, Near);
+			count += intersect_store(hit + i, simd::bits(simd::less_equal(Near, simd::mul(Far, farScale))), simd::width);
+		}
+		return i;
+	}
+
+	template <typename simd>
+	GLM_FUNC_QUALIFIER std::size_t batch_intersect_spheres_frustum(float const * planes,
+		batch::const_soa_vec3 center, float const * radius,
+		bool * inside, std::size_t first, std::size_t n, std::size_t & count)
+	{
+		typedef typename simd::type vec;
+		typedef typename simd::mask mask;
+		vec const zero = simd::set1(0.0f);
+		unsigned const All = (1u << simd::width) - 1u;
+
+		std::size_t i = first;
+		for(; i + simd::width <= n; i += simd::width)
+		{
+			vec const cx = simd::load(center.x + i), cy = simd::load(center.y + i), cz = simd::load(center.z + i);
+			vec const negRadius = simd::sub(zero, simd::load(radius + i));
+
+			mask Outside = simd::less(zero, zero);
+			for(std::size_t p = 0; p < 6; ++p)
+			{
+				float const * const plane = planes + p * 4;
+				vec const d = simd::add(simd::add(simd::add(
+					simd::mul(simd::set1(plane[0]), cx), simd::mul(simd::set1(plane[1]), cy)), simd::mul(simd::set1(plane[2]), cz)), simd::set1(plane[3]));
+				Outside = simd::mask_or(Outside, simd::less(d, negRadius));
+			}
+			count += intersect_store(inside + i, ~simd::bits(Outside) & All, simd::width);
+		}
+		return i;
+	}
+}//namespace detail
+
 	template <typename genType>
 	GLM_FUNC_QUALIFIER bool intersectRayPlane
 	(
@@ -167,4 +490,174 @@ namespace glm
 		intersectionNormal2 = (intersectionPoint2 - sphereCenter) / sphereRadius;
 		return true;
 	}
+
+	template <typename genType>
+	GLM_FUNC_QUALIFIER bool intersectRayTriangleWatertight
+	(
+		genType const & orig, genType const & dir,
+		genType const & vert0, genType const & vert1, genType const & vert2,
+		genType & baryPosition
+	)
+	{
+		detail::watertight_ray<typename genType::value_type> const Ray(dir);
+		return detail::intersect_watertight(Ray, orig, vert0, vert1, vert2, baryPosition);
+	}
+
+	template <typename genType>
+	GLM_FUNC_QUALIFIER bool intersectRayBox
+	(
+		genType const & orig, genType const & dir,
+		genType const & boxMin, genType const & boxMax,
+		typename genType::value_type & intersectionDistance
+	)
+	{
+		return detail::intersect_box(orig, static_cast<typename genType::value_type>(1) / dir, boxMin, boxMax, intersectionDistance);
+	}
+
+	template <typename T, precision P>
+	GLM_FUNC_QUALIFIER bool intersectSphereFrustum
+	(
+		tvec3<T, P> const & sphereCenter, T sphereRadius,
+		tvec4<T, P> const * frustumPlanes
+	)
+	{
+		for(std::size_t i = 0; i < 6; ++i)
+			if(dot(tvec3<T, P>(frustumPlanes[i]), sphereCenter) + frustumPlanes[i].w < -sphereRadius)
+				return false;
+		return true;
+	}
+
+	template <precision P>
+	GLM_FUNC_QUALIFIER std::size_t intersectRayTriangles
+	(
+		tvec3<float, P> const & orig, tvec3<float, P> const & dir,
+		batch::const_soa_vec3 vert0, batch::const_soa_vec3 vert1, batch::const_soa_vec3 vert2, std::size_t n,
+		bool * hit, batch::soa_vec3 baryPosition
+	)
+	{
+		std::size_t i = 0, Count = 0;
+#		if GLM_BATCH_AVX512
+			i = detail::batch_intersect_triangles<detail::batch_avx512>(&orig.x, &dir.x, vert0, vert1, vert2, hit, baryPosition, i, n, Count);
+#		endif
+#		if GLM_ARCH & GLM_ARCH_AVX_BIT
+			i = detail::batch_intersect_triangles<detail::batch_avx>(&orig.x, &dir.x, vert0, vert1, vert2, hit, baryPosition, i, n, Count);
+#		endif
+#		if GLM_ARCH & GLM_ARCH_SSE2_BIT
+			i = detail::batch_intersect_triangles<detail::batch_sse>(&orig.x, &dir.x, vert0, vert1, vert2, hit, baryPosition, i, n, Count);
+#		endif
+		for(; i < n; ++i)
+		{
+			tvec3<float, P> Bary(0.0f);
+			hit[i] = intersectRayTriangle(orig, dir,
+				tvec3<float, P>(vert0.x[i], vert0.y[i], vert0.z[i]),
+				tvec3<float, P>(vert1.x[i], vert1.y[i], vert1.z[i]),
+				tvec3<float, P>(vert2.x[i], vert2.y[i], vert2.z[i]), Bary);
+			baryPosition.x[i] = Bary.x;
+			baryPosition.y[i] = Bary.y;
+			baryPosition.z[i] = Bary.z;
+			Count += hit[i] ? 1 : 0;
+		}
+		return Count;
+	}
+
+	template <precision P>
+	GLM_FUNC_QUALIFIER std::size_t intersectRayTrianglesWatertight
+	(
+		tvec3<float, P> const & orig, tvec3<float, P> const & dir,
+		batch::const_soa_vec3 vert0, batch::const_soa_vec3 vert1, batch::const_soa_vec3 vert2, std::size_t n,
+		bool * hit, batch::soa_vec3 baryPosition
+	)
+	{
+		detail::watertight_ray<float> const Ray(dir);
+		std::size_t i = 0, Count = 0;
+
+#		if GLM_ARCH & GLM_ARCH_SSE2_BIT
+			// the vertex arrays in the ray's axis order
+			float const * const Vert0[3] = {vert0.x, vert0.y, vert0.z};
+			float const * const Vert1[3] = {vert1.x, vert1.y, vert1.z};
+			float const * const Vert2[3] = {vert2.x, vert2.y, vert2.z};
+			float const * const V0[3] = {Vert0[Ray.kx], Vert0[Ray.ky], Vert0[Ray.kz]};
+			float const * const V1[3] = {Vert1[Ray.kx], Vert1[Ray.ky], Vert1[Ray.kz]};
+			float const * const V2[3] = {Vert2[Ray.kx], Vert2[Ray.ky], Vert2[Ray.kz]};
+			float const Orig[3] = {orig[Ray.kx], orig[Ray.ky], orig[Ray.kz]};
+#		endif
+#		if GLM_BATCH_AVX512
+			i = detail::batch_intersect_triangles_watertight<detail::batch_avx512>(Orig, Ray, V0, V1, V2, hit, baryPosition, i, n, Count);
+#		endif
+#		if GLM_ARCH & GLM_ARCH_AVX_BIT
+			i = detail::batch_intersect_triangles_watertight<detail::batch_avx>(Orig, Ray, V0, V1, V2, hit, baryPosition, i, n, Count);
+#		endif
+#		if GLM_ARCH & GLM_ARCH_SSE2_BIT
+			i = detail::batch_intersect_triangles_watertight<detail::batch_sse>(Orig, Ray, V0, V1, V2, hit, baryPosition, i, n, Count);
+#		endif
+		for(; i < n; ++i)
+		{
+			tvec3<float, P> Bary(0.0f);
+			hit[i] = detail::intersect_watertight(Ray, orig,
+				tvec3<float, P>(vert0.x[i], vert0.y[i], vert0.z[i]),
+				tvec3<float, P>(vert1.x[i], vert1.y[i], vert1.z[i]),
+				tvec3<float, P>(vert2.x[i], vert2.y[i], vert2.z[i]), Bary);
+			baryPosition.x[i] = Bary.x;
+			baryPosition.y[i] = Bary.y;
+			baryPosition.z[i] = Bary.z;
+			Count += hit[i] ? 1 : 0;
+		}
+		return Count;
+	}
+
+	template <precision P>
+	GLM_FUNC_QUALIFIER std::size_t intersectRayBoxes
+	(
+		tvec3<float, P> const & orig, tvec3<float, P> const & dir,
+		batch::const_soa_vec3 boxMin, batch::const_soa_vec3 boxMax, std::size_t n,
+		bool * hit, float * intersectionDistance
+	)
+	{
+		tvec3<float, P> const InvDir = 1.0f / dir;
+
+		std::size_t i = 0, Count = 0;
+#		if GLM_BATCH_AVX512
+			i = detail::batch_intersect_boxes<detail::batch_avx512>(&orig.x, &InvDir.x, boxMin, boxMax, hit, intersectionDistance, i, n, Count);
+#		endif
+#		if GLM_ARCH & GLM_ARCH_AVX_BIT
+			i = detail::batch_intersect_boxes<detail::batch_avx>(&orig.x, &InvDir.x, boxMin, boxMax, hit, intersectionDistance, i, n, Count);
+#		endif
+#		if GLM_ARCH & GLM_ARCH_SSE2_BIT
+			i = detail::batch_intersect_boxes<detail::batch_sse>(&orig.x, &InvDir.x, boxMin, boxMax, hit, intersectionDistance, i, n, Count);
+#		endif
+		for(; i < n; ++i)
+		{
+			hit[i] = detail::intersect_box(orig, InvDir,
+				tvec3<float, P>(boxMin.x[i], boxMin.y[i], boxMin.z[i]),
+				tvec3<float, P>(boxMax.x[i], boxMax.y[i], boxMax.z[i]), intersectionDistance[i]);
+			Count += hit[i] ? 1 : 0;
+		}
+		return Count;
+	}
+
+	template <precision P>
+	GLM_FUNC_QUALIFIER std::size_t intersectSpheresFrustum
+	(
+		batch::const_soa_vec3 sphereCenter, float const * sphereRadius, std::size_t n,
+		tvec4<float, P> const * frustumPlanes,
+		bool * inside
+	)
+	{
+		std::size_t i = 0, Count = 0;
+#		if GLM_BATCH_AVX512
+			i = detail::batch_intersect_spheres_frustum<detail::batch_avx512>(&frustumPlanes[0].x, sphereCenter, sphereRadius, inside, i, n, Count);
+#		endif
+#		if GLM_ARCH & GLM_ARCH_AVX_BIT
+			i = detail::batch_intersect_spheres_frustum<detail::batch_avx>(&frustumPlanes[0].x, sphereCenter, sphereRadius, inside, i, n, Count);
+#		endif
+#		if GLM_ARCH & GLM_ARCH_SSE2_BIT
+			i = detail::batch_intersect_spheres_frustum<detail::batch_sse>(&frustumPlanes[0].x, sphereCenter, sphereRadius, inside, i, n, Count);
+#		endif
+		for(; i < n; ++i)
+		{
+			inside[i] = intersectSphereFrustum(tvec3<float, P>(sphereCenter.x[i], sphereCenter.y[i], sphereCenter.z[i]), sphereRadius[i], frustumPlanes);
+			Count += inside[i] ? 1 : 0;
+		}
+		return Count;
+	}
 }//namespace glm
@@ -3,6 +3,72 @@
 
 #pragma once
 
+#include "platform.h"
+
 #if GLM_ARCH & GLM_ARCH_SSE2_BIT
 
+// Four floats to four halves, one in the low 16 bits of each lane, sign extended so
+// _mm_packs_epi32 narrows them without saturating. Rounds to nearest even like F16C,
+// NaN keep their top payload bits and come out quiet.
+GLM_FUNC_QUALIFIER glm_ivec4 glm_vec4_to_half(glm_vec4 v)
+{
+	glm_ivec4 const SignMask = _mm_set1_epi32(static_cast<int>(0x80000000u));
+	glm_ivec4 const Overflow = _mm_set1_epi32((127 + 16) << 23);		// |v| from here is infinity or NaN
+	glm_ivec4 const MinNormal = _mm_set1_epi32((127 - 14) << 23);		// below this the half is denormal
+	glm_ivec4 const DenormMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+	glm_ivec4 const NormalBias = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+
+	glm_ivec4 const Bits = _mm_castps_si128(v);
+	glm_ivec4 const Sign = _mm_and_si128(Bits, SignMask);
+	glm_ivec4 const Abs = _mm_xor_si128(Bits, Sign);
+
+	// denormal halves: adding the magic float lets the FPU round the mantissa into the low bits
+	glm_ivec4 const Denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(Abs), _mm_castsi128_ps(DenormMagic))), DenormMagic);
+
+	// normal halves: rebias the exponent, add just under half an ulp plus the ulp's low bit, truncate
+	glm_ivec4 const Odd = _mm_and_si128(_mm_srli_epi32(Abs, 13), _mm_set1_epi32(1));
+	glm_ivec4 const Normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(Abs, NormalBias), Odd), 13);
+
+	// infinity, or NaN with the quiet bit set
+	glm_ivec4 const IsNan = _mm_cmpgt_epi32(Abs, _mm_set1_epi32(0x7f800000));
+	glm_ivec4 const Payload = _mm_or_si128(_mm_set1_epi32(0x0200), _mm_and_si128(_mm_srli_epi32(Abs, 13), _mm_set1_epi32(0x03ff)));
+	glm_ivec4 const Special = _mm_or_si128(_mm_set1_epi32(0x7c00), _mm_and_si128(IsNan, Payload));
+
+	glm_ivec4 const IsDenormal = _mm_cmpgt_epi32(MinNormal, Abs);
+	glm_ivec4 const IsFinite = _mm_cmpgt_epi32(Overflow, Abs);
+	glm_ivec4 const Finite = _mm_or_si128(_mm_and_si128(IsDenormal, Denormal), _mm_andnot_si128(IsDenormal, Normal));
+	glm_ivec4 const Result = _mm_or_si128(_mm_and_si128(IsFinite, Finite), _mm_andnot_si128(IsFinite, Special));
+
+	return _mm_or_si128(Result, _mm_srai_epi32(Sign, 16));
+}
+
+// Four halves, in the low 16 bits of each lane, to four floats. Exact, signaling NaN come out quiet.
+// Denormal halves go through a float subtraction of normal numbers so DAZ / FTZ don't flush them.
+GLM_FUNC_QUALIFIER glm_vec4 glm_vec4_from_half(glm_ivec4 h)
+{
+	glm_ivec4 const ExpMask = _mm_set1_epi32(0x7c00 << 13);
+	glm_ivec4 const Magic = _mm_set1_epi32(113 << 23);
+
+	glm_ivec4 const Abs = _mm_and_si128(h, _mm_set1_epi32(0x7fff));
+	glm_ivec4 const Shifted = _mm_slli_epi32(Abs, 13);
+	glm_ivec4 const Exp = _mm_and_si128(Shifted, ExpMask);
+	glm_ivec4 const Rebiased = _mm_add_epi32(Shifted, _mm_set1_epi32((127 - 15) << 23));
+
+	// infinity and NaN take the maximum exponent, NaN the quiet bit
+	glm_ivec4 const IsSpecial = _mm_cmpeq_epi32(Exp, ExpMask);
+	glm_ivec4 const IsNan = _mm_cmpgt_epi32(Abs, _mm_set1_epi32(0x7c00));
+	glm_ivec4 const Normal = _mm_or_si128(
+		_mm_add_epi32(Rebiased, _mm_and_si128(IsSpecial, _mm_set1_epi32((128 - 16) << 23))),
+		_mm_and_si128(IsNan, _mm_set1_epi32(0x00400000)));
+
+	// zero and denormals: renormalize by subtracting the implicit one back out
+	glm_ivec4 const IsDenormal = _mm_cmpeq_epi32(Exp, _mm_setzero_si128());
+	glm_ivec4 const Denormal = _mm_castps_si128(_mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(Rebiased, _mm_set1_epi32(1 << 23))), _mm_castsi128_ps(Magic)));
+
+	glm_ivec4 const Result = _mm_or_si128(_mm_and_si128(IsDenormal, Denormal), _mm_andnot_si128(IsDenormal, Normal));
+	glm_ivec4 const Sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+
+	return _mm_castsi128_ps(_mm_or_si128(Result, Sign));
+}
+
 #endif//GLM_ARCH & GLM_ARCH_SSE2_BIT
@@ -1,6 +1,9 @@
 #include <glm/gtc/packing.hpp>
 #include <glm/gtc/epsilon.hpp>
 #include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <ctime>
 #include <vector>
 
 void print_bits(float const & s)
@@ -107,6 +110,173 @@ int test_Half4x16()
 	return Error;
 }
 
+glm::uint32 float_bits(float f)
+{
+	glm::uint32 Bits = 0;
+	std::memcpy(&Bits, &f, sizeof(Bits));
+	return Bits;
+}
+
+float bits_float(glm::uint32 Bits)
+{
+	float f = 0;
+	std::memcpy(&f, &Bits, sizeof(f));
+	return f;
+}
+
+// Round to nearest even computed in double: the half quantum at x, x / quantum rounded to an
+// integer, which makes the result exact as a float so packHalf1x16 has nothing left to round.
+glm::uint16 reference_half(float x)
+{
+	if(std::fabs(x) >= 65520.0f)
+		return static_cast<glm::uint16>((x < 0 ? 0x8000 : 0) | 0x7c00);
+
+	int Exponent = 0;
+	std::frexp(static_cast<double>(x), &Exponent);
+	double const Quantum = std::ldexp(1.0, glm::max(Exponent - 1 - 10, -24));
+	double const Scaled = static_cast<double>(x) / Quantum;
+	double Rounded = std::floor(Scaled);
+	if(Scaled - Rounded > 0.5 || (Scaled - Rounded == 0.5 && std::fmod(Rounded, 2.0) != 0.0))
+		Rounded += 1.0;
+	glm::uint16 const Half = glm::packHalf1x16(static_cast<float>(Rounded * Quantum));
+	return static_cast<glm::uint16>(Half | (x < 0 ? 0x8000 : 0));
+}
+
+int test_HalfArray_exhaustive()
+{
+	int Error = 0;
+
+	std::vector<glm::uint16> Halves(1 << 16);
+	for(std::size_t i = 0; i < Halves.size(); ++i)
+		Halves[i] = static_cast<glm::uint16>(i);
+
+	std::vector<float> Floats(Halves.size());
+	glm::unpackHalfArray(&Halves[0], &Floats[0], Halves.size());
+
+	std::vector<glm::uint16> Back(Halves.size());
+	glm::packHalfArray(&Floats[0], &Back[0], Floats.size());
+
+	for(std::size_t i = 0; i < Halves.size(); ++i)
+	{
+		glm::uint32 const h = Halves[i];
+		bool const IsNan = (h & 0x7fff) > 0x7c00;
+		if(IsNan)
+		{
+			// quiet, payload and sign kept in both directions
+			glm::uint32 const Expected = ((h & 0x8000) << 16) | 0x7fc00000 | ((h & 0x03ff) << 13);
+			Error += float_bits(Floats[i]) == Expected ? 0 : 1;
+			Error += Back[i] == (h | 0x0200) ? 0 : 1;
+		}
+		else
+		{
+			Error += float_bits(Floats[i]) == float_bits(glm::unpackHalf1x16(Halves[i])) ? 0 : 1;
+			Error += Back[i] == h ? 0 : 1;
+		}
+	}
+
+	return Error;
+}
+
+int test_HalfArray_rounding()
+{
+	int Error = 0;
+
+	// every midpoint between two neighbouring halves, and a spread of all the float bit patterns
+	std::vector<float> Floats;
+	for(glm::uint32 h = 0; h < 0x7c00; ++h)
+	{
+		float const Midpoint = (glm::unpackHalf1x16(static_cast<glm::uint16>(h)) + glm::unpackHalf1x16(static_cast<glm::uint16>(h + 1))) * 0.5f;
+		Floats.push_back(Midpoint);
+		Floats.push_back(-Midpoint);
+	}
+	for(glm::uint64 Bits = 0; Bits <= 0xffffffffu; Bits += 4099)
+		Floats.push_back(bits_float(static_cast<glm::uint32>(Bits)));
+
+	std::vector<glm::uint16> Halves(Floats.size());
+	glm::packHalfArray(&Floats[0], &Halves[0], Floats.size());
+
+	for(std::size_t i = 0; i < Floats.size(); ++i)
+	{
+		glm::uint32 const Bits = float_bits(Floats[i]);
+		// the SIMD paths and the scalar tail agree bit for bit, NaN payloads included
+		Error += Halves[i] == glm::detail::float2halfRoundEven(Bits) ? 0 : 1;
+		if((Bits & 0x7fffffff) <= 0x7f800000)
+			Error += Halves[i] == reference_half(Floats[i]) ? 0 : 1;
+	}
+
+	// ties go to the even neighbour: 1 + 2^-11 is halfway between 1 and the next half
+	float const Ties[] = {1.0f + 1.0f / 2048.0f, 1.0f + 3.0f / 2048.0f, 65519.99f, 65520.0f, 1.0f / 33554432.0f, 3.0f / 33554432.0f};
+	glm::uint16 const Expected[] = {0x3c00, 0x3c02, 0x7bff, 0x7c00, 0x0000, 0x0002};
+	glm::uint16 Result[6];
+	glm::packHalfArray(Ties, Result, 6);
+	for(std::size_t i = 0; i < 6; ++i)
+		Error += Result[i] == Expected[i] ? 0 : 1;
+
+	return Error;
+}
+
+// every count up to a few AVX-512 vectors so each path ends in every remainder, without writing past the end
+int test_HalfArray_count()
+{
+	int Error = 0;
+
+	for(std::size_t Count = 0; Count <= 67; ++Count)
+	{
+		std::vector<float> Floats(Count + 1, 42.0f);
+		std::vector<glm::uint16> Halves(Count + 1, 0xdead);
+		for(std::size_t i = 0; i < Count; ++i)
+			Floats[i] = static_cast<float>(i) * 0.25f - 3.0f;
+
+		glm::packHalfArray(&Floats[0], &Halves[0], Count);
+		Error += Halves[Count] == 0xdead ? 0 : 1;
+		for(std::size_t i = 0; i < Count; ++i)
+			Error += Halves[i] == glm::packHalf1x16(Floats[i]) ? 0 : 1;
+
+		std::vector<float> Back(Count + 1, 42.0f);
+		glm::unpackHalfArray(&Halves[0], &Back[0], Count);
+		Error += Back[Count] == 42.0f ? 0 : 1;
+		for(std::size_t i = 0; i < Count; ++i)
+			Error += Back[i] == Floats[i] ? 0 : 1;
+	}
+
+	return Error;
+}
+
+int perf_HalfArray(std::size_t Count)
+{
+	std::vector<float> Floats(Count);
+	std::vector<glm::uint16> Halves(Count);
+	for(std::size_t i = 0; i < Count; ++i)
+		Floats[i] = static_cast<float>(i % 4096) * 0.1f - 200.0f;
+
+	int const Iterations = 10;
+	double const Bytes = static_cast<double>(Count) * Iterations * (sizeof(float) + sizeof(glm::uint16));
+
+	std::clock_t const Timestamp0 = std::clock();
+	for(int Iteration = 0; Iteration < Iterations; ++Iteration)
+		glm::packHalfArray(&Floats[0], &Halves[0], Count);
+	std::clock_t const Timestamp1 = std::clock();
+	for(int Iteration = 0; Iteration < Iterations; ++Iteration)
+	for(std::size_t i = 0; i < Count; ++i)
+		Halves[i] = glm::packHalf1x16(Floats[i]);
+	std::clock_t const Timestamp2 = std::clock();
+	for(int Iteration = 0; Iteration < Iterations; ++Iteration)
+		glm::unpackHalfArray(&Halves[0], &Floats[0], Count);
+	std::clock_t const Timestamp3 = std::clock();
+	for(int Iteration = 0; Iteration < Iterations; ++Iteration)
+	for(std::size_t i = 0; i < Count; ++i)
+		Floats[i] = glm::unpackHalf1x16(Halves[i]);
+	std::clock_t const Timestamp4 = std::clock();
+
+	double const Seconds[] = {
+		static_cast<double>(Timestamp1 - Timestamp0) / CLOCKS_PER_SEC, static_cast<double>(Timestamp2 - Timestamp1) / CLOCKS_PER_SEC,
+		static_cast<double>(Timestamp3 - Timestamp2) / CLOCKS_PER_SEC, static_cast<double>(Timestamp4 - Timestamp3) / CLOCKS_PER_SEC};
+	std::printf("packHalfArray %.2f GB/s, packHalf1x16 loop %.2f GB/s\n", Bytes / glm::max(Seconds[0], 1e-6) * 1e-9, Bytes / glm::max(Seconds[1], 1e-6) * 1e-9);
+	std::printf("unpackHalfArray %.2f GB/s, unpackHalf1x16 loop %.2f GB/s\n", Bytes / glm::max(Seconds[2], 1e-6) * 1e-9, Bytes / glm::max(Seconds[3], 1e-6) * 1e-9);
+
+	return 0;
+}
+
 int test_I3x10_1x2()
 {
 	int Error = 0;
@@ -680,6 +850,13 @@ int main()
 	Error += test_U3x10_1x2();
 	Error += test_Half1x16();
 	Error += test_Half4x16();
+	Error += test_HalfArray_exhaustive();
+	Error += test_HalfArray_rounding();
+	Error += test_HalfArray_count();
+
+#	ifdef NDEBUG
+		Error += perf_HalfArray(1 << 24);
+#	endif//NDEBUG
 
 	return Error;
 }
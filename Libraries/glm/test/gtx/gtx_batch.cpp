@@ -0,0 +1,237 @@
+#include <glm/gtx/batch.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/epsilon.hpp>
+#include <vector>
+#include <cstdlib>
+#include <ctime>
+#include <cstdio>
+
+namespace
+{
+	float random(float Min, float Max)
+	{
+		return Min + (Max - Min) * static_cast<float>(std::rand()) / static_cast<float>(RAND_MAX);
+	}
+
+	glm::mat4 random_mat4()
+	{
+		glm::mat4 M;
+		for(glm::length_t c = 0; c < 4; ++c)
+		for(glm::length_t r = 0; r < 4; ++r)
+			M[c][r] = random(-2.0f, 2.0f);
+		return M;
+	}
+
+	glm::quat random_quat()
+	{
+		return glm::normalize(glm::quat(random(-1, 1), random(-1, 1), random(-1, 1), random(-1, 1)));
+	}
+
+	bool equal(glm::mat4 const & A, glm::mat4 const & B, float Epsilon)
+	{
+		for(glm::length_t c = 0; c < 4; ++c)
+			if(!glm::all(glm::epsilonEqual(A[c], B[c], Epsilon)))
+				return false;
+		return true;
+	}
+
+	struct points
+	{
+		explicit points(std::size_t Count) : x(Count), y(Count), z(Count) {}
+
+		glm::batch::soa_vec3 soa()
+		{
+			glm::batch::soa_vec3 const Result = {x.data(), y.data(), z.data()};
+			return Result;
+		}
+
+		std::vector<float> x, y, z;
+	};
+}//namespace
+
+namespace transform
+{
+	// every count up to a few AVX-512 vectors, so each kernel ends in every possible remainder
+	int test()
+	{
+		int Error(0);
+
+		glm::mat4 const M = glm::translate(glm::rotate(glm::mat4(1.0f), 0.7f, glm::vec3(1, 2, 3)), glm::vec3(4, -5, 6)) * random_mat4();
+		for(std::size_t Count = 0; Count <= 67; ++Count)
+		{
+			points In(Count), Points(Count), Vectors(Count);
+			for(std::size_t i = 0; i < Count; ++i)
+			{
+				In.x[i] = random(-100, 100);
+				In.y[i] = random(-100, 100);
+				In.z[i] = random(-100, 100);
+			}
+			glm::batch::transform_points(M, In.soa(), Points.soa(), Count);
+			glm::batch::transform_vectors(M, In.soa(), Vectors.soa(), Count);
+
+			for(std::size_t i = 0; i < Count; ++i)
+			{
+				glm::vec4 const P = M * glm::vec4(In.x[i], In.y[i], In.z[i], 1.0f);
+				glm::vec4 const V = M * glm::vec4(In.x[i], In.y[i], In.z[i], 0.0f);
+				Error += glm::all(glm::epsilonEqual(glm::vec3(P), glm::vec3(Points.x[i], Points.y[i], Points.z[i]), 1e-3f)) ? 0 : 1;
+				Error += glm::all(glm::epsilonEqual(glm::vec3(V), glm::vec3(Vectors.x[i], Vectors.y[i], Vectors.z[i]), 1e-3f)) ? 0 : 1;
+			}
+
+			// in place
+			points Copy(In);
+			glm::batch::transform_points(M, Copy.soa(), Copy.soa(), Count);
+			Error += Copy.x == Points.x && Copy.y == Points.y && Copy.z == Points.z ? 0 : 1;
+		}
+
+		return Error;
+	}
+
+	int perf(std::size_t Count)
+	{
+		points In(Count), Out(Count);
+		for(std::size_t i = 0; i < Count; ++i)
+		{
+			In.x[i] = random(-100, 100);
+			In.y[i] = random(-100, 100);
+			In.z[i] = random(-100, 100);
+		}
+		glm::mat4 const M = random_mat4();
+
+		std::clock_t const Timestamp0 = std::clock();
+		for(int Iteration = 0; Iteration < 10; ++Iteration)
+			glm::batch::transform_points(M, In.soa(), Out.soa(), Count);
+		std::clock_t const Timestamp1 = std::clock();
+		for(int Iteration = 0; Iteration < 10; ++Iteration)
+		for(std::size_t i = 0; i < Count; ++i)
+		{
+			glm::vec4 const P = M * glm::vec4(In.x[i], In.y[i], In.z[i], 1.0f);
+			Out.x[i] = P.x;
+			Out.y[i] = P.y;
+			Out.z[i] = P.z;
+		}
+		std::clock_t const Timestamp2 = std::clock();
+
+		std::printf("transform_points: batch %d clocks, scalar %d clocks for %d x %d points\n",
+			static_cast<int>(Timestamp1 - Timestamp0), static_cast<int>(Timestamp2 - Timestamp1), 10, static_cast<int>(Count));
+		return 0;
+	}
+}//namespace transform
+
+namespace mul
+{
+	int test()
+	{
+		int Error(0);
+
+		for(std::size_t Count = 0; Count <= 9; ++Count)
+		{
+			std::vector<glm::mat4> A(Count), B(Count), Out(Count);
+			for(std::size_t i = 0; i < Count; ++i)
+			{
+				A[i] = random_mat4();
+				B[i] = random_mat4();
+			}
+			glm::mat4 const Parent = random_mat4();
+
+			glm::batch::mul(A.data(), B.data(), Out.data(), Count);
+			for(std::size_t i = 0; i < Count; ++i)
+				Error += equal(Out[i], A[i] * B[i], 1e-4f) ? 0 : 1;
+
+			glm::batch::mul(Parent, B.data(), Out.data(), Count);
+			for(std::size_t i = 0; i < Count; ++i)
+				Error += equal(Out[i], Parent * B[i], 1e-4f) ? 0 : 1;
+
+			// out is b
+			std::vector<glm::mat4> InPlace(B);
+			glm::batch::mul(A.data(), InPlace.data(), InPlace.data(), Count);
+			for(std::size_t i = 0; i < Count; ++i)
+				Error += equal(InPlace[i], A[i] * B[i], 1e-4f) ? 0 : 1;
+		}
+
+		return Error;
+	}
+
+	int perf(std::size_t Count)
+	{
+		std::vector<glm::mat4> A(Count), B(Count), Out(Count);
+		for(std::size_t i = 0; i < Count; ++i)
+		{
+			A[i] = random_mat4();
+			B[i] = random_mat4();
+		}
+
+		std::clock_t const Timestamp0 = std::clock();
+		for(int Iteration = 0; Iteration < 10; ++Iteration)
+			glm::batch::mul(A.data(), B.data(), Out.data(), Count);
+		std::clock_t const Timestamp1 = std::clock();
+		for(int Iteration = 0; Iteration < 10; ++Iteration)
+		for(std::size_t i = 0; i < Count; ++i)
+			Out[i] = A[i] * B[i];
+		std::clock_t const Timestamp2 = std::clock();
+
+		std::printf("mul: batch %d clocks, scalar %d clocks for %d x %d matrices\n",
+			static_cast<int>(Timestamp1 - Timestamp0), static_cast<int>(Timestamp2 - Timestamp1), 10, static_cast<int>(Count));
+		return 0;
+	}
+}//namespace mul
+
+namespace mat4_cast
+{
+	int test()
+	{
+		int Error(0);
+
+		for(std::size_t Count = 0; Count <= 67; ++Count)
+		{
+			std::vector<glm::quat> Q(Count);
+			std::vector<glm::mat4> Out(Count);
+			for(std::size_t i = 0; i < Count; ++i)
+				Q[i] = random_quat();
+
+			glm::batch::mat4_cast(Q.data(), Out.data(), Count);
+			for(std::size_t i = 0; i < Count; ++i)
+				Error += equal(Out[i], glm::mat4_cast(Q[i]), 1e-6f) ? 0 : 1;
+		}
+
+		return Error;
+	}
+
+	int perf(std::size_t Count)
+	{
+		std::vector<glm::quat> Q(Count);
+		std::vector<glm::mat4> Out(Count);
+		for(std::size_t i = 0; i < Count; ++i)
+			Q[i] = random_quat();
+
+		std::clock_t const Timestamp0 = std::clock();
+		for(int Iteration = 0; Iteration < 10; ++Iteration)
+			glm::batch::mat4_cast(Q.data(), Out.data(), Count);
+		std::clock_t const Timestamp1 = std::clock();
+		for(int Iteration = 0; Iteration < 10; ++Iteration)
+		for(std::size_t i = 0; i < Count; ++i)
+			Out[i] = glm::mat4_cast(Q[i]);
+		std::clock_t const Timestamp2 = std::clock();
+
+		std::printf("mat4_cast: batch %d clocks, scalar %d clocks for %d x %d quaternions\n",
+			static_cast<int>(Timestamp1 - Timestamp0), static_cast<int>(Timestamp2 - Timestamp1), 10, static_cast<int>(Count));
+		return 0;
+	}
+}//namespace mat4_cast
+
+int main()
+{
+	int Error(0);
+
+	Error += transform::test();
+	Error += mul::test();
+	Error += mat4_cast::test();
+
+#	ifdef NDEBUG
+		std::size_t const Samples = 1000000;
+		Error += transform::perf(Samples);
+		Error += mul::perf(Samples);
+		Error += mat4_cast::perf(Samples);
+#	endif//NDEBUG
+
+	return Error;
+}
@@ -0,0 +1,108 @@
+#include <glm/gtx/hash.hpp>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <cstdio>
+
+namespace signed_zero
+{
+	int test()
+	{
+		int Error(0);
+
+		Error += glm::hash64(0.0f) == glm::hash64(-0.0f) ? 0 : 1;
+		Error += glm::hash64(0.0) == glm::hash64(-0.0) ? 0 : 1;
+		Error += glm::hash64(glm::vec3(0.0f, 1.0f, -0.0f)) == glm::hash64(glm::vec3(-0.0f, 1.0f, 0.0f)) ? 0 : 1;
+		Error += std::hash<glm::vec2>()(glm::vec2(-0.0f)) == std::hash<glm::vec2>()(glm::vec2(0.0f)) ? 0 : 1;
+		Error += std::hash<glm::dvec4>()(glm::dvec4(-0.0)) == std::hash<glm::dvec4>()(glm::dvec4(0.0)) ? 0 : 1;
+
+		return Error;
+	}
+}//namespace signed_zero
+
+namespace types
+{
+	int test()
+	{
+		int Error(0);
+
+		// every specialization builds and tells values apart
+		Error += std::hash<glm::vec1>()(glm::vec1(1.0f)) != std::hash<glm::vec1>()(glm::vec1(2.0f)) ? 0 : 1;
+		Error += std::hash<glm::ivec2>()(glm::ivec2(1, 2)) != std::hash<glm::ivec2>()(glm::ivec2(2, 1)) ? 0 : 1;
+		Error += std::hash<glm::vec3>()(glm::vec3(1, 2, 3)) != std::hash<glm::vec3>()(glm::vec3(3, 2, 1)) ? 0 : 1;
+		Error += std::hash<glm::uvec4>()(glm::uvec4(1, 2, 3, 4)) != std::hash<glm::uvec4>()(glm::uvec4(1, 2, 3, 5)) ? 0 : 1;
+		Error += std::hash<glm::quat>()(glm::quat(1, 0, 0, 0)) != std::hash<glm::quat>()(glm::quat(0, 1, 0, 0)) ? 0 : 1;
+		Error += std::hash<glm::dualquat>()(glm::dualquat()) == std::hash<glm::dualquat>()(glm::dualquat()) ? 0 : 1;
+		Error += std::hash<glm::mat2>()(glm::mat2(1.0f)) != std::hash<glm::mat2>()(glm::mat2(2.0f)) ? 0 : 1;
+		Error += std::hash<glm::mat2x3>()(glm::mat2x3(1.0f)) != std::hash<glm::mat2x3>()(glm::mat2x3(2.0f)) ? 0 : 1;
+		Error += std::hash<glm::mat2x4>()(glm::mat2x4(1.0f)) != std::hash<glm::mat2x4>()(glm::mat2x4(2.0f)) ? 0 : 1;
+		Error += std::hash<glm::mat3x2>()(glm::mat3x2(1.0f)) != std::hash<glm::mat3x2>()(glm::mat3x2(2.0f)) ? 0 : 1;
+		Error += std::hash<glm::mat3>()(glm::mat3(1.0f)) != std::hash<glm::mat3>()(glm::mat3(2.0f)) ? 0 : 1;
+		Error += std::hash<glm::mat3x4>()(glm::mat3x4(1.0f)) != std::hash<glm::mat3x4>()(glm::mat3x4(2.0f)) ? 0 : 1;
+		Error += std::hash<glm::mat4x2>()(glm::mat4x2(1.0f)) != std::hash<glm::mat4x2>()(glm::mat4x2(2.0f)) ? 0 : 1;
+		Error += std::hash<glm::mat4x3>()(glm::mat4x3(1.0f)) != std::hash<glm::mat4x3>()(glm::mat4x3(2.0f)) ? 0 : 1;
+		Error += std::hash<glm::dmat4>()(glm::dmat4(1.0)) != std::hash<glm::dmat4>()(glm::dmat4(2.0)) ? 0 : 1;
+
+		// a matrix is its columns in order, the state picks up where a seed left off
+		glm::mat3 const M(1, 2, 3, 4, 5, 6, 7, 8, 9);
+		Error += glm::hash64(M) == glm::hash_state().add(M[0]).add(M[1]).add(M[2]).value() ? 0 : 1;
+		Error += glm::hash64(glm::vec2(1, 2), 1) != glm::hash64(glm::vec2(1, 2), 2) ? 0 : 1;
+		// same bytes, different lengths
+		Error += glm::hash64(glm::vec2(0.0f)) != glm::hash64(glm::vec4(0.0f)) ? 0 : 1;
+		Error += glm::hash64(glm::vec3(0.0f)) != glm::hash64(glm::vec4(0.0f)) ? 0 : 1;
+
+		return Error;
+	}
+}//namespace types
+
+namespace distribution
+{
+	// a grid of positions that share their components, like the corners of a mesh: every value
+	// hashes differently and the low bits (what a power of two table looks at) fill the buckets
+	int test()
+	{
+		int Error(0);
+
+		std::size_t const Size = 64;
+		std::unordered_set<glm::uint64> Hashes;
+		std::vector<std::size_t> Buckets(1 << 16, 0);
+		for(std::size_t z = 0; z < Size; ++z)
+		for(std::size_t y = 0; y < Size; ++y)
+		for(std::size_t x = 0; x < Size; ++x)
+		{
+			glm::vec3 const Position(static_cast<float>(x) * 0.25f, static_cast<float>(y) * 0.25f, static_cast<float>(z) * 0.25f);
+			glm::uint64 const Hash = glm::hash64(Position);
+			Hashes.insert(Hash);
+			++Buckets[Hash & (Buckets.size() - 1)];
+		}
+		Error += Hashes.size() == Size * Size * Size ? 0 : 1;
+
+		// 262144 keys in 65536 buckets, a Poisson(4) load: a bucket over 20 is a broken hash
+		std::size_t MaxLoad = 0, Empty = 0;
+		for(std::size_t i = 0; i < Buckets.size(); ++i)
+		{
+			MaxLoad = Buckets[i] > MaxLoad ? Buckets[i] : MaxLoad;
+			Empty += Buckets[i] == 0 ? 1 : 0;
+		}
+		Error += MaxLoad <= 20 ? 0 : 1;
+		Error += Empty < Buckets.size() / 32 ? 0 : 1;
+
+		std::unordered_map<glm::vec3, int> Map;
+		Map[glm::vec3(1, 2, 3)] = 1;
+		Map[glm::vec3(-0.0f)] = 2;
+		Error += Map[glm::vec3(0.0f)] == 2 && Map.size() == 2 ? 0 : 1;
+
+		return Error;
+	}
+}//namespace distribution
+
+int main()
+{
+	int Error(0);
+
+	Error += signed_zero::test();
+	Error += types::test();
+	Error += distribution::test();
+
+	return Error;
+}
@@ -1,8 +1,476 @@
 #include <glm/gtx/intersect.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/epsilon.hpp>
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+#include <cstdio>
+
+namespace
+{
+	float random(float Min, float Max)
+	{
+		return Min + (Max - Min) * static_cast<float>(std::rand()) / static_cast<float>(RAND_MAX);
+	}
+
+	glm::vec3 random_vec3(float Min, float Max)
+	{
+		return glm::vec3(random(Min, Max), random(Min, Max), random(Min, Max));
+	}
+
+	struct points
+	{
+		explicit points(std::size_t Count) : x(Count), y(Count), z(Count) {}
+
+		void set(std::size_t i, glm::vec3 const & v)
+		{
+			x[i] = v.x;
+			y[i] = v.y;
+			z[i] = v.z;
+		}
+
+		glm::vec3 get(std::size_t i) const
+		{
+			return glm::vec3(x[i], y[i], z[i]);
+		}
+
+		glm::batch::soa_vec3 soa()
+		{
+			glm::batch::soa_vec3 const Result = {x.data(), y.data(), z.data()};
+			return Result;
+		}
+
+		glm::batch::const_soa_vec3 soa() const
+		{
+			return glm::batch::const_soa_vec3(x.data(), y.data(), z.data());
+		}
+
+		std::vector<float> x, y, z;
+	};
+
+	struct flags
+	{
+		explicit flags(std::size_t Count) : data(new bool[Count + 1]()) {}
+		~flags() { delete[] data; }
+
+		bool * data;
+
+	private:
+		flags(flags const &);
+		flags & operator=(flags const &);
+	};
+
+	// triangles scattered around a ray so that about half of them are hit
+	struct triangles
+	{
+		triangles(glm::vec3 const & Orig, glm::vec3 const & Dir, std::size_t Count) : v0(Count), v1(Count), v2(Count)
+		{
+			for(std::size_t i = 0; i < Count; ++i)
+			{
+				glm::vec3 const Center = Orig + Dir * random(-2.0f, 20.0f);
+				v0.set(i, Center + random_vec3(-1.0f, 1.0f));
+				v1.set(i, Center + random_vec3(-1.0f, 1.0f));
+				v2.set(i, Center + random_vec3(-1.0f, 1.0f));
+			}
+		}
+
+		points v0, v1, v2;
+	};
+
+	// how far inside the triangle and in front of the origin the ray passes, in double: rounding
+	// may decide hits either way closer than this to an edge
+	double margin(glm::vec3 const & Orig, glm::vec3 const & Dir, glm::vec3 const & V0, glm::vec3 const & V1, glm::vec3 const & V2)
+	{
+		glm::dvec3 const e1 = glm::dvec3(V1) - glm::dvec3(V0);
+		glm::dvec3 const e2 = glm::dvec3(V2) - glm::dvec3(V0);
+		glm::dvec3 const p = glm::cross(glm::dvec3(Dir), e2);
+		double const a = glm::dot(e1, p);
+		if(std::abs(a) < 1e-4)
+			return 0.0;
+		glm::dvec3 const s = glm::dvec3(Orig) - glm::dvec3(V0);
+		glm::dvec3 const q = glm::cross(s, e1);
+		double const u = glm::dot(s, p) / a;
+		double const v = glm::dot(glm::dvec3(Dir), q) / a;
+		double const t = glm::dot(e2, q) / a;
+		return glm::min(glm::min(std::abs(u), std::abs(v)), glm::min(std::abs(1.0 - u - v), std::abs(t)));
+	}
+}//namespace
+
+namespace triangle
+{
+	// every count up to a few AVX-512 vectors, so each kernel ends in every possible remainder
+	int test()
+	{
+		int Error(0);
+
+		for(std::size_t Count = 0; Count <= 67; ++Count)
+		{
+			glm::vec3 const Orig = random_vec3(-10, 10);
+			glm::vec3 const Dir = glm::normalize(random_vec3(-1, 1));
+			triangles const Triangles(Orig, Dir, Count);
+
+			std::vector<bool> Scalar(Count), ScalarWatertight(Count);
+			std::vector<glm::vec3> Bary(Count), BaryWatertight(Count);
+			for(std::size_t i = 0; i < Count; ++i)
+			{
+				Scalar[i] = glm::intersectRayTriangle(Orig, Dir, Triangles.v0.get(i), Triangles.v1.get(i), Triangles.v2.get(i), Bary[i]);
+				ScalarWatertight[i] = glm::intersectRayTriangleWatertight(Orig, Dir, Triangles.v0.get(i), Triangles.v1.get(i), Triangles.v2.get(i), BaryWatertight[i]);
+			}
+
+			bool Hit[67], HitWatertight[67];
+			points Out(Count), OutWatertight(Count);
+			std::size_t const Hits = glm::intersectRayTriangles(Orig, Dir, Triangles.v0.soa(), Triangles.v1.soa(), Triangles.v2.soa(), Count, Hit, Out.soa());
+			std::size_t const HitsWatertight = glm::intersectRayTrianglesWatertight(Orig, Dir, Triangles.v0.soa(), Triangles.v1.soa(), Triangles.v2.soa(), Count, HitWatertight, OutWatertight.soa());
+
+			std::size_t Counted = 0, CountedWatertight = 0;
+			for(std::size_t i = 0; i < Count; ++i)
+			{
+				Counted += Hit[i] ? 1 : 0;
+				CountedWatertight += HitWatertight[i] ? 1 : 0;
+				if(margin(Orig, Dir, Triangles.v0.get(i), Triangles.v1.get(i), Triangles.v2.get(i)) < 1e-4)
+					continue;
+
+				// both algorithms, scalar or not, agree away from the edges
+				Error += Hit[i] == Scalar[i] ? 0 : 1;
+				Error += HitWatertight[i] == ScalarWatertight[i] ? 0 : 1;
+				Error += Scalar[i] == ScalarWatertight[i] ? 0 : 1;
+				if(Hit[i] && Scalar[i])
+					Error += glm::all(glm::epsilonEqual(Out.get(i), Bary[i], 1e-4f)) ? 0 : 1;
+				if(HitWatertight[i] && ScalarWatertight[i])
+				{
+					Error += glm::all(glm::epsilonEqual(OutWatertight.get(i), BaryWatertight[i], 1e-4f)) ? 0 : 1;
+					Error += glm::all(glm::epsilonEqual(BaryWatertight[i], Bary[i], 1e-3f)) ? 0 : 1;
+				}
+			}
+			Error += Hits == Counted ? 0 : 1;
+			Error += HitsWatertight == CountedWatertight ? 0 : 1;
+		}
+
+		// a hit behind the origin or in the plane of the triangle doesn't count
+		glm::vec3 Bary;
+		Error += !glm::intersectRayTriangleWatertight(glm::vec3(0, 0, 1), glm::vec3(0, 0, 1), glm::vec3(-1, -1, 0), glm::vec3(1, -1, 0), glm::vec3(0, 1, 0), Bary) ? 0 : 1;
+		Error += !glm::intersectRayTriangleWatertight(glm::vec3(-5, 0, 0), glm::vec3(1, 0, 0), glm::vec3(-1, -1, 0), glm::vec3(1, -1, 0), glm::vec3(0, 1, 0), Bary) ? 0 : 1;
+		Error += glm::intersectRayTriangleWatertight(glm::vec3(0, 0, 1), glm::vec3(0, 0, -1), glm::vec3(-1, -1, 0), glm::vec3(1, -1, 0), glm::vec3(0, 1, 0), Bary) ? 0 : 1;
+		Error += glm::epsilonEqual(Bary.z, 1.0f, 1e-6f) ? 0 : 1;
+
+		return Error;
+	}
+
+	// A grid of triangles, the rays aimed at its vertices and the middle of its edges, exactly where
+	// rounding decides which triangle is hit: the watertight test hits at least one every time.
+	int test_watertight()
+	{
+		int Error(0);
+
+		std::size_t const Size = 8;
+		std::vector<glm::vec3> Vertices;
+		for(std::size_t y = 0; y <= Size; ++y)
+		for(std::size_t x = 0; x <= Size; ++x)
+			Vertices.push_back(glm::vec3(static_cast<float>(x) * 0.37f, static_cast<float>(y) * 0.29f, 0.1f * static_cast<float>(x + y)));
+
+		points V0(Size * Size * 2), V1(Size * Size * 2), V2(Size * Size * 2);
+		std::vector<glm::vec3> Targets;
+		for(std::size_t y = 0; y < Size; ++y)
+		for(std::size_t x = 0; x < Size; ++x)
+		{
+			std::size_t const Corner = y * (Size + 1) + x;
+			glm::vec3 const A = Vertices[Corner], B = Vertices[Corner + 1], C = Vertices[Corner + Size + 1], D = Vertices[Corner + Size + 2];
+			std::size_t const Quad = (y * Size + x) * 2;
+			V0.set(Quad + 0, A); V1.set(Quad + 0, B); V2.set(Quad + 0, D);
+			V0.set(Quad + 1, A); V1.set(Quad + 1, D); V2.set(Quad + 1, C);
+
+			// inner vertices and edges only, the border has no neighbour
+			if(x > 0 && y > 0)
+				Targets.push_back(A);
+			Targets.push_back((A + D) * 0.5f);
+			if(y > 0)
+				Targets.push_back((A + B) * 0.5f);
+			if(x > 0)
+				Targets.push_back((A + C) * 0.5f);
+		}
+
+		std::size_t const Triangles = Size * Size * 2;
+		flags Hit(Triangles);
+		points Bary(Triangles);
+		std::size_t Missed = 0, MissedWatertight = 0;
+		for(std::size_t i = 0; i < Targets.size(); ++i)
+		for(int Ray = 0; Ray < 16; ++Ray)
+		{
+			glm::vec3 const Orig = Targets[i] + glm::vec3(random(-3, 3), random(-3, 3), random(1, 3));
+			glm::vec3 const Dir = Targets[i] - Orig;
+
+			bool * const Hits = Hit.data;
+			MissedWatertight += glm::intersectRayTrianglesWatertight(Orig, Dir, V0.soa(), V1.soa(), V2.soa(), Triangles, Hits, Bary.soa()) == 0 ? 1 : 0;
+			Missed += glm::intersectRayTriangles(Orig, Dir, V0.soa(), V1.soa(), V2.soa(), Triangles, Hits, Bary.soa()) == 0 ? 1 : 0;
+
+			std::size_t Scalar = 0;
+			for(std::size_t t = 0; t < Triangles; ++t)
+			{
+				glm::vec3 Position;
+				Scalar += glm::intersectRayTriangleWatertight(Orig, Dir, V0.get(t), V1.get(t), V2.get(t), Position) ? 1 : 0;
+			}
+			Error += Scalar > 0 ? 0 : 1;
+		}
+		Error += MissedWatertight == 0 ? 0 : 1;
+
+		std::printf("watertight: %d of %d rays through edges and vertices missed, %d with intersectRayTriangles\n",
+			static_cast<int>(MissedWatertight), static_cast<int>(Targets.size() * 16), static_cast<int>(Missed));
+
+		return Error;
+	}
+
+	int perf(std::size_t Count)
+	{
+		glm::vec3 const Orig(1, 2, 3);
+		glm::vec3 const Dir = glm::normalize(glm::vec3(1, -1, 0.5f));
+		triangles const Triangles(Orig, Dir, Count);
+		flags Hit(Count);
+		bool * const Hits = Hit.data;
+		points Bary(Count);
+
+		std::size_t Found = 0;
+		std::clock_t const Timestamp0 = std::clock();
+		for(int Iteration = 0; Iteration < 10; ++Iteration)
+			Found += glm::intersectRayTriangles(Orig, Dir, Triangles.v0.soa(), Triangles.v1.soa(), Triangles.v2.soa(), Count, Hits, Bary.soa());
+		std::clock_t const Timestamp1 = std::clock();
+		for(int Iteration = 0; Iteration < 10; ++Iteration)
+			Found += glm::intersectRayTrianglesWatertight(Orig, Dir, Triangles.v0.soa(), Triangles.v1.soa(), Triangles.v2.soa(), Count, Hits, Bary.soa());
+		std::clock_t const Timestamp2 = std::clock();
+		for(int Iteration = 0; Iteration < 10; ++Iteration)
+		for(std::size_t i = 0; i < Count; ++i)
+		{
+			glm::vec3 Position;
+			Found += glm::intersectRayTriangle(Orig, Dir, Triangles.v0.get(i), Triangles.v1.get(i), Triangles.v2.get(i), Position) ? 1 : 0;
+		}
+		std::clock_t const Timestamp3 = std::clock();
+		for(int Iteration = 0; Iteration < 10; ++Iteration)
+		for(std::size_t i = 0; i < Count; ++i)
+		{
+			glm::vec3 Position;
+			Found += glm::intersectRayTriangleWatertight(Orig, Dir, Triangles.v0.get(i), Triangles.v1.get(i), Triangles.v2.get(i), Position) ? 1 : 0;
+		}
+		std::clock_t const Timestamp4 = std::clock();
+
+		double const Tests = static_cast<double>(Count) * 10.0 * 1e-6 * CLOCKS_PER_SEC;
+		std::printf("ray-triangle: batch %.1f, scalar %.1f million tests per second\n",
+			Tests / glm::max(static_cast<double>(Timestamp1 - Timestamp0), 1.0), Tests / glm::max(static_cast<double>(Timestamp3 - Timestamp2), 1.0));
+		std::printf("ray-triangle watertight: batch %.1f, scalar %.1f million tests per second (%d hits)\n",
+			Tests / glm::max(static_cast<double>(Timestamp2 - Timestamp1), 1.0), Tests / glm::max(static_cast<double>(Timestamp4 - Timestamp3), 1.0), static_cast<int>(Found));
+		return 0;
+	}
+}//namespace triangle
+
+namespace box
+{
+	// the exact answer, in double: the ray goes through the box or misses it by more than rounding
+	int exact(glm::vec3 const & Orig, glm::vec3 const & Dir, glm::vec3 const & Min, glm::vec3 const & Max)
+	{
+		double Near = 0.0, Far = 1e300;
+		for(glm::length_t i = 0; i < 3; ++i)
+		{
+			if(Dir[i] == 0.0f)
+			{
+				if(Orig[i] < Min[i] || Orig[i] > Max[i])
+					return 0;
+				continue;
+			}
+			double const t0 = (static_cast<double>(Min[i]) - Orig[i]) / Dir[i];
+			double const t1 = (static_cast<double>(Max[i]) - Orig[i]) / Dir[i];
+			Near = glm::max(Near, glm::min(t0, t1));
+			Far = glm::min(Far, glm::max(t0, t1));
+		}
+		return Near < Far * (1.0 - 1e-5) ? 1 : (Near > Far * (1.0 + 1e-5) ? 0 : -1);
+	}
+
+	int test()
+	{
+		int Error(0);
+
+		for(std::size_t Count = 0; Count <= 67; ++Count)
+		{
+			glm::vec3 const Orig = random_vec3(-10, 10);
+			glm::vec3 Dir = glm::normalize(random_vec3(-1, 1));
+			if(Count % 3 == 0)
+				Dir[Count % 2] = 0.0f; // a slab the ray is parallel to
+
+			points Min(Count), Max(Count);
+			for(std::size_t i = 0; i < Count; ++i)
+			{
+				glm::vec3 const Center = Orig + Dir * random(-5, 20) + random_vec3(-2, 2);
+				glm::vec3 const Extent = random_vec3(0.1f, 2.0f);
+				Min.set(i, Center - Extent);
+				Max.set(i, Center + Extent);
+			}
+
+			bool Hit[67];
+			float Distance[67];
+			std::size_t const Hits = glm::intersectRayBoxes(Orig, Dir, Min.soa(), Max.soa(), Count, Hit, Distance);
+
+			std::size_t Counted = 0;
+			for(std::size_t i = 0; i < Count; ++i)
+			{
+				// the same slab test scalar or not, but x87 keeps excess precision the SIMD lanes don't:
+				// the answers agree away from the box's edges, the distances up to rounding
+				float ScalarDistance = 0.0f;
+				bool const Scalar = glm::intersectRayBox(Orig, Dir, Min.get(i), Max.get(i), ScalarDistance);
+				int const Exact = exact(Orig, Dir, Min.get(i), Max.get(i));
+				Error += Exact < 0 || Hit[i] == Scalar ? 0 : 1;
+				Error += Exact < 0 || Hit[i] == (Exact == 1) ? 0 : 1;
+				Error += !Hit[i] || !Scalar || glm::abs(Distance[i] - ScalarDistance) <= 1e-5f * glm::max(glm::abs(ScalarDistance), 1.0f) ? 0 : 1;
+				Counted += Hit[i] ? 1 : 0;
+			}
+			Error += Hits == Counted ? 0 : 1;
+		}
+
+		float Distance = 0.0f;
+		Error += glm::intersectRayBox(glm::vec3(-1, 0.5f, 0.5f), glm::vec3(1, 0, 0), glm::vec3(0), glm::vec3(1), Distance) && Distance == 1.0f ? 0 : 1;
+		Error += glm::intersectRayBox(glm::vec3(0.5f), glm::vec3(0, 1, 0), glm::vec3(0), glm::vec3(1), Distance) && Distance == 0.0f ? 0 : 1;
+		Error += !glm::intersectRayBox(glm::vec3(-1, 0.5f, 0.5f), glm::vec3(-1, 0, 0), glm::vec3(0), glm::vec3(1), Distance) ? 0 : 1;
+		Error += !glm::intersectRayBox(glm::vec3(-1, 2, 0.5f), glm::vec3(1, 0, 0), glm::vec3(0), glm::vec3(1), Distance) ? 0 : 1;
+
+		return Error;
+	}
+
+	int perf(std::size_t Count)
+	{
+		glm::vec3 const Orig(1, 2, 3);
+		glm::vec3 const Dir = glm::normalize(glm::vec3(1, -1, 0.5f));
+		points Min(Count), Max(Count);
+		for(std::size_t i = 0; i < Count; ++i)
+		{
+			glm::vec3 const Center = Orig + Dir * random(-5, 20) + random_vec3(-2, 2);
+			Min.set(i, Center - glm::vec3(0.5f));
+			Max.set(i, Center + glm::vec3(0.5f));
+		}
+		flags Hit(Count);
+		std::vector<float> Distance(Count);
+
+		std::size_t Found = 0;
+		std::clock_t const Timestamp0 = std::clock();
+		for(int Iteration = 0; Iteration < 10; ++Iteration)
+			Found += glm::intersectRayBoxes(Orig, Dir, Min.soa(), Max.soa(), Count, Hit.data, &Distance[0]);
+		std::clock_t const Timestamp1 = std::clock();
+		for(int Iteration = 0; Iteration < 10; ++Iteration)
+		for(std::size_t i = 0; i < Count; ++i)
+			Found += glm::intersectRayBox(Orig, Dir, Min.get(i), Max.get(i), Distance[i]) ? 1 : 0;
+		std::clock_t const Timestamp2 = std::clock();
+
+		double const Tests = static_cast<double>(Count) * 10.0 * 1e-6 * CLOCKS_PER_SEC;
+		std::printf("ray-box: batch %.1f, scalar %.1f million tests per second (%d hits)\n",
+			Tests / glm::max(static_cast<double>(Timestamp1 - Timestamp0), 1.0), Tests / glm::max(static_cast<double>(Timestamp2 - Timestamp1), 1.0), static_cast<int>(Found));
+		return 0;
+	}
+}//namespace box
+
+namespace frustum
+{
+	// Gribb and Hartmann: the planes are sums and differences of the rows of the view projection
+	void planes(glm::mat4 const & ViewProj, glm::vec4 * Planes)
+	{
+		glm::mat4 const M = glm::transpose(ViewProj);
+		Planes[0] = M[3] + M[0];
+		Planes[1] = M[3] - M[0];
+		Planes[2] = M[3] + M[1];
+		Planes[3] = M[3] - M[1];
+		Planes[4] = M[3] + M[2];
+		Planes[5] = M[3] - M[2];
+		for(std::size_t i = 0; i < 6; ++i)
+			Planes[i] /= glm::length(glm::vec3(Planes[i]));
+	}
+
+	// how far the sphere is from crossing a plane, rounding may decide either way closer than this
+	float margin(glm::vec4 const * Planes, glm::vec3 const & Center, float Radius)
+	{
+		float Result = 1e30f;
+		for(std::size_t i = 0; i < 6; ++i)
+			Result = glm::min(Result, std::abs(glm::dot(glm::vec3(Planes[i]), Center) + Planes[i].w + Radius));
+		return Result;
+	}
+
+	int test()
+	{
+		int Error(0);
+
+		glm::vec4 Planes[6];
+		planes(glm::perspective(glm::radians(60.0f), 1.5f, 0.1f, 100.0f) * glm::lookAt(glm::vec3(0, 0, 5), glm::vec3(0), glm::vec3(0, 1, 0)), Planes);
+
+		for(std::size_t Count = 0; Count <= 67; ++Count)
+		{
+			points Centers(Count);
+			std::vector<float> Radius(Count);
+			for(std::size_t i = 0; i < Count; ++i)
+			{
+				Centers.set(i, random_vec3(-60, 60));
+				Radius[i] = random(0.0f, 10.0f);
+			}
+
+			bool Inside[67];
+			std::size_t const Hits = glm::intersectSpheresFrustum(Centers.soa(), &Radius[0], Count, Planes, Inside);
+
+			std::size_t Counted = 0;
+			for(std::size_t i = 0; i < Count; ++i)
+			{
+				Counted += Inside[i] ? 1 : 0;
+				if(margin(Planes, Centers.get(i), Radius[i]) > 1e-4f)
+					Error += Inside[i] == glm::intersectSphereFrustum(Centers.get(i), Radius[i], Planes) ? 0 : 1;
+			}
+			Error += Hits == Counted ? 0 : 1;
+		}
+
+		Error += glm::intersectSphereFrustum(glm::vec3(0), 1.0f, Planes) ? 0 : 1;
+		Error += !glm::intersectSphereFrustum(glm::vec3(0, 0, 10), 1.0f, Planes) ? 0 : 1;
+		Error += glm::intersectSphereFrustum(glm::vec3(0, 0, 5.5f), 1.0f, Planes) ? 0 : 1;
+		Error += !glm::intersectSphereFrustum(glm::vec3(0, 0, -200), 50.0f, Planes) ? 0 : 1;
+
+		return Error;
+	}
+
+	int perf(std::size_t Count)
+	{
+		glm::vec4 Planes[6];
+		planes(glm::perspective(glm::radians(60.0f), 1.5f, 0.1f, 100.0f) * glm::lookAt(glm::vec3(0, 0, 5), glm::vec3(0), glm::vec3(0, 1, 0)), Planes);
+		points Centers(Count);
+		std::vector<float> Radius(Count);
+		for(std::size_t i = 0; i < Count; ++i)
+		{
+			Centers.set(i, random_vec3(-60, 60));
+			Radius[i] = random(0.0f, 10.0f);
+		}
+		flags Inside(Count);
+
+		std::size_t Found = 0;
+		std::clock_t const Timestamp0 = std::clock();
+		for(int Iteration = 0; Iteration < 10; ++Iteration)
+			Found += glm::intersectSpheresFrustum(Centers.soa(), &Radius[0], Count, Planes, Inside.data);
+		std::clock_t const Timestamp1 = std::clock();
+		for(int Iteration = 0; Iteration < 10; ++Iteration)
+		for(std::size_t i = 0; i < Count; ++i)
+			Found += glm::intersectSphereFrustum(Centers.get(i), Radius[i], Planes) ? 1 : 0;
+		std::clock_t const Timestamp2 = std::clock();
+
+		double const Tests = static_cast<double>(Count) * 10.0 * 1e-6 * CLOCKS_PER_SEC;
+		std::printf("sphere-frustum: batch %.1f, scalar %.1f million tests per second (%d inside)\n",
+			Tests / glm::max(static_cast<double>(Timestamp1 - Timestamp0), 1.0), Tests / glm::max(static_cast<double>(Timestamp2 - Timestamp1), 1.0), static_cast<int>(Found));
+		return 0;
+	}
+}//namespace frustum
 
 int main()
 {
 	int Error(0);
 
+	Error += triangle::test();
+	Error += triangle::test_watertight();
+	Error += box::test();
+	Error += frustum::test();
+
+#	ifdef NDEBUG
+		std::size_t const Samples = 1000000;
+		Error += triangle::perf(Samples);
+		Error += box::perf(Samples);
+		Error += frustum::perf(Samples);
+#	endif//NDEBUG
+
 	return Error;
 }
@@ -0,0 +1,969 @@
+#pragma once
+
+/*
+	Include dependencies: glm (+ gtc/matrix_transform), Macros.h, JobSystem.h, CpuProfiler.h
+*/
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <chrono>
+#include <ostream>
+#include <limits>
+#include <cmath>
+#include <stdint.h>
+
+// ray/box slab test on 4 lanes (xyz of one box) with SSE, both children of a node at once with AVX
+#if defined(__AVX__)
+#define PV_BVH_AVX 1
+#else
+#define PV_BVH_AVX 0
+#endif
+#if PV_BVH_AVX || defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PV_BVH_SSE 1
+#include <immintrin.h>
+#else
+#define PV_BVH_SSE 0
+#endif
+
+
+// 32 bytes, min and max each load as one 16 byte vector (the w lanes hold the ints).
+// Siblings are always next to each other so a node only stores its left child.
+struct BvhNode
+{
+	glm::vec3 boundsMin;
+	uint32_t leftOrFirst;	// interior: left child, the right one is leftOrFirst + 1. leaf: first entry in Bvh::primitiveIndices
+	glm::vec3 boundsMax;
+	uint32_t count;			// primitives in a leaf, 0 for interior nodes
+
+	bool isLeaf() const { return count != 0; }
+};
+static_assert(sizeof(BvhNode) == 32, "BvhNode: keep it at half a cache line");
+
+// t in [0, tMax], direction doesn't have to be normalized (t is in units of it)
+struct BvhRay
+{
+	glm::vec3 origin;
+	glm::vec3 direction;
+	float tMax;
+
+	BvhRay(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, float maxDistance = std::numeric_limits<float>::max())
+		: origin(rayOrigin), direction(rayDirection), tMax(maxDistance)
+	{ }
+};
+
+struct RayHit
+{
+	static const uint32_t NONE = 0xFFFFFFFF;
+
+	float t = std::numeric_limits<float>::max();
+	uint32_t instance = NONE;
+	uint32_t triangle = NONE;	// index into the mesh's index buffer / 3
+	float u = 0.0f, v = 0.0f;	// barycentrics of vertex 1 and 2
+
+	bool hit() const { return triangle != NONE; }
+};
+
+
+namespace bvh_detail
+{
+	static const float NO_HIT = std::numeric_limits<float>::infinity();
+
+	// per ray constants of the slab test
+	struct RayData
+	{
+		glm::vec3 origin;
+		glm::vec3 invDirection;
+#if PV_BVH_SSE
+		__m128 origin4, invDirection4;
+#endif
+#if PV_BVH_AVX
+		__m256 origin8, invDirection8;
+#endif
+
+		explicit RayData(const BvhRay& ray)
+		{
+			origin = ray.origin;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				// a huge finite 1/d instead of inf keeps 0 * inf NaNs out of the slab test
+				float d = ray.direction[axis];
+				if (std::abs(d) < 1e-30f) d = d < 0.0f ? -1e-30f : 1e-30f;
+				invDirection[axis] = 1.0f / d;
+			}
+#if PV_BVH_SSE
+			origin4 = _mm_setr_ps(origin.x, origin.y, origin.z, 0.0f);
+			invDirection4 = _mm_setr_ps(invDirection.x, invDirection.y, invDirection.z, 0.0f);
+#endif
+#if PV_BVH_AVX
+			origin8 = _mm256_set_m128(origin4, origin4);
+			invDirection8 = _mm256_set_m128(invDirection4, invDirection4);
+#endif
+		}
+	};
+
+	// distance the ray enters the box at, NO_HIT if it misses it within [0, tMax]
+	inline float intersectBox(const BvhNode& node, const RayData& r, float tMax)
+	{
+#if PV_BVH_SSE
+		__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.boundsMin.x), r.origin4), r.invDirection4);
+		__m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.boundsMax.x), r.origin4), r.invDirection4);
+		__m128 tNear = _mm_min_ps(t1, t2);
+		__m128 tFar = _mm_max_ps(t1, t2);
+		// xyz only, w is the node's ints
+		tNear = _mm_max_ss(tNear, _mm_max_ss(_mm_shuffle_ps(tNear, tNear, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(tNear, tNear, _MM_SHUFFLE(2, 2, 2, 2))));
+		tFar = _mm_min_ss(tFar, _mm_min_ss(_mm_shuffle_ps(tFar, tFar, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(tFar, tFar, _MM_SHUFFLE(2, 2, 2, 2))));
+		float entry = std::max(_mm_cvtss_f32(tNear), 0.0f);
+		float exit = std::min(_mm_cvtss_f32(tFar), tMax);
+#else
+		glm::vec3 t1 = (node.boundsMin - r.origin) * r.invDirection;
+		glm::vec3 t2 = (node.boundsMax - r.origin) * r.invDirection;
+		glm::vec3 tNear = glm::min(t1, t2), tFar = glm::max(t1, t2);
+		float entry = std::max(std::max(std::max(tNear.x, tNear.y), tNear.z), 0.0f);
+		float exit = std::min(std::min(std::min(tFar.x, tFar.y), tFar.z), tMax);
+#endif
+		return entry <= exit ? entry : NO_HIT;
+	}
+
+	// both children of an interior node, they sit next to each other
+	inline void intersectChildren(const BvhNode* left, const RayData& r, float tMax, float& leftEntry, float& rightEntry)
+	{
+#if PV_BVH_AVX
+		// [left min | left max] and [right min | right max] -> [left min | right min] and [left max | right max]
+		__m256 a = _mm256_loadu_ps(&left[0].boundsMin.x);
+		__m256 b = _mm256_loadu_ps(&left[1].boundsMin.x);
+		__m256 mins = _mm256_permute2f128_ps(a, b, 0x20);
+		__m256 maxs = _mm256_permute2f128_ps(a, b, 0x31);
+		__m256 t1 = _mm256_mul_ps(_mm256_sub_ps(mins, r.origin8), r.invDirection8);
+		__m256 t2 = _mm256_mul_ps(_mm256_sub_ps(maxs, r.origin8), r.invDirection8);
+		__m256 tNear = _mm256_min_ps(t1, t2);
+		__m256 tFar = _mm256_max_ps(t1, t2);
+		// lanes 0 and 4 end up with max(x, y, z) / min(x, y, z) of each box
+		tNear = _mm256_max_ps(tNear, _mm256_max_ps(_mm256_shuffle_ps(tNear, tNear, _MM_SHUFFLE(1, 1, 1, 1)), _mm256_shuffle_ps(tNear, tNear, _MM_SHUFFLE(2, 2, 2, 2))));
+		tFar = _mm256_min_ps(tFar, _mm256_min_ps(_mm256_shuffle_ps(tFar, tFar, _MM_SHUFFLE(1, 1, 1, 1)), _mm256_shuffle_ps(tFar, tFar, _MM_SHUFFLE(2, 2, 2, 2))));
+		tNear = _mm256_max_ps(tNear, _mm256_setzero_ps());
+		tFar = _mm256_min_ps(tFar, _mm256_set1_ps(tMax));
+
+		float leftNear = _mm256_cvtss_f32(tNear), leftFar = _mm256_cvtss_f32(tFar);
+		float rightNear = _mm_cvtss_f32(_mm256_extractf128_ps(tNear, 1)), rightFar = _mm_cvtss_f32(_mm256_extractf128_ps(tFar, 1));
+		leftEntry = leftNear <= leftFar ? leftNear : NO_HIT;
+		rightEntry = rightNear <= rightFar ? rightNear : NO_HIT;
+#else
+		leftEntry = intersectBox(left[0], r, tMax);
+		rightEntry = intersectBox(left[1], r, tMax);
+#endif
+	}
+
+	struct Bounds
+	{
+		glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+		void grow(const glm::vec3& p) { min = glm::min(min, p); max = glm::max(max, p); }
+		void grow(const glm::vec3& boxMin, const glm::vec3& boxMax) { min = glm::min(min, boxMin); max = glm::max(max, boxMax); }
+		void grow(const Bounds& other) { grow(other.min, other.max); }
+		float area() const
+		{
+			glm::vec3 e = max - min;
+			return e.x < 0.0f ? 0.0f : 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+		}
+	};
+
+	// box around the box transformed by an affine matrix
+	inline void transformBounds(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::mat4& m, glm::vec3& outMin, glm::vec3& outMax)
+	{
+		glm::vec3 center = (boxMin + boxMax) * 0.5f;
+		glm::vec3 extent = (boxMax - boxMin) * 0.5f;
+		glm::vec3 worldCenter = glm::vec3(m * glm::vec4(center, 1.0f));
+		glm::vec3 worldExtent = glm::abs(glm::vec3(m[0])) * extent.x + glm::abs(glm::vec3(m[1])) * extent.y + glm::abs(glm::vec3(m[2])) * extent.z;
+		outMin = worldCenter - worldExtent;
+		outMax = worldCenter + worldExtent;
+	}
+}
+
+
+// Binary BVH over anything with an AABB. Built top down with binned SAH, large nodes are binned
+// across the job system and the subtrees below them are built in parallel. refit() keeps the
+// tree and only updates the boxes, for things that moved but didn't change much.
+struct Bvh
+{
+	std::vector<BvhNode> nodes;
+	std::vector<uint32_t> primitiveIndices;	// leaves point into this, the entries are the primitive indices build() got
+
+	static const uint32_t BIN_COUNT = 16;
+	static const uint32_t MAX_LEAF_SIZE = 8;
+
+	// jobs may be null for a single threaded build
+	void build(const glm::vec3* primitiveMin, const glm::vec3* primitiveMax, uint32_t primitiveCount, JobSystem* jobs)
+	{
+		PV_PROFILE_FUNCTION();
+		nodes.clear();
+		primitiveIndices.resize(primitiveCount);
+		if (primitiveCount == 0) return;
+
+		boxMin = primitiveMin;
+		boxMax = primitiveMax;
+		centroids.resize(primitiveCount);
+		nodes.resize(2 * primitiveCount - 1);
+		nodesUsed = 1;
+
+		BuildTask root;
+		root.node = 0;
+		root.first = 0;
+		root.count = primitiveCount;
+		forRange(jobs, primitiveCount, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				primitiveIndices[i] = i;
+				centroids[i] = (primitiveMin[i] + primitiveMax[i]) * 0.5f;
+			}
+		});
+		// node and centroid bounds of the root, after that they come out of the parent's bins
+		{
+			std::vector<bvh_detail::Bounds> chunkBounds((primitiveCount + PARALLEL_GRAIN_SIZE - 1) / PARALLEL_GRAIN_SIZE);
+			std::vector<bvh_detail::Bounds> chunkCentroids(chunkBounds.size());
+			forRange(jobs, primitiveCount, [&](uint32_t begin, uint32_t end)
+			{
+				uint32_t chunk = begin / PARALLEL_GRAIN_SIZE;
+				for (uint32_t i = begin; i < end; ++i)
+				{
+					chunkBounds[chunk].grow(primitiveMin[i], primitiveMax[i]);
+					chunkCentroids[chunk].grow(centroids[i]);
+				}
+			});
+			for (size_t chunk = 0; chunk < chunkBounds.size(); ++chunk)
+			{
+				root.bounds.grow(chunkBounds[chunk]);
+				root.centroidBounds.grow(chunkCentroids[chunk]);
+			}
+		}
+
+		// split big nodes here with the binning spread over the job system until there are
+		// enough independent subtrees to keep every thread busy, then build those in parallel
+		const uint32_t threads = jobs != nullptr ? jobs->threadCount() : 1;
+		const uint32_t subtreeSize = std::max(PARALLEL_GRAIN_SIZE, primitiveCount / (8 * threads));
+		std::vector<BuildTask> pending = { root };
+		std::vector<BuildTask> subtrees;
+		while (!pending.empty())
+		{
+			BuildTask task = pending.back();
+			pending.pop_back();
+			if (jobs == nullptr || task.count <= subtreeSize)
+			{
+				subtrees.push_back(task);
+				continue;
+			}
+			BuildTask children[2];
+			if (split(task, jobs, children))
+			{
+				pending.push_back(children[0]);
+				pending.push_back(children[1]);
+			}
+		}
+		auto buildSubtrees = [&](uint32_t begin, uint32_t end)
+		{
+			std::vector<BuildTask> stack;
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				stack.push_back(subtrees[i]);
+				while (!stack.empty())
+				{
+					BuildTask task = stack.back();
+					stack.pop_back();
+					BuildTask children[2];
+					if (split(task, nullptr, children))
+					{
+						stack.push_back(children[0]);
+						stack.push_back(children[1]);
+					}
+				}
+			}
+		};
+		if (jobs != nullptr)
+			jobs->parallelFor(static_cast<uint32_t>(subtrees.size()), 1, buildSubtrees);
+		else
+			buildSubtrees(0, static_cast<uint32_t>(subtrees.size()));
+
+		nodes.resize(nodesUsed);
+		centroids.clear();
+	}
+
+	// New primitive boxes, same tree. Children always come after their parent, so one backwards
+	// pass sees every child before its parent.
+	void refit(const glm::vec3* primitiveMin, const glm::vec3* primitiveMax)
+	{
+		PV_PROFILE_FUNCTION();
+		for (size_t i = nodes.size(); i-- > 0;)
+		{
+			BvhNode& node = nodes[i];
+			bvh_detail::Bounds bounds;
+			if (node.isLeaf())
+			{
+				for (uint32_t p = node.leftOrFirst; p < node.leftOrFirst + node.count; ++p)
+				{
+					bounds.grow(primitiveMin[primitiveIndices[p]], primitiveMax[primitiveIndices[p]]);
+				}
+			}
+			else
+			{
+				bounds.grow(nodes[node.leftOrFirst].boundsMin, nodes[node.leftOrFirst].boundsMax);
+				bounds.grow(nodes[node.leftOrFirst + 1].boundsMin, nodes[node.leftOrFirst + 1].boundsMax);
+			}
+			node.boundsMin = bounds.min;
+			node.boundsMax = bounds.max;
+		}
+	}
+
+	// Front to back through every leaf the ray touches. intersectPrimitive(primitive, tMax) tests
+	// one primitive and lowers tMax on a hit, boxes further away than that are skipped.
+	template<typename F>
+	void traverse(const BvhRay& ray, float& tMax, F&& intersectPrimitive) const
+	{
+		if (nodes.empty()) return;
+		const bvh_detail::RayData r(ray);
+		if (bvh_detail::intersectBox(nodes[0], r, tMax) == bvh_detail::NO_HIT) return;
+
+		uint32_t stack[64];
+		float stackEntry[64];
+		uint32_t stackSize = 0;
+		const BvhNode* node = &nodes[0];
+		for (;;)
+		{
+			if (node->isLeaf())
+			{
+				for (uint32_t p = node->leftOrFirst; p < node->leftOrFirst + node->count; ++p)
+				{
+					intersectPrimitive(primitiveIndices[p], tMax);
+				}
+			}
+			else
+			{
+				const BvhNode* left = &nodes[node->leftOrFirst];
+				float leftEntry, rightEntry;
+				bvh_detail::intersectChildren(left, r, tMax, leftEntry, rightEntry);
+				const BvhNode* nearChild = left;
+				const BvhNode* farChild = left + 1;
+				if (rightEntry < leftEntry)
+				{
+					std::swap(nearChild, farChild);
+					std::swap(leftEntry, rightEntry);
+				}
+				if (leftEntry != bvh_detail::NO_HIT)
+				{
+					if (rightEntry != bvh_detail::NO_HIT)
+					{
+						PV_ASSERT(stackSize < 64, "Bvh: traversal stack overflow");
+						stack[stackSize] = static_cast<uint32_t>(farChild - nodes.data());
+						stackEntry[stackSize++] = rightEntry;
+					}
+					node = nearChild;
+					continue;
+				}
+			}
+
+			// next node on the stack that is still closer than the closest hit
+			node = nullptr;
+			while (stackSize > 0)
+			{
+				--stackSize;
+				if (stackEntry[stackSize] <= tMax)
+				{
+					node = &nodes[stack[stackSize]];
+					break;
+				}
+			}
+			if (node == nullptr) return;
+		}
+	}
+
+	// onPrimitive(primitive) for every primitive whose leaf box overlaps [queryMin, queryMax]
+	template<typename F>
+	void query(const glm::vec3& queryMin, const glm::vec3& queryMax, F&& onPrimitive) const
+	{
+		if (nodes.empty()) return;
+		uint32_t stack[64];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0)
+		{
+			const BvhNode& node = nodes[stack[--stackSize]];
+			if (glm::any(glm::lessThan(node.boundsMax, queryMin)) || glm::any(glm::greaterThan(node.boundsMin, queryMax)))
+				continue;
+			if (node.isLeaf())
+			{
+				for (uint32_t p = node.leftOrFirst; p < node.leftOrFirst + node.count; ++p)
+				{
+					onPrimitive(primitiveIndices[p]);
+				}
+			}
+			else
+			{
+				PV_ASSERT(stackSize + 2 <= 64, "Bvh: query stack overflow");
+				stack[stackSize++] = node.leftOrFirst;
+				stack[stackSize++] = node.leftOrFirst + 1;
+			}
+		}
+	}
+
+private:
+	struct BuildTask
+	{
+		uint32_t node;
+		uint32_t first;
+		uint32_t count;
+		bvh_detail::Bounds bounds;
+		bvh_detail::Bounds centroidBounds;
+	};
+	struct Bin
+	{
+		bvh_detail::Bounds bounds;
+		bvh_detail::Bounds centroidBounds;
+		uint32_t count = 0;
+	};
+	typedef Bin AxisBins[3][BIN_COUNT];
+
+	static const uint32_t PARALLEL_GRAIN_SIZE = 16 * 1024;
+
+	// build() input, only valid while building
+	const glm::vec3* boxMin = nullptr;
+	const glm::vec3* boxMax = nullptr;
+	std::vector<glm::vec3> centroids;
+	std::atomic<uint32_t> nodesUsed{ 0 };
+
+	template<typename F>
+	static void forRange(JobSystem* jobs, uint32_t count, F&& func)
+	{
+		if (jobs != nullptr)
+			jobs->parallelFor(count, PARALLEL_GRAIN_SIZE, func);
+		else
+			for (uint32_t begin = 0; begin < count; begin += PARALLEL_GRAIN_SIZE)
+				func(begin, std::min(begin + PARALLEL_GRAIN_SIZE, count));
+	}
+
+	uint32_t binIndex(const glm::vec3& centroid, int axis, const BuildTask& task, float scale) const
+	{
+		int bin = static_cast<int>((centroid[axis] - task.centroidBounds.min[axis]) * scale);
+		return static_cast<uint32_t>(std::min(std::max(bin, 0), static_cast<int>(BIN_COUNT) - 1));
+	}
+
+	void binRange(const BuildTask& task, const float scale[3], uint32_t begin, uint32_t end, AxisBins& bins) const
+	{
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const uint32_t primitive = primitiveIndices[i];
+			const glm::vec3& centroid = centroids[primitive];
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				Bin& bin = bins[axis][binIndex(centroid, axis, task, scale[axis])];
+				bin.bounds.grow(boxMin[primitive], boxMax[primitive]);
+				bin.centroidBounds.grow(centroid);
+				++bin.count;
+			}
+		}
+	}
+
+	// Writes task's node as a leaf or splits it along the cheapest SAH plane and returns the
+	// two children to build next.
+	bool split(const BuildTask& task, JobSystem* jobs, BuildTask children[2])
+	{
+		BvhNode& node = nodes[task.node];
+		node.boundsMin = task.bounds.min;
+		node.boundsMax = task.bounds.max;
+
+		auto makeLeaf = [&]()
+		{
+			node.leftOrFirst = task.first;
+			node.count = task.count;
+			return false;
+		};
+		if (task.count <= 2)
+			return makeLeaf();
+
+		const glm::vec3 centroidExtent = task.centroidBounds.max - task.centroidBounds.min;
+		float scale[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			scale[axis] = centroidExtent[axis] > 0.0f ? BIN_COUNT / centroidExtent[axis] : 0.0f;
+		}
+
+		AxisBins bins;
+		if (jobs != nullptr && task.count > PARALLEL_GRAIN_SIZE)
+		{
+			std::vector<AxisBins> chunkBins((task.count + PARALLEL_GRAIN_SIZE - 1) / PARALLEL_GRAIN_SIZE);
+			jobs->parallelFor(task.count, PARALLEL_GRAIN_SIZE, [&](uint32_t begin, uint32_t end)
+			{
+				binRange(task, scale, task.first + begin, task.first + end, chunkBins[begin / PARALLEL_GRAIN_SIZE]);
+			});
+			for (const AxisBins& chunk : chunkBins)
+				for (int axis = 0; axis < 3; ++axis)
+					for (uint32_t b = 0; b < BIN_COUNT; ++b)
+					{
+						bins[axis][b].bounds.grow(chunk[axis][b].bounds);
+						bins[axis][b].centroidBounds.grow(chunk[axis][b].centroidBounds);
+						bins[axis][b].count += chunk[axis][b].count;
+					}
+		}
+		else
+		{
+			binRange(task, scale, task.first, task.first + task.count, bins);
+		}
+
+		// cost of a plane after bin b: leftArea * leftCount + rightArea * rightCount
+		float bestCost = std::numeric_limits<float>::max();
+		int bestAxis = -1;
+		uint32_t bestPlane = 0;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			if (scale[axis] == 0.0f) continue;
+			float rightCost[BIN_COUNT];
+			bvh_detail::Bounds right;
+			uint32_t rightCount = 0;
+			for (uint32_t b = BIN_COUNT - 1; b > 0; --b)
+			{
+				right.grow(bins[axis][b].bounds);
+				rightCount += bins[axis][b].count;
+				rightCost[b] = rightCount > 0 ? right.area() * rightCount : -1.0f;
+			}
+			bvh_detail::Bounds left;
+			uint32_t leftCount = 0;
+			for (uint32_t plane = 1; plane < BIN_COUNT; ++plane)
+			{
+				left.grow(bins[axis][plane - 1].bounds);
+				leftCount += bins[axis][plane - 1].count;
+				if (leftCount == 0 || rightCost[plane] < 0.0f) continue;
+				float cost = left.area() * leftCount + rightCost[plane];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestPlane = plane;
+				}
+			}
+		}
+
+		// traversal costs about as much as one primitive test
+		const float leafCost = static_cast<float>(task.count);
+		const float splitCost = 1.0f + bestCost / std::max(task.bounds.area(), 1e-30f);
+		if (bestAxis < 0 || (splitCost >= leafCost && task.count <= MAX_LEAF_SIZE))
+		{
+			if (bestAxis >= 0 || task.count <= MAX_LEAF_SIZE)
+				return makeLeaf();
+			return splitMedian(task, children);	// every centroid in one spot, SAH can't help
+		}
+
+		// partition the range around the plane
+		uint32_t* begin = primitiveIndices.data() + task.first;
+		uint32_t* middle = std::partition(begin, begin + task.count, [&](uint32_t primitive)
+		{
+			return binIndex(centroids[primitive], bestAxis, task, scale[bestAxis]) < bestPlane;
+		});
+		const uint32_t leftCount = static_cast<uint32_t>(middle - begin);
+
+		for (int side = 0; side < 2; ++side)
+		{
+			children[side] = BuildTask();
+			uint32_t binBegin = side == 0 ? 0 : bestPlane;
+			uint32_t binEnd = side == 0 ? bestPlane : BIN_COUNT;
+			for (uint32_t b = binBegin; b < binEnd; ++b)
+			{
+				children[side].bounds.grow(bins[bestAxis][b].bounds);
+				children[side].centroidBounds.grow(bins[bestAxis][b].centroidBounds);
+			}
+		}
+		return link(task, leftCount, children);
+	}
+
+	// halves by index, bounds from scratch
+	bool splitMedian(const BuildTask& task, BuildTask children[2])
+	{
+		const uint32_t leftCount = task.count / 2;
+		for (int side = 0; side < 2; ++side)
+		{
+			children[side] = BuildTask();
+			uint32_t begin = task.first + (side == 0 ? 0 : leftCount);
+			uint32_t end = side == 0 ? task.first + leftCount : task.first + task.count;
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				children[side].bounds.grow(boxMin[primitiveIndices[i]], boxMax[primitiveIndices[i]]);
+				children[side].centroidBounds.grow(centroids[primitiveIndices[i]]);
+			}
+		}
+		return link(task, leftCount, children);
+	}
+
+	bool link(const BuildTask& task, uint32_t leftCount, BuildTask children[2])
+	{
+		const uint32_t left = nodesUsed.fetch_add(2);
+		BvhNode& node = nodes[task.node];
+		node.leftOrFirst = left;
+		node.count = 0;
+
+		children[0].node = left;
+		children[0].first = task.first;
+		children[0].count = leftCount;
+		children[1].node = left + 1;
+		children[1].first = task.first + leftCount;
+		children[1].count = task.count - leftCount;
+		return true;
+	}
+};
+
+
+// Bottom level: one BVH over the triangles of a mesh, in mesh space
+struct MeshBvh
+{
+	Bvh bvh;
+
+	// positions: the first vertex's position, positionStride bytes between vertices (sizeof(Vertex) for Vertex arrays)
+	void build(const void* positions, uint32_t positionStride, const uint32_t* indices, uint32_t triangleCount, JobSystem* jobs)
+	{
+		PV_PROFILE_FUNCTION();
+		triangles.resize(triangleCount);
+		std::vector<glm::vec3> triangleMin(triangleCount), triangleMax(triangleCount);
+		const char* base = static_cast<const char*>(positions);
+		auto position = [&](uint32_t index) { return *reinterpret_cast<const glm::vec3*>(base + static_cast<size_t>(index) * positionStride); };
+		for (uint32_t t = 0; t < triangleCount; ++t)
+		{
+			glm::vec3 p0 = position(indices[t * 3 + 0]);
+			glm::vec3 p1 = position(indices[t * 3 + 1]);
+			glm::vec3 p2 = position(indices[t * 3 + 2]);
+			triangles[t].v0 = p0;
+			triangles[t].edge1 = p1 - p0;
+			triangles[t].edge2 = p2 - p0;
+			triangleMin[t] = glm::min(p0, glm::min(p1, p2));
+			triangleMax[t] = glm::max(p0, glm::max(p1, p2));
+		}
+		bvh.build(triangleMin.data(), triangleMax.data(), triangleCount, jobs);
+	}
+
+	// closest hit in front of hit.t, updates hit (not hit.instance) and returns true if there is one
+	bool intersect(const BvhRay& ray, RayHit& hit) const
+	{
+		float tMax = std::min(ray.tMax, hit.t);
+		bool found = false;
+		bvh.traverse(ray, tMax, [&](uint32_t triangle, float& closest)
+		{
+			float t, u, v;
+			if (intersectTriangle(triangles[triangle], ray, t, u, v) && t < closest)
+			{
+				closest = t;
+				hit.t = t;
+				hit.triangle = triangle;
+				hit.u = u;
+				hit.v = v;
+				found = true;
+			}
+		});
+		return found;
+	}
+
+	glm::vec3 boundsMin() const { return bvh.nodes.empty() ? glm::vec3(0.0f) : bvh.nodes[0].boundsMin; }
+	glm::vec3 boundsMax() const { return bvh.nodes.empty() ? glm::vec3(0.0f) : bvh.nodes[0].boundsMax; }
+	uint32_t triangleCount() const { return static_cast<uint32_t>(triangles.size()); }
+
+	// Möller-Trumbore, double sided
+	struct Triangle
+	{
+		glm::vec3 v0, edge1, edge2;
+	};
+	static bool intersectTriangle(const Triangle& triangle, const BvhRay& ray, float& t, float& u, float& v)
+	{
+		glm::vec3 p = glm::cross(ray.direction, triangle.edge2);
+		float determinant = glm::dot(triangle.edge1, p);
+		if (std::abs(determinant) < 1e-12f) return false;
+		float inverse = 1.0f / determinant;
+		glm::vec3 s = ray.origin - triangle.v0;
+		u = glm::dot(s, p) * inverse;
+		if (u < 0.0f || u > 1.0f) return false;
+		glm::vec3 q = glm::cross(s, triangle.edge1);
+		v = glm::dot(ray.direction, q) * inverse;
+		if (v < 0.0f || u + v > 1.0f) return false;
+		t = glm::dot(triangle.edge2, q) * inverse;
+		return t >= 0.0f && t <= ray.tMax;
+	}
+
+	std::vector<Triangle> triangles;
+};
+
+
+// Top level: a BVH over mesh instances, each with its own world matrix. Moving instances only
+// needs setTransform + refit, rebuild when they moved far enough for the tree to get bad.
+struct SceneBvh
+{
+	Bvh bvh;
+
+	uint32_t addInstance(const MeshBvh* mesh, const glm::mat4& world)
+	{
+		meshes.push_back(mesh);
+		worlds.push_back(world);
+		inverseWorlds.push_back(glm::inverse(world));
+		instanceMin.emplace_back();
+		instanceMax.emplace_back();
+		uint32_t instance = instanceCount() - 1;
+		bvh_detail::transformBounds(mesh->boundsMin(), mesh->boundsMax(), world, instanceMin[instance], instanceMax[instance]);
+		return instance;
+	}
+
+	void setTransform(uint32_t instance, const glm::mat4& world)
+	{
+		worlds[instance] = world;
+		inverseWorlds[instance] = glm::inverse(world);
+		bvh_detail::transformBounds(meshes[instance]->boundsMin(), meshes[instance]->boundsMax(), world, instanceMin[instance], instanceMax[instance]);
+	}
+
+	void build(JobSystem* jobs) { bvh.build(instanceMin.data(), instanceMax.data(), instanceCount(), jobs); }
+	void refit() { bvh.refit(instanceMin.data(), instanceMax.data()); }
+
+	// closest hit along the ray in world space, hit.t in units of ray.direction
+	bool intersect(const BvhRay& ray, RayHit& hit) const
+	{
+		float tMax = std::min(ray.tMax, hit.t);
+		bool found = false;
+		bvh.traverse(ray, tMax, [&](uint32_t instance, float& closest)
+		{
+			// the direction isn't renormalized, so t means the same in mesh space
+			const glm::mat4& toMesh = inverseWorlds[instance];
+			BvhRay meshRay(glm::vec3(toMesh * glm::vec4(ray.origin, 1.0f)), glm::vec3(toMesh * glm::vec4(ray.direction, 0.0f)), closest);
+			if (meshes[instance]->intersect(meshRay, hit))
+			{
+				closest = hit.t;
+				hit.instance = instance;
+				found = true;
+			}
+		});
+		return found;
+	}
+
+	// onInstance(instance) for every instance whose world box overlaps [queryMin, queryMax]
+	template<typename F>
+	void query(const glm::vec3& queryMin, const glm::vec3& queryMax, F&& onInstance) const
+	{
+		bvh.query(queryMin, queryMax, [&](uint32_t instance)
+		{
+			if (glm::all(glm::lessThanEqual(instanceMin[instance], queryMax)) && glm::all(glm::greaterThanEqual(instanceMax[instance], queryMin)))
+				onInstance(instance);
+		});
+	}
+
+	uint32_t instanceCount() const { return static_cast<uint32_t>(meshes.size()); }
+	const glm::mat4& world(uint32_t instance) const { return worlds[instance]; }
+
+private:
+	std::vector<const MeshBvh*> meshes;
+	std::vector<glm::mat4> worlds;
+	std::vector<glm::mat4> inverseWorlds;
+	std::vector<glm::vec3> instanceMin;
+	std::vector<glm::vec3> instanceMax;
+};
+
+
+namespace bvh_detail
+{
+	// width x width grid of quads with rolling hills, 2 triangles per quad
+	inline void makeTerrain(uint32_t width, float height, std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices)
+	{
+		positions.clear();
+		indices.clear();
+		for (uint32_t y = 0; y <= width; ++y)
+			for (uint32_t x = 0; x <= width; ++x)
+				positions.push_back(glm::vec3(x, y, height * std::sin(x * 0.05f) * std::cos(y * 0.07f)));
+		for (uint32_t y = 0; y < width; ++y)
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				uint32_t i = y * (width + 1) + x;
+				indices.insert(indices.end(), { i, i + 1, i + width + 1, i + 1, i + width + 2, i + width + 1 });
+			}
+	}
+
+	// unit sphere, rings x segments
+	inline void makeSphere(uint32_t rings, uint32_t segments, std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices)
+	{
+		positions.clear();
+		indices.clear();
+		for (uint32_t r = 0; r <= rings; ++r)
+			for (uint32_t s = 0; s <= segments; ++s)
+			{
+				float theta = 3.14159265f * r / rings, phi = 2.0f * 3.14159265f * s / segments;
+				positions.push_back(glm::vec3(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta)));
+			}
+		for (uint32_t r = 0; r < rings; ++r)
+			for (uint32_t s = 0; s < segments; ++s)
+			{
+				uint32_t i = r * (segments + 1) + s;
+				indices.insert(indices.end(), { i, i + segments + 1, i + 1, i + 1, i + segments + 1, i + segments + 2 });
+			}
+	}
+
+	inline double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+// Build and refit times and rays/second for a ~500k triangle terrain (one MeshBvh) and for
+// 10k instances of a sphere (SceneBvh over MeshBvh), on one thread and across the job system.
+// A few hundred rays of each are checked against brute force.
+inline void benchmarkBvh(JobSystem& jobs, std::ostream& out)
+{
+	using namespace bvh_detail;
+	typedef std::chrono::high_resolution_clock Clock;
+	std::mt19937 rng(777);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const uint32_t RAY_COUNT = 1000000;
+	const uint32_t CHECKED_RAYS = 200;
+
+	// rays/second on one thread and across the job system, returns hits
+	auto traceRays = [&](const std::vector<BvhRay>& rays, const std::function<bool(const BvhRay&, RayHit&)>& trace)
+	{
+		std::atomic<uint32_t> hits{ 0 };
+		auto start = Clock::now();
+		for (uint32_t i = 0; i < RAY_COUNT / 10; ++i)
+		{
+			RayHit hit;
+			trace(rays[i], hit);
+		}
+		double singleMs = elapsedMs(start) * 10.0;
+		start = Clock::now();
+		jobs.parallelFor(RAY_COUNT, 4096, [&](uint32_t begin, uint32_t end)
+		{
+			uint32_t localHits = 0;
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				RayHit hit;
+				localHits += trace(rays[i], hit) ? 1 : 0;
+			}
+			hits += localHits;
+		});
+		double parallelMs = elapsedMs(start);
+		out << "\trays: " << RAY_COUNT / singleMs / 1000.0 << " Mrays/s 1 thread, " << RAY_COUNT / parallelMs / 1000.0 << " Mrays/s "
+			<< jobs.threadCount() << " threads, " << hits.load() * 100.0 / RAY_COUNT << "% hit" << std::endl;
+	};
+
+	// one mesh
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+		const uint32_t WIDTH = 500;
+		makeTerrain(WIDTH, 20.0f, positions, indices);
+		const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+		MeshBvh mesh;
+		auto start = Clock::now();
+		mesh.build(positions.data(), sizeof(glm::vec3), indices.data(), triangleCount, nullptr);
+		double serialMs = elapsedMs(start);
+		start = Clock::now();
+		mesh.build(positions.data(), sizeof(glm::vec3), indices.data(), triangleCount, &jobs);
+		double parallelMs = elapsedMs(start);
+
+		// hills get taller, same topology
+		std::vector<glm::vec3> triangleMin(triangleCount), triangleMax(triangleCount);
+		for (uint32_t t = 0; t < triangleCount; ++t)
+		{
+			MeshBvh::Triangle& triangle = mesh.triangles[t];
+			triangle.v0.z *= 1.5f;
+			triangle.edge1.z *= 1.5f;
+			triangle.edge2.z *= 1.5f;
+			triangleMin[t] = glm::min(triangle.v0, glm::min(triangle.v0 + triangle.edge1, triangle.v0 + triangle.edge2));
+			triangleMax[t] = glm::max(triangle.v0, glm::max(triangle.v0 + triangle.edge1, triangle.v0 + triangle.edge2));
+		}
+		start = Clock::now();
+		mesh.bvh.refit(triangleMin.data(), triangleMax.data());
+		double refitMs = elapsedMs(start);
+
+		out << "BVH benchmark, one mesh: " << triangleCount << " triangles, " << mesh.bvh.nodes.size() << " nodes" << std::endl;
+		out << "\tbuild: " << serialMs << " ms 1 thread, " << parallelMs << " ms " << jobs.threadCount() << " threads, refit " << refitMs << " ms" << std::endl;
+
+		// from above the terrain down at it at an angle
+		std::vector<BvhRay> rays;
+		for (uint32_t i = 0; i < RAY_COUNT; ++i)
+		{
+			glm::vec3 origin(unit(rng) * WIDTH, unit(rng) * WIDTH, 100.0f);
+			glm::vec3 target(unit(rng) * WIDTH, unit(rng) * WIDTH, 0.0f);
+			rays.push_back(BvhRay(origin, target - origin));
+		}
+		traceRays(rays, [&](const BvhRay& ray, RayHit& hit) { return mesh.intersect(ray, hit); });
+
+		for (uint32_t i = 0; i < CHECKED_RAYS; ++i)
+		{
+			RayHit hit, reference;
+			mesh.intersect(rays[i], hit);
+			for (uint32_t t = 0; t < triangleCount; ++t)
+			{
+				float distance, u, v;
+				if (MeshBvh::intersectTriangle(mesh.triangles[t], rays[i], distance, u, v) && distance < reference.t)
+				{
+					reference.t = distance;
+					reference.triangle = t;
+				}
+			}
+			PV_ASSERT(hit.hit() == reference.hit() && (!hit.hit() || std::abs(hit.t - reference.t) <= 1e-5f * reference.t),
+				"benchmarkBvh: mesh BVH disagrees with brute force");
+		}
+	}
+
+	// two levels
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+		makeSphere(64, 128, positions, indices);
+		MeshBvh sphere;
+		sphere.build(positions.data(), sizeof(glm::vec3), indices.data(), static_cast<uint32_t>(indices.size() / 3), &jobs);
+
+		const uint32_t INSTANCE_COUNT = 10000;
+		const float WORLD_SIZE = 400.0f;
+		SceneBvh scene;
+		std::vector<glm::mat4> worlds;
+		for (uint32_t i = 0; i < INSTANCE_COUNT; ++i)
+		{
+			glm::vec3 position(unit(rng) * WORLD_SIZE, unit(rng) * WORLD_SIZE, unit(rng) * WORLD_SIZE);
+			glm::mat4 world = glm::translate(glm::mat4(1.0f), position) * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f + 2.0f * unit(rng)));
+			worlds.push_back(world);
+			scene.addInstance(&sphere, world);
+		}
+		auto start = Clock::now();
+		scene.build(nullptr);
+		double serialMs = elapsedMs(start);
+		start = Clock::now();
+		scene.build(&jobs);
+		double parallelMs = elapsedMs(start);
+
+		// everything drifts a little
+		for (uint32_t i = 0; i < INSTANCE_COUNT; ++i)
+		{
+			worlds[i] = glm::translate(glm::mat4(1.0f), glm::vec3(unit(rng), unit(rng), unit(rng))) * worlds[i];
+			scene.setTransform(i, worlds[i]);
+		}
+		start = Clock::now();
+		scene.refit();
+		double refitMs = elapsedMs(start);
+
+		out << "BVH benchmark, two levels: " << INSTANCE_COUNT << " instances of " << sphere.triangleCount() << " triangles" << std::endl;
+		out << "\ttop level build: " << serialMs << " ms 1 thread, " << parallelMs << " ms " << jobs.threadCount() << " threads, refit " << refitMs << " ms" << std::endl;
+
+		std::vector<BvhRay> rays;
+		for (uint32_t i = 0; i < RAY_COUNT; ++i)
+		{
+			glm::vec3 origin(unit(rng) * WORLD_SIZE, unit(rng) * WORLD_SIZE, unit(rng) * WORLD_SIZE);
+			glm::vec3 direction(unit(rng) - 0.5f, unit(rng) - 0.5f, unit(rng) - 0.5f);
+			rays.push_back(BvhRay(origin, glm::normalize(direction)));
+		}
+		traceRays(rays, [&](const BvhRay& ray, RayHit& hit) { return scene.intersect(ray, hit); });
+
+		for (uint32_t i = 0; i < CHECKED_RAYS; ++i)
+		{
+			RayHit hit, reference;
+			scene.intersect(rays[i], hit);
+			for (uint32_t instance = 0; instance < INSTANCE_COUNT; ++instance)
+			{
+				glm::mat4 toMesh = glm::inverse(worlds[instance]);
+				BvhRay meshRay(glm::vec3(toMesh * glm::vec4(rays[i].origin, 1.0f)), glm::vec3(toMesh * glm::vec4(rays[i].direction, 0.0f)));
+				if (sphere.intersect(meshRay, reference))
+					reference.instance = instance;
+			}
+			PV_ASSERT(hit.hit() == reference.hit() && (!hit.hit() || std::abs(hit.t - reference.t) <= 1e-4f * reference.t),
+				"benchmarkBvh: scene BVH disagrees with brute force");
+		}
+	}
+}
@@ -0,0 +1,359 @@
+#pragma once
+
+/*
+	Include dependencies: none
+*/
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <fstream>
+#include <ostream>
+#include <iomanip>
+#include <cstring>
+#include <stdint.h>
+
+// Set to 0 to compile every PV_PROFILE_* macro out
+#ifndef PV_PROFILE_ENABLED
+#define PV_PROFILE_ENABLED 1
+#endif
+
+// rdtsc is a few cycles where steady_clock can be a syscall on some platforms.
+// Ticks are converted to wall time with a frequency measured against steady_clock.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PV_PROFILE_USE_RDTSC 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#define PV_PROFILE_USE_RDTSC 0
+#endif
+
+
+// Writes str as a quoted JSON string, escaping quotes, backslashes and control characters.
+// Shared by the CPU and GPU trace exporters, scope names are free text.
+inline void writeJsonString(std::ostream& out, const char* str)
+{
+	static const char* const hex = "0123456789abcdef";
+	out << '"';
+	for (const char* c = str; *c != '\0'; ++c)
+	{
+		const unsigned char ch = static_cast<unsigned char>(*c);
+		if (ch == '"' || ch == '\\')
+			out << '\\' << *c;
+		else if (ch < 0x20)
+			out << "\\u00" << hex[ch >> 4] << hex[ch & 0xf];
+		else
+			out << *c;
+	}
+	out << '"';
+}
+
+
+struct CpuProfiler
+{
+	enum EventType : uint32_t
+	{
+		EVENT_SCOPE,
+		EVENT_COUNTER,
+		EVENT_FRAME,
+	};
+
+	// names must be string literals (or otherwise outlive the profiler), only the pointer is stored
+	struct Event
+	{
+		const char* name;
+		uint64_t start;
+		uint64_t end;	// counters keep their value bits here
+		EventType type;
+	};
+
+	// Single producer. Events that start before the first PV_PROFILE_FRAME() (init, pipeline and
+	// shader creation) go to an append only startup log so a long run cannot push them out, the
+	// frames after go to a ring that overwrites its oldest events once full. Only the owning
+	// thread writes, export reads everything below the heads.
+	struct ThreadBuffer
+	{
+		static const uint32_t CAPACITY = 1 << 16; // power of 2
+		static const uint32_t STARTUP_CAPACITY = 1 << 14; // startup events past this go to the ring
+		Event events[CAPACITY];
+		Event startupEvents[STARTUP_CAPACITY];
+		std::atomic<uint64_t> head{ 0 };
+		std::atomic<uint32_t> startupCount{ 0 };
+		const std::atomic<uint64_t>* firstFrameTicks = nullptr;
+		uint32_t threadIndex = 0;
+
+		void push(const Event& ev)
+		{
+			uint32_t s = startupCount.load(std::memory_order_relaxed);
+			if (ev.start < firstFrameTicks->load(std::memory_order_relaxed) && s < STARTUP_CAPACITY)
+			{
+				startupEvents[s] = ev;
+				startupCount.store(s + 1, std::memory_order_release);
+				return;
+			}
+			uint64_t h = head.load(std::memory_order_relaxed);
+			events[h & (CAPACITY - 1)] = ev;
+			head.store(h + 1, std::memory_order_release);
+		}
+	};
+
+	static uint64_t now()
+	{
+#if PV_PROFILE_USE_RDTSC
+		return __rdtsc();
+#else
+		return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+	}
+
+	static CpuProfiler& get()
+	{
+		static CpuProfiler profiler;
+		return profiler;
+	}
+
+	ThreadBuffer& threadBuffer()
+	{
+		thread_local ThreadBuffer* buffer = nullptr;
+		if (buffer == nullptr)
+		{
+			// only place that locks, once per thread
+			std::lock_guard<std::mutex> lock(registryMutex);
+			threadBuffers.emplace_back(new ThreadBuffer());
+			buffer = threadBuffers.back().get();
+			buffer->firstFrameTicks = &firstFrameTicks;
+			buffer->threadIndex = static_cast<uint32_t>(threadBuffers.size() - 1);
+		}
+		return *buffer;
+	}
+
+	void counter(const char* name, double value)
+	{
+		Event ev;
+		ev.name = name;
+		ev.start = now();
+		std::memcpy(&ev.end, &value, sizeof(value));
+		ev.type = EVENT_COUNTER;
+		threadBuffer().push(ev);
+	}
+
+	void frameMarker()
+	{
+		Event ev;
+		ev.name = "Frame";
+		ev.start = now();
+		ev.end = frameCount.fetch_add(1, std::memory_order_relaxed);
+		ev.type = EVENT_FRAME;
+		if (ev.end == 0)
+		{
+			firstFrameTicks.store(ev.start, std::memory_order_relaxed);
+		}
+		threadBuffer().push(ev);
+	}
+
+	// converts profiler ticks into microseconds since the profiler was created
+	double ticksToUs(uint64_t ticks) const
+	{
+		return static_cast<double>(ticks - startTicks) * usPerTick();
+	}
+
+	double usPerTick() const
+	{
+#if PV_PROFILE_USE_RDTSC
+		// measure the tsc frequency over the lifetime of the profiler, this gets more precise the longer we run
+		double elapsedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+		uint64_t elapsedTicks = now() - startTicks;
+		return elapsedTicks > 0 ? elapsedUs / static_cast<double>(elapsedTicks) : 0.0;
+#else
+		return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::duration(1)).count();
+#endif
+	}
+
+	// Chrome trace format (chrome://tracing, ui.perfetto.dev)
+	bool writeChromeTrace(const std::string& path)
+	{
+		std::ofstream file(path);
+		if (!file.is_open())
+			return false;
+
+		const double tickScale = usPerTick();
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		bool first = true;
+		forEachEvent([&](const ThreadBuffer& buffer, const Event& ev)
+		{
+			double ts = static_cast<double>(ev.start - startTicks) * tickScale;
+			file << (first ? "" : ",\n") << std::fixed << std::setprecision(3);
+			first = false;
+
+			switch (ev.type)
+			{
+			case EVENT_SCOPE:
+				file << "{\"name\":";
+				writeJsonString(file, ev.name);
+				file << ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer.threadIndex
+					<< ",\"ts\":" << ts << ",\"dur\":" << static_cast<double>(ev.end - ev.start) * tickScale << "}";
+				break;
+			case EVENT_COUNTER:
+			{
+				double value;
+				std::memcpy(&value, &ev.end, sizeof(value));
+				file << "{\"name\":";
+				writeJsonString(file, ev.name);
+				file << ",\"ph\":\"C\",\"pid\":0,\"tid\":" << buffer.threadIndex
+					<< ",\"ts\":" << ts << ",\"args\":{\"value\":" << value << "}}";
+				break;
+			}
+			case EVENT_FRAME:
+				file << "{\"name\":\"Frame " << ev.end << "\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":" << buffer.threadIndex
+					<< ",\"ts\":" << ts << "}";
+				break;
+			}
+		});
+		file << "\n]}\n";
+		return true;
+	}
+
+	// Per scope name: call count, total, average and max time. Sorted by total time.
+	void printSummary(std::ostream& out)
+	{
+		struct Totals { uint64_t count = 0; uint64_t total = 0; uint64_t max = 0; };
+		std::unordered_map<const char*, Totals> totals;
+		std::unordered_map<const char*, double> lastCounterValue;
+		uint64_t frames = 0;
+
+		forEachEvent([&](const ThreadBuffer&, const Event& ev)
+		{
+			if (ev.type == EVENT_SCOPE)
+			{
+				Totals& t = totals[ev.name];
+				uint64_t duration = ev.end - ev.start;
+				t.count++;
+				t.total += duration;
+				t.max = std::max(t.max, duration);
+			}
+			else if (ev.type == EVENT_COUNTER)
+			{
+				double value;
+				std::memcpy(&value, &ev.end, sizeof(value));
+				lastCounterValue[ev.name] = value;
+			}
+			else
+			{
+				frames++;
+			}
+		});
+
+		std::vector<std::pair<const char*, Totals>> sorted(totals.begin(), totals.end());
+		std::sort(sorted.begin(), sorted.end(), [](const std::pair<const char*, Totals>& a, const std::pair<const char*, Totals>& b)
+		{
+			return a.second.total > b.second.total;
+		});
+
+		const double msPerTick = usPerTick() / 1000.0;
+		out << "CPU Profile (ms)                          total        avg        max      count\n";
+		for (const auto& entry : sorted)
+		{
+			const Totals& t = entry.second;
+			out << "\t" << std::left << std::setw(34) << entry.first << std::right << std::fixed << std::setprecision(3)
+				<< std::setw(11) << t.total * msPerTick
+				<< std::setw(11) << (t.total * msPerTick) / t.count
+				<< std::setw(11) << t.max * msPerTick
+				<< std::setw(11) << t.count << "\n";
+		}
+		for (const auto& c : lastCounterValue)
+		{
+			out << "\t" << std::left << std::setw(34) << c.first << std::right << std::setw(11) << c.second << " (counter)\n";
+		}
+		out << "\tFrames: " << frames << std::endl;
+	}
+
+private:
+	std::mutex registryMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers;
+	std::atomic<uint64_t> frameCount{ 0 };
+	std::atomic<uint64_t> firstFrameTicks{ UINT64_MAX };
+	const uint64_t startTicks;
+	const std::chrono::steady_clock::time_point startTime;
+
+	CpuProfiler()
+		: startTicks(now())
+		, startTime(std::chrono::steady_clock::now())
+	{ }
+
+	template<typename F>
+	void forEachEvent(F&& func)
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		for (const auto& buffer : threadBuffers)
+		{
+			// the startup log is never overwritten
+			uint32_t startupCount = buffer->startupCount.load(std::memory_order_acquire);
+			for (uint32_t i = 0; i < startupCount; ++i)
+			{
+				func(*buffer, buffer->startupEvents[i]);
+			}
+
+			// The owner keeps writing while we read: copy each event out, then check the writer
+			// has not reached the slot's next lap (event i + CAPACITY), else the copy may be torn.
+			uint64_t head = buffer->head.load(std::memory_order_acquire);
+			uint64_t begin = head > ThreadBuffer::CAPACITY ? head - ThreadBuffer::CAPACITY : 0;
+			for (uint64_t i = begin; i < head; ++i)
+			{
+				Event ev = buffer->events[i & (ThreadBuffer::CAPACITY - 1)];
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (buffer->head.load(std::memory_order_relaxed) >= i + ThreadBuffer::CAPACITY)
+				{
+					continue;
+				}
+				func(*buffer, ev);
+			}
+		}
+	}
+};
+
+
+// RAII scope, pushes one event into the thread's buffer when it ends
+struct CpuProfileScope
+{
+	const char* name;
+	uint64_t start;
+	CpuProfiler::ThreadBuffer& buffer;
+
+	explicit CpuProfileScope(const char* scopeName)
+		: name(scopeName)
+		, start(CpuProfiler::now())
+		, buffer(CpuProfiler::get().threadBuffer())
+	{ }
+
+	~CpuProfileScope()
+	{
+		CpuProfiler::Event ev;
+		ev.name = name;
+		ev.start = start;
+		ev.end = CpuProfiler::now();
+		ev.type = CpuProfiler::EVENT_SCOPE;
+		buffer.push(ev);
+	}
+};
+
+
+#if PV_PROFILE_ENABLED
+#define PV_PROFILE_CONCAT_(A, B) A##B
+#define PV_PROFILE_CONCAT(A, B) PV_PROFILE_CONCAT_(A, B)
+#define PV_PROFILE_SCOPE(NAME) CpuProfileScope PV_PROFILE_CONCAT(zz_profile_scope, __LINE__)(NAME)
+#define PV_PROFILE_FUNCTION() PV_PROFILE_SCOPE(__FUNCTION__)
+#define PV_PROFILE_COUNTER(NAME, VALUE) CpuProfiler::get().counter(NAME, static_cast<double>(VALUE))
+#define PV_PROFILE_FRAME() CpuProfiler::get().frameMarker()
+#else
+#define PV_PROFILE_SCOPE(NAME) do {} while (0)
+#define PV_PROFILE_FUNCTION() do {} while (0)
+#define PV_PROFILE_COUNTER(NAME, VALUE) do {} while (0)
+#define PV_PROFILE_FRAME() do {} while (0)
+#endif
@@ -0,0 +1,415 @@
+#pragma once
+
+/*
+	Include dependencies: glm, MultiArray.h, JobSystem.h, CpuProfiler.h
+*/
+#include <vector>
+#include <random>
+#include <chrono>
+#include <ostream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <stdint.h>
+
+// 8 objects per iteration with AVX2 (/arch:AVX2, set for Release|x64), 4 with SSE, scalar otherwise
+#if defined(__AVX2__)
+#define PV_CULLING_AVX2 1
+#else
+#define PV_CULLING_AVX2 0
+#endif
+#if PV_CULLING_AVX2 || defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PV_CULLING_SSE 1
+#include <immintrin.h>
+#else
+#define PV_CULLING_SSE 0
+#endif
+
+
+// Six inward facing planes (xyz normal, w distance), a point p is inside when dot(n, p) + w >= 0 for all of them
+struct Frustum
+{
+	glm::vec4 planes[6];
+
+	// Gribb/Hartmann extraction. Vulkan clip space, so the near plane is z >= 0 instead of z >= -w.
+	static Frustum fromViewProjection(const glm::mat4& viewProjection)
+	{
+		const glm::mat4& m = viewProjection;
+		glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+		glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+		glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+		glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+		Frustum frustum;
+		frustum.planes[0] = row3 + row0;	// left
+		frustum.planes[1] = row3 - row0;	// right
+		frustum.planes[2] = row3 + row1;	// bottom
+		frustum.planes[3] = row3 - row1;	// top
+		frustum.planes[4] = row2;			// near
+		frustum.planes[5] = row3 - row2;	// far
+
+		// normalized so the distances compare against radii in world units
+		for (glm::vec4& plane : frustum.planes)
+		{
+			plane /= glm::length(glm::vec3(plane));
+		}
+		return frustum;
+	}
+};
+
+
+// Per object bounds, SoA so 8 objects load with one instruction per component.
+// Every object has a sphere and an AABB (center + half extent, the center is shared).
+// An object is visible if both are, so whichever is tighter wins.
+struct CullingBounds
+{
+	MultiArray<
+		float, float, float,	// center
+		float,					// sphere radius
+		float, float, float>	// AABB half extent
+		data;
+	uint32_t count;
+
+	CullingBounds(uint32_t objectCount)
+		: data({ objectCount, objectCount, objectCount, objectCount, objectCount, objectCount, objectCount })
+		, count(objectCount)
+	{ }
+
+	ArrayView<float> centerX() { return data.getView<0, float>(); }
+	ArrayView<float> centerY() { return data.getView<1, float>(); }
+	ArrayView<float> centerZ() { return data.getView<2, float>(); }
+	ArrayView<float> radius() { return data.getView<3, float>(); }
+	ArrayView<float> extentX() { return data.getView<4, float>(); }
+	ArrayView<float> extentY() { return data.getView<5, float>(); }
+	ArrayView<float> extentZ() { return data.getView<6, float>(); }
+
+	// sphere around the box
+	void setAabb(uint32_t index, const glm::vec3& boxMin, const glm::vec3& boxMax)
+	{
+		glm::vec3 center = (boxMin + boxMax) * 0.5f;
+		glm::vec3 extent = (boxMax - boxMin) * 0.5f;
+		centerX()[index] = center.x;
+		centerY()[index] = center.y;
+		centerZ()[index] = center.z;
+		radius()[index] = glm::length(extent);
+		extentX()[index] = extent.x;
+		extentY()[index] = extent.y;
+		extentZ()[index] = extent.z;
+	}
+
+	// A model space box (center + half extent) moved into world space by an affine transform. The
+	// box is the box around the transformed box, the sphere grows with the largest axis scale.
+	// shaders/cull.comp does the same math, keep them in sync.
+	void setTransformedBox(uint32_t index, const glm::vec3& boxCenter, const glm::vec3& boxExtent, const glm::mat4& world)
+	{
+		glm::vec3 center = glm::vec3(world * glm::vec4(boxCenter, 1.0f));
+		glm::vec3 extent =
+			glm::abs(glm::vec3(world[0])) * boxExtent.x +
+			glm::abs(glm::vec3(world[1])) * boxExtent.y +
+			glm::abs(glm::vec3(world[2])) * boxExtent.z;
+		float maxScaleSquared = std::max(std::max(
+			glm::dot(glm::vec3(world[0]), glm::vec3(world[0])),
+			glm::dot(glm::vec3(world[1]), glm::vec3(world[1]))),
+			glm::dot(glm::vec3(world[2]), glm::vec3(world[2])));
+		centerX()[index] = center.x;
+		centerY()[index] = center.y;
+		centerZ()[index] = center.z;
+		radius()[index] = glm::length(boxExtent) * std::sqrt(maxScaleSquared);
+		extentX()[index] = extent.x;
+		extentY()[index] = extent.y;
+		extentZ()[index] = extent.z;
+	}
+};
+
+
+namespace culling_detail
+{
+	struct Streams
+	{
+		const float* cx; const float* cy; const float* cz;
+		const float* r;
+		const float* ex; const float* ey; const float* ez;
+	};
+
+	inline Streams streams(CullingBounds& bounds)
+	{
+		return Streams{
+			bounds.centerX().data(), bounds.centerY().data(), bounds.centerZ().data(),
+			bounds.radius().data(),
+			bounds.extentX().data(), bounds.extentY().data(), bounds.extentZ().data() };
+	}
+
+	inline bool visibleScalar(const Streams& s, const Frustum& frustum, uint32_t i)
+	{
+		bool inside = true;
+		for (const glm::vec4& p : frustum.planes)
+		{
+			float distance = p.x * s.cx[i] + p.y * s.cy[i] + p.z * s.cz[i] + p.w;
+			float boxRadius = std::abs(p.x) * s.ex[i] + std::abs(p.y) * s.ey[i] + std::abs(p.z) * s.ez[i];
+			inside &= (distance + s.r[i] >= 0.0f) & (distance + boxRadius >= 0.0f);
+		}
+		return inside;
+	}
+
+	// True when one of the plane tests is within float rounding of zero for object i, there a
+	// contracted (FMA) or reordered plane test can decide either way. Checked in double.
+	inline bool onPlaneEdge(const Streams& s, const Frustum& frustum, uint32_t i)
+	{
+		for (const glm::vec4& p : frustum.planes)
+		{
+			double distance = double(p.x) * s.cx[i] + double(p.y) * s.cy[i] + double(p.z) * s.cz[i] + p.w;
+			double boxRadius = std::abs(double(p.x)) * s.ex[i] + std::abs(double(p.y)) * s.ey[i] + std::abs(double(p.z)) * s.ez[i];
+			double magnitude = std::abs(double(p.x) * s.cx[i]) + std::abs(double(p.y) * s.cy[i]) + std::abs(double(p.z) * s.cz[i]) + std::abs(double(p.w));
+			double tolerance = 1e-5 * (magnitude + s.r[i] + boxRadius);
+			if (std::abs(distance + s.r[i]) <= tolerance || std::abs(distance + boxRadius) <= tolerance)
+				return true;
+		}
+		return false;
+	}
+
+	// Objects in one ascending index list but not the other. Those on a plane's edge are only
+	// counted in onEdge, the rest are real disagreements.
+	inline uint32_t countDisagreements(const Streams& s, const Frustum& frustum, const std::vector<uint32_t>& a, const std::vector<uint32_t>& b, uint32_t& onEdge)
+	{
+		uint32_t wrong = 0;
+		size_t i = 0, j = 0;
+		while (i < a.size() || j < b.size())
+		{
+			if (i < a.size() && j < b.size() && a[i] == b[j])
+			{
+				++i; ++j;
+				continue;
+			}
+			uint32_t object = (j == b.size() || (i < a.size() && a[i] < b[j])) ? a[i++] : b[j++];
+			if (onPlaneEdge(s, frustum, object))
+				++onEdge;
+			else
+				++wrong;
+		}
+		return wrong;
+	}
+
+	// Writes the indices of visible objects in [begin, end) to out, returns how many.
+	// Stores are unconditional and may write up to 8 slots past the returned count, but
+	// never past out + (end - begin), so ranges handed to different threads can't overlap.
+	inline uint32_t cullScalar(const Streams& s, const Frustum& frustum, uint32_t begin, uint32_t end, uint32_t* out)
+	{
+		uint32_t visible = 0;
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			out[visible] = i;
+			visible += visibleScalar(s, frustum, i) ? 1 : 0;
+		}
+		return visible;
+	}
+
+#if PV_CULLING_AVX2
+	// for every 8 bit visibility mask, the lanes to keep packed to the front
+	struct CompactTable
+	{
+		alignas(32) uint32_t lanes[256][8];
+		CompactTable()
+		{
+			for (uint32_t mask = 0; mask < 256; ++mask)
+			{
+				uint32_t n = 0;
+				for (uint32_t lane = 0; lane < 8; ++lane)
+				{
+					if (mask & (1u << lane)) lanes[mask][n++] = lane;
+				}
+				while (n < 8) lanes[mask][n++] = 0;
+			}
+		}
+	};
+	inline const CompactTable& compactTable()
+	{
+		static const CompactTable table;
+		return table;
+	}
+
+	inline uint32_t cullAvx2(const Streams& s, const Frustum& frustum, uint32_t begin, uint32_t end, uint32_t* out)
+	{
+		const CompactTable& table = compactTable();
+		const __m256 zero = _mm256_setzero_ps();
+
+		// broadcast the planes once, the loop only loads bounds
+		__m256 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+		for (int p = 0; p < 6; ++p)
+		{
+			const glm::vec4& plane = frustum.planes[p];
+			nx[p] = _mm256_set1_ps(plane.x); ny[p] = _mm256_set1_ps(plane.y);
+			nz[p] = _mm256_set1_ps(plane.z); nw[p] = _mm256_set1_ps(plane.w);
+			ax[p] = _mm256_set1_ps(std::abs(plane.x)); ay[p] = _mm256_set1_ps(std::abs(plane.y)); az[p] = _mm256_set1_ps(std::abs(plane.z));
+		}
+
+		uint32_t visible = 0;
+		uint32_t i = begin;
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256 cx = _mm256_loadu_ps(s.cx + i), cy = _mm256_loadu_ps(s.cy + i), cz = _mm256_loadu_ps(s.cz + i);
+			__m256 r = _mm256_loadu_ps(s.r + i);
+			__m256 ex = _mm256_loadu_ps(s.ex + i), ey = _mm256_loadu_ps(s.ey + i), ez = _mm256_loadu_ps(s.ez + i);
+
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int p = 0; p < 6; ++p)
+			{
+				__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx[p], cx), _mm256_mul_ps(ny[p], cy)),
+					_mm256_add_ps(_mm256_mul_ps(nz[p], cz), nw[p]));
+				__m256 boxRadius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax[p], ex), _mm256_mul_ps(ay[p], ey)), _mm256_mul_ps(az[p], ez));
+
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, r), zero, _CMP_GE_OQ));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, boxRadius), zero, _CMP_GE_OQ));
+			}
+
+			// pack the visible lanes' indices to the front and store all 8, only the first popcount count
+			uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+			__m256i lanes = _mm256_load_si256(reinterpret_cast<const __m256i*>(table.lanes[mask]));
+			__m256i indices = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(i)), lanes);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + visible), indices);
+			visible += static_cast<uint32_t>(_mm_popcnt_u32(mask));
+		}
+		return visible + cullScalar(s, frustum, i, end, out + visible);
+	}
+#endif
+
+#if PV_CULLING_SSE
+	inline uint32_t cullSse(const Streams& s, const Frustum& frustum, uint32_t begin, uint32_t end, uint32_t* out)
+	{
+		const __m128 zero = _mm_setzero_ps();
+
+		__m128 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+		for (int p = 0; p < 6; ++p)
+		{
+			const glm::vec4& plane = frustum.planes[p];
+			nx[p] = _mm_set1_ps(plane.x); ny[p] = _mm_set1_ps(plane.y);
+			nz[p] = _mm_set1_ps(plane.z); nw[p] = _mm_set1_ps(plane.w);
+			ax[p] = _mm_set1_ps(std::abs(plane.x)); ay[p] = _mm_set1_ps(std::abs(plane.y)); az[p] = _mm_set1_ps(std::abs(plane.z));
+		}
+
+		uint32_t visible = 0;
+		uint32_t i = begin;
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 cx = _mm_loadu_ps(s.cx + i), cy = _mm_loadu_ps(s.cy + i), cz = _mm_loadu_ps(s.cz + i);
+			__m128 r = _mm_loadu_ps(s.r + i);
+			__m128 ex = _mm_loadu_ps(s.ex + i), ey = _mm_loadu_ps(s.ey + i), ez = _mm_loadu_ps(s.ez + i);
+
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; ++p)
+			{
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)),
+					_mm_add_ps(_mm_mul_ps(nz[p], cz), nw[p]));
+				__m128 boxRadius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)), _mm_mul_ps(az[p], ez));
+
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, r), zero));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, boxRadius), zero));
+			}
+
+			// branchless compaction, SSE2 has no variable shuffle
+			uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(inside));
+			for (uint32_t lane = 0; lane < 4; ++lane)
+			{
+				out[visible] = i + lane;
+				visible += (mask >> lane) & 1;
+			}
+		}
+		return visible + cullScalar(s, frustum, i, end, out + visible);
+	}
+#endif
+}
+
+
+// Indices of the objects in [begin, end) that intersect the frustum, written to out in
+// ascending order. out must have room for end - begin entries. Returns the visible count.
+inline uint32_t cullBounds(CullingBounds& bounds, const Frustum& frustum, uint32_t begin, uint32_t end, uint32_t* out)
+{
+	culling_detail::Streams s = culling_detail::streams(bounds);
+#if PV_CULLING_AVX2
+	return culling_detail::cullAvx2(s, frustum, begin, end, out);
+#elif PV_CULLING_SSE
+	return culling_detail::cullSse(s, frustum, begin, end, out);
+#else
+	return culling_detail::cullScalar(s, frustum, begin, end, out);
+#endif
+}
+
+// Same as cullBounds over every object, split across the job system. visible is resized to the visible count.
+inline void cullBoundsParallel(CullingBounds& bounds, const Frustum& frustum, std::vector<uint32_t>& visible, JobSystem& jobs)
+{
+	PV_PROFILE_FUNCTION();
+	// big enough that a chunk amortizes the job handoff, small enough to balance over the workers
+	const uint32_t CHUNK_SIZE = 16 * 1024;
+	const uint32_t chunkCount = (bounds.count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+	visible.resize(bounds.count);
+	std::vector<uint32_t> chunkVisible(chunkCount);
+
+	// every chunk writes into its own [begin, end) of visible ...
+	jobs.parallelFor(bounds.count, CHUNK_SIZE, [&](uint32_t begin, uint32_t end)
+	{
+		chunkVisible[begin / CHUNK_SIZE] = cullBounds(bounds, frustum, begin, end, visible.data() + begin);
+	});
+
+	// ... then they are packed down, in order
+	uint32_t total = 0;
+	for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+	{
+		uint32_t begin = chunk * CHUNK_SIZE;
+		if (begin != total)
+			std::memmove(visible.data() + total, visible.data() + begin, chunkVisible[chunk] * sizeof(uint32_t));
+		total += chunkVisible[chunk];
+	}
+	visible.resize(total);
+}
+
+
+// 1M random objects against a camera frustum. Checks the SIMD path against the scalar one and
+// prints objects/ns for scalar, SIMD on one thread and SIMD across the job system.
+inline void benchmarkCulling(JobSystem& jobs, std::ostream& out, uint32_t objectCount = 1000000)
+{
+	CullingBounds bounds(objectCount);
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+	std::uniform_real_distribution<float> size(0.25f, 4.0f);
+	for (uint32_t i = 0; i < objectCount; ++i)
+	{
+		glm::vec3 center(position(rng), position(rng), position(rng));
+		glm::vec3 extent(size(rng), size(rng), size(rng));
+		bounds.setAabb(i, center - extent, center + extent);
+	}
+
+	glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 150.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.3f, 0.2f), glm::vec3(0.0f, 0.0f, 1.0f));
+	Frustum frustum = Frustum::fromViewProjection(proj * view);
+
+	std::vector<uint32_t> scalarVisible(objectCount), simdVisible(objectCount), parallelVisible;
+	const int ITERATIONS = 10;
+
+	auto timeNs = [&](const std::function<void()>& func)
+	{
+		func(); // warm up caches and the job system
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int it = 0; it < ITERATIONS; ++it) func();
+		return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count() / ITERATIONS;
+	};
+
+	uint32_t scalarCount = 0, simdCount = 0;
+	culling_detail::Streams s = culling_detail::streams(bounds);
+	double scalarNs = timeNs([&]() { scalarCount = culling_detail::cullScalar(s, frustum, 0, objectCount, scalarVisible.data()); });
+	double simdNs = timeNs([&]() { simdCount = cullBounds(bounds, frustum, 0, objectCount, simdVisible.data()); });
+	double parallelNs = timeNs([&]() { cullBoundsParallel(bounds, frustum, parallelVisible, jobs); });
+
+	// the scalar test may be contracted into FMAs where the SIMD one isn't, objects exactly on a plane can go either way
+	scalarVisible.resize(scalarCount);
+	simdVisible.resize(simdCount);
+	uint32_t onEdge = 0;
+	PV_ASSERT(culling_detail::countDisagreements(s, frustum, scalarVisible, simdVisible, onEdge) == 0, "benchmarkCulling: SIMD culling disagrees with scalar");
+	PV_ASSERT(culling_detail::countDisagreements(s, frustum, scalarVisible, parallelVisible, onEdge) == 0, "benchmarkCulling: parallel culling disagrees with scalar");
+
+	const char* simdName = PV_CULLING_AVX2 ? "AVX2" : PV_CULLING_SSE ? "SSE" : "scalar";
+	out << "Culling benchmark: " << objectCount << " objects, " << scalarCount << " visible, "
+		<< onEdge << " disagreements on a plane's edge" << std::endl;
+	out << "\tscalar:             " << objectCount / scalarNs << " objects/ns (" << scalarNs / 1e6 << " ms)" << std::endl;
+	out << "\t" << simdName << " 1 thread:      " << objectCount / simdNs << " objects/ns (" << simdNs / 1e6 << " ms)" << std::endl;
+	out << "\t" << simdName << " " << jobs.threadCount() << " threads:     " << objectCount / parallelNs << " objects/ns (" << parallelNs / 1e6 << " ms)" << std::endl;
+}
@@ -0,0 +1,364 @@
+#pragma once
+
+/*
+	Include dependencies: Vulkan, Macros.h
+*/
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+#include <stdint.h>
+
+
+// One descriptor, laid out the way update templates read them: every kind takes the same 24 bytes,
+// so a set's descriptors are one array in binding order. Zeroed first so the cache can hash the bytes.
+struct DescriptorInfo
+{
+	union
+	{
+		VkDescriptorImageInfo image;
+		VkDescriptorBufferInfo buffer;
+		VkBufferView texelBuffer;
+	};
+
+	// buffer is as large as the union and has no padding, so zeroing it zeroes every byte
+	DescriptorInfo() : buffer() {}
+	DescriptorInfo(VkBuffer b, VkDeviceSize offset, VkDeviceSize range)
+		: DescriptorInfo()
+	{
+		buffer.buffer = b;
+		buffer.offset = offset;
+		buffer.range = range;
+	}
+	DescriptorInfo(VkSampler sampler, VkImageView view, VkImageLayout layout)
+		: DescriptorInfo()
+	{
+		image.sampler = sampler;
+		image.imageView = view;
+		image.imageLayout = layout;
+	}
+};
+static_assert(sizeof(DescriptorInfo) == sizeof(VkDescriptorImageInfo) && sizeof(DescriptorInfo) == sizeof(VkDescriptorBufferInfo), "DescriptorInfo: update template stride");
+
+
+// How a layout's DescriptorInfo array maps onto its bindings. Written through a
+// VkDescriptorUpdateTemplate when VK_KHR_descriptor_update_template is enabled, through the
+// equivalent VkWriteDescriptorSets otherwise.
+struct DescriptorTemplate
+{
+	VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+	VkDescriptorUpdateTemplate handle = VK_NULL_HANDLE;
+	std::vector<VkDescriptorUpdateTemplateEntry> entries;	// one per binding, offsets into the infos
+	uint32_t descriptorCount = 0;							// DescriptorInfos per set
+};
+
+
+// Hands out descriptor sets from a list of pools. A pool that runs out (OUT_OF_POOL_MEMORY or
+// FRAGMENTED_POOL) is left as is and allocation moves on to the next, a bigger one if none is
+// left over from before a reset. reset() takes every pool back at once with vkResetDescriptorPool,
+// so an allocator per frame in flight (or per thread) never frees single sets.
+// Not thread safe, one allocator per thread.
+struct DescriptorAllocator
+{
+	static const uint32_t FIRST_POOL_SETS = 64;
+	static const uint32_t MAX_POOL_SETS = 4096;
+
+	struct Stats
+	{
+		uint32_t pools = 0;
+		uint32_t sets = 0;			// since the last reset
+		uint32_t poolsFilled = 0;	// allocations that had to move on to another pool
+		uint32_t resets = 0;
+		uint32_t templateWrites = 0;
+		uint32_t plainWrites = 0;
+	};
+	Stats stats;
+
+	// useUpdateTemplates: VK_KHR_descriptor_update_template is enabled on the device
+	void init(VkDevice logicalDevice, bool useUpdateTemplates)
+	{
+		device = logicalDevice;
+		if (useUpdateTemplates)
+		{
+			createTemplate = reinterpret_cast<PFN_vkCreateDescriptorUpdateTemplateKHR>(vkGetDeviceProcAddr(device, "vkCreateDescriptorUpdateTemplateKHR"));
+			destroyTemplate = reinterpret_cast<PFN_vkDestroyDescriptorUpdateTemplateKHR>(vkGetDeviceProcAddr(device, "vkDestroyDescriptorUpdateTemplateKHR"));
+			updateWithTemplate = reinterpret_cast<PFN_vkUpdateDescriptorSetWithTemplateKHR>(vkGetDeviceProcAddr(device, "vkUpdateDescriptorSetWithTemplateKHR"));
+			if (createTemplate == nullptr || destroyTemplate == nullptr || updateWithTemplate == nullptr)
+			{
+				createTemplate = nullptr;
+			}
+		}
+	}
+
+	void cleanup()
+	{
+		if (device == VK_NULL_HANDLE) return;
+		for (VkDescriptorPool pool : pools)
+		{
+			vkDestroyDescriptorPool(device, pool, allocnullptr);
+		}
+		pools.clear();
+		for (auto& entry : templates)
+		{
+			if (entry.second.handle != VK_NULL_HANDLE)
+				destroyTemplate(device, entry.second.handle, allocnullptr);
+		}
+		templates.clear();
+		currentPool = 0;
+		stats = Stats();
+	}
+
+	VkDescriptorSet allocate(VkDescriptorSetLayout layout)
+	{
+		if (pools.empty())
+		{
+			addPool();
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		VkDescriptorSet set;
+		allocInfo.descriptorPool = pools[currentPool];
+		VkResult result = vkAllocateDescriptorSets(device, &allocInfo, &set);
+		if (result == VK_ERROR_OUT_OF_POOL_MEMORY_KHR || result == VK_ERROR_FRAGMENTED_POOL)
+		{
+			// full, the next pool is either one a reset emptied or a new bigger one
+			++stats.poolsFilled;
+			if (++currentPool == pools.size())
+			{
+				addPool();
+			}
+			allocInfo.descriptorPool = pools[currentPool];
+			result = vkAllocateDescriptorSets(device, &allocInfo, &set);
+		}
+		PV_VK_RUN(result);
+		++stats.sets;
+		return set;
+	}
+
+	// every set handed out since the last reset is gone, the pools stay for the next round
+	void reset()
+	{
+		for (VkDescriptorPool pool : pools)
+		{
+			PV_VK_RUN(vkResetDescriptorPool(device, pool, 0));
+		}
+		currentPool = 0;
+		stats.sets = 0;
+		++stats.resets;
+	}
+
+	// One per layout, bindings are the ones the layout was created with (LayoutCache's key)
+	const DescriptorTemplate& getTemplate(VkDescriptorSetLayout layout, const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+	{
+		auto found = templates.find(layout);
+		if (found != templates.end()) return found->second;
+
+		DescriptorTemplate result;
+		result.layout = layout;
+		for (const VkDescriptorSetLayoutBinding& binding : bindings)
+		{
+			VkDescriptorUpdateTemplateEntry entry = {};
+			entry.dstBinding = binding.binding;
+			entry.dstArrayElement = 0;
+			entry.descriptorCount = binding.descriptorCount;
+			entry.descriptorType = binding.descriptorType;
+			entry.offset = result.descriptorCount * sizeof(DescriptorInfo);
+			entry.stride = sizeof(DescriptorInfo);
+			result.entries.push_back(entry);
+			result.descriptorCount += binding.descriptorCount;
+		}
+
+		if (createTemplate != nullptr)
+		{
+			VkDescriptorUpdateTemplateCreateInfoKHR templateInfo = {};
+			templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR;
+			templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(result.entries.size());
+			templateInfo.pDescriptorUpdateEntries = result.entries.data();
+			templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR;
+			templateInfo.descriptorSetLayout = layout;
+			PV_VK_RUN(createTemplate(device, &templateInfo, allocnullptr, &result.handle));
+		}
+		return templates.emplace(layout, std::move(result)).first->second;
+	}
+
+	// infos: descriptorCount of them, in binding order
+	void write(VkDescriptorSet set, const DescriptorTemplate& writeTemplate, const DescriptorInfo* infos)
+	{
+		if (writeTemplate.handle != VK_NULL_HANDLE)
+		{
+			updateWithTemplate(device, set, writeTemplate.handle, infos);
+			++stats.templateWrites;
+			return;
+		}
+
+		std::vector<VkWriteDescriptorSet> writes(writeTemplate.entries.size());
+		for (size_t i = 0; i < writeTemplate.entries.size(); ++i)
+		{
+			const VkDescriptorUpdateTemplateEntry& entry = writeTemplate.entries[i];
+			const DescriptorInfo* info = infos + entry.offset / sizeof(DescriptorInfo);
+			VkWriteDescriptorSet& write = writes[i];
+			write = {};
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = set;
+			write.dstBinding = entry.dstBinding;
+			write.dstArrayElement = entry.dstArrayElement;
+			write.descriptorCount = entry.descriptorCount;
+			write.descriptorType = entry.descriptorType;
+			// image and buffer infos are 24 bytes themselves so their arrays line up, texel buffer views don't
+			switch (entry.descriptorType)
+			{
+			case VK_DESCRIPTOR_TYPE_SAMPLER:
+			case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+			case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+			case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+			case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+				write.pImageInfo = &info->image;
+				break;
+			case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+			case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+				PV_ASSERT(entry.descriptorCount == 1, "DescriptorAllocator: texel buffer arrays need update templates");
+				write.pTexelBufferView = &info->texelBuffer;
+				break;
+			default:
+				write.pBufferInfo = &info->buffer;
+				break;
+			}
+		}
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+		++stats.plainWrites;
+	}
+	void write(VkDescriptorSet set, const DescriptorTemplate& writeTemplate, const std::vector<DescriptorInfo>& infos)
+	{
+		PV_ASSERT(infos.size() == writeTemplate.descriptorCount, "DescriptorAllocator: one DescriptorInfo per descriptor");
+		write(set, writeTemplate, infos.data());
+	}
+
+	bool usesUpdateTemplates() const { return createTemplate != nullptr; }
+
+	void printStats(std::ostream& out) const
+	{
+		out << "Descriptor allocator: " << stats.pools << " pools, " << stats.sets << " sets, " << stats.poolsFilled << " pools filled, "
+			<< stats.resets << " resets, " << stats.templateWrites << " template writes, " << stats.plainWrites << " plain writes" << std::endl;
+	}
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	std::vector<VkDescriptorPool> pools;
+	size_t currentPool = 0;
+	std::unordered_map<VkDescriptorSetLayout, DescriptorTemplate> templates;
+	PFN_vkCreateDescriptorUpdateTemplateKHR createTemplate = nullptr;
+	PFN_vkDestroyDescriptorUpdateTemplateKHR destroyTemplate = nullptr;
+	PFN_vkUpdateDescriptorSetWithTemplateKHR updateWithTemplate = nullptr;
+
+	// Each pool doubles the sets of the one before, with room for a typical set of each
+	void addPool()
+	{
+		const uint32_t sets = std::min(MAX_POOL_SETS, FIRST_POOL_SETS << std::min<size_t>(pools.size(), 6));
+		const VkDescriptorPoolSize perSet[] =
+		{
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4 },
+			{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1 },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
+		};
+		const uint32_t typeCount = sizeof(perSet) / sizeof(perSet[0]);
+		VkDescriptorPoolSize poolSizes[typeCount];
+		for (uint32_t i = 0; i < typeCount; ++i)
+		{
+			poolSizes[i] = { perSet[i].type, perSet[i].descriptorCount * sets };
+		}
+
+		VkDescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount = typeCount;
+		poolInfo.pPoolSizes = poolSizes;
+		poolInfo.maxSets = sets;
+
+		VkDescriptorPool pool;
+		PV_VK_RUN(vkCreateDescriptorPool(device, &poolInfo, allocnullptr, &pool));
+		pools.push_back(pool);
+		currentPool = pools.size() - 1;
+		++stats.pools;
+	}
+};
+
+
+// Sets that never change after their first write (materials, per region compute inputs),
+// shared by everyone asking for the same layout and descriptors. Keyed by the layout handle
+// and the raw DescriptorInfo words, so a repeat request costs a hash and a compare.
+struct DescriptorSetCache
+{
+	uint32_t hits = 0;
+	uint32_t misses = 0;
+
+	// sets come from (and die with) allocator, which must not be reset while the cache is used
+	void init(DescriptorAllocator& setAllocator)
+	{
+		allocator = &setAllocator;
+	}
+
+	VkDescriptorSet get(const DescriptorTemplate& writeTemplate, const std::vector<DescriptorInfo>& infos)
+	{
+		PV_ASSERT(infos.size() == writeTemplate.descriptorCount, "DescriptorSetCache: one DescriptorInfo per descriptor");
+		std::vector<uint32_t> key(2 + infos.size() * sizeof(DescriptorInfo) / sizeof(uint32_t));
+		const uint64_t handle = reinterpret_cast<uint64_t>(writeTemplate.layout);
+		key[0] = static_cast<uint32_t>(handle);
+		key[1] = static_cast<uint32_t>(handle >> 32);
+		memcpy(&key[2], infos.data(), infos.size() * sizeof(DescriptorInfo));
+
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		auto found = sets.find(key);
+		if (found != sets.end())
+		{
+			++hits;
+			return found->second;
+		}
+		++misses;
+
+		VkDescriptorSet set = allocator->allocate(writeTemplate.layout);
+		allocator->write(set, writeTemplate, infos);
+		sets.emplace(std::move(key), set);
+		return set;
+	}
+
+	// the sets themselves go back with the allocator's pools
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		sets.clear();
+	}
+
+	void printStats(std::ostream& out)
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		out << "Descriptor set cache: " << sets.size() << " sets, " << hits << " hits, " << misses << " misses" << std::endl;
+	}
+
+private:
+	// FNV-1a over the key words
+	struct KeyHasher
+	{
+		size_t operator()(const std::vector<uint32_t>& key) const
+		{
+			uint64_t hash = 0xcbf29ce484222325ULL;
+			for (uint32_t word : key)
+			{
+				hash ^= word;
+				hash *= 0x100000001b3ULL;
+			}
+			return static_cast<size_t>(hash);
+		}
+	};
+
+	DescriptorAllocator* allocator = nullptr;
+	std::mutex cacheMutex;
+	std::unordered_map<std::vector<uint32_t>, VkDescriptorSet, KeyHasher> sets;
+};
@@ -0,0 +1,628 @@
+#pragma once
+
+/*
+	Include dependencies: glm, Macros.h, MultiArray.h, JobSystem.h
+*/
+#include <stdint.h>
+#include <array>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <ostream>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+
+// An index into EntityWorld's records and the generation it was handed out with, the handle
+// stops matching once the entity is destroyed and its index reused.
+struct Entity
+{
+	uint32_t index = UINT32_MAX;
+	uint32_t generation = 0;
+
+	bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const Entity& other) const { return !(*this == other); }
+};
+
+// Components are trivially copyable structs, they live in MultiArrays and move with memcpy.
+// Every component type gets one bit the first time it's used.
+typedef uint64_t ComponentMask;
+static const uint32_t MAX_COMPONENT_TYPES = 64;
+
+namespace entity_detail
+{
+	inline uint32_t nextComponentId()
+	{
+		static std::atomic<uint32_t> next{ 0 };
+		return next.fetch_add(1);
+	}
+
+	template <class T>
+	struct ComponentId
+	{
+		static uint32_t get()
+		{
+			static const uint32_t id = nextComponentId();
+			return id;
+		}
+	};
+}
+
+template <class T>
+inline uint32_t componentId()
+{
+	const uint32_t id = entity_detail::ComponentId<typename std::remove_const<T>::type>::get();
+	PV_ASSERT(id < MAX_COMPONENT_TYPES, "componentId: more than MAX_COMPONENT_TYPES component types");
+	return id;
+}
+
+template <class... Ts>
+inline ComponentMask componentMask()
+{
+	const uint32_t ids[] = { componentId<Ts>()..., 0 };
+	ComponentMask mask = 0;
+	for (size_t i = 0; i < sizeof...(Ts); ++i) mask |= ComponentMask(1) << ids[i];
+	return mask;
+}
+
+
+// Up to CHUNK_BYTES of entities of one archetype, one MultiArray stream per component plus the
+// Entity handles in stream 0. Every chunk of an archetype but the last one is full.
+struct EntityChunk
+{
+	static const uint32_t MAX_STREAMS = 16;
+	static const uint32_t CHUNK_BYTES = 16 * 1024;
+
+	uint32_t count = 0;
+	uint32_t capacity = 0;
+	std::array<char*, MAX_STREAMS> streams;
+	// EntityWorld::version() of the last write to each stream, queries skip chunks that didn't change
+	std::array<uint32_t, MAX_STREAMS> versions;
+
+	virtual ~EntityChunk() = default;
+
+	void stamp(uint32_t streamCount, uint32_t version)
+	{
+		std::fill(versions.begin(), versions.begin() + streamCount, version);
+	}
+};
+
+namespace entity_detail
+{
+	template <class... Components>
+	struct TypedChunk : EntityChunk
+	{
+		MultiArray<Entity, Components...> data;
+
+		explicit TypedChunk(uint32_t chunkCapacity)
+		{
+			data.resize(chunkCapacity);
+			capacity = chunkCapacity;
+			streams.fill(nullptr);
+			versions.fill(0);
+			for (uint32_t i = 0; i < data.s_num_arrays; ++i) streams[i] = data.data() + data.arrayOffset(i);
+		}
+	};
+
+	template <class... Components>
+	std::unique_ptr<EntityChunk> newChunk(uint32_t capacity)
+	{
+		return std::unique_ptr<EntityChunk>(new TypedChunk<Components...>(capacity));
+	}
+}
+
+// All entities with the same set of components. Its streams are in the order of the first
+// create() with that set, rows of later creates are shuffled into it by component id.
+struct Archetype
+{
+	ComponentMask mask = 0;
+	uint32_t streamCount = 0;
+	uint32_t chunkCapacity = 0;
+	uint32_t rowSize = 0;									// bytes of one entity's components
+	std::array<uint32_t, EntityChunk::MAX_STREAMS> streamSizes;
+	std::array<uint32_t, EntityChunk::MAX_STREAMS> rowOffsets;	// of each stream in a pending row
+	std::array<uint8_t, MAX_COMPONENT_TYPES> streamOf;		// component id -> stream, 0 if not in here
+	std::unique_ptr<EntityChunk>(*newChunk)(uint32_t capacity) = nullptr;
+
+	std::vector<std::unique_ptr<EntityChunk>> chunks;
+	std::unique_ptr<EntityChunk> spareChunk;				// last chunk to empty out, reused before a new one
+
+	// created this frame, placed by EntityWorld::applyChanges
+	std::vector<Entity> pendingEntities;
+	std::vector<char> pendingRows;
+
+	template <class... Components>
+	static std::unique_ptr<Archetype> make()
+	{
+		static_assert(sizeof...(Components) + 1 <= EntityChunk::MAX_STREAMS, "Archetype: too many components");
+		std::unique_ptr<Archetype> archetype(new Archetype());
+		const uint32_t ids[] = { componentId<Components>()... };
+		const uint32_t sizes[] = { uint32_t(sizeof(Entity)), uint32_t(sizeof(Components))... };
+
+		archetype->mask = componentMask<Components...>();
+		archetype->streamCount = sizeof...(Components) + 1;
+		archetype->streamSizes.fill(0);
+		archetype->rowOffsets.fill(0);
+		archetype->streamOf.fill(0);
+		uint32_t entityBytes = 0;
+		for (uint32_t stream = 0; stream < archetype->streamCount; ++stream)
+		{
+			archetype->streamSizes[stream] = sizes[stream];
+			entityBytes += sizes[stream];
+			if (stream == 0) continue;
+			archetype->streamOf[ids[stream - 1]] = static_cast<uint8_t>(stream);
+			archetype->rowOffsets[stream] = archetype->rowSize;
+			archetype->rowSize += sizes[stream];
+		}
+		// a multiple of 16 so whole chunks go through vector loops without a remainder
+		archetype->chunkCapacity = std::max(16u, EntityChunk::CHUNK_BYTES / entityBytes / 16 * 16);
+		archetype->newChunk = &entity_detail::newChunk<Components...>;
+		return archetype;
+	}
+
+	uint32_t entityCount() const
+	{
+		return chunks.empty() ? 0 : static_cast<uint32_t>(chunks.size() - 1) * chunkCapacity + chunks.back()->count;
+	}
+};
+
+
+// Archetype ECS, every archetype's components in chunked SoA MultiArrays.
+//
+// Structural changes (create, destroy) are recorded, also from inside jobs, and happen in
+// applyChanges at the end of the frame, so queries never see chunks move under them.
+// Queries run a function over whole chunks across the job system:
+//
+//	world.forEach<Position, const Velocity>(jobs, [](ArrayView<const Entity> entities,
+//		ArrayView<Position> positions, ArrayView<const Velocity> velocities) { ... });
+//
+// Non-const components are written: the chunks they're in get a new version. forEachChanged
+// only visits chunks where any of the listed components changed after a version the system
+// remembered from its last run, so transform or culling systems skip everything that stood still:
+//
+//	world.forEachChanged<const LocalTransform, WorldTransform>(jobs, lastVersion, update);
+//	lastVersion = world.version();
+struct EntityWorld
+{
+	EntityWorld() = default;
+	EntityWorld(const EntityWorld&) = delete;
+	EntityWorld& operator=(const EntityWorld&) = delete;
+
+	// goes up with every write, a system's own writes are <= version() right after it ran
+	uint32_t version() const { return currentVersion; }
+
+	// The handle is valid right away, the entity exists (alive, in queries) after applyChanges.
+	// Any thread, also from inside a query.
+	template <class... Components>
+	Entity create(const Components&... components)
+	{
+		static_assert(sizeof...(Components) > 0, "EntityWorld::create: an entity needs a component");
+		const ComponentMask mask = componentMask<Components...>();
+		PV_ASSERT(bitCount(mask) == sizeof...(Components), "EntityWorld::create: a component type is listed twice");
+
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		Archetype& archetype = findArchetype<Components...>(mask);
+
+		// records don't change until applyChanges, new indices go past their end
+		Entity entity;
+		if (!freeIndices.empty())
+		{
+			entity.index = freeIndices.back();
+			entity.generation = records[entity.index].generation;
+			freeIndices.pop_back();
+		}
+		else
+		{
+			entity.index = static_cast<uint32_t>(records.size()) + pendingNewRecords++;
+			entity.generation = 0;
+		}
+
+		archetype.pendingEntities.push_back(entity);
+		const size_t rowStart = archetype.pendingRows.size();
+		archetype.pendingRows.resize(rowStart + archetype.rowSize);
+		char* row = archetype.pendingRows.data() + rowStart;
+		const int unused[] = { 0, (std::memcpy(row + archetype.rowOffsets[archetype.streamOf[componentId<Components>()]], &components, sizeof(Components)), 0)... };
+		(void)unused;
+		++pendingCreates;
+		return entity;
+	}
+
+	// The entity goes away in applyChanges, destroying a dead or already destroyed one does nothing.
+	// Any thread, also from inside a query.
+	void destroy(Entity entity)
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		pendingDestroys.push_back(entity);
+	}
+
+	// End of the frame: places the created entities, then removes the destroyed ones by moving the
+	// archetype's last entity into the hole. Every chunk that changed gets a new version.
+	void applyChanges()
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		if (pendingCreates == 0 && pendingDestroys.empty()) return;
+		const uint32_t changeVersion = ++currentVersion;
+
+		records.resize(records.size() + pendingNewRecords);
+		pendingNewRecords = 0;
+		for (std::unique_ptr<Archetype>& archetype : archetypes)
+		{
+			placePending(*archetype, changeVersion);
+		}
+		pendingCreates = 0;
+
+		for (Entity entity : pendingDestroys)
+		{
+			remove(entity, changeVersion);
+		}
+		pendingDestroys.clear();
+	}
+
+	bool alive(Entity entity) const
+	{
+		return entity.index < records.size() && records[entity.index].generation == entity.generation &&
+			records[entity.index].archetype != nullptr;
+	}
+
+	template <class T>
+	bool has(Entity entity) const
+	{
+		return alive(entity) && (records[entity.index].archetype->mask & (ComponentMask(1) << componentId<T>())) != 0;
+	}
+
+	// nullptr if the entity is gone or doesn't have a T. Good until the next applyChanges.
+	template <class T>
+	const T* get(Entity entity) const
+	{
+		if (!has<T>(entity)) return nullptr;
+		const EntityRecord& record = records[entity.index];
+		const EntityChunk& chunk = *record.archetype->chunks[record.chunk];
+		return reinterpret_cast<const T*>(chunk.streams[record.archetype->streamOf[componentId<T>()]]) + record.row;
+	}
+
+	// Writes one component and marks its stream in the entity's chunk as changed. Main thread,
+	// outside of queries; a query that writes a lot of entities is the better tool.
+	template <class T>
+	bool set(Entity entity, const T& value)
+	{
+		if (!has<T>(entity)) return false;
+		const EntityRecord& record = records[entity.index];
+		EntityChunk& chunk = *record.archetype->chunks[record.chunk];
+		const uint8_t stream = record.archetype->streamOf[componentId<T>()];
+		reinterpret_cast<T*>(chunk.streams[stream])[record.row] = value;
+		chunk.versions[stream] = ++currentVersion;
+		return true;
+	}
+
+	// func(ArrayView<const Entity>, ArrayView<Access>...) once per chunk of every archetype that has
+	// all of the components, chunks spread across the job system. Returns the chunks visited.
+	template <class... Access, class Func>
+	uint32_t forEach(JobSystem& jobs, Func&& func)
+	{
+		return forEachChanged<Access...>(jobs, 0, std::forward<Func>(func));
+	}
+
+	// Same, but only chunks where any of the components changed after sinceVersion (0 = all of them)
+	template <class... Access, class Func>
+	uint32_t forEachChanged(JobSystem& jobs, uint32_t sinceVersion, Func&& func)
+	{
+		static_assert(sizeof...(Access) > 0 && sizeof...(Access) < EntityChunk::MAX_STREAMS, "EntityWorld::forEach: 1 to 15 components");
+		const uint32_t ids[] = { componentId<Access>()... };
+		const bool writes[] = { !std::is_const<Access>::value... };
+		const ComponentMask required = componentMask<Access...>();
+		const bool anyWrite = std::find(std::begin(writes), std::end(writes), true) != std::end(writes);
+		const uint32_t writeVersion = anyWrite ? ++currentVersion : currentVersion;
+
+		matches.clear();
+		for (const std::unique_ptr<Archetype>& archetype : archetypes)
+		{
+			if ((archetype->mask & required) != required) continue;
+
+			QueryMatch match;
+			for (size_t i = 0; i < sizeof...(Access); ++i) match.streams[i] = archetype->streamOf[ids[i]];
+			for (const std::unique_ptr<EntityChunk>& chunk : archetype->chunks)
+			{
+				if (chunk->count == 0 || !changedSince(*chunk, match.streams.data(), sizeof...(Access), sinceVersion)) continue;
+				match.chunk = chunk.get();
+				matches.push_back(match);
+			}
+		}
+
+		// a few ranges per thread, chunks take about the same time
+		const uint32_t chunkCount = static_cast<uint32_t>(matches.size());
+		const uint32_t grainSize = std::max(1u, chunkCount / (jobs.threadCount() * 4));
+		jobs.parallelFor(chunkCount, grainSize, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				runChunk<Access...>(matches[i], writeVersion, func, std::index_sequence_for<Access...>());
+			}
+		});
+		return chunkCount;
+	}
+
+	uint32_t entityCount() const
+	{
+		uint32_t count = 0;
+		for (const std::unique_ptr<Archetype>& archetype : archetypes) count += archetype->entityCount();
+		return count;
+	}
+	uint32_t chunkCount() const
+	{
+		size_t count = 0;
+		for (const std::unique_ptr<Archetype>& archetype : archetypes) count += archetype->chunks.size();
+		return static_cast<uint32_t>(count);
+	}
+	uint32_t archetypeCount() const { return static_cast<uint32_t>(archetypes.size()); }
+
+private:
+	struct EntityRecord
+	{
+		Archetype* archetype = nullptr;		// nullptr while the index is free or the entity is pending
+		uint32_t chunk = 0;
+		uint32_t row = 0;
+		uint32_t generation = 0;
+	};
+	struct QueryMatch
+	{
+		EntityChunk* chunk = nullptr;
+		std::array<uint8_t, EntityChunk::MAX_STREAMS> streams;
+	};
+
+	std::vector<std::unique_ptr<Archetype>> archetypes;
+	std::vector<EntityRecord> records;
+	std::vector<uint32_t> freeIndices;
+	std::vector<QueryMatch> matches;
+	uint32_t currentVersion = 1;
+
+	std::mutex pendingMutex;
+	std::vector<Entity> pendingDestroys;
+	uint32_t pendingCreates = 0;
+	uint32_t pendingNewRecords = 0;
+
+	static uint32_t bitCount(ComponentMask mask)
+	{
+		uint32_t count = 0;
+		for (; mask != 0; mask &= mask - 1) ++count;
+		return count;
+	}
+
+	template <class... Components>
+	Archetype& findArchetype(ComponentMask mask)
+	{
+		for (std::unique_ptr<Archetype>& archetype : archetypes)
+		{
+			if (archetype->mask == mask) return *archetype;
+		}
+		archetypes.push_back(Archetype::make<Components...>());
+		return *archetypes.back();
+	}
+
+	static bool changedSince(const EntityChunk& chunk, const uint8_t* streams, size_t streamCount, uint32_t sinceVersion)
+	{
+		if (sinceVersion == 0) return true;
+		for (size_t i = 0; i < streamCount; ++i)
+		{
+			if (chunk.versions[streams[i]] > sinceVersion) return true;
+		}
+		return false;
+	}
+
+	template <class... Access, class Func, size_t... I>
+	static void runChunk(const QueryMatch& match, uint32_t writeVersion, Func& func, std::index_sequence<I...>)
+	{
+		EntityChunk& chunk = *match.chunk;
+		func(ArrayView<const Entity>(reinterpret_cast<const Entity*>(chunk.streams[0]), chunk.count),
+			ArrayView<Access>(reinterpret_cast<Access*>(chunk.streams[match.streams[I]]), chunk.count)...);
+
+		const bool writes[] = { !std::is_const<Access>::value... };
+		for (size_t i = 0; i < sizeof...(Access); ++i)
+		{
+			if (writes[i]) chunk.versions[match.streams[i]] = writeVersion;
+		}
+	}
+
+	void placePending(Archetype& archetype, uint32_t changeVersion)
+	{
+		const char* row = archetype.pendingRows.data();
+		for (Entity entity : archetype.pendingEntities)
+		{
+			if (archetype.chunks.empty() || archetype.chunks.back()->count == archetype.chunkCapacity)
+			{
+				archetype.chunks.push_back(archetype.spareChunk ? std::move(archetype.spareChunk) : archetype.newChunk(archetype.chunkCapacity));
+			}
+			EntityChunk& chunk = *archetype.chunks.back();
+			const uint32_t slot = chunk.count++;
+			reinterpret_cast<Entity*>(chunk.streams[0])[slot] = entity;
+			for (uint32_t stream = 1; stream < archetype.streamCount; ++stream)
+			{
+				std::memcpy(chunk.streams[stream] + size_t(slot) * archetype.streamSizes[stream], row + archetype.rowOffsets[stream], archetype.streamSizes[stream]);
+			}
+			chunk.stamp(archetype.streamCount, changeVersion);
+			row += archetype.rowSize;
+
+			EntityRecord& record = records[entity.index];
+			record.archetype = &archetype;
+			record.chunk = static_cast<uint32_t>(archetype.chunks.size() - 1);
+			record.row = slot;
+		}
+		archetype.pendingEntities.clear();
+		archetype.pendingRows.clear();
+	}
+
+	void remove(Entity entity, uint32_t changeVersion)
+	{
+		if (!alive(entity)) return;
+		EntityRecord& record = records[entity.index];
+		Archetype& archetype = *record.archetype;
+		EntityChunk& chunk = *archetype.chunks[record.chunk];
+		EntityChunk& last = *archetype.chunks.back();
+		const uint32_t lastSlot = last.count - 1;
+
+		// the archetype's last entity moves into the hole, all chunks but the last stay full
+		if (&chunk != &last || record.row != lastSlot)
+		{
+			for (uint32_t stream = 0; stream < archetype.streamCount; ++stream)
+			{
+				const size_t size = archetype.streamSizes[stream];
+				std::memcpy(chunk.streams[stream] + record.row * size, last.streams[stream] + lastSlot * size, size);
+			}
+			const Entity moved = reinterpret_cast<const Entity*>(chunk.streams[0])[record.row];
+			records[moved.index].chunk = record.chunk;
+			records[moved.index].row = record.row;
+			chunk.stamp(archetype.streamCount, changeVersion);
+		}
+		if (--last.count == 0)
+		{
+			archetype.spareChunk = std::move(archetype.chunks.back());
+			archetype.chunks.pop_back();
+		}
+
+		record.archetype = nullptr;
+		++record.generation;
+		freeIndices.push_back(entity.index);
+	}
+};
+
+
+// 1M entities in three archetypes: batched creation, a movement system over all of them against
+// the same loop over an array of structs, a bounds system that only visits chunks whose
+// positions changed, and a batched destroy of 10%.
+inline void benchmarkEntities(JobSystem& jobs, std::ostream& out, uint32_t entityCount = 1000000)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	auto elapsedMs = [](Clock::time_point start) { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+
+	struct Position { glm::vec3 value; };
+	struct Velocity { glm::vec3 value; };
+	struct Bounds { glm::vec3 min, max; };
+	struct Visible { uint32_t mask; };
+	// what an object with every component looks like without the ECS
+	struct Object { Entity entity; Position position; Velocity velocity; Bounds bounds; Visible visible; bool moves; };
+
+	const float DT = 1.0f / 60.0f, RADIUS = 0.5f;
+	std::mt19937 rng(2024);
+	std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+
+	EntityWorld world;
+	std::vector<Object> objects(entityCount);
+	std::vector<Entity> entities(entityCount);
+	auto start = Clock::now();
+	for (uint32_t i = 0; i < entityCount; ++i)
+	{
+		Object& object = objects[i];
+		object.position.value = glm::vec3(coordinate(rng), coordinate(rng), coordinate(rng));
+		object.velocity.value = glm::vec3(coordinate(rng), coordinate(rng), coordinate(rng)) * 0.01f;
+		object.bounds = Bounds{ object.position.value - RADIUS, object.position.value + RADIUS };
+		object.visible.mask = 0;
+		switch (i % 3)
+		{
+		case 0: entities[i] = world.create(object.position, object.velocity, object.bounds); object.moves = true; break;
+		case 1: entities[i] = world.create(object.position, object.bounds, object.visible); object.moves = false; break;
+		default: entities[i] = world.create(object.position, object.velocity, object.bounds, object.visible); object.moves = true; break;
+		}
+		object.entity = entities[i];
+	}
+	world.applyChanges();
+	const double createMs = elapsedMs(start);
+	PV_ASSERT(world.entityCount() == entityCount, "benchmarkEntities: entities missing after applyChanges");
+
+	out << "Entity benchmark: " << entityCount << " entities, " << world.archetypeCount() << " archetypes, " << world.chunkCount()
+		<< " chunks, " << jobs.threadCount() << " threads" << std::endl;
+	out << "\tcreate + applyChanges: " << createMs << " ms" << std::endl;
+
+	// movement, ECS vs array of structs
+	const int ITERATIONS = 10;
+	auto move = [DT](ArrayView<const Entity>, ArrayView<Position> positions, ArrayView<const Velocity> velocities)
+	{
+		for (int64_t i = 0; i < positions.size(); ++i) positions[i].value += velocities[i].value * DT;
+	};
+	start = Clock::now();
+	for (int i = 0; i < ITERATIONS; ++i) world.forEach<Position, const Velocity>(jobs, move);
+	const double ecsMs = elapsedMs(start) / ITERATIONS;
+
+	start = Clock::now();
+	for (int i = 0; i < ITERATIONS; ++i)
+	{
+		jobs.parallelFor(entityCount, 16384, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t j = begin; j < end; ++j)
+			{
+				if (objects[j].moves) objects[j].position.value += objects[j].velocity.value * DT;
+			}
+		});
+	}
+	const double aosMs = elapsedMs(start) / ITERATIONS;
+
+	float maxError = 0.0f;
+	for (uint32_t i = 0; i < entityCount; i += 97)
+	{
+		const Position* position = world.get<Position>(entities[i]);
+		PV_ASSERT(position != nullptr, "benchmarkEntities: entity lost");
+		maxError = std::max(maxError, glm::length(position->value - objects[i].position.value));
+	}
+	PV_ASSERT(maxError < 1e-3f, "benchmarkEntities: ECS and array of structs moved differently");
+	out << "\tmovement: ECS " << ecsMs << " ms (" << ecsMs * 1e6 / entityCount << " ns/entity), array of structs "
+		<< aosMs << " ms" << std::endl;
+
+	// bounds follow positions, first everything, then only the chunks where 1% of the entities moved
+	auto updateBounds = [RADIUS](ArrayView<const Entity>, ArrayView<const Position> positions, ArrayView<Bounds> bounds)
+	{
+		for (int64_t i = 0; i < positions.size(); ++i)
+		{
+			bounds[i].min = positions[i].value - RADIUS;
+			bounds[i].max = positions[i].value + RADIUS;
+		}
+	};
+	start = Clock::now();
+	const uint32_t allChunks = world.forEach<const Position, Bounds>(jobs, updateBounds);
+	const double fullMs = elapsedMs(start);
+	uint32_t boundsVersion = world.version();
+
+	std::vector<uint32_t> movedEntities;
+	for (uint32_t i = 0; i < entityCount / 100; ++i)
+	{
+		// a handful of neighbourhoods, like objects near the player
+		const uint32_t index = ((i / 64) * 6400 + i % 64) % entityCount;
+		Position position = *world.get<Position>(entities[index]);
+		position.value.y += 1.0f;
+		world.set(entities[index], position);
+		movedEntities.push_back(index);
+	}
+	start = Clock::now();
+	const uint32_t changedChunks = world.forEachChanged<const Position, Bounds>(jobs, boundsVersion, updateBounds);
+	const double changedMs = elapsedMs(start);
+	boundsVersion = world.version();
+	for (uint32_t index : movedEntities)
+	{
+		const Bounds* bounds = world.get<Bounds>(entities[index]);
+		PV_ASSERT(bounds->min == world.get<Position>(entities[index])->value - RADIUS, "benchmarkEntities: forEachChanged skipped a moved entity");
+	}
+	const uint32_t idleChunks = world.forEachChanged<const Position, Bounds>(jobs, boundsVersion, updateBounds);
+	PV_ASSERT(idleChunks == 0, "benchmarkEntities: forEachChanged visited chunks nothing wrote to");
+	out << "\tbounds: all " << allChunks << " chunks " << fullMs << " ms, " << movedEntities.size() << " moved entities in "
+		<< changedChunks << " chunks " << changedMs << " ms" << std::endl;
+
+	// destroy every 10th entity, recorded from the job system
+	start = Clock::now();
+	jobs.parallelFor(entityCount / 10, 4096, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; ++i) world.destroy(entities[i * 10]);
+	});
+	world.applyChanges();
+	const double destroyMs = elapsedMs(start);
+	PV_ASSERT(world.entityCount() == entityCount - entityCount / 10 && !world.alive(entities[0]) && world.alive(entities[1]),
+		"benchmarkEntities: batched destroy");
+	for (uint32_t i = 1; i < entityCount; i += 101)
+	{
+		if (i % 10 == 0) continue;
+		PV_ASSERT(glm::length(world.get<Position>(entities[i])->value - objects[i].position.value) < 2.0f,
+			"benchmarkEntities: destroy moved the wrong entity");
+	}
+	out << "\tdestroy " << entityCount / 10 << " + applyChanges: " << destroyMs << " ms" << std::endl;
+}
@@ -0,0 +1,275 @@
+#pragma once
+
+/*
+	Include dependencies: Vulkan, glm, Macros.h, ShaderReflection.h, Descriptors.h, Instancing.h, Culling.h
+*/
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <iterator>
+#include <cstring>
+#include <cmath>
+#include <stdint.h>
+
+
+// Where everything lives in one region of the instance ring. The output buffer uses the same
+// layout, so the vertex bindings and the indirect draw only change which buffer they point at.
+struct GpuCullRegionLayout
+{
+	VkDeviceSize arrayOffsets[3];	// TransformData rows
+	VkDeviceSize indirectOffset;	// VkDrawIndexedIndirectCommand, storage buffer aligned
+	VkDeviceSize paramsOffset;		// GpuCullParams, input only, uniform buffer aligned
+	VkDeviceSize regionSize;
+};
+
+// CullParams in shaders/cull.comp, std140
+struct GpuCullParams
+{
+	glm::vec4 planes[6];
+	glm::vec4 modelCenter;
+	glm::vec4 modelExtent;
+	uint32_t instanceCount;
+	uint32_t rowOffsets[3];		// in vec4s from the start of the region
+};
+
+// validate() against the CPU culler. GPU and CPU may round a plane distance differently,
+// so objects touching a plane are allowed to land on either side (borderline).
+struct GpuCullValidation
+{
+	uint32_t cpuVisible = 0;
+	uint32_t gpuVisible = 0;
+	uint32_t mismatches = 0;
+	uint32_t borderline = 0;
+
+	bool passed() const { return mismatches == borderline; }
+};
+
+
+// Frustum culling on the GPU. Every frame the CPU only writes the transforms and a GpuCullParams
+// into the instance ring, cull.comp tests every instance and appends the visible ones to this
+// region of the output buffer together with the draw's instance count. The draw reads both from
+// there, so the visible count never travels back to the CPU.
+//
+// The CPU culler (Culling.h) stays the reference, validate() compares the two on any device
+// including lavapipe.
+struct GpuCulling
+{
+	VkBuffer outputBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory outputMemory = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;	// owned by the LayoutCache
+
+	static const uint32_t GROUP_SIZE = 64;	// local_size_x in cull.comp
+
+	// Takes ownership of output/memory like MappedRingBuffer::init, it must hold input.regionCount
+	// regions of regionLayout.regionSize with STORAGE, VERTEX, INDIRECT and TRANSFER_DST usage.
+	// Host visible output memory gets mapped so validate() can read it.
+	void init(VkDevice logicalDevice, const std::vector<char>& spirv, LayoutCache& layoutCache, DescriptorSetCache& setCache,
+		DescriptorAllocator& setAllocator, VkPipelineCache cache,
+		MappedRingBuffer& input, VkBuffer output, VkDeviceMemory memory, bool hostVisible, const GpuCullRegionLayout& regionLayout)
+	{
+		device = logicalDevice;
+		inputRing = &input;
+		outputBuffer = output;
+		outputMemory = memory;
+		layout = regionLayout;
+
+		if (hostVisible)
+		{
+			void* ptr;
+			PV_VK_RUN(vkMapMemory(device, outputMemory, 0, layout.regionSize * inputRing->regionCount, 0, &ptr));
+			outputMapped = static_cast<char*>(ptr);
+		}
+
+		ShaderReflection reflection = reflectSpirv(spirv);
+		PipelineLayoutDesc layoutDesc = mergeShaderLayouts({ &reflection });
+		PV_ASSERT(layoutDesc.sets.size() == 1 && layoutDesc.sets[0].size() == 4, "cull.comp: expected one set with the params, in, out and draw bindings");
+		VkDescriptorSetLayout setLayout = layoutCache.getDescriptorSetLayout(layoutDesc.sets[0]);
+		pipelineLayout = layoutCache.getPipelineLayout(layoutDesc);
+
+		createPipeline(spirv, cache);
+		createDescriptorSets(setCache, setAllocator.getTemplate(setLayout, layoutDesc.sets[0]));
+	}
+
+	void cleanup()
+	{
+		if (device == VK_NULL_HANDLE) return;
+
+		vkDestroyPipeline(device, pipeline, allocnullptr);
+		if (outputMapped != nullptr)
+			vkUnmapMemory(device, outputMemory);
+		vkDestroyBuffer(device, outputBuffer, allocnullptr);
+		vkFreeMemory(device, outputMemory, allocnullptr);
+		device = VK_NULL_HANDLE;
+		outputMapped = nullptr;
+	}
+
+	// this frame's input, next to the transforms in the ring region
+	void writeParams(uint32_t region, const Frustum& frustum, const glm::vec3& modelCenter, const glm::vec3& modelExtent, uint32_t instanceCount)
+	{
+		GpuCullParams params;
+		for (int p = 0; p < 6; ++p)
+		{
+			params.planes[p] = frustum.planes[p];
+		}
+		params.modelCenter = glm::vec4(modelCenter, 0.0f);
+		params.modelExtent = glm::vec4(modelExtent, 0.0f);
+		params.instanceCount = instanceCount;
+		for (int row = 0; row < 3; ++row)
+		{
+			PV_ASSERT(layout.arrayOffsets[row] % sizeof(glm::vec4) == 0, "GpuCulling: TransformData rows have to start on a vec4");
+			params.rowOffsets[row] = static_cast<uint32_t>(layout.arrayOffsets[row] / sizeof(glm::vec4));
+		}
+		memcpy(static_cast<char*>(inputRing->region(region)) + layout.paramsOffset, &params, sizeof(params));
+	}
+
+	// Outside a render pass, the caller's render graph orders these: recordReset writes the region's
+	// draw with a transfer, recordDispatch reads and writes the whole region in the compute stage.
+	// The culled region is read by vertex input and draw indirect (and the host, for validate()).
+	void recordReset(VkCommandBuffer cmd, uint32_t region, uint32_t indexCount)
+	{
+		VkDrawIndexedIndirectCommand draw = {};
+		draw.indexCount = indexCount;
+		vkCmdUpdateBuffer(cmd, outputBuffer, regionOffset(region) + layout.indirectOffset, sizeof(draw), &draw);
+	}
+
+	void recordDispatch(VkCommandBuffer cmd, uint32_t region, uint32_t maxInstances)
+	{
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[region], 0, nullptr);
+		vkCmdDispatch(cmd, (maxInstances + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+	}
+
+	VkDeviceSize regionOffset(uint32_t region) const { return region * layout.regionSize; }
+
+	// Culls the transforms and frustum the region was last dispatched with on the CPU and compares
+	// the visible sets. GPU slots are in any order, so instances are matched by their transform.
+	// The region's submit has to be finished and the output host visible.
+	GpuCullValidation validate(uint32_t region)
+	{
+		PV_ASSERT(outputMapped != nullptr, "GpuCulling: validation needs host visible output memory");
+
+		const char* in = static_cast<const char*>(inputRing->region(region));
+		const char* out = outputMapped + regionOffset(region);
+		GpuCullParams params;
+		memcpy(&params, in + layout.paramsOffset, sizeof(params));
+		VkDrawIndexedIndirectCommand draw;
+		memcpy(&draw, out + layout.indirectOffset, sizeof(draw));
+
+		Frustum frustum;
+		for (int p = 0; p < 6; ++p)
+		{
+			frustum.planes[p] = params.planes[p];
+		}
+		const glm::vec3 modelCenter(params.modelCenter);
+		const glm::vec3 modelExtent(params.modelExtent);
+
+		// the three rows of an instance's world matrix
+		typedef std::array<float, 12> TransformKey;
+		auto transformKey = [&](const char* regionMemory, uint32_t index)
+		{
+			TransformKey key;
+			for (int row = 0; row < 3; ++row)
+			{
+				memcpy(&key[row * 4], regionMemory + layout.arrayOffsets[row] + index * sizeof(glm::vec4), sizeof(glm::vec4));
+			}
+			return key;
+		};
+		auto keyWorld = [](const TransformKey& k)
+		{
+			return TransformData::fromRows(glm::vec4(k[0], k[1], k[2], k[3]), glm::vec4(k[4], k[5], k[6], k[7]), glm::vec4(k[8], k[9], k[10], k[11]));
+		};
+
+		const uint32_t count = params.instanceCount;
+		CullingBounds bounds(count);
+		std::vector<TransformKey> inputKeys(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			inputKeys[i] = transformKey(in, i);
+			bounds.setTransformedBox(i, modelCenter, modelExtent, keyWorld(inputKeys[i]));
+		}
+		std::vector<uint32_t> visible(count);
+		GpuCullValidation result;
+		result.cpuVisible = count > 0 ? cullBounds(bounds, frustum, 0, count, visible.data()) : 0;
+		result.gpuVisible = draw.instanceCount;
+		PV_ASSERT(result.gpuVisible <= count, "GpuCulling: more instances visible than there are");
+
+		std::vector<TransformKey> cpuKeys, gpuKeys;
+		for (uint32_t v = 0; v < result.cpuVisible; ++v) cpuKeys.push_back(inputKeys[visible[v]]);
+		for (uint32_t v = 0; v < result.gpuVisible; ++v) gpuKeys.push_back(transformKey(out, v));
+		std::sort(cpuKeys.begin(), cpuKeys.end());
+		std::sort(gpuKeys.begin(), gpuKeys.end());
+		std::vector<TransformKey> different;
+		std::set_symmetric_difference(cpuKeys.begin(), cpuKeys.end(), gpuKeys.begin(), gpuKeys.end(), std::back_inserter(different));
+		result.mismatches = static_cast<uint32_t>(different.size());
+
+		// within float noise of a plane, either answer is right
+		for (const TransformKey& k : different)
+		{
+			CullingBounds single(1);
+			single.setTransformedBox(0, modelCenter, modelExtent, keyWorld(k));
+			const glm::vec3 center(single.centerX()[0], single.centerY()[0], single.centerZ()[0]);
+			const glm::vec3 extent(single.extentX()[0], single.extentY()[0], single.extentZ()[0]);
+			const float radius = single.radius()[0];
+
+			float margin = std::numeric_limits<float>::max();
+			for (const glm::vec4& plane : frustum.planes)
+			{
+				float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+				float boxRadius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+				margin = std::min(margin, std::min(distance + radius, distance + boxRadius));
+			}
+			const float tolerance = 1e-4f * std::max(1.0f, glm::length(center) + radius);
+			if (std::abs(margin) <= tolerance)
+				++result.borderline;
+		}
+		return result;
+	}
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	MappedRingBuffer* inputRing = nullptr;
+	GpuCullRegionLayout layout = {};
+	char* outputMapped = nullptr;
+	std::vector<VkDescriptorSet> descriptorSets;	// owned by the DescriptorSetCache's allocator
+
+	void createPipeline(const std::vector<char>& spirv, VkPipelineCache cache)
+	{
+		VkShaderModuleCreateInfo moduleInfo = {};
+		moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleInfo.codeSize = spirv.size();
+		moduleInfo.pCode = reinterpret_cast<const uint32_t*>(spirv.data());
+		VkShaderModule module;
+		PV_VK_RUN(vkCreateShaderModule(device, &moduleInfo, allocnullptr, &module));
+
+		VkComputePipelineCreateInfo pipelineInfo = {};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = module;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.layout = pipelineLayout;
+
+		VkResult result = vkCreateComputePipelines(device, cache, 1, &pipelineInfo, allocnullptr, &pipeline);
+		// the pipeline keeps what it needs, the module can go either way
+		vkDestroyShaderModule(device, module, allocnullptr);
+		PV_VK_RUN(result);
+	}
+
+	// one set per region: params and transforms in the ring, transforms and draw in the output
+	void createDescriptorSets(DescriptorSetCache& setCache, const DescriptorTemplate& setTemplate)
+	{
+		descriptorSets.resize(inputRing->regionCount);
+		for (uint32_t region = 0; region < inputRing->regionCount; ++region)
+		{
+			const VkDeviceSize base = regionOffset(region);
+			descriptorSets[region] = setCache.get(setTemplate,
+			{
+				DescriptorInfo(inputRing->buffer, base + layout.paramsOffset, sizeof(GpuCullParams)),
+				DescriptorInfo(inputRing->buffer, base, layout.indirectOffset),
+				DescriptorInfo(outputBuffer, base, layout.indirectOffset),
+				DescriptorInfo(outputBuffer, base + layout.indirectOffset, sizeof(VkDrawIndexedIndirectCommand)),
+			});
+		}
+	}
+};
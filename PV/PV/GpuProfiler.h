@@ -0,0 +1,376 @@
+#pragma once
+
+/*
+	Include dependencies: Vulkan, Macros.h
+*/
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <fstream>
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+#include "CpuProfiler.h" // writeJsonString
+
+
+// Slot used by beginSingleTimeCommands/endSingleTimeCommands work (uploads, layout
+// transitions, mip generation). Frame slots are [0, swapChainImages.size())
+static const uint32_t GPU_PROFILER_UPLOAD_SLOT = 31;
+
+
+struct GpuScope
+{
+	uint32_t slot = 0;
+	uint32_t region = UINT32_MAX; // UINT32_MAX means the profiler was disabled when the scope began
+};
+
+struct GpuScopeStats
+{
+	std::string name;
+	double lastMs = 0.0;
+	double averageMs = 0.0; // rolling average over the last GpuProfiler::ROLLING_WINDOW samples
+	double minMs = 0.0;
+	double maxMs = 0.0;
+	uint64_t sampleCount = 0;
+
+	// ring of the last ROLLING_WINDOW samples
+	std::vector<double> window;
+	uint32_t windowHead = 0;
+	double windowSum = 0.0;
+};
+
+
+// Times regions of command buffers with vkCmdWriteTimestamp pairs.
+//
+// Every slot owns its own query pool. A slot is a set of command buffers that are
+// submitted together, for us that is one slot per swap chain image (those command buffers are
+// recorded once and resubmitted) and GPU_PROFILER_UPLOAD_SLOT for single time commands.
+// Results are only read back with vkGetQueryPoolResults(..., WITH_AVAILABILITY) right before
+// a slot is used again, so by then the GPU finished it N frames ago and we never stall on it.
+struct GpuProfiler
+{
+	static const uint32_t MAX_QUERIES_PER_SLOT = 128;	// 2 queries per scope
+	static const uint32_t ROLLING_WINDOW = 64;			// samples in the rolling average
+	static const size_t   MAX_TRACE_EVENTS = 16384;		// events kept for the chrome trace
+
+	enum RegionState { REGION_RECORDED, REGION_SUBMITTED, REGION_READ };
+
+	struct Region
+	{
+		uint32_t scopeId;
+		uint32_t firstQuery;
+		RegionState state;
+	};
+
+	struct Slot
+	{
+		VkQueryPool pool = VK_NULL_HANDLE;
+		std::vector<Region> regions;
+		uint32_t nextQuery = 0;
+		// one shot slots (single time commands) are never resubmitted, so their regions are
+		// dropped after they have been read back. Frame slots keep theirs.
+		bool persistent = true;
+	};
+
+	struct TraceEvent
+	{
+		uint32_t scopeId;
+		uint32_t slot;
+		uint64_t frame;
+		uint64_t startTicks;
+		uint64_t durationTicks;
+	};
+
+	// false if the selected queue family can't write timestamps, then everything is a no-op
+	bool enabled = false;
+
+	void init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, uint32_t queueFamilyIndex)
+	{
+		device = logicalDevice;
+
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+		// nanoseconds per timestamp tick
+		timestampPeriod = static_cast<double>(deviceProperties.limits.timestampPeriod);
+
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+		uint32_t validBits = queueFamilyIndex < queueFamilyCount ? queueFamilies[queueFamilyIndex].timestampValidBits : 0;
+		enabled = validBits > 0 && timestampPeriod > 0.0;
+		timestampMask = validBits >= 64 ? UINT64_MAX : ((uint64_t(1) << validBits) - 1);
+	}
+
+	void cleanup()
+	{
+		for (auto& slot : slots)
+		{
+			if (slot.pool != VK_NULL_HANDLE)
+				vkDestroyQueryPool(device, slot.pool, allocnullptr);
+		}
+		slots.clear();
+		enabled = false;
+	}
+
+	// Call before (re)recording the command buffers of a frame slot. Old regions are forgotten.
+	void clearSlot(uint32_t slotIndex)
+	{
+		Slot& slot = getSlot(slotIndex);
+		slot.regions.clear();
+		slot.nextQuery = 0;
+	}
+
+	// Records a reset of the scope's queries and the begin timestamp.
+	// Must be called outside of a render pass instance (vkCmdResetQueryPool restriction).
+	GpuScope beginScope(VkCommandBuffer cmd, uint32_t slotIndex, const char* name,
+		VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT)
+	{
+		GpuScope scope;
+		scope.slot = slotIndex;
+		if (!enabled) return scope;
+
+		Slot& slot = getSlot(slotIndex);
+		if (slot.nextQuery + 2 > MAX_QUERIES_PER_SLOT)
+		{
+			// one shot slots may be full of results we haven't read yet, try to make room
+			if (!slot.persistent)
+				collect(slotIndex);
+			if (slot.nextQuery + 2 > MAX_QUERIES_PER_SLOT)
+				return scope; // out of queries, drop the scope
+		}
+
+		Region region;
+		region.scopeId = getScopeId(name);
+		region.firstQuery = slot.nextQuery;
+		region.state = REGION_RECORDED;
+		slot.nextQuery += 2;
+
+		vkCmdResetQueryPool(cmd, slot.pool, region.firstQuery, 2);
+		vkCmdWriteTimestamp(cmd, stage, slot.pool, region.firstQuery);
+
+		scope.region = static_cast<uint32_t>(slot.regions.size());
+		slot.regions.push_back(region);
+		return scope;
+	}
+
+	void endScope(VkCommandBuffer cmd, const GpuScope& scope,
+		VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT)
+	{
+		if (!enabled || scope.region == UINT32_MAX) return;
+
+		Slot& slot = getSlot(scope.slot);
+		vkCmdWriteTimestamp(cmd, stage, slot.pool, slot.regions[scope.region].firstQuery + 1);
+	}
+
+	// The command buffers of the slot were handed to vkQueueSubmit, their queries
+	// may be read back from now on.
+	void markSubmitted(uint32_t slotIndex)
+	{
+		if (!enabled) return;
+
+		Slot& slot = getSlot(slotIndex);
+		for (auto& region : slot.regions)
+		{
+			// frame slots are resubmitted and measured again, one shot regions only once
+			if (slot.persistent || region.state == REGION_RECORDED)
+				region.state = REGION_SUBMITTED;
+		}
+	}
+
+	// Reads back every submitted region of the slot that the GPU has finished.
+	// Never waits, regions that are not available yet are picked up by a later call.
+	void collect(uint32_t slotIndex)
+	{
+		if (!enabled) return;
+
+		Slot& slot = getSlot(slotIndex);
+		// queries that were never reset on the GPU can't be read, wait for the first submit
+		bool anySubmitted = false;
+		for (const auto& region : slot.regions)
+			anySubmitted |= region.state == REGION_SUBMITTED;
+		if (!anySubmitted) return;
+
+		// (value, availability) pairs for every query
+		resultScratch.resize(slot.nextQuery * 2);
+		VkResult res = vkGetQueryPoolResults(device, slot.pool, 0, slot.nextQuery,
+			resultScratch.size() * sizeof(uint64_t), resultScratch.data(), sizeof(uint64_t) * 2,
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+		if (res != VK_SUCCESS && res != VK_NOT_READY)
+			return;
+
+		bool allRead = true;
+		for (auto& region : slot.regions)
+		{
+			const uint64_t* begin = &resultScratch[region.firstQuery * 2];
+			const uint64_t* end = begin + 2;
+			if (region.state == REGION_READ)
+				continue;
+			if (region.state != REGION_SUBMITTED || begin[1] == 0 || end[1] == 0)
+			{
+				allRead = false;
+				continue;
+			}
+
+			uint64_t startTicks = begin[0] & timestampMask;
+			uint64_t durationTicks = ((end[0] & timestampMask) - startTicks) & timestampMask;
+			addSample(region.scopeId, slotIndex, startTicks, durationTicks);
+
+			// a sample is only counted once per submit
+			region.state = REGION_READ;
+		}
+
+		// one shot slots are done once everything in them was read
+		if (!slot.persistent && allRead)
+		{
+			slot.regions.clear();
+			slot.nextQuery = 0;
+		}
+		++collectCount;
+	}
+
+	const std::vector<GpuScopeStats>& getScopeStats() const
+	{
+		return scopeStats;
+	}
+
+	// returns nullptr if no scope with that name was ever recorded
+	const GpuScopeStats* findScope(const std::string& name) const
+	{
+		auto found = scopeIds.find(name);
+		if (found == scopeIds.end())
+			return nullptr;
+		return &scopeStats[found->second];
+	}
+
+	void printSummary(std::ostream& out) const
+	{
+		out << "GPU Profile (ms)            last      avg      min      max  samples\n";
+		for (const auto& stats : scopeStats)
+		{
+			out << "\t" << std::left << std::setw(20) << stats.name << std::right << std::fixed << std::setprecision(3)
+				<< std::setw(9) << stats.lastMs
+				<< std::setw(9) << stats.averageMs
+				<< std::setw(9) << stats.minMs
+				<< std::setw(9) << stats.maxMs
+				<< std::setw(9) << stats.sampleCount << "\n";
+		}
+		out << std::endl;
+	}
+
+	// Chrome trace format (chrome://tracing, ui.perfetto.dev). Every slot becomes its own track.
+	bool writeChromeTrace(const std::string& path) const
+	{
+		std::ofstream file(path);
+		if (!file.is_open())
+			return false;
+
+		uint64_t firstTicks = UINT64_MAX;
+		for (const auto& ev : traceEvents)
+			firstTicks = std::min(firstTicks, ev.startTicks);
+
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		bool first = true;
+		for (size_t i = 0; i < traceEvents.size(); ++i)
+		{
+			// oldest first, traceEvents is a ring once full
+			const TraceEvent& ev = traceEvents[(traceHead + i) % traceEvents.size()];
+			double startUs = ticksToMs(ev.startTicks - firstTicks) * 1000.0;
+			double durationUs = ticksToMs(ev.durationTicks) * 1000.0;
+
+			file << (first ? "" : ",\n") << std::fixed << std::setprecision(3) << "{\"name\":";
+			writeJsonString(file, scopeStats[ev.scopeId].name.c_str());
+			file << ",\"cat\":\"gpu\",\"ph\":\"X\""
+				<< ",\"pid\":1,\"tid\":" << ev.slot
+				<< ",\"ts\":" << startUs << ",\"dur\":" << durationUs
+				<< ",\"args\":{\"collect\":" << ev.frame << "}}";
+			first = false;
+		}
+		file << "\n]}\n";
+		return true;
+	}
+
+	double ticksToMs(uint64_t ticks) const
+	{
+		return static_cast<double>(ticks) * timestampPeriod / 1000000.0;
+	}
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	double timestampPeriod = 0.0;
+	uint64_t timestampMask = UINT64_MAX;
+	uint64_t collectCount = 0;
+
+	std::vector<Slot> slots;
+	std::vector<uint64_t> resultScratch;
+
+	std::unordered_map<std::string, uint32_t> scopeIds;
+	std::vector<GpuScopeStats> scopeStats;
+
+	std::vector<TraceEvent> traceEvents;
+	size_t traceHead = 0;
+
+	Slot& getSlot(uint32_t slotIndex)
+	{
+		if (slotIndex >= slots.size())
+			slots.resize(slotIndex + 1);
+
+		Slot& slot = slots[slotIndex];
+		if (slot.pool == VK_NULL_HANDLE && enabled)
+		{
+			VkQueryPoolCreateInfo poolInfo = {};
+			poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			poolInfo.queryCount = MAX_QUERIES_PER_SLOT;
+
+			PV_VK_RUN(vkCreateQueryPool(device, &poolInfo, allocnullptr, &slot.pool));
+			slot.persistent = slotIndex != GPU_PROFILER_UPLOAD_SLOT;
+		}
+		return slot;
+	}
+
+	uint32_t getScopeId(const char* name)
+	{
+		auto found = scopeIds.find(name);
+		if (found != scopeIds.end())
+			return found->second;
+
+		uint32_t id = static_cast<uint32_t>(scopeStats.size());
+		scopeIds.emplace(name, id);
+
+		GpuScopeStats stats;
+		stats.name = name;
+		stats.window.assign(ROLLING_WINDOW, 0.0);
+		scopeStats.push_back(stats);
+		return id;
+	}
+
+	void addSample(uint32_t scopeId, uint32_t slotIndex, uint64_t startTicks, uint64_t durationTicks)
+	{
+		GpuScopeStats& stats = scopeStats[scopeId];
+		double ms = ticksToMs(durationTicks);
+
+		stats.lastMs = ms;
+		stats.minMs = stats.sampleCount == 0 ? ms : std::min(stats.minMs, ms);
+		stats.maxMs = stats.sampleCount == 0 ? ms : std::max(stats.maxMs, ms);
+
+		stats.windowSum += ms - stats.window[stats.windowHead];
+		stats.window[stats.windowHead] = ms;
+		stats.windowHead = (stats.windowHead + 1) % ROLLING_WINDOW;
+		++stats.sampleCount;
+		stats.averageMs = stats.windowSum / static_cast<double>(std::min<uint64_t>(stats.sampleCount, ROLLING_WINDOW));
+
+		TraceEvent ev = { scopeId, slotIndex, collectCount, startTicks, durationTicks };
+		if (traceEvents.size() < MAX_TRACE_EVENTS)
+		{
+			traceEvents.push_back(ev);
+		}
+		else
+		{
+			traceEvents[traceHead] = ev;
+			traceHead = (traceHead + 1) % MAX_TRACE_EVENTS;
+		}
+	}
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+/*
+	Include dependencies: Vulkan, glm, glm/gtc/quaternion.hpp, Macros.h, Vertex.h, MultiArray.h
+*/
+#include <stdint.h>
+
+
+// Per instance world transform, SoA: the rows of the upper 3x4 of the world matrix. Each array is
+// fed to the vertex shader as its own instance rate vertex binding, so the whole thing reaches the
+// GPU with one memcpy and no repacking. TransformHierarchy fills it (writeWorldTransforms).
+struct TransformData
+{
+	MultiArray<glm::vec4, glm::vec4, glm::vec4> data;
+	uint32_t count;
+
+	TransformData(uint32_t instanceCount)
+		: data({ instanceCount, instanceCount, instanceCount })
+		, count(instanceCount)
+	{
+	}
+
+	ArrayView<glm::vec4> row0() {
+		return data.getView<0, glm::vec4>();
+	}
+	ArrayView<glm::vec4> row1() {
+		return data.getView<1, glm::vec4>();
+	}
+	ArrayView<glm::vec4> row2() {
+		return data.getView<2, glm::vec4>();
+	}
+
+	glm::mat4 world(uint32_t index) {
+		return fromRows(row0()[index], row1()[index], row2()[index]);
+	}
+
+	static glm::mat4 fromRows(const glm::vec4& r0, const glm::vec4& r1, const glm::vec4& r2)
+	{
+		return glm::mat4(
+			glm::vec4(r0.x, r1.x, r2.x, 0.0f),
+			glm::vec4(r0.y, r1.y, r2.y, 0.0f),
+			glm::vec4(r0.z, r1.z, r2.z, 0.0f),
+			glm::vec4(r0.w, r1.w, r2.w, 1.0f));
+	}
+
+	// one binding per array starting at firstBinding, attributes at firstLocation..firstLocation+2
+	// (instanceRow0..2 in shader.vert)
+	static void addInputDescriptions(VertexInputState& state, uint32_t firstBinding, uint32_t firstLocation)
+	{
+		for (uint32_t row = 0; row < BINDING_COUNT; ++row)
+		{
+			state.add(GetInputDescription<VertexData<glm::vec4>>(firstBinding + row, VK_VERTEX_INPUT_RATE_INSTANCE, firstLocation + row));
+		}
+	}
+	static const uint32_t BINDING_COUNT = 3;
+};
+
+
+// Persistently mapped, host coherent buffer split into equal regions, one per frame in flight.
+// The CPU writes region N while the GPU may still read the others.
+struct MappedRingBuffer
+{
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize regionSize = 0;
+	uint32_t regionCount = 0;
+
+	// takes ownership of buffer/bufferMemory, which must hold regionCount * regionSize bytes
+	void init(VkDevice logicalDevice, VkBuffer ringBuffer, VkDeviceMemory bufferMemory, VkDeviceSize sizePerRegion, uint32_t regions)
+	{
+		device = logicalDevice;
+		buffer = ringBuffer;
+		memory = bufferMemory;
+		regionSize = sizePerRegion;
+		regionCount = regions;
+
+		void* ptr;
+		PV_VK_RUN(vkMapMemory(device, memory, 0, regionSize * regionCount, 0, &ptr));
+		mapped = static_cast<char*>(ptr);
+	}
+
+	void cleanup()
+	{
+		if (buffer == VK_NULL_HANDLE) return;
+
+		vkUnmapMemory(device, memory);
+		vkDestroyBuffer(device, buffer, allocnullptr);
+		vkFreeMemory(device, memory, allocnullptr);
+		buffer = VK_NULL_HANDLE;
+		memory = VK_NULL_HANDLE;
+		mapped = nullptr;
+	}
+
+	void* region(uint32_t index)
+	{
+		PV_ASSERT(index < regionCount, "MappedRingBuffer: region out of range");
+		return mapped + regionOffset(index);
+	}
+
+	VkDeviceSize regionOffset(uint32_t index) const
+	{
+		return regionSize * index;
+	}
+
+	static VkDeviceSize alignUp(VkDeviceSize size, VkDeviceSize alignment)
+	{
+		return (size + alignment - 1) / alignment * alignment;
+	}
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	char* mapped = nullptr;
+};
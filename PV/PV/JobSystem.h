@@ -0,0 +1,178 @@
+#pragma once
+
+/*
+	Include dependencies: none
+*/
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+
+// Small fixed size thread pool. Work is handed out as index ranges through parallelFor,
+// the calling thread works on the range too so nested parallelFor calls can't deadlock
+// even when every worker is busy.
+struct JobSystem
+{
+	~JobSystem()
+	{
+		shutdown();
+	}
+
+	// threadCount 0 = one worker per hardware thread, minus the calling thread
+	void init(uint32_t threadCount = 0)
+	{
+		if (threadCount == 0)
+		{
+			uint32_t hardwareThreads = std::thread::hardware_concurrency();
+			threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+
+		running = true;
+		for (uint32_t i = 0; i < threadCount; ++i)
+		{
+			workers.emplace_back([this, i]() { workerLoop(i + 1); });
+		}
+	}
+
+	void shutdown()
+	{
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			running = false;
+		}
+		queueCondition.notify_all();
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+		workers.clear();
+	}
+
+	uint32_t workerCount() const { return static_cast<uint32_t>(workers.size()); }
+
+	// threads that may call into a job at the same time (workers + the caller)
+	uint32_t threadCount() const { return workerCount() + 1; }
+
+	// 0 on any thread that isn't a worker, [1, workerCount()] on workers
+	static uint32_t threadIndex() { return currentThreadIndex(); }
+
+	// Calls func(begin, end) for [0, count) split into ranges of at most grainSize.
+	// Blocks until every range is done. If func throws, the ranges not started yet are
+	// skipped and the first exception is rethrown on the caller once every helper is done
+	// with func, whose captures may live on the caller's stack.
+	template<typename F>
+	void parallelFor(uint32_t count, uint32_t grainSize, F&& func)
+	{
+		if (count == 0) return;
+		grainSize = std::max(grainSize, 1u);
+
+		const uint32_t chunkCount = (count + grainSize - 1) / grainSize;
+		if (chunkCount == 1 || workers.empty())
+		{
+			func(0u, count);
+			return;
+		}
+
+		// shared with the helpers, one of them may only start after we already returned
+		struct Batch
+		{
+			std::atomic<uint32_t> nextChunk{ 0 };
+			std::atomic<uint32_t> chunksDone{ 0 };
+			std::atomic<bool> failed{ false };
+			std::exception_ptr error;	// the first exception, written under doneMutex
+			std::mutex doneMutex;
+			std::condition_variable doneCondition;
+		};
+		auto batch = std::make_shared<Batch>();
+		std::function<void(uint32_t, uint32_t)> rangeFunc = func;
+
+		auto work = [batch, rangeFunc, count, grainSize, chunkCount]()
+		{
+			uint32_t chunk;
+			while ((chunk = batch->nextChunk.fetch_add(1)) < chunkCount)
+			{
+				if (!batch->failed.load(std::memory_order_relaxed))
+				{
+					uint32_t begin = chunk * grainSize;
+					try
+					{
+						rangeFunc(begin, std::min(begin + grainSize, count));
+					}
+					catch (...)
+					{
+						std::lock_guard<std::mutex> lock(batch->doneMutex);
+						if (!batch->error)
+						{
+							batch->error = std::current_exception();
+						}
+						batch->failed.store(true, std::memory_order_relaxed);
+					}
+				}
+
+				if (batch->chunksDone.fetch_add(1) + 1 == chunkCount)
+				{
+					std::lock_guard<std::mutex> lock(batch->doneMutex);
+					batch->doneCondition.notify_all();
+				}
+			}
+		};
+
+		const uint32_t helpers = std::min(workerCount(), chunkCount - 1);
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			for (uint32_t i = 0; i < helpers; ++i)
+			{
+				jobs.push_back(work);
+			}
+		}
+		queueCondition.notify_all();
+
+		work();
+
+		std::unique_lock<std::mutex> lock(batch->doneMutex);
+		batch->doneCondition.wait(lock, [&]() { return batch->chunksDone.load() == chunkCount; });
+		if (batch->error)
+		{
+			std::rethrow_exception(batch->error);
+		}
+	}
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	bool running = false;
+
+	static uint32_t& currentThreadIndex()
+	{
+		thread_local uint32_t index = 0;
+		return index;
+	}
+
+	void workerLoop(uint32_t index)
+	{
+		currentThreadIndex() = index;
+		for (;;)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				queueCondition.wait(lock, [this]() { return !running || !jobs.empty(); });
+				if (!running && jobs.empty())
+					return;
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			job();
+		}
+	}
+};
@@ -103,7 +103,7 @@ void LoadMesh(const LoadedModelData* data, bool normals, bool tangents, bool bit
 	}
 	auto loadFunc = loadFunctions[functionPtrFlag];
 
-	Mesh m(2, 2);
+	Mesh m(2);
 
 
 	loadFunc();
@@ -0,0 +1,572 @@
+#pragma once
+
+/*
+	Include dependencies: glm, Macros.h, MultiArray.h, JobSystem.h
+*/
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <random>
+#include <chrono>
+#include <ostream>
+#include <new>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <utility>
+#include <stdint.h>
+
+
+// Counters for every arena and pool of one subsystem ("Frame", "Import", ...). Arenas and pools
+// count locally and add to them on reset / flush, the allocation path never touches an atomic.
+struct MemoryStats
+{
+	explicit MemoryStats(const char* subsystemName) : name(subsystemName) { }
+
+	const char* name;
+	std::atomic<uint64_t> allocations{ 0 };		// handed out
+	std::atomic<uint64_t> bytes{ 0 };
+	std::atomic<uint64_t> frees{ 0 };			// pools only, arenas free everything at once
+	std::atomic<uint64_t> heapAllocations{ 0 };	// blocks / chunks taken from the heap
+	std::atomic<uint64_t> reservedBytes{ 0 };	// held from the heap right now
+	std::atomic<uint64_t> peakUsedBytes{ 0 };	// most one arena had in use between two resets, pool slots
+
+	void addPeak(uint64_t used)
+	{
+		uint64_t peak = peakUsedBytes.load(std::memory_order_relaxed);
+		while (used > peak && !peakUsedBytes.compare_exchange_weak(peak, used, std::memory_order_relaxed)) { }
+	}
+};
+
+namespace memory_detail
+{
+	struct Registry
+	{
+		std::mutex mutex;
+		std::deque<MemoryStats> subsystems; // stable addresses
+	};
+	inline Registry& registry()
+	{
+		static Registry instance;
+		return instance;
+	}
+}
+
+// The counters of a subsystem, created on first use. Look them up once at init, not per allocation.
+inline MemoryStats& memoryStats(const char* subsystem)
+{
+	memory_detail::Registry& registry = memory_detail::registry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	for (MemoryStats& stats : registry.subsystems)
+	{
+		if (std::strcmp(stats.name, subsystem) == 0)
+			return stats;
+	}
+	registry.subsystems.emplace_back(subsystem);
+	return registry.subsystems.back();
+}
+
+inline void printMemoryStats(std::ostream& out)
+{
+	memory_detail::Registry& registry = memory_detail::registry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	out << "Memory:" << std::endl;
+	for (const MemoryStats& stats : registry.subsystems)
+	{
+		out << "\t" << stats.name << ": " << stats.allocations.load() << " allocations, " << stats.bytes.load() / 1024 << " KiB";
+		if (stats.frees.load() > 0)
+			out << ", " << stats.allocations.load() - stats.frees.load() << " live";
+		out << ", " << stats.heapAllocations.load() << " heap allocations, " << stats.reservedBytes.load() / 1024 << " KiB reserved, "
+			<< stats.peakUsedBytes.load() / 1024 << " KiB peak" << std::endl;
+	}
+}
+
+
+// Bump allocation out of a list of heap blocks. Nothing is freed on its own: reset() takes all of
+// it back at once, rewind(mark()) everything since the mark. A reset after running into more than
+// one block replaces them with a single block of their total size, so a steady workload ends up
+// bumping through one block. Not thread safe, one arena per thread.
+struct LinearArena
+{
+	static const size_t DEFAULT_ALIGNMENT = alignof(std::max_align_t);
+	static const size_t BLOCK_ALIGNMENT = 64;
+
+	struct Marker
+	{
+		size_t block = 0;
+		size_t offset = 0;
+	};
+
+	LinearArena() = default;
+	LinearArena(size_t blockSize, MemoryStats& memoryStats)
+	{
+		init(blockSize, memoryStats);
+	}
+	LinearArena(const LinearArena&) = delete;
+	LinearArena& operator=(const LinearArena&) = delete;
+	LinearArena(LinearArena&& other)
+	{
+		swap(other);
+	}
+	LinearArena& operator=(LinearArena&& other)
+	{
+		swap(other);
+		return *this;
+	}
+	~LinearArena()
+	{
+		release();
+	}
+
+	void init(size_t blockSize, MemoryStats& memoryStats)
+	{
+		release();
+		defaultBlockSize = blockSize;
+		stats = &memoryStats;
+	}
+
+	void* allocate(size_t bytes, size_t alignment = DEFAULT_ALIGNMENT)
+	{
+		PV_ASSERT(stats != nullptr, "LinearArena: allocate before init");
+		for (;;)
+		{
+			if (current < blocks.size())
+			{
+				Block& block = blocks[current];
+				const uintptr_t base = reinterpret_cast<uintptr_t>(block.memory);
+				const size_t start = static_cast<size_t>(((base + offset + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1)) - base);
+				if (start + bytes <= block.size)
+				{
+					offset = start + bytes;
+					used += bytes;
+					++allocations;
+					return block.memory + start;
+				}
+				// the rest of this block is wasted until the next reset
+				++current;
+				offset = 0;
+				continue;
+			}
+			addBlock(std::max(defaultBlockSize, bytes + alignment));
+		}
+	}
+
+	template <class T>
+	T* allocateArray(size_t count)
+	{
+		return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+	}
+
+	Marker mark() const
+	{
+		Marker marker;
+		marker.block = current;
+		marker.offset = offset;
+		return marker;
+	}
+	// frees everything allocated since marker, keeps the blocks
+	void rewind(const Marker& marker)
+	{
+		current = marker.block;
+		offset = marker.offset;
+	}
+
+	void reset()
+	{
+		flushStats();
+		if (current > 0 && blocks.size() > 1)
+		{
+			size_t total = 0;
+			for (const Block& block : blocks) total += block.size;
+			release();
+			addBlock(total);
+		}
+		current = 0;
+		offset = 0;
+	}
+
+	// back to the heap
+	void release()
+	{
+		flushStats();
+		AlignedHeapAllocator heap;
+		for (const Block& block : blocks)
+		{
+			heap.deallocate(block.memory, block.size);
+			if (stats != nullptr) stats->reservedBytes -= block.size;
+		}
+		blocks.clear();
+		current = 0;
+		offset = 0;
+	}
+
+	size_t reserved() const
+	{
+		size_t total = 0;
+		for (const Block& block : blocks) total += block.size;
+		return total;
+	}
+
+private:
+	struct Block
+	{
+		char* memory;
+		size_t size;
+	};
+
+	std::vector<Block> blocks;
+	size_t current = 0;		// block allocation is bumping through
+	size_t offset = 0;		// into blocks[current]
+	size_t defaultBlockSize = 0;
+	MemoryStats* stats = nullptr;
+	// since the last flush
+	uint64_t allocations = 0;
+	uint64_t used = 0;
+
+	void addBlock(size_t size)
+	{
+		Block block;
+		block.memory = static_cast<char*>(AlignedHeapAllocator().allocate(size, BLOCK_ALIGNMENT));
+		block.size = size;
+		blocks.push_back(block);
+		stats->heapAllocations += 1;
+		stats->reservedBytes += size;
+	}
+
+	void flushStats()
+	{
+		if (stats != nullptr && allocations > 0)
+		{
+			stats->allocations += allocations;
+			stats->bytes += used;
+			stats->addPeak(used);
+		}
+		allocations = 0;
+		used = 0;
+	}
+
+	void swap(LinearArena& other)
+	{
+		std::swap(blocks, other.blocks);
+		std::swap(current, other.current);
+		std::swap(offset, other.offset);
+		std::swap(defaultBlockSize, other.defaultBlockSize);
+		std::swap(stats, other.stats);
+		std::swap(allocations, other.allocations);
+		std::swap(used, other.used);
+	}
+};
+
+
+// STL allocator out of a LinearArena, deallocate does nothing. The container has to be gone
+// (or never touched again) before the arena is reset.
+template <class T>
+struct ArenaAllocator
+{
+	typedef T value_type;
+
+	LinearArena* arena;
+
+	explicit ArenaAllocator(LinearArena& linearArena) : arena(&linearArena) { }
+	template <class U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) { }
+
+	T* allocate(size_t count) { return arena->allocateArray<T>(count); }
+	void deallocate(T*, size_t) { }
+
+	template <class U> bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+	template <class U> bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+};
+
+template <class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+
+// Everything allocated from arena while this is alive is freed with it. Asset import wraps a load
+// in one, its temporaries (dedup maps, staging vectors) go away in one go.
+struct ScopedArena
+{
+	explicit ScopedArena(LinearArena& linearArena)
+		: arena(linearArena)
+		, marker(linearArena.mark())
+	{ }
+	~ScopedArena()
+	{
+		arena.rewind(marker);
+	}
+	ScopedArena(const ScopedArena&) = delete;
+	ScopedArena& operator=(const ScopedArena&) = delete;
+
+	template <class T>
+	ArenaAllocator<T> allocator() { return ArenaAllocator<T>(arena); }
+
+	LinearArena& arena;
+	const LinearArena::Marker marker;
+};
+
+
+// One arena per job system thread per frame in flight. current() is the calling thread's arena of
+// this frame, so jobs allocate without locks. endFrame() moves on to the next frame's arenas and
+// resets them, what was allocated in a frame stays valid for framesInFlight - 1 more frames.
+// Only the thread that calls parallelFor (thread index 0) may use it outside of jobs.
+struct FrameArenas
+{
+	void init(uint32_t jobThreadCount, uint32_t framesInFlight, size_t blockSize)
+	{
+		threadCount = jobThreadCount;
+		frameCount = framesInFlight;
+		frame = 0;
+		MemoryStats& stats = memoryStats("Frame");
+		arenas.clear();
+		arenas.reserve(threadCount * frameCount);
+		for (uint32_t i = 0; i < threadCount * frameCount; ++i)
+		{
+			arenas.emplace_back(blockSize, stats);
+		}
+	}
+
+	void cleanup()
+	{
+		arenas.clear();
+	}
+
+	LinearArena& current()
+	{
+		const uint32_t thread = JobSystem::threadIndex();
+		PV_ASSERT(thread < threadCount, "FrameArenas: more threads than init was told about");
+		return arenas[frame * threadCount + thread];
+	}
+
+	template <class T>
+	ArenaAllocator<T> allocator() { return ArenaAllocator<T>(current()); }
+
+	void endFrame()
+	{
+		frame = (frame + 1) % frameCount;
+		for (uint32_t thread = 0; thread < threadCount; ++thread)
+		{
+			arenas[frame * threadCount + thread].reset();
+		}
+	}
+
+private:
+	std::vector<LinearArena> arenas;
+	uint32_t threadCount = 0;
+	uint32_t frameCount = 0;
+	uint32_t frame = 0;
+};
+
+
+// Fixed size slots for one type, carved out of chunks of SLOTS_PER_CHUNK. Freed slots go on a free
+// list and are handed out again first, chunks are only returned when the pool goes away (live
+// objects are not destroyed then). Counts reach the subsystem's stats on flushStats() and when
+// the pool goes away. Not thread safe.
+template <class T, uint32_t SLOTS_PER_CHUNK = 256>
+struct ObjectPool
+{
+	explicit ObjectPool(MemoryStats& memoryStats) : stats(&memoryStats) { }
+	ObjectPool(const ObjectPool&) = delete;
+	ObjectPool& operator=(const ObjectPool&) = delete;
+	~ObjectPool()
+	{
+		flushStats();
+		AlignedHeapAllocator heap;
+		for (Slot* chunk : chunks)
+		{
+			heap.deallocate(chunk, CHUNK_BYTES);
+			stats->reservedBytes -= CHUNK_BYTES;
+		}
+	}
+
+	template <class... Args>
+	T* create(Args&&... args)
+	{
+		if (freeList == nullptr)
+			addChunk();
+		Slot* slot = freeList;
+		freeList = slot->next;
+		T* object = new (&slot->value) T(std::forward<Args>(args)...);
+		++live;
+		++allocations;
+		return object;
+	}
+
+	void destroy(T* object)
+	{
+		if (object == nullptr) return;
+		object->~T();
+		Slot* slot = reinterpret_cast<Slot*>(object);
+		slot->next = freeList;
+		freeList = slot;
+		--live;
+		++frees;
+	}
+
+	void flushStats()
+	{
+		stats->allocations += allocations;
+		stats->bytes += allocations * sizeof(T);
+		stats->frees += frees;
+		stats->addPeak(capacity() * sizeof(Slot));
+		allocations = 0;
+		frees = 0;
+	}
+
+	uint32_t liveCount() const { return live; }
+	uint32_t capacity() const { return static_cast<uint32_t>(chunks.size()) * SLOTS_PER_CHUNK; }
+
+private:
+	union Slot
+	{
+		Slot* next;
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type value;
+	};
+	static const size_t CHUNK_BYTES = sizeof(Slot) * SLOTS_PER_CHUNK;
+
+	std::vector<Slot*> chunks;
+	Slot* freeList = nullptr;
+	uint32_t live = 0;
+	MemoryStats* stats;
+	// since the last flush
+	uint64_t allocations = 0;
+	uint64_t frees = 0;
+
+	void addChunk()
+	{
+		Slot* chunk = static_cast<Slot*>(AlignedHeapAllocator().allocate(CHUNK_BYTES, std::max<size_t>(alignof(Slot), sizeof(void*))));
+		chunks.push_back(chunk);
+		// threaded back to front, so slots come out in address order
+		for (uint32_t i = SLOTS_PER_CHUNK; i-- > 0;)
+		{
+			chunk[i].next = freeList;
+			freeList = &chunk[i];
+		}
+		stats->heapAllocations += 1;
+		stats->reservedBytes += CHUNK_BYTES;
+	}
+};
+
+
+// Heap against the arenas and pools for the three kinds of temporaries they are for: per frame
+// lists built by jobs, an import dedup map, and objects created and destroyed all the time.
+inline void benchmarkMemory(JobSystem& jobs, std::ostream& out)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	auto elapsedMs = [](Clock::time_point start) { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+
+	out << "Memory benchmark:" << std::endl;
+
+	// 200 frames, each builds 4096 lists of 16..271 elements across the job system that are read
+	// at the end of the frame (draw lists, visible sets)
+	{
+		const uint32_t FRAMES = 200, LISTS = 4096;
+		FrameArenas frameArenas;
+		frameArenas.init(jobs.threadCount(), 2, 1 << 20);
+		auto listLength = [](uint32_t list, uint32_t frame) { return 16 + ((list * 2654435761u + frame) & 255); };
+		uint64_t heapSum = 0, arenaSum = 0;
+
+		std::vector<std::vector<uint32_t>> heapLists(LISTS);
+		auto start = Clock::now();
+		for (uint32_t frame = 0; frame < FRAMES; ++frame)
+		{
+			jobs.parallelFor(LISTS, 64, [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t list = begin; list < end; ++list)
+				{
+					std::vector<uint32_t> values;
+					for (uint32_t i = 0; i < listLength(list, frame); ++i) values.push_back(i);
+					heapLists[list] = std::move(values);
+				}
+			});
+			for (const std::vector<uint32_t>& list : heapLists) heapSum += list.back();
+		}
+		const double heapMs = elapsedMs(start);
+
+		std::vector<std::pair<const uint32_t*, size_t>> arenaLists(LISTS);
+		start = Clock::now();
+		for (uint32_t frame = 0; frame < FRAMES; ++frame)
+		{
+			jobs.parallelFor(LISTS, 64, [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t list = begin; list < end; ++list)
+				{
+					// the elements stay where they are until the arena is reset
+					ArenaVector<uint32_t> values(frameArenas.allocator<uint32_t>());
+					for (uint32_t i = 0; i < listLength(list, frame); ++i) values.push_back(i);
+					arenaLists[list] = std::make_pair(values.data(), values.size());
+				}
+			});
+			for (const std::pair<const uint32_t*, size_t>& list : arenaLists) arenaSum += list.first[list.second - 1];
+			frameArenas.endFrame();
+		}
+		const double arenaMs = elapsedMs(start);
+		PV_ASSERT(heapSum == arenaSum, "benchmarkMemory: frame lists disagree");
+		out << "\tframe lists:  heap " << heapMs / FRAMES << " ms/frame, frame arenas " << arenaMs / FRAMES << " ms/frame (" << jobs.threadCount() << " threads)" << std::endl;
+	}
+
+	// dedup of 1M keys with 25% unique, like loadModel's uniqueVertices
+	{
+		const uint32_t KEYS = 1000000;
+		std::vector<uint64_t> keys(KEYS);
+		std::mt19937_64 rng(1234);
+		for (uint64_t& key : keys) key = rng() % (KEYS / 4);
+
+		auto start = Clock::now();
+		std::unordered_map<uint64_t, uint32_t> heapMap;
+		for (uint64_t key : keys) heapMap.emplace(key, static_cast<uint32_t>(heapMap.size()));
+		const double heapMs = elapsedMs(start);
+
+		LinearArena importArena(1 << 20, memoryStats("Import"));
+		size_t arenaSize = 0;
+		start = Clock::now();
+		{
+			ScopedArena scope(importArena);
+			typedef std::pair<const uint64_t, uint32_t> Entry;
+			std::unordered_map<uint64_t, uint32_t, std::hash<uint64_t>, std::equal_to<uint64_t>, ArenaAllocator<Entry>> arenaMap(
+				0, std::hash<uint64_t>(), std::equal_to<uint64_t>(), scope.allocator<Entry>());
+			for (uint64_t key : keys) arenaMap.emplace(key, static_cast<uint32_t>(arenaMap.size()));
+			arenaSize = arenaMap.size();
+		}
+		const double arenaMs = elapsedMs(start);
+		PV_ASSERT(heapMap.size() == arenaSize, "benchmarkMemory: dedup maps disagree");
+		out << "\tdedup map:    heap " << heapMs << " ms, scoped arena " << arenaMs << " ms for " << KEYS << " keys" << std::endl;
+	}
+
+	// 64 live objects replaced in random order, 1M times
+	{
+		struct Object { glm::mat4 transform; uint32_t id; };
+		const uint32_t LIVE = 64, CHURN = 1000000;
+		std::vector<uint32_t> order(CHURN);
+		std::mt19937 rng(99);
+		for (uint32_t& o : order) o = rng() % LIVE;
+
+		std::vector<Object*> objects(LIVE);
+		auto start = Clock::now();
+		for (uint32_t i = 0; i < LIVE; ++i) objects[i] = new Object{ glm::mat4(1.0f), i };
+		for (uint32_t i = 0; i < CHURN; ++i)
+		{
+			delete objects[order[i]];
+			objects[order[i]] = new Object{ glm::mat4(1.0f), i };
+		}
+		for (Object* object : objects) delete object;
+		const double heapMs = elapsedMs(start);
+
+		ObjectPool<Object> pool(memoryStats("Pools"));
+		start = Clock::now();
+		for (uint32_t i = 0; i < LIVE; ++i) objects[i] = pool.create(Object{ glm::mat4(1.0f), i });
+		for (uint32_t i = 0; i < CHURN; ++i)
+		{
+			pool.destroy(objects[order[i]]);
+			objects[order[i]] = pool.create(Object{ glm::mat4(1.0f), i });
+		}
+		for (Object* object : objects) pool.destroy(object);
+		const double poolMs = elapsedMs(start);
+		PV_ASSERT(pool.liveCount() == 0 && pool.capacity() == 256, "benchmarkMemory: pool should reuse its first chunk");
+		out << "\tobject churn: new/delete " << heapMs * 1e6 / CHURN << " ns, pool " << poolMs * 1e6 / CHURN << " ns per replacement" << std::endl;
+	}
+
+	printMemoryStats(out);
+}
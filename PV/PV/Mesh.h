@@ -18,8 +18,9 @@ struct Mesh
 		glm::vec2> // texCoord
 		preVertData;
 
-	Mesh(uint32_t num_vertices, uint32_t num_indices)
-		: preVertData({ num_vertices, num_indices, num_vertices })
+	// every stream has one element per vertex
+	explicit Mesh(uint32_t num_vertices)
+		: preVertData({ num_vertices, num_vertices, num_vertices, num_vertices, num_vertices })
 	{ }
 
 	ArrayView<glm::vec3> positions() {
@@ -1,14 +1,32 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdlib.h>
+#include <array>
+#include <tuple>
+#include <new>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
 
 template <class T>
 struct ArrayView {
 
+	ArrayView() = default;
 	ArrayView(char * begin, char * end)
 		: m_begin(reinterpret_cast<T *>(begin))
 		, m_end(reinterpret_cast<T *>(end))
 	{ }
+	ArrayView(T * begin, int64_t count)
+		: m_begin(begin)
+		, m_end(begin + count)
+	{ }
 
 	T & operator[](int64_t index) {
 #ifdef DEBUG
@@ -17,75 +35,312 @@ struct ArrayView {
 #endif
 		return m_begin[index];
 	}
+	const T & operator[](int64_t index) const {
+#ifdef DEBUG
+		assert(m_begin != nullptr && index >= 0 &&
+			index < (m_end - m_begin));
+#endif
+		return m_begin[index];
+	}
+
+	T * data() { return m_begin; }
+	const T * data() const { return m_begin; }
+
+	T * begin() { return m_begin; }
+	T * end() { return m_end; }
+	const T * begin() const { return m_begin; }
+	const T * end() const { return m_end; }
 
 	int64_t size() const { return m_end - m_begin; }
 	int64_t memory_size() const {
 		return sizeof(T) * size();
 	}
-	// ... More methods, const operator[], begin, end, etc
+
+	// elements [begin, end) of this view
+	ArrayView slice(int64_t begin, int64_t end) const {
+#ifdef DEBUG
+		assert(begin >= 0 && begin <= end && end <= size());
+#endif
+		return ArrayView(m_begin + begin, end - begin);
+	}
 private:
 	T * m_begin = nullptr;
 	T * m_end = nullptr;
 };
 
 
+// MultiArray allocators hand out one aligned block for all the arrays at once:
+//	void* allocate(size_t bytes, size_t alignment);
+//	void deallocate(void* memory, size_t bytes);
+// They are copied along with the MultiArray, so stateful ones point at their state.
 
-#include <typeindex>
-#include <typeinfo>
+// The heap, aligned
+struct AlignedHeapAllocator
+{
+	void* allocate(size_t bytes, size_t alignment)
+	{
+#ifdef _MSC_VER
+		void* memory = _aligned_malloc(bytes, alignment);
+#else
+		void* memory = nullptr;
+		if (posix_memalign(&memory, alignment, bytes) != 0) memory = nullptr;
+#endif
+		if (memory == nullptr) throw std::bad_alloc();
+		return memory;
+	}
+	void deallocate(void* memory, size_t)
+	{
+#ifdef _MSC_VER
+		_aligned_free(memory);
+#else
+		free(memory);
+#endif
+	}
+};
 
-template <class ... Args>
-struct MultiArray 
+// Bump allocation inside memory somebody else owns: a persistently mapped upload region, an
+// arena, a pool slot. Nothing is freed on its own, a relocation leaves the old copy behind
+// until the owner resets the block (used = 0).
+struct MemoryBlock
+{
+	char* memory = nullptr;
+	size_t capacity = 0;
+	size_t used = 0;
+};
+struct MemoryBlockAllocator
+{
+	MemoryBlock* block = nullptr;
+
+	MemoryBlockAllocator() = default;
+	explicit MemoryBlockAllocator(MemoryBlock& memoryBlock) : block(&memoryBlock) { }
+
+	void* allocate(size_t bytes, size_t alignment)
+	{
+		if (block == nullptr) throw std::bad_alloc();
+		const uintptr_t base = reinterpret_cast<uintptr_t>(block->memory);
+		const uintptr_t start = (base + block->used + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+		if (start + bytes > base + block->capacity) throw std::bad_alloc();
+		block->used = start + bytes - base;
+		return reinterpret_cast<void*>(start);
+	}
+	void deallocate(void*, size_t) { }
+};
+
+
+// Several arrays (streams) of possibly different types and lengths in one allocation, SoA style.
+// Every stream starts on a STREAM_ALIGNMENT boundary (a cache line, enough for any AVX / AVX-512
+// load) and is padded up to the next one, so all of them can be walked with aligned vector loads
+// and the whole block goes to the GPU with one memcpy. Sizes and offsets are 64 bit.
+//
+// resize / reserve grow every stream's capacity by at least half at once and move all of them
+// into one new allocation, appending one element at a time is amortized O(1). Elements are moved
+// with memcpy, so the types have to be trivially copyable.
+template <class Allocator, class ... Args>
+struct BasicMultiArray
 {
 	static constexpr int s_num_arrays = sizeof...(Args);
-	std::array<uint32_t, s_num_arrays> m_offsets;
-	std::unique_ptr<char[]> m_memory;
+	static constexpr size_t STREAM_ALIGNMENT = 64;
+	typedef uint64_t size_type;
 
 	static constexpr std::array<uint32_t, s_num_arrays> type_sizes = { sizeof(Args)... };
 
+	template <uint32_t ItemIndex>
+	using ItemType = typename std::tuple_element<ItemIndex, std::tuple<Args...>>::type;
+
 	static const std::array<const std::type_info*, s_num_arrays>& getTypeIds()
 	{
 		static std::array<const std::type_info*, s_num_arrays> type_info_array = { &typeid(Args)... };
 		return type_info_array;
 	}
 
-	MultiArray(const std::array<uint32_t, s_num_arrays> & sizes)
+	explicit BasicMultiArray(const Allocator& allocator = Allocator())
+		: m_allocator(allocator)
 	{
-		uint32_t partial_sum = 0;
-		for (std::size_t i = 0; i != s_num_arrays; ++i) {
-			partial_sum += sizes[i] * type_sizes[i];
-			m_offsets[i] = partial_sum;
-		}
-
-		m_memory.reset(new char[totalMemory()]);
+		m_sizes.fill(0);
+		m_capacities.fill(0);
+		m_offsets.fill(0);
+	}
+	BasicMultiArray(const std::array<size_type, s_num_arrays> & sizes, const Allocator& allocator = Allocator())
+		: BasicMultiArray(allocator)
+	{
+		relocate(sizes);
+		m_sizes = sizes;
 	}
-	MultiArray(const MultiArray & other)
-		: m_offsets(other.m_offsets)
-		, m_memory(new char[other.totalMemory()])
+	BasicMultiArray(const BasicMultiArray & other)
+		: BasicMultiArray(other.m_allocator)
 	{
-		std::memcpy(m_memory.get(), other.m_memory.get(), totalMemory());
+		*this = other;
 	}
-	MultiArray& operator=(const MultiArray & other) {
+	BasicMultiArray(BasicMultiArray && other)
+		: BasicMultiArray(other.m_allocator)
+	{
+		swap(other);
+	}
+	~BasicMultiArray()
+	{
+		release();
+	}
+
+	// same capacities and contents
+	BasicMultiArray& operator=(const BasicMultiArray & other) {
 		if (this == &other) {
 			return *this;
 		}
 		if (totalMemory() != other.totalMemory()) {
-			m_memory.reset(new char[other.totalMemory()]);
+			release();
+			if (other.totalMemory() > 0)
+				m_memory = static_cast<char*>(m_allocator.allocate(static_cast<size_t>(other.totalMemory()), STREAM_ALIGNMENT));
 		}
+		m_sizes = other.m_sizes;
+		m_capacities = other.m_capacities;
 		m_offsets = other.m_offsets;
-		std::memcpy(m_memory.get(), other.m_memory.get(), totalMemory());
+		if (totalMemory() > 0)
+			std::memcpy(m_memory, other.m_memory, static_cast<size_t>(totalMemory()));
 		return *this;
 	}
+	BasicMultiArray& operator=(BasicMultiArray && other) {
+		swap(other);
+		return *this;
+	}
+
+	void swap(BasicMultiArray& other)
+	{
+		std::swap(m_allocator, other.m_allocator);
+		std::swap(m_memory, other.m_memory);
+		std::swap(m_sizes, other.m_sizes);
+		std::swap(m_capacities, other.m_capacities);
+		std::swap(m_offsets, other.m_offsets);
+	}
+
+	size_type size(uint32_t arrayIndex) const { return m_sizes[arrayIndex]; }
+	size_type capacity(uint32_t arrayIndex) const { return m_capacities[arrayIndex]; }
+
+	// every stream's elements past their old size are uninitialized
+	void resize(const std::array<size_type, s_num_arrays> & sizes)
+	{
+		reserve(sizes);
+		m_sizes = sizes;
+	}
+	void resize(size_type size)
+	{
+		resize(uniform(size));
+	}
+
+	// Grows (never shrinks) the streams whose capacity is short, by at least half of it
+	void reserve(const std::array<size_type, s_num_arrays> & capacities)
+	{
+		bool grow = false;
+		std::array<size_type, s_num_arrays> newCapacities = m_capacities;
+		for (std::size_t i = 0; i != s_num_arrays; ++i) {
+			if (capacities[i] > m_capacities[i]) {
+				newCapacities[i] = std::max(capacities[i], m_capacities[i] + m_capacities[i] / 2);
+				grow = true;
+			}
+		}
+		if (grow) {
+			relocate(newCapacities);
+		}
+	}
+	void reserve(size_type capacity)
+	{
+		reserve(uniform(capacity));
+	}
+
+	// capacity down to size, one allocation
+	void shrinkToFit()
+	{
+		if (m_sizes != m_capacities)
+			relocate(m_sizes);
+	}
+
+	// bytes from the start of the first stream to the end of the last one's (padded) capacity
+	size_type totalMemory() const {
+		return s_num_arrays == 0 ? 0 : alignUp(m_offsets.back() + m_capacities.back() * type_sizes.back());
+	}
+
+	// byte offset of array ArrayIndex from the start of the allocation, a multiple of STREAM_ALIGNMENT
+	size_type arrayOffset(uint32_t arrayIndex) const {
+		return m_offsets[arrayIndex];
+	}
+
+	// all arrays back to back, totalMemory() bytes
+	const char* data() const {
+		return m_memory;
+	}
+	char* data() {
+		return m_memory;
+	}
+
+	template <uint32_t ItemIndex, typename T>
+	ArrayView<T> getView()
+	{
+		static_assert(std::is_same<T, ItemType<ItemIndex>>::value, "MultiArray::getView: wrong type for this array");
+		return view<ItemIndex>();
+	}
+	template <uint32_t ItemIndex>
+	ArrayView<ItemType<ItemIndex>> view()
+	{
+		char* begin = m_memory + m_offsets[ItemIndex];
+		return ArrayView<ItemType<ItemIndex>>(begin, begin + m_sizes[ItemIndex] * sizeof(ItemType<ItemIndex>));
+	}
+
+private:
+	Allocator m_allocator;
+	char* m_memory = nullptr;
+	std::array<size_type, s_num_arrays> m_sizes;
+	std::array<size_type, s_num_arrays> m_capacities;
+	std::array<size_type, s_num_arrays> m_offsets;
+
+	static size_type alignUp(size_type bytes)
+	{
+		return (bytes + STREAM_ALIGNMENT - 1) & ~static_cast<size_type>(STREAM_ALIGNMENT - 1);
+	}
+	static std::array<size_type, s_num_arrays> uniform(size_type count)
+	{
+		std::array<size_type, s_num_arrays> counts;
+		counts.fill(count);
+		return counts;
+	}
+
+	template <class... T> struct AllTriviallyCopyable : std::true_type { };
+	template <class T, class... Rest> struct AllTriviallyCopyable<T, Rest...>
+		: std::integral_constant<bool, std::is_trivially_copyable<T>::value && AllTriviallyCopyable<Rest...>::value> { };
+	static_assert(AllTriviallyCopyable<Args...>::value, "MultiArray: elements are moved with memcpy");
+	static_assert(std::max<size_t>({ alignof(Args)... }) <= STREAM_ALIGNMENT, "MultiArray: element alignment above STREAM_ALIGNMENT");
 
+	// lays the streams out for the new capacities, moves what fits of every stream over in one go
+	void relocate(const std::array<size_type, s_num_arrays> & capacities)
+	{
+		std::array<size_type, s_num_arrays> offsets;
+		size_type offset = 0;
+		for (std::size_t i = 0; i != s_num_arrays; ++i) {
+			offsets[i] = offset;
+			offset = alignUp(offset + capacities[i] * type_sizes[i]);
+		}
 
-	int32_t totalMemory() const {
-		return m_offsets.back();
+		char* memory = offset > 0 ? static_cast<char*>(m_allocator.allocate(static_cast<size_t>(offset), STREAM_ALIGNMENT)) : nullptr;
+		for (std::size_t i = 0; i != s_num_arrays; ++i) {
+			m_sizes[i] = std::min(m_sizes[i], capacities[i]);
+			if (m_sizes[i] > 0)
+				std::memcpy(memory + offsets[i], m_memory + m_offsets[i], static_cast<size_t>(m_sizes[i] * type_sizes[i]));
+		}
+		release();
+		m_memory = memory;
+		m_capacities = capacities;
+		m_offsets = offsets;
 	}
 
-	template <uint32_t ItemIndex, typename ItemType>
-	ArrayView<ItemType> getView()
+	void release()
 	{
-		return ArrayView<ItemType>(m_memory.get() + (ItemIndex == 0 ? 0 : m_offsets[ItemIndex - 1]),
-			m_memory.get() + m_offsets[ItemIndex]);
+		if (m_memory != nullptr)
+			m_allocator.deallocate(m_memory, static_cast<size_t>(totalMemory()));
+		m_memory = nullptr;
 	}
 };
 
+template <class Allocator, class ... Args>
+constexpr std::array<uint32_t, BasicMultiArray<Allocator, Args...>::s_num_arrays> BasicMultiArray<Allocator, Args...>::type_sizes;
+
+// The arrays on the (aligned) heap
+template <class ... Args>
+using MultiArray = BasicMultiArray<AlignedHeapAllocator, Args...>;
@@ -0,0 +1,692 @@
+#pragma once
+
+/*
+	Include dependencies: glm (+ gtc/matrix_transform), MultiArray.h, JobSystem.h, CpuProfiler.h, Culling.h
+*/
+#include <vector>
+#include <random>
+#include <chrono>
+#include <ostream>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <algorithm>
+#include <stdint.h>
+
+// 8 rows of a tile per instruction with AVX2 (/arch:AVX2, set for Release|x64), one row at a time otherwise
+#if defined(__AVX2__)
+#define PV_OCCLUSION_AVX2 1
+#include <immintrin.h>
+#else
+#define PV_OCCLUSION_AVX2 0
+#endif
+
+
+// A clipped occluder triangle in pixels, set up for OcclusionBuffer's tiles.
+// Wound so that (x1 - x0) * (y2 - y0) - (y1 - y0) * (x2 - x0) is positive, edge i goes from vertex i to i + 1.
+struct OccluderTriangle
+{
+	enum EdgeKind : uint8_t
+	{
+		EDGE_LEFT,		// pixels right of the edge are inside
+		EDGE_RIGHT,		// pixels left of it are
+		EDGE_FLAT,		// horizontal, the triangle's y range takes care of it
+	};
+
+	float x[3], y[3];
+	float slope[3];				// dx/dy of edge i
+	EdgeKind edges[3];
+	float zBase, zdx, zdy;		// depth plane: zBase + zdx * x + zdy * y
+	float zMax;					// farthest vertex
+	float minX, maxX, minY, maxY;
+	int32_t tileMinX, tileMaxX, tileMinY, tileMaxY;	// inclusive, on screen
+};
+
+namespace occlusion_detail
+{
+	static const float BIG = 1e30f;
+
+	// one bit per pixel of a 32x8 tile, row r in word r, column c in bit 31 - c
+#if PV_OCCLUSION_AVX2
+	typedef __m256i TileMask;
+	inline TileMask loadMask(const uint32_t* rows) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows)); }
+	inline void storeMask(uint32_t* rows, TileMask mask) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(rows), mask); }
+	inline TileMask maskOr(TileMask a, TileMask b) { return _mm256_or_si256(a, b); }
+	inline TileMask maskAnd(TileMask a, TileMask b) { return _mm256_and_si256(a, b); }
+	inline TileMask maskAndNot(TileMask a, TileMask b) { return _mm256_andnot_si256(b, a); } // a & ~b
+	inline TileMask maskZero() { return _mm256_setzero_si256(); }
+	inline bool maskEmpty(TileMask mask) { return _mm256_testz_si256(mask, mask) != 0; }
+	inline bool maskFull(TileMask mask) { return _mm256_testc_si256(mask, _mm256_set1_epi32(-1)) != 0; }
+#else
+	struct TileMask
+	{
+		uint32_t rows[8];
+	};
+	inline TileMask loadMask(const uint32_t* rows) { TileMask mask; std::memcpy(mask.rows, rows, sizeof(mask.rows)); return mask; }
+	inline void storeMask(uint32_t* rows, const TileMask& mask) { std::memcpy(rows, mask.rows, sizeof(mask.rows)); }
+	inline TileMask maskOr(const TileMask& a, const TileMask& b) { TileMask m; for (int r = 0; r < 8; ++r) m.rows[r] = a.rows[r] | b.rows[r]; return m; }
+	inline TileMask maskAnd(const TileMask& a, const TileMask& b) { TileMask m; for (int r = 0; r < 8; ++r) m.rows[r] = a.rows[r] & b.rows[r]; return m; }
+	inline TileMask maskAndNot(const TileMask& a, const TileMask& b) { TileMask m; for (int r = 0; r < 8; ++r) m.rows[r] = a.rows[r] & ~b.rows[r]; return m; }
+	inline TileMask maskZero() { TileMask m = {}; return m; }
+	inline bool maskEmpty(const TileMask& mask) { uint32_t any = 0; for (int r = 0; r < 8; ++r) any |= mask.rows[r]; return any == 0; }
+	inline bool maskFull(const TileMask& mask) { uint32_t all = ~0u; for (int r = 0; r < 8; ++r) all &= mask.rows[r]; return all == ~0u; }
+#endif
+
+	// columns [first, end) of a 32 wide row, both clamped to [0, 32]
+	inline uint32_t columnBits(int32_t first, int32_t end)
+	{
+		uint32_t fromFirst = first >= 32 ? 0u : ~0u >> std::max(first, 0);
+		uint32_t fromEnd = end >= 32 ? 0u : ~0u >> std::max(end, 0);
+		return fromFirst & ~fromEnd;
+	}
+
+	// First covered pixel column and one past the last one of the 8 rows of tile row tileY. Rows
+	// outside the triangle get an empty span. Pixel centers on an edge count as covered.
+#if PV_OCCLUSION_AVX2
+	struct RowSpans
+	{
+		__m256 first, end;
+	};
+	inline RowSpans rowSpans(const OccluderTriangle& tri, int32_t tileY)
+	{
+		const __m256 y = _mm256_add_ps(_mm256_set1_ps(tileY * 8.0f + 0.5f), _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f));
+		__m256 left = _mm256_set1_ps(-BIG), right = _mm256_set1_ps(BIG);
+		for (int e = 0; e < 3; ++e)
+		{
+			if (tri.edges[e] == OccluderTriangle::EDGE_FLAT) continue;
+			__m256 x = _mm256_add_ps(_mm256_set1_ps(tri.x[e]), _mm256_mul_ps(_mm256_sub_ps(y, _mm256_set1_ps(tri.y[e])), _mm256_set1_ps(tri.slope[e])));
+			if (tri.edges[e] == OccluderTriangle::EDGE_LEFT)
+				left = _mm256_max_ps(left, x);
+			else
+				right = _mm256_min_ps(right, x);
+		}
+		const __m256 half = _mm256_set1_ps(0.5f);
+		const __m256 inside = _mm256_and_ps(_mm256_cmp_ps(y, _mm256_set1_ps(tri.minY), _CMP_GE_OQ), _mm256_cmp_ps(y, _mm256_set1_ps(tri.maxY), _CMP_LE_OQ));
+		RowSpans spans;
+		spans.first = _mm256_blendv_ps(_mm256_set1_ps(BIG), _mm256_ceil_ps(_mm256_sub_ps(left, half)), inside);
+		spans.end = _mm256_add_ps(_mm256_floor_ps(_mm256_sub_ps(right, half)), _mm256_set1_ps(1.0f));
+		return spans;
+	}
+	inline TileMask coverage(const RowSpans& spans, int32_t tileX)
+	{
+		const __m256 tileLeft = _mm256_set1_ps(tileX * 32.0f);
+		const __m256 zero = _mm256_setzero_ps(), width = _mm256_set1_ps(32.0f);
+		__m256i first = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(spans.first, tileLeft), zero), width));
+		__m256i end = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(spans.end, tileLeft), zero), width));
+		// shifts by 32 come out as 0
+		const __m256i ones = _mm256_set1_epi32(-1);
+		return _mm256_andnot_si256(_mm256_srlv_epi32(ones, end), _mm256_srlv_epi32(ones, first));
+	}
+#else
+	struct RowSpans
+	{
+		float first[8], end[8];
+	};
+	inline RowSpans rowSpans(const OccluderTriangle& tri, int32_t tileY)
+	{
+		RowSpans spans;
+		for (int r = 0; r < 8; ++r)
+		{
+			float y = tileY * 8.0f + r + 0.5f;
+			float left = -BIG, right = BIG;
+			for (int e = 0; e < 3; ++e)
+			{
+				if (tri.edges[e] == OccluderTriangle::EDGE_FLAT) continue;
+				float x = tri.x[e] + (y - tri.y[e]) * tri.slope[e];
+				if (tri.edges[e] == OccluderTriangle::EDGE_LEFT)
+					left = std::max(left, x);
+				else
+					right = std::min(right, x);
+			}
+			bool inside = y >= tri.minY && y <= tri.maxY;
+			spans.first[r] = inside ? std::ceil(left - 0.5f) : BIG;
+			spans.end[r] = std::floor(right - 0.5f) + 1.0f;
+		}
+		return spans;
+	}
+	inline TileMask coverage(const RowSpans& spans, int32_t tileX)
+	{
+		TileMask mask;
+		const float tileLeft = tileX * 32.0f;
+		for (int r = 0; r < 8; ++r)
+		{
+			int32_t first = static_cast<int32_t>(std::min(std::max(spans.first[r] - tileLeft, 0.0f), 32.0f));
+			int32_t end = static_cast<int32_t>(std::min(std::max(spans.end[r] - tileLeft, 0.0f), 32.0f));
+			mask.rows[r] = columnBits(first, end);
+		}
+		return mask;
+	}
+#endif
+}
+
+
+// Masked software occlusion culling (Hasselgren et al.). The screen is split into 32x8 pixel
+// tiles, each stores two depth layers and one coverage bit per pixel: pixels with their bit set
+// are at most zFar1 deep, the rest at most zFar0. Every update keeps both bounds true, so
+// anything behind them at every pixel it touches is guaranteed hidden. The tile depths are
+// the coarse level of the hierarchy, tests go down to the pixel masks only where they have to.
+//
+// Per frame: clear, setViewProjection, add occluders (low poly, they must lie inside what they
+// stand in for), rasterize, then test bounds. Depth is Vulkan's 0..1, smaller is closer.
+struct OcclusionBuffer
+{
+	static const uint32_t TILE_WIDTH = 32;
+	static const uint32_t TILE_HEIGHT = 8;
+
+	struct Stats
+	{
+		uint32_t submittedTriangles = 0;
+		uint32_t rasterizedTriangles = 0;	// after clipping, backface and off screen rejection
+	};
+
+	uint32_t width = 0, height = 0;
+	uint32_t tilesX = 0, tilesY = 0;
+	std::vector<OccluderTriangle> triangles;	// queued for the next rasterize()
+	Stats stats;
+
+	// width is rounded up to whole tiles, height to whole tile rows
+	void init(uint32_t screenWidth, uint32_t screenHeight)
+	{
+		tilesX = (screenWidth + TILE_WIDTH - 1) / TILE_WIDTH;
+		tilesY = (screenHeight + TILE_HEIGHT - 1) / TILE_HEIGHT;
+		width = tilesX * TILE_WIDTH;
+		height = tilesY * TILE_HEIGHT;
+		masks.resize(tilesX * tilesY * TILE_HEIGHT);
+		zFar0.resize(tilesX * tilesY);
+		zFar1.resize(tilesX * tilesY);
+		clear();
+	}
+
+	// nothing drawn, no occluders queued
+	void clear()
+	{
+		std::fill(masks.begin(), masks.end(), 0u);
+		std::fill(zFar0.begin(), zFar0.end(), std::numeric_limits<float>::max());
+		std::fill(zFar1.begin(), zFar1.end(), std::numeric_limits<float>::max());
+		triangles.clear();
+		stats = Stats();
+	}
+
+	void setViewProjection(const glm::mat4& matrix) { viewProjection = matrix; }
+
+	// Transforms, clips and sets up an occluder mesh's triangles, rasterize() draws them.
+	// positions: the first vertex's position, positionStride bytes between vertices. With
+	// cullBackfaces the mesh has to be closed and counter clockwise like the render pipeline's.
+	void addOccluder(const void* positions, uint32_t positionStride, const uint32_t* indices, uint32_t triangleCount, const glm::mat4& world, bool cullBackfaces = true)
+	{
+		const glm::mat4 toClip = viewProjection * world;
+		const char* base = static_cast<const char*>(positions);
+		for (uint32_t t = 0; t < triangleCount; ++t)
+		{
+			glm::vec4 clip[3];
+			for (int v = 0; v < 3; ++v)
+			{
+				const glm::vec3& position = *reinterpret_cast<const glm::vec3*>(base + static_cast<size_t>(indices[t * 3 + v]) * positionStride);
+				clip[v] = toClip * glm::vec4(position, 1.0f);
+			}
+			addClipTriangle(clip, cullBackfaces);
+		}
+		stats.submittedTriangles += triangleCount;
+	}
+
+	// the 12 triangles of a box, the box has to be inside the object it stands in for
+	void addOccluderBox(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::mat4& world)
+	{
+		glm::vec3 corners[8];
+		for (uint32_t c = 0; c < 8; ++c)
+		{
+			corners[c] = glm::vec3(c & 1 ? boxMax.x : boxMin.x, c & 2 ? boxMax.y : boxMin.y, c & 4 ? boxMax.z : boxMin.z);
+		}
+		// counter clockwise seen from outside
+		static const uint32_t BOX_INDICES[36] =
+		{
+			0, 2, 1, 1, 2, 3,	// -z
+			4, 5, 6, 5, 7, 6,	// +z
+			0, 1, 4, 1, 5, 4,	// -y
+			2, 6, 3, 3, 6, 7,	// +y
+			0, 4, 2, 2, 4, 6,	// -x
+			1, 3, 5, 3, 7, 5,	// +x
+		};
+		addOccluder(corners, sizeof(glm::vec3), BOX_INDICES, 12, world, true);
+	}
+
+	// Draws every queued triangle, bands of tile rows go to the job system (jobs may be null)
+	void rasterize(JobSystem* jobs)
+	{
+		PV_PROFILE_FUNCTION();
+		auto band = [&](uint32_t tileRowBegin, uint32_t tileRowEnd)
+		{
+			for (const OccluderTriangle& tri : triangles)
+			{
+				int32_t rowBegin = std::max(tri.tileMinY, static_cast<int32_t>(tileRowBegin));
+				int32_t rowEnd = std::min(tri.tileMaxY + 1, static_cast<int32_t>(tileRowEnd));
+				for (int32_t tileY = rowBegin; tileY < rowEnd; ++tileY)
+				{
+					rasterizeTileRow(tri, tileY);
+				}
+			}
+		};
+		const uint32_t bandCount = jobs != nullptr ? 4 * jobs->threadCount() : 1;
+		if (jobs != nullptr)
+			jobs->parallelFor(tilesY, (tilesY + bandCount - 1) / bandCount, band);
+		else
+			band(0, tilesY);
+	}
+
+	// Could any part of the world space box be in front of the occluders? Boxes through the near
+	// plane always are, boxes entirely off screen never are.
+	bool isBoxVisible(const glm::vec3& boxMin, const glm::vec3& boxMax) const
+	{
+		const glm::vec4 center = viewProjection * glm::vec4((boxMin + boxMax) * 0.5f, 1.0f);
+		const glm::vec3 extent = (boxMax - boxMin) * 0.5f;
+		const glm::vec4 axes[3] = { viewProjection[0] * extent.x, viewProjection[1] * extent.y, viewProjection[2] * extent.z };
+
+		float minX = occlusion_detail::BIG, minY = occlusion_detail::BIG, maxX = -occlusion_detail::BIG, maxY = -occlusion_detail::BIG;
+		float zNear = occlusion_detail::BIG;
+		for (uint32_t c = 0; c < 8; ++c)
+		{
+			glm::vec4 clip = center + (c & 1 ? axes[0] : -axes[0]) + (c & 2 ? axes[1] : -axes[1]) + (c & 4 ? axes[2] : -axes[2]);
+			if (clip.z < 0.0f) return true;
+			float invW = 1.0f / clip.w;
+			float x = (clip.x * invW * 0.5f + 0.5f) * width;
+			float y = (clip.y * invW * 0.5f + 0.5f) * height;
+			minX = std::min(minX, x); maxX = std::max(maxX, x);
+			minY = std::min(minY, y); maxY = std::max(maxY, y);
+			zNear = std::min(zNear, clip.z * invW);
+		}
+		return isRectVisible(minX, minY, maxX, maxY, zNear);
+	}
+
+	// Screen rect in pixels and its closest depth. Every pixel the rect touches counts.
+	bool isRectVisible(float minX, float minY, float maxX, float maxY, float zNear) const
+	{
+		using namespace occlusion_detail;
+		const int32_t x0 = std::max(static_cast<int32_t>(std::floor(std::max(minX, -1.0f))), 0);
+		const int32_t y0 = std::max(static_cast<int32_t>(std::floor(std::max(minY, -1.0f))), 0);
+		const int32_t x1 = std::min(static_cast<int32_t>(std::ceil(std::min(maxX, width + 1.0f))), static_cast<int32_t>(width));
+		const int32_t y1 = std::min(static_cast<int32_t>(std::ceil(std::min(maxY, height + 1.0f))), static_cast<int32_t>(height));
+		if (x0 >= x1 || y0 >= y1) return false;
+
+		for (int32_t tileY = y0 / TILE_HEIGHT; tileY <= (y1 - 1) / static_cast<int32_t>(TILE_HEIGHT); ++tileY)
+		{
+			const int32_t rowFirst = std::max(y0 - tileY * static_cast<int32_t>(TILE_HEIGHT), 0);
+			const int32_t rowEnd = std::min(y1 - tileY * static_cast<int32_t>(TILE_HEIGHT), static_cast<int32_t>(TILE_HEIGHT));
+			for (int32_t tileX = x0 / TILE_WIDTH; tileX <= (x1 - 1) / static_cast<int32_t>(TILE_WIDTH); ++tileX)
+			{
+				const uint32_t tile = tileY * tilesX + tileX;
+				// closer than both layers, no need to look at pixels
+				if (zNear <= std::min(zFar0[tile], zFar1[tile])) return true;
+				if (zNear > std::max(zFar0[tile], zFar1[tile])) continue;
+
+				const uint32_t columns = columnBits(x0 - tileX * static_cast<int32_t>(TILE_WIDTH), x1 - tileX * static_cast<int32_t>(TILE_WIDTH));
+				uint32_t rows[TILE_HEIGHT];
+				for (int32_t r = 0; r < static_cast<int32_t>(TILE_HEIGHT); ++r)
+				{
+					rows[r] = r >= rowFirst && r < rowEnd ? columns : 0u;
+				}
+				const TileMask rect = loadMask(rows);
+				const TileMask layer1 = loadMask(&masks[tile * TILE_HEIGHT]);
+				if (zNear <= zFar0[tile] && !maskEmpty(maskAndNot(rect, layer1))) return true;
+				if (zNear <= zFar1[tile] && !maskEmpty(maskAnd(rect, layer1))) return true;
+			}
+		}
+		return false;
+	}
+
+	// Writes the entries of candidates whose CullingBounds box isn't occluded to out, in order.
+	// out may be candidates. Returns how many.
+	uint32_t cullOccluded(CullingBounds& bounds, const uint32_t* candidates, uint32_t count, uint32_t* out) const
+	{
+		const float* cx = bounds.centerX().data(); const float* cy = bounds.centerY().data(); const float* cz = bounds.centerZ().data();
+		const float* ex = bounds.extentX().data(); const float* ey = bounds.extentY().data(); const float* ez = bounds.extentZ().data();
+		uint32_t visible = 0;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const uint32_t object = candidates[i];
+			const glm::vec3 center(cx[object], cy[object], cz[object]);
+			const glm::vec3 extent(ex[object], ey[object], ez[object]);
+			if (isBoxVisible(center - extent, center + extent))
+				out[visible++] = object;
+		}
+		return visible;
+	}
+
+	// cullOccluded over visible (say cullBoundsParallel's output) in place, across the job system
+	void cullOccludedParallel(CullingBounds& bounds, std::vector<uint32_t>& visible, JobSystem& jobs) const
+	{
+		PV_PROFILE_FUNCTION();
+		const uint32_t CHUNK_SIZE = 4 * 1024;
+		const uint32_t count = static_cast<uint32_t>(visible.size());
+		const uint32_t chunkCount = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+		std::vector<uint32_t> chunkVisible(chunkCount);
+		jobs.parallelFor(count, CHUNK_SIZE, [&](uint32_t begin, uint32_t end)
+		{
+			chunkVisible[begin / CHUNK_SIZE] = cullOccluded(bounds, visible.data() + begin, end - begin, visible.data() + begin);
+		});
+		uint32_t total = 0;
+		for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+		{
+			uint32_t begin = chunk * CHUNK_SIZE;
+			if (begin != total)
+				std::memmove(visible.data() + total, visible.data() + begin, chunkVisible[chunk] * sizeof(uint32_t));
+			total += chunkVisible[chunk];
+		}
+		visible.resize(total);
+	}
+
+private:
+	glm::mat4 viewProjection = glm::mat4(1.0f);
+	std::vector<uint32_t> masks;	// TILE_HEIGHT rows per tile
+	std::vector<float> zFar0;		// depth bound of the pixels outside the mask
+	std::vector<float> zFar1;		// and inside it
+
+	// clips against the near plane (z >= 0 in Vulkan clip space), the rest is left to the tile bounds
+	void addClipTriangle(const glm::vec4 clip[3], bool cullBackfaces)
+	{
+		// all of it off one side of the frustum
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			bool allBelow = true, allAbove = true;
+			for (int v = 0; v < 3; ++v)
+			{
+				allBelow = allBelow && (axis == 2 ? clip[v].z < 0.0f : clip[v][axis] < -clip[v].w);
+				allAbove = allAbove && clip[v][axis] > clip[v].w;
+			}
+			if (allBelow || allAbove) return;
+		}
+
+		glm::vec4 polygon[4];
+		uint32_t vertexCount = 0;
+		for (int v = 0; v < 3; ++v)
+		{
+			const glm::vec4& a = clip[v];
+			const glm::vec4& b = clip[(v + 1) % 3];
+			if (a.z >= 0.0f) polygon[vertexCount++] = a;
+			if ((a.z >= 0.0f) != (b.z >= 0.0f))
+				polygon[vertexCount++] = a + (b - a) * (a.z / (a.z - b.z));
+		}
+		for (uint32_t v = 2; v < vertexCount; ++v)
+		{
+			setupTriangle(polygon[0], polygon[v - 1], polygon[v], cullBackfaces);
+		}
+	}
+
+	void setupTriangle(const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2, bool cullBackfaces)
+	{
+		OccluderTriangle tri;
+		float z[3];
+		const glm::vec4* clip[3] = { &c0, &c1, &c2 };
+		for (int v = 0; v < 3; ++v)
+		{
+			float invW = 1.0f / clip[v]->w;
+			tri.x[v] = (clip[v]->x * invW * 0.5f + 0.5f) * width;
+			tri.y[v] = (clip[v]->y * invW * 0.5f + 0.5f) * height;
+			z[v] = clip[v]->z * invW;
+		}
+
+		// Twice the signed area in pixels. Counter clockwise front faces with the y flipped
+		// projection come out negative here (y points down), so positive is a back face.
+		float area = (tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) - (tri.y[1] - tri.y[0]) * (tri.x[2] - tri.x[0]);
+		if (area == 0.0f || (cullBackfaces && area > 0.0f)) return;
+		if (area < 0.0f)
+		{
+			std::swap(tri.x[1], tri.x[2]);
+			std::swap(tri.y[1], tri.y[2]);
+			std::swap(z[1], z[2]);
+			area = -area;
+		}
+
+		tri.minX = std::min(std::min(tri.x[0], tri.x[1]), tri.x[2]);
+		tri.maxX = std::max(std::max(tri.x[0], tri.x[1]), tri.x[2]);
+		tri.minY = std::min(std::min(tri.y[0], tri.y[1]), tri.y[2]);
+		tri.maxY = std::max(std::max(tri.y[0], tri.y[1]), tri.y[2]);
+		// pixels whose centers can be inside, clamped to the screen
+		const float firstColumn = std::max(std::ceil(tri.minX - 0.5f), 0.0f);
+		const float lastColumn = std::min(std::floor(tri.maxX - 0.5f), width - 1.0f);
+		const float firstRow = std::max(std::ceil(tri.minY - 0.5f), 0.0f);
+		const float lastRow = std::min(std::floor(tri.maxY - 0.5f), height - 1.0f);
+		if (firstColumn > lastColumn || firstRow > lastRow) return;
+		tri.tileMinX = static_cast<int32_t>(firstColumn) / TILE_WIDTH;
+		tri.tileMaxX = static_cast<int32_t>(lastColumn) / TILE_WIDTH;
+		tri.tileMinY = static_cast<int32_t>(firstRow) / TILE_HEIGHT;
+		tri.tileMaxY = static_cast<int32_t>(lastRow) / TILE_HEIGHT;
+
+		for (int e = 0; e < 3; ++e)
+		{
+			int next = (e + 1) % 3;
+			float dy = tri.y[next] - tri.y[e];
+			tri.edges[e] = dy < 0.0f ? OccluderTriangle::EDGE_LEFT : dy > 0.0f ? OccluderTriangle::EDGE_RIGHT : OccluderTriangle::EDGE_FLAT;
+			tri.slope[e] = dy != 0.0f ? (tri.x[next] - tri.x[e]) / dy : 0.0f;
+		}
+
+		tri.zdx = ((z[1] - z[0]) * (tri.y[2] - tri.y[0]) - (z[2] - z[0]) * (tri.y[1] - tri.y[0])) / area;
+		tri.zdy = ((z[2] - z[0]) * (tri.x[1] - tri.x[0]) - (z[1] - z[0]) * (tri.x[2] - tri.x[0])) / area;
+		tri.zBase = z[0] - tri.zdx * tri.x[0] - tri.zdy * tri.y[0];
+		tri.zMax = std::max(std::max(z[0], z[1]), z[2]);
+
+		triangles.push_back(tri);
+		++stats.rasterizedTriangles;
+	}
+
+	void rasterizeTileRow(const OccluderTriangle& tri, int32_t tileY)
+	{
+		using namespace occlusion_detail;
+		const occlusion_detail::RowSpans spans = rowSpans(tri, tileY);
+		// farthest point of the triangle's bounds inside the tile, the depth plane is linear so it's at a corner
+		const float tileTop = tileY * static_cast<float>(TILE_HEIGHT);
+		const float farY = tri.zdy > 0.0f ? std::min(tileTop + TILE_HEIGHT, tri.maxY) : std::max(tileTop, tri.minY);
+
+		for (int32_t tileX = tri.tileMinX; tileX <= tri.tileMaxX; ++tileX)
+		{
+			const TileMask covered = coverage(spans, tileX);
+			if (maskEmpty(covered)) continue;
+
+			const float tileLeft = tileX * static_cast<float>(TILE_WIDTH);
+			const float farX = tri.zdx > 0.0f ? std::min(tileLeft + TILE_WIDTH, tri.maxX) : std::max(tileLeft, tri.minX);
+			const float zTri = std::min(tri.zBase + tri.zdx * farX + tri.zdy * farY, tri.zMax);
+			updateTile(tileY * tilesX + tileX, covered, zTri);
+		}
+	}
+
+	// Merges covered pixels at depth zTri or closer into the tile's two layers
+	void updateTile(uint32_t tile, occlusion_detail::TileMask covered, float zTri)
+	{
+		using namespace occlusion_detail;
+		float& z0 = zFar0[tile];
+		float& z1 = zFar1[tile];
+		if (zTri >= z0) return;
+
+		uint32_t* rows = &masks[tile * TILE_HEIGHT];
+		TileMask layer1 = loadMask(rows);
+		if (maskEmpty(layer1) || z1 - zTri > z0 - z1)
+		{
+			// the triangle is much closer than the working layer: start over with it,
+			// the old layer's pixels fall back to zFar0 which still holds for them
+			layer1 = covered;
+			z1 = zTri;
+		}
+		else
+		{
+			layer1 = maskOr(layer1, covered);
+			z1 = std::max(z1, zTri);
+		}
+		// the whole tile is at most z1 deep now
+		if (maskFull(layer1))
+		{
+			z0 = z1;
+			layer1 = maskZero();
+		}
+		storeMask(rows, layer1);
+	}
+};
+
+
+namespace occlusion_detail
+{
+	// Per pixel exact depth of the same triangles, what the masked buffer has to stay conservative against
+	struct ReferenceDepth
+	{
+		uint32_t width, height;
+		std::vector<float> depth;
+
+		ReferenceDepth(const OcclusionBuffer& buffer)
+			: width(buffer.width), height(buffer.height), depth(buffer.width * buffer.height, std::numeric_limits<float>::max())
+		{
+			for (const OccluderTriangle& tri : buffer.triangles)
+			{
+				for (int32_t py = tri.tileMinY * 8; py < (tri.tileMaxY + 1) * 8; ++py)
+					for (int32_t px = tri.tileMinX * 32; px < (tri.tileMaxX + 1) * 32; ++px)
+					{
+						float x = px + 0.5f, y = py + 0.5f;
+						bool inside = true;
+						for (int e = 0; e < 3; ++e)
+						{
+							int next = (e + 1) % 3;
+							float edge = (tri.x[next] - tri.x[e]) * (y - tri.y[e]) - (tri.y[next] - tri.y[e]) * (x - tri.x[e]);
+							inside = inside && edge >= 0.0f;
+						}
+						if (inside)
+						{
+							float& d = depth[py * width + px];
+							d = std::min(d, tri.zBase + tri.zdx * x + tri.zdy * y);
+						}
+					}
+			}
+		}
+
+		bool isRectVisible(float minX, float minY, float maxX, float maxY, float zNear) const
+		{
+			int32_t x0 = std::max(static_cast<int32_t>(std::floor(std::max(minX, -1.0f))), 0);
+			int32_t y0 = std::max(static_cast<int32_t>(std::floor(std::max(minY, -1.0f))), 0);
+			int32_t x1 = std::min(static_cast<int32_t>(std::ceil(std::min(maxX, width + 1.0f))), static_cast<int32_t>(width));
+			int32_t y1 = std::min(static_cast<int32_t>(std::ceil(std::min(maxY, height + 1.0f))), static_cast<int32_t>(height));
+			for (int32_t py = y0; py < y1; ++py)
+				for (int32_t px = x0; px < x1; ++px)
+					if (zNear <= depth[py * width + px]) return true;
+			return false;
+		}
+	};
+}
+
+// A 32x32 block city of box buildings (the occluders) with 200k small boxes around the streets,
+// seen from street level and from above the roofs. Prints occluder triangles/ms, objects
+// tested/ms and how many of the frustum visible objects got culled, and checks that nothing
+// visible in an exact per pixel depth buffer of the same occluders got culled.
+inline void benchmarkOcclusionCulling(JobSystem& jobs, std::ostream& out, uint32_t objectCount = 200000)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	auto elapsedMs = [](Clock::time_point start) { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+
+	const uint32_t BLOCKS = 32;
+	const float BLOCK_SIZE = 12.0f;	// 8 m building, 4 m street
+	std::mt19937 rng(4321);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	std::vector<glm::vec3> buildingMin, buildingMax;
+	for (uint32_t by = 0; by < BLOCKS; ++by)
+		for (uint32_t bx = 0; bx < BLOCKS; ++bx)
+		{
+			glm::vec3 corner(bx * BLOCK_SIZE + 2.0f, by * BLOCK_SIZE + 2.0f, 0.0f);
+			buildingMin.push_back(corner);
+			buildingMax.push_back(corner + glm::vec3(8.0f, 8.0f, 6.0f + 34.0f * unit(rng)));
+		}
+
+	CullingBounds bounds(objectCount);
+	for (uint32_t i = 0; i < objectCount; ++i)
+	{
+		glm::vec3 position(unit(rng) * BLOCKS * BLOCK_SIZE, unit(rng) * BLOCKS * BLOCK_SIZE, unit(rng) * 3.0f);
+		glm::vec3 extent(0.25f + unit(rng), 0.25f + unit(rng), 0.25f + unit(rng));
+		bounds.setAabb(i, position - extent, position + extent);
+	}
+
+	OcclusionBuffer buffer;
+	buffer.init(640, 360);
+
+	struct View
+	{
+		const char* name;
+		glm::vec3 eye, target;
+	};
+	// down the middle of a street (x = 204 is 0 mod BLOCK_SIZE) and over the roofs
+	const View views[] =
+	{
+		{ "street level", glm::vec3(204.0f, 4.0f, 1.7f), glm::vec3(210.0f, 380.0f, 1.7f) },
+		{ "above roofs ", glm::vec3(-20.0f, -20.0f, 60.0f), glm::vec3(200.0f, 200.0f, 0.0f) },
+	};
+	const int ITERATIONS = 10;
+
+	out << "Occlusion culling benchmark: " << buildingMin.size() * 12 << " occluder triangles, " << objectCount << " objects, "
+		<< buffer.width << "x" << buffer.height << (PV_OCCLUSION_AVX2 ? ", AVX2" : ", scalar") << std::endl;
+	for (const View& view : views)
+	{
+		glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+		proj[1][1] *= -1.0f;
+		const glm::mat4 viewProjection = proj * glm::lookAt(view.eye, view.target, glm::vec3(0.0f, 0.0f, 1.0f));
+		std::vector<uint32_t> frustumVisible;
+		cullBoundsParallel(bounds, Frustum::fromViewProjection(viewProjection), frustumVisible, jobs);
+
+		auto render = [&](JobSystem* rasterJobs)
+		{
+			buffer.clear();
+			buffer.setViewProjection(viewProjection);
+			for (size_t b = 0; b < buildingMin.size(); ++b)
+			{
+				buffer.addOccluderBox(buildingMin[b], buildingMax[b], glm::mat4(1.0f));
+			}
+			buffer.rasterize(rasterJobs);
+		};
+		auto start = Clock::now();
+		for (int it = 0; it < ITERATIONS; ++it) render(nullptr);
+		const double serialMs = elapsedMs(start) / ITERATIONS;
+		start = Clock::now();
+		for (int it = 0; it < ITERATIONS; ++it) render(&jobs);
+		const double parallelMs = elapsedMs(start) / ITERATIONS;
+
+		std::vector<uint32_t> visible;
+		start = Clock::now();
+		for (int it = 0; it < ITERATIONS; ++it)
+		{
+			visible = frustumVisible;
+			buffer.cullOccludedParallel(bounds, visible, jobs);
+		}
+		const double testMs = elapsedMs(start) / ITERATIONS;
+
+		// nothing the exact depth buffer sees may be culled
+		occlusion_detail::ReferenceDepth reference(buffer);
+		uint32_t referenceVisible = 0, falselyCulled = 0;
+		size_t next = 0;
+		for (uint32_t object : frustumVisible)
+		{
+			glm::vec3 center(bounds.centerX()[object], bounds.centerY()[object], bounds.centerZ()[object]);
+			glm::vec3 extent(bounds.extentX()[object], bounds.extentY()[object], bounds.extentZ()[object]);
+			bool maskedVisible = next < visible.size() && visible[next] == object;
+			next += maskedVisible ? 1 : 0;
+
+			// same projection as isBoxVisible
+			bool exactVisible = false, nearClipped = false;
+			float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, zNear = 1e30f;
+			for (uint32_t c = 0; c < 8; ++c)
+			{
+				glm::vec3 corner = center + glm::vec3(c & 1 ? extent.x : -extent.x, c & 2 ? extent.y : -extent.y, c & 4 ? extent.z : -extent.z);
+				glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+				nearClipped = nearClipped || clip.z < 0.0f;
+				float x = (clip.x / clip.w * 0.5f + 0.5f) * buffer.width, y = (clip.y / clip.w * 0.5f + 0.5f) * buffer.height;
+				minX = std::min(minX, x); maxX = std::max(maxX, x); minY = std::min(minY, y); maxY = std::max(maxY, y);
+				zNear = std::min(zNear, clip.z / clip.w);
+			}
+			exactVisible = nearClipped || reference.isRectVisible(minX, minY, maxX, maxY, zNear);
+			referenceVisible += exactVisible ? 1 : 0;
+			falselyCulled += exactVisible && !maskedVisible ? 1 : 0;
+		}
+		PV_ASSERT(falselyCulled == 0, "benchmarkOcclusionCulling: " + std::to_string(falselyCulled) + " objects culled that the exact depth buffer sees");
+
+		const double frustumCount = static_cast<double>(frustumVisible.size());
+		out << "\t" << view.name << ": " << buffer.stats.rasterizedTriangles << " triangles rasterized, "
+			<< buffer.stats.submittedTriangles / serialMs << " triangles/ms 1 thread (" << serialMs << " ms), "
+			<< buffer.stats.submittedTriangles / parallelMs << " triangles/ms " << jobs.threadCount() << " threads (" << parallelMs << " ms)" << std::endl;
+		out << "\t              " << frustumVisible.size() << " in the frustum, " << frustumCount / testMs << " objects/ms tested, "
+			<< 100.0 * (frustumCount - visible.size()) / std::max(frustumCount, 1.0) << "% culled (exact depth buffer: "
+			<< 100.0 * (frustumCount - referenceVisible) / std::max(frustumCount, 1.0) << "%)" << std::endl;
+	}
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+/*
+	Include dependencies: Vulkan, Macros.h
+*/
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <mutex>
+#include <iostream>
+
+
+// VkPipelineCache that lives on disk between runs.
+//
+// The blob is only handed to the driver if its header matches the device we are running on,
+// a driver update or a different GPU will otherwise feed it data it has to reject (or worse).
+// Worker threads can create their own caches with createThreadCache() so they never contend
+// on the main one, those get merged back in with mergeThreadCaches().
+struct PipelineCache
+{
+	VkPipelineCache cache = VK_NULL_HANDLE;
+
+	// true if a valid blob was loaded from disk
+	bool warm = false;
+
+	// accumulated time spent in vkCreate*Pipelines with this cache
+	double creationMs = 0.0;
+	uint32_t creationCount = 0;
+
+	void init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, const std::string& cachePath)
+	{
+		device = logicalDevice;
+		path = cachePath;
+		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+		std::vector<char> blob = loadBlob();
+		warm = !blob.empty();
+
+		VkPipelineCacheCreateInfo cacheInfo = {};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheInfo.initialDataSize = blob.size();
+		cacheInfo.pInitialData = blob.empty() ? nullptr : blob.data();
+
+		PV_VK_RUN(vkCreatePipelineCache(device, &cacheInfo, allocnullptr, &cache));
+	}
+
+	// Writes the cache (including everything merged into it) back to disk and destroys it
+	void cleanup()
+	{
+		if (cache == VK_NULL_HANDLE) return;
+
+		mergeThreadCaches();
+		save();
+		vkDestroyPipelineCache(device, cache, allocnullptr);
+		cache = VK_NULL_HANDLE;
+	}
+
+	// An empty cache for a single worker thread. It is merged into the main cache
+	// by mergeThreadCaches(), the caller must not use it after that.
+	VkPipelineCache createThreadCache()
+	{
+		VkPipelineCacheCreateInfo cacheInfo = {};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+		VkPipelineCache threadCache;
+		PV_VK_RUN(vkCreatePipelineCache(device, &cacheInfo, allocnullptr, &threadCache));
+
+		std::lock_guard<std::mutex> lock(threadCacheMutex);
+		threadCaches.push_back(threadCache);
+		return threadCache;
+	}
+
+	// Call once every worker is done creating pipelines
+	void mergeThreadCaches()
+	{
+		std::lock_guard<std::mutex> lock(threadCacheMutex);
+		if (threadCaches.empty()) return;
+
+		PV_VK_RUN(vkMergePipelineCaches(device, cache, static_cast<uint32_t>(threadCaches.size()), threadCaches.data()));
+		for (VkPipelineCache threadCache : threadCaches)
+		{
+			vkDestroyPipelineCache(device, threadCache, allocnullptr);
+		}
+		threadCaches.clear();
+	}
+
+	void save()
+	{
+		size_t dataSize = 0;
+		PV_VK_RUN(vkGetPipelineCacheData(device, cache, &dataSize, nullptr));
+		if (dataSize == 0) return;
+
+		std::vector<char> data(dataSize);
+		PV_VK_RUN(vkGetPipelineCacheData(device, cache, &dataSize, data.data()));
+
+		// write next to the old one and swap, a crash mid write would otherwise leave a truncated blob
+		const std::string tempPath = path + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+			{
+				std::cerr << "PipelineCache: failed to write " << tempPath << std::endl;
+				return;
+			}
+			file.write(data.data(), dataSize);
+		}
+		std::remove(path.c_str());
+		std::rename(tempPath.c_str(), path.c_str());
+	}
+
+	// called from whichever thread built the pipeline
+	void recordCreation(double ms)
+	{
+		std::lock_guard<std::mutex> lock(statsMutex);
+		creationMs += ms;
+		++creationCount;
+	}
+
+	void printStats(std::ostream& out) const
+	{
+		out << "Pipeline creation (" << (warm ? "warm" : "cold") << " cache): "
+			<< creationCount << " pipelines in " << creationMs << " ms" << std::endl;
+	}
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties deviceProperties = {};
+	std::string path;
+
+	std::mutex statsMutex;
+	std::mutex threadCacheMutex;
+	std::vector<VkPipelineCache> threadCaches;
+
+	// returns an empty blob if there is no cache on disk or it was made by another device/driver
+	std::vector<char> loadBlob() const
+	{
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (!file.is_open())
+			return {};
+
+		size_t fileSize = static_cast<size_t>(file.tellg());
+		std::vector<char> blob(fileSize);
+		file.seekg(0);
+		file.read(blob.data(), fileSize);
+
+		// VkPipelineCacheHeaderVersionOne layout, see the vkGetPipelineCacheData spec
+		struct CacheHeader
+		{
+			uint32_t headerSize;
+			uint32_t headerVersion;
+			uint32_t vendorID;
+			uint32_t deviceID;
+			uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		};
+
+		CacheHeader header;
+		if (fileSize < sizeof(header))
+			return {};
+		std::memcpy(&header, blob.data(), sizeof(header));
+
+		const bool valid =
+			header.headerSize >= sizeof(header) &&
+			header.headerSize <= fileSize &&
+			header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+			header.vendorID == deviceProperties.vendorID &&
+			header.deviceID == deviceProperties.deviceID &&
+			std::memcmp(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+
+		if (!valid)
+		{
+			std::cout << "PipelineCache: " << path << " was made by a different device or driver, starting cold" << std::endl;
+			return {};
+		}
+		return blob;
+	}
+};
@@ -0,0 +1,936 @@
+#pragma once
+
+/*
+	Include dependencies: Vulkan, Macros.h, CpuProfiler.h
+*/
+#include <vector>
+#include <string>
+#include <functional>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <ostream>
+#include <stdint.h>
+
+
+typedef uint32_t RenderResource;
+
+// How a pass touches a resource: the stages and accesses it uses it with and, for images, the layout
+// it has to be in. Combine uses in the same pass with |, they have to agree on the layout.
+struct ResourceUsage
+{
+	VkPipelineStageFlags stages = 0;
+	VkAccessFlags access = 0;
+	VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	static const VkAccessFlags WRITE_ACCESS =
+		VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+	ResourceUsage() = default;
+	ResourceUsage(VkPipelineStageFlags usageStages, VkAccessFlags usageAccess, VkImageLayout usageLayout = VK_IMAGE_LAYOUT_UNDEFINED)
+		: stages(usageStages), access(usageAccess), layout(usageLayout)
+	{ }
+
+	bool writes() const { return (access & WRITE_ACCESS) != 0; }
+	bool reads() const { return (access & ~WRITE_ACCESS) != 0; }
+
+	ResourceUsage operator|(const ResourceUsage& other) const
+	{
+		PV_ASSERT(layout == other.layout, "ResourceUsage: can't combine uses with different layouts");
+		return ResourceUsage(stages | other.stages, access | other.access, layout);
+	}
+
+	static ResourceUsage colorAttachment()
+	{
+		return ResourceUsage(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	}
+	static ResourceUsage depthAttachment()
+	{
+		return ResourceUsage(VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+	}
+	static ResourceUsage sampled(VkPipelineStageFlags shaderStages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
+	{
+		return ResourceUsage(shaderStages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+	// storage images are in GENERAL, the layout is ignored for buffers
+	static ResourceUsage storageRead(VkPipelineStageFlags shaderStages)
+	{
+		return ResourceUsage(shaderStages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL);
+	}
+	static ResourceUsage storageWrite(VkPipelineStageFlags shaderStages)
+	{
+		return ResourceUsage(shaderStages, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL);
+	}
+	static ResourceUsage uniformRead(VkPipelineStageFlags shaderStages)
+	{
+		return ResourceUsage(shaderStages, VK_ACCESS_UNIFORM_READ_BIT);
+	}
+	static ResourceUsage transferSrc()
+	{
+		return ResourceUsage(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+	}
+	static ResourceUsage transferDst()
+	{
+		return ResourceUsage(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	}
+	static ResourceUsage vertexInput()
+	{
+		return ResourceUsage(VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+	}
+	static ResourceUsage drawIndirect()
+	{
+		return ResourceUsage(VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+	}
+	static ResourceUsage hostRead()
+	{
+		return ResourceUsage(VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+	}
+	// a swap chain image after acquire (waited on at color output) and before present
+	static ResourceUsage acquired()
+	{
+		return ResourceUsage(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED);
+	}
+	static ResourceUsage present()
+	{
+		return ResourceUsage(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	}
+};
+
+// Transient images are described, the graph works out the usage flags from the passes
+struct RenderImageDesc
+{
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	uint32_t width = 0, height = 0;
+	uint32_t mipLevels = 1;
+	VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+};
+
+
+// A frame (or an upload) as a list of passes that declare which resources they use and how.
+// compile() drops passes nothing exported depends on, gives transient images with disjoint
+// lifetimes the same memory and works out the barriers: at most one vkCmdPipelineBarrier in
+// front of every pass, only for real hazards (reads after reads of the same layout need none),
+// tracked per mip level. execute() records the barriers and calls the passes in declaration order.
+//
+// Imported resources belong to the caller and start in the state they are imported with,
+// transient images belong to a RenderGraphTransients and start out undefined every execution.
+// The same compiled graph can be recorded into several command buffers, setImportedImage /
+// setImportedBuffer swap the handles behind an import in between.
+struct RenderGraph
+{
+	static const uint32_t ALL_MIPS = ~0u;
+
+	struct PassBuilder
+	{
+		RenderGraph* graph;
+		uint32_t pass;
+
+		PassBuilder& read(RenderResource resource, const ResourceUsage& usage, uint32_t baseMip = 0, uint32_t mipCount = ALL_MIPS)
+		{
+			PV_ASSERT(!usage.writes(), "RenderGraph: read() with write access, use write()");
+			graph->addUse(pass, resource, usage, baseMip, mipCount);
+			return *this;
+		}
+		PassBuilder& write(RenderResource resource, const ResourceUsage& usage, uint32_t baseMip = 0, uint32_t mipCount = ALL_MIPS)
+		{
+			PV_ASSERT(usage.writes(), "RenderGraph: write() without write access");
+			graph->addUse(pass, resource, usage, baseMip, mipCount);
+			return *this;
+		}
+		// never culled, for passes whose results leave the graph some other way
+		PassBuilder& sideEffects()
+		{
+			graph->passes[pass].sideEffects = true;
+			return *this;
+		}
+	};
+
+	struct Stats
+	{
+		uint32_t passes = 0;
+		uint32_t culledPasses = 0;
+		uint32_t barrierCalls = 0;		// vkCmdPipelineBarrier per execute
+		uint32_t imageBarriers = 0;
+		uint32_t bufferBarriers = 0;
+		uint32_t transientImages = 0;
+		uint32_t memoryBlocks = 0;
+		VkDeviceSize transientBytes = 0;	// what the transients would need on their own
+		VkDeviceSize aliasedBytes = 0;		// what they need sharing memory
+	};
+
+	// transient memory sharing, filled by compile()
+	struct MemoryBlock
+	{
+		VkDeviceSize size = 0;
+		VkDeviceSize alignment = 1;
+		uint32_t memoryTypeBits = ~0u;
+	};
+	std::vector<MemoryBlock> memoryBlocks;
+	Stats stats;
+
+	RenderResource createImage(const char* name, const RenderImageDesc& desc)
+	{
+		Resource resource;
+		resource.name = name;
+		resource.isImage = true;
+		resource.transient = true;
+		resource.desc = desc;
+		return addResource(resource, ResourceUsage());
+	}
+	RenderResource importImage(const char* name, VkImage image, VkImageView view, const RenderImageDesc& desc, const ResourceUsage& initial)
+	{
+		Resource resource;
+		resource.name = name;
+		resource.isImage = true;
+		resource.desc = desc;
+		resource.image = image;
+		resource.view = view;
+		return addResource(resource, initial);
+	}
+	RenderResource importBuffer(const char* name, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, const ResourceUsage& initial)
+	{
+		Resource resource;
+		resource.name = name;
+		resource.buffer = buffer;
+		resource.offset = offset;
+		resource.size = size;
+		return addResource(resource, initial);
+	}
+	// has to be in this state after the graph ran (present, host read...), keeps its producers alive
+	void exportResource(RenderResource resource, const ResourceUsage& final)
+	{
+		resources[resource].exported = true;
+		resources[resource].final = final;
+	}
+
+	void setImportedImage(RenderResource resource, VkImage image, VkImageView view)
+	{
+		PV_ASSERT(!resources[resource].transient, "RenderGraph: transients belong to RenderGraphTransients");
+		resources[resource].image = image;
+		resources[resource].view = view;
+	}
+	void setImportedBuffer(RenderResource resource, VkBuffer buffer, VkDeviceSize offset)
+	{
+		resources[resource].buffer = buffer;
+		resources[resource].offset = offset;
+	}
+
+	PassBuilder addPass(const char* name, std::function<void(VkCommandBuffer)> execute)
+	{
+		Pass pass;
+		pass.name = name;
+		pass.execute = std::move(execute);
+		passes.push_back(std::move(pass));
+		return PassBuilder{ this, static_cast<uint32_t>(passes.size() - 1) };
+	}
+
+	// Size, alignment and memory types of a transient image with the given usage
+	typedef std::function<VkMemoryRequirements(const RenderImageDesc&, VkImageUsageFlags)> MemoryRequirementsFunc;
+
+	// Culls passes, plans the transient memory and the barriers. Pure CPU, RenderGraphTransients
+	// creates the images afterwards.
+	void compile(const MemoryRequirementsFunc& memoryRequirements)
+	{
+		PV_PROFILE_FUNCTION();
+		stats = Stats();
+		stats.passes = static_cast<uint32_t>(passes.size());
+		cullPasses();
+		planMemory(memoryRequirements);
+		planBarriers();
+	}
+
+	void execute(VkCommandBuffer cmd) const
+	{
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			recordBarriers(cmd, barriersBefore[i]);
+			passes[order[i]].execute(cmd);
+		}
+		recordBarriers(cmd, finalBarriers);
+	}
+
+	VkImage image(RenderResource resource) const { return resources[resource].image; }
+	VkImageView imageView(RenderResource resource) const { return resources[resource].view; }
+	const RenderImageDesc& imageDesc(RenderResource resource) const { return resources[resource].desc; }
+	bool isPassCulled(uint32_t pass) const { return !passes[pass].alive; }
+
+	void printPlan(std::ostream& out) const
+	{
+		out << "Render graph: " << stats.passes << " passes, " << stats.culledPasses << " culled, " << stats.barrierCalls << " barrier calls ("
+			<< stats.imageBarriers << " image, " << stats.bufferBarriers << " buffer), " << stats.transientImages << " transient images in "
+			<< stats.memoryBlocks << " blocks, " << stats.aliasedBytes / 1024 << " KiB instead of " << stats.transientBytes / 1024 << " KiB" << std::endl;
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			const BarrierBatch& batch = barriersBefore[i];
+			out << "\t" << passes[order[i]].name;
+			if (batch.srcStages != 0)
+				out << " (after " << batch.images.size() << " image, " << batch.buffers.size() << " buffer barriers)";
+			out << std::endl;
+		}
+	}
+
+private:
+	friend struct RenderGraphTransients;
+
+	struct Resource
+	{
+		std::string name;
+		bool isImage = false;
+		bool transient = false;
+		bool exported = false;
+		RenderImageDesc desc;
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0, size = 0;
+		ResourceUsage initial, final;
+
+		// compile() output for transients
+		VkImageUsageFlags usageFlags = 0;
+		uint32_t firstUse = ~0u, lastUse = 0;	// in order
+		uint32_t block = ~0u;
+	};
+	struct Use
+	{
+		RenderResource resource;
+		ResourceUsage usage;
+		uint32_t baseMip, mipCount;
+	};
+	struct Pass
+	{
+		std::string name;
+		std::function<void(VkCommandBuffer)> execute;
+		std::vector<Use> uses;
+		bool sideEffects = false;
+		bool alive = false;
+	};
+	struct ImageBarrier
+	{
+		RenderResource resource;
+		uint32_t baseMip, mipCount;
+		VkImageLayout oldLayout, newLayout;
+		VkAccessFlags srcAccess, dstAccess;
+	};
+	struct BufferBarrier
+	{
+		RenderResource resource;
+		VkAccessFlags srcAccess, dstAccess;
+	};
+	struct BarrierBatch
+	{
+		VkPipelineStageFlags srcStages = 0, dstStages = 0;
+		std::vector<ImageBarrier> images;
+		std::vector<BufferBarrier> buffers;
+	};
+	// per buffer or image mip while planning
+	struct SubresourceState
+	{
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags writeStages = 0;	// last write or layout transition
+		VkAccessFlags writeAccess = 0;
+		VkPipelineStageFlags readStages = 0;	// reads since then, later writes wait for them
+		VkPipelineStageFlags visibleStages = 0;	// already synchronized with the last write
+		VkAccessFlags visibleAccess = 0;
+	};
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	std::vector<uint32_t> order;				// alive passes
+	std::vector<BarrierBatch> barriersBefore;	// one per order entry
+	BarrierBatch finalBarriers;
+
+	RenderResource addResource(const Resource& resource, const ResourceUsage& initial)
+	{
+		resources.push_back(resource);
+		resources.back().initial = initial;
+		return static_cast<RenderResource>(resources.size() - 1);
+	}
+
+	void addUse(uint32_t pass, RenderResource resource, const ResourceUsage& usage, uint32_t baseMip, uint32_t mipCount)
+	{
+		const Resource& r = resources[resource];
+		const uint32_t mips = r.isImage ? r.desc.mipLevels : 1;
+		if (mipCount == ALL_MIPS) mipCount = mips - baseMip;
+		PV_ASSERT(baseMip + mipCount <= mips, "RenderGraph: mip range out of bounds for " + r.name);
+		passes[pass].uses.push_back(Use{ resource, usage, baseMip, mipCount });
+	}
+
+	static VkImageUsageFlags imageUsageFlags(const ResourceUsage& usage)
+	{
+		switch (usage.layout)
+		{
+		case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL: return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL: return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL: return VK_IMAGE_USAGE_SAMPLED_BIT;
+		case VK_IMAGE_LAYOUT_GENERAL: return VK_IMAGE_USAGE_STORAGE_BIT;
+		case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL: return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL: return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		default: return 0;
+		}
+	}
+
+	// Backwards from the exported resources: a pass lives if it has side effects or writes
+	// something a living pass (or the outside) reads, then what it reads lives too.
+	void cullPasses()
+	{
+		std::vector<bool> needed(resources.size(), false);
+		for (size_t r = 0; r < resources.size(); ++r)
+		{
+			needed[r] = resources[r].exported;
+		}
+		for (size_t p = passes.size(); p-- > 0;)
+		{
+			Pass& pass = passes[p];
+			pass.alive = pass.sideEffects;
+			for (const Use& use : pass.uses)
+			{
+				pass.alive = pass.alive || (use.usage.writes() && needed[use.resource]);
+			}
+			if (!pass.alive) continue;
+			for (const Use& use : pass.uses)
+			{
+				// read-modify-write uses need what came before them too
+				if (use.usage.reads() || !use.usage.writes()) needed[use.resource] = true;
+			}
+		}
+
+		order.clear();
+		for (uint32_t p = 0; p < passes.size(); ++p)
+		{
+			if (passes[p].alive) order.push_back(p);
+			else ++stats.culledPasses;
+		}
+	}
+
+	// Lifetimes of the transients over the living passes, then greedy interval packing: every
+	// transient takes the smallest free block that fits (growing the largest free one if none
+	// does) whose memory types it can live in.
+	void planMemory(const MemoryRequirementsFunc& memoryRequirements)
+	{
+		memoryBlocks.clear();
+		std::vector<RenderResource> transients;
+		for (RenderResource r = 0; r < resources.size(); ++r)
+		{
+			Resource& resource = resources[r];
+			resource.firstUse = ~0u;
+			resource.lastUse = 0;
+			resource.usageFlags = 0;
+			resource.block = ~0u;
+			if (!resource.transient) continue;
+			for (uint32_t i = 0; i < order.size(); ++i)
+				for (const Use& use : passes[order[i]].uses)
+					if (use.resource == r)
+					{
+						resource.firstUse = std::min(resource.firstUse, i);
+						resource.lastUse = std::max(resource.lastUse, i);
+						resource.usageFlags |= imageUsageFlags(use.usage);
+					}
+			if (resource.firstUse != ~0u) transients.push_back(r);
+		}
+		std::sort(transients.begin(), transients.end(), [&](RenderResource a, RenderResource b) { return resources[a].firstUse < resources[b].firstUse; });
+
+		std::vector<uint32_t> blockFreeAfter;	// last pass of the block's current occupant
+		for (RenderResource r : transients)
+		{
+			Resource& resource = resources[r];
+			const VkMemoryRequirements requirements = memoryRequirements(resource.desc, resource.usageFlags);
+			stats.transientBytes += requirements.size;
+
+			uint32_t best = ~0u;
+			for (uint32_t b = 0; b < memoryBlocks.size(); ++b)
+			{
+				if (blockFreeAfter[b] >= resource.firstUse || (memoryBlocks[b].memoryTypeBits & requirements.memoryTypeBits) == 0) continue;
+				if (best == ~0u) { best = b; continue; }
+				const bool fits = memoryBlocks[b].size >= requirements.size;
+				const bool bestFits = memoryBlocks[best].size >= requirements.size;
+				if (fits != bestFits ? fits : (fits ? memoryBlocks[b].size < memoryBlocks[best].size : memoryBlocks[b].size > memoryBlocks[best].size))
+					best = b;
+			}
+			if (best == ~0u)
+			{
+				best = static_cast<uint32_t>(memoryBlocks.size());
+				memoryBlocks.emplace_back();
+				blockFreeAfter.push_back(0);
+			}
+			MemoryBlock& block = memoryBlocks[best];
+			block.size = std::max(block.size, requirements.size);
+			block.alignment = std::max(block.alignment, requirements.alignment);
+			block.memoryTypeBits &= requirements.memoryTypeBits;
+			blockFreeAfter[best] = resource.lastUse;
+			resource.block = best;
+		}
+
+		stats.transientImages = static_cast<uint32_t>(transients.size());
+		stats.memoryBlocks = static_cast<uint32_t>(memoryBlocks.size());
+		for (const MemoryBlock& block : memoryBlocks)
+		{
+			stats.aliasedBytes += block.size;
+		}
+	}
+
+	static SubresourceState stateFrom(const ResourceUsage& usage)
+	{
+		SubresourceState state;
+		state.layout = usage.layout;
+		if (usage.writes())
+		{
+			state.writeStages = usage.stages;
+			state.writeAccess = usage.access & ResourceUsage::WRITE_ACCESS;
+			state.visibleStages = usage.stages;
+			state.visibleAccess = usage.access;
+		}
+		else
+		{
+			state.readStages = usage.stages;
+		}
+		return state;
+	}
+
+	// One use of one subresource: what has to be waited on, and the state after it
+	void transition(SubresourceState& state, const ResourceUsage& usage, bool isImage,
+		VkPipelineStageFlags& srcStages, VkAccessFlags& srcAccess, VkImageLayout& oldLayout, bool& needed)
+	{
+		const bool layoutChange = isImage && state.layout != usage.layout;
+		needed = false;
+		oldLayout = state.layout;
+		if (usage.writes() || layoutChange)
+		{
+			// write after write / after read, or a layout transition (which is a write)
+			srcStages = state.writeStages | state.readStages;
+			srcAccess = state.writeAccess;
+			needed = srcStages != 0 || layoutChange;
+			if (srcStages == 0) srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+			state.layout = usage.layout;
+			state.writeStages = usage.stages;
+			state.writeAccess = usage.access & ResourceUsage::WRITE_ACCESS;
+			state.readStages = 0;
+			state.visibleStages = usage.stages;
+			state.visibleAccess = usage.access;
+		}
+		else
+		{
+			// read after write, once per new stage or access type
+			if (state.writeStages != 0 && ((usage.stages & ~state.visibleStages) != 0 || (usage.access & ~state.visibleAccess) != 0))
+			{
+				srcStages = state.writeStages;
+				srcAccess = state.writeAccess;
+				needed = true;
+				state.visibleStages |= usage.stages;
+				state.visibleAccess |= usage.access;
+			}
+			state.readStages |= usage.stages;
+		}
+	}
+
+	void addBarrier(BarrierBatch& batch, RenderResource resource, const ResourceUsage& usage, uint32_t baseMip, uint32_t mipCount,
+		VkPipelineStageFlags srcStages, VkAccessFlags srcAccess, VkImageLayout oldLayout)
+	{
+		const Resource& r = resources[resource];
+		batch.srcStages |= srcStages;
+		batch.dstStages |= usage.stages;
+		// pure execution dependencies need no barrier struct
+		if (r.isImage && (srcAccess != 0 || oldLayout != usage.layout))
+		{
+			// neighbouring mips with the same transition share one
+			if (!batch.images.empty())
+			{
+				ImageBarrier& last = batch.images.back();
+				if (last.resource == resource && last.baseMip + last.mipCount == baseMip && last.oldLayout == oldLayout
+					&& last.newLayout == usage.layout && last.srcAccess == srcAccess && last.dstAccess == usage.access)
+				{
+					last.mipCount += mipCount;
+					return;
+				}
+			}
+			batch.images.push_back(ImageBarrier{ resource, baseMip, mipCount, oldLayout, usage.layout, srcAccess, usage.access });
+		}
+		else if (!r.isImage && srcAccess != 0)
+		{
+			batch.buffers.push_back(BufferBarrier{ resource, srcAccess, usage.access });
+		}
+	}
+
+	void applyUse(std::vector<std::vector<SubresourceState>>& states, BarrierBatch& batch, RenderResource resource, const ResourceUsage& usage, uint32_t baseMip, uint32_t mipCount)
+	{
+		const bool isImage = resources[resource].isImage;
+		for (uint32_t mip = baseMip; mip < baseMip + mipCount; ++mip)
+		{
+			VkPipelineStageFlags srcStages = 0;
+			VkAccessFlags srcAccess = 0;
+			VkImageLayout oldLayout;
+			bool needed;
+			transition(states[resource][mip], usage, isImage, srcStages, srcAccess, oldLayout, needed);
+			if (needed)
+				addBarrier(batch, resource, usage, mip, 1, srcStages, srcAccess, oldLayout);
+		}
+	}
+
+	void planBarriers()
+	{
+		// Transients start undefined, but their memory was last used by the previous occupant of
+		// their block: an earlier pass, or for the first occupant the last one of the previous execution.
+		std::vector<std::vector<SubresourceState>> states(resources.size());
+		std::vector<VkPipelineStageFlags> blockStages(memoryBlocks.size(), 0);
+		std::vector<VkAccessFlags> blockWrites(memoryBlocks.size(), 0);
+		for (uint32_t i = 0; i < order.size(); ++i)
+			for (const Use& use : passes[order[i]].uses)
+			{
+				const Resource& r = resources[use.resource];
+				if (r.transient && r.block != ~0u)
+				{
+					blockStages[r.block] |= use.usage.stages;
+					blockWrites[r.block] |= use.usage.access & ResourceUsage::WRITE_ACCESS;
+				}
+			}
+		for (RenderResource r = 0; r < resources.size(); ++r)
+		{
+			const Resource& resource = resources[r];
+			SubresourceState initial = resource.transient ? SubresourceState() : stateFrom(resource.initial);
+			if (resource.transient && resource.block != ~0u)
+			{
+				initial.writeStages = blockStages[resource.block];
+				initial.writeAccess = blockWrites[resource.block];
+			}
+			states[r].assign(resource.isImage ? resource.desc.mipLevels : 1, initial);
+		}
+
+		barriersBefore.assign(order.size(), BarrierBatch());
+		for (uint32_t i = 0; i < order.size(); ++i)
+		{
+			for (const Use& use : passes[order[i]].uses)
+			{
+				applyUse(states, barriersBefore[i], use.resource, use.usage, use.baseMip, use.mipCount);
+			}
+		}
+		finalBarriers = BarrierBatch();
+		for (RenderResource r = 0; r < resources.size(); ++r)
+		{
+			if (resources[r].exported)
+				applyUse(states, finalBarriers, r, resources[r].final, 0, static_cast<uint32_t>(states[r].size()));
+		}
+
+		auto count = [&](const BarrierBatch& batch)
+		{
+			if (batch.srcStages == 0) return;
+			++stats.barrierCalls;
+			stats.imageBarriers += static_cast<uint32_t>(batch.images.size());
+			stats.bufferBarriers += static_cast<uint32_t>(batch.buffers.size());
+		};
+		for (const BarrierBatch& batch : barriersBefore) count(batch);
+		count(finalBarriers);
+	}
+
+	void recordBarriers(VkCommandBuffer cmd, const BarrierBatch& batch) const
+	{
+		if (batch.srcStages == 0) return;
+		std::vector<VkImageMemoryBarrier> imageBarriers(batch.images.size());
+		for (size_t i = 0; i < batch.images.size(); ++i)
+		{
+			const ImageBarrier& b = batch.images[i];
+			const Resource& r = resources[b.resource];
+			VkImageMemoryBarrier& barrier = imageBarriers[i];
+			barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcAccessMask = b.srcAccess;
+			barrier.dstAccessMask = b.dstAccess;
+			barrier.oldLayout = b.oldLayout;
+			barrier.newLayout = b.newLayout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = r.image;
+			barrier.subresourceRange.aspectMask = r.desc.aspect;
+			barrier.subresourceRange.baseMipLevel = b.baseMip;
+			barrier.subresourceRange.levelCount = b.mipCount;
+			barrier.subresourceRange.baseArrayLayer = 0;
+			barrier.subresourceRange.layerCount = 1;
+		}
+		std::vector<VkBufferMemoryBarrier> bufferBarriers(batch.buffers.size());
+		for (size_t i = 0; i < batch.buffers.size(); ++i)
+		{
+			const BufferBarrier& b = batch.buffers[i];
+			const Resource& r = resources[b.resource];
+			VkBufferMemoryBarrier& barrier = bufferBarriers[i];
+			barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = b.srcAccess;
+			barrier.dstAccessMask = b.dstAccess;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.buffer = r.buffer;
+			barrier.offset = r.offset;
+			barrier.size = r.size;
+		}
+		vkCmdPipelineBarrier(cmd, batch.srcStages, batch.dstStages, 0, 0, nullptr,
+			static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+			static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+	}
+};
+
+
+// Owns the memory and images behind RenderGraph transients. Memory blocks are kept by index and
+// images by (description, usage, block), so graphs compiled again the same way, or other graphs
+// with the same plan, get the same images back. Only call realize() and cleanup() while the GPU
+// isn't using them.
+struct RenderGraphTransients
+{
+	void init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice)
+	{
+		device = logicalDevice;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	}
+
+	void cleanup()
+	{
+		for (auto& entry : images)
+		{
+			vkDestroyImageView(device, entry.second.view, nullptr);
+			vkDestroyImage(device, entry.second.image, nullptr);
+		}
+		images.clear();
+		for (const Block& block : blocks)
+		{
+			vkFreeMemory(device, block.memory, nullptr);
+		}
+		blocks.clear();
+		requirements.clear();
+	}
+
+	// for RenderGraph::compile
+	VkMemoryRequirements memoryRequirements(const RenderImageDesc& desc, VkImageUsageFlags usage)
+	{
+		const std::string key = imageKey(desc, usage, ~0u);
+		auto found = requirements.find(key);
+		if (found != requirements.end()) return found->second;
+
+		VkImage probe = createImage(desc, usage);
+		VkMemoryRequirements result;
+		vkGetImageMemoryRequirements(device, probe, &result);
+		vkDestroyImage(device, probe, nullptr);
+		requirements[key] = result;
+		return result;
+	}
+	RenderGraph::MemoryRequirementsFunc requirementsFunc()
+	{
+		return [this](const RenderImageDesc& desc, VkImageUsageFlags usage) { return memoryRequirements(desc, usage); };
+	}
+
+	// Allocates what the compiled graph's blocks need and puts images and views behind its transients
+	void realize(RenderGraph& graph)
+	{
+		PV_PROFILE_FUNCTION();
+		for (uint32_t b = 0; b < graph.memoryBlocks.size(); ++b)
+		{
+			const RenderGraph::MemoryBlock& needed = graph.memoryBlocks[b];
+			if (b < blocks.size() && blocks[b].size >= needed.size && (needed.memoryTypeBits & (1u << blocks[b].memoryType)) != 0)
+				continue;
+
+			// too small or the wrong type, whatever was bound to it goes too
+			if (b < blocks.size())
+			{
+				releaseBlock(b);
+			}
+			else
+			{
+				blocks.resize(b + 1);
+			}
+			VkMemoryAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocInfo.allocationSize = needed.size;
+			allocInfo.memoryTypeIndex = findMemoryType(needed.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			PV_VK_RUN(vkAllocateMemory(device, &allocInfo, nullptr, &blocks[b].memory));
+			blocks[b].size = needed.size;
+			blocks[b].memoryType = allocInfo.memoryTypeIndex;
+		}
+
+		for (RenderGraph::Resource& resource : graph.resources)
+		{
+			if (!resource.transient || resource.block == ~0u) continue;
+			const std::string key = imageKey(resource.desc, resource.usageFlags, resource.block);
+			auto found = images.find(key);
+			if (found == images.end())
+			{
+				Image image;
+				image.block = resource.block;
+				image.image = createImage(resource.desc, resource.usageFlags);
+				PV_VK_RUN(vkBindImageMemory(device, image.image, blocks[resource.block].memory, 0));
+
+				VkImageViewCreateInfo viewInfo = {};
+				viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+				viewInfo.image = image.image;
+				viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				viewInfo.format = resource.desc.format;
+				viewInfo.subresourceRange.aspectMask = resource.desc.aspect;
+				viewInfo.subresourceRange.levelCount = resource.desc.mipLevels;
+				viewInfo.subresourceRange.layerCount = 1;
+				PV_VK_RUN(vkCreateImageView(device, &viewInfo, nullptr, &image.view));
+				found = images.emplace(key, image).first;
+			}
+			resource.image = found->second.image;
+			resource.view = found->second.view;
+		}
+	}
+
+private:
+	struct Block
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint32_t memoryType = 0;
+	};
+	struct Image
+	{
+		VkImage image;
+		VkImageView view;
+		uint32_t block;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	std::vector<Block> blocks;
+	std::unordered_map<std::string, Image> images;
+	std::unordered_map<std::string, VkMemoryRequirements> requirements;
+
+	static std::string imageKey(const RenderImageDesc& desc, VkImageUsageFlags usage, uint32_t block)
+	{
+		return std::to_string(desc.format) + "/" + std::to_string(desc.width) + "x" + std::to_string(desc.height) + "/" + std::to_string(desc.mipLevels)
+			+ "/" + std::to_string(usage) + "/" + std::to_string(block);
+	}
+
+	VkImage createImage(const RenderImageDesc& desc, VkImageUsageFlags usage)
+	{
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent = { desc.width, desc.height, 1 };
+		imageInfo.mipLevels = desc.mipLevels;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = desc.format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = usage;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		VkImage image;
+		PV_VK_RUN(vkCreateImage(device, &imageInfo, nullptr, &image));
+		return image;
+	}
+
+	void releaseBlock(uint32_t block)
+	{
+		for (auto it = images.begin(); it != images.end();)
+		{
+			if (it->second.block == block)
+			{
+				vkDestroyImageView(device, it->second.view, nullptr);
+				vkDestroyImage(device, it->second.image, nullptr);
+				it = images.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+		vkFreeMemory(device, blocks[block].memory, nullptr);
+		blocks[block] = Block();
+	}
+
+	uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const
+	{
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+		{
+			if ((typeBits & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+				return i;
+		}
+		throw std::runtime_error("RenderGraphTransients: no suitable memory type");
+	}
+};
+
+
+// A deferred style frame (G-buffer, SSAO + blur, lighting, bloom down/up chain, tonemap, UI, plus
+// two debug passes nobody reads) compiled with made up memory sizes. Prints what got culled, how
+// many barriers it takes and the transient memory with and without aliasing, and the compile time.
+inline void benchmarkRenderGraph(std::ostream& out)
+{
+	const uint32_t W = 1920, H = 1080;
+	auto noop = [](VkCommandBuffer) {};
+	auto bytesPerPixel = [](VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_R16G16B16A16_SFLOAT: return 8u;
+		case VK_FORMAT_R8_UNORM: return 1u;
+		default: return 4u;
+		}
+	};
+	// every transient fits any memory type, sized like an uncompressed image
+	RenderGraph::MemoryRequirementsFunc requirements = [&](const RenderImageDesc& desc, VkImageUsageFlags)
+	{
+		VkMemoryRequirements result = {};
+		for (uint32_t mip = 0; mip < desc.mipLevels; ++mip)
+			result.size += static_cast<VkDeviceSize>(std::max(desc.width >> mip, 1u)) * std::max(desc.height >> mip, 1u) * bytesPerPixel(desc.format);
+		result.alignment = 65536;
+		result.memoryTypeBits = ~0u;
+		return result;
+	};
+	auto image = [&](VkFormat format, uint32_t width, uint32_t height, VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT)
+	{
+		RenderImageDesc desc;
+		desc.format = format;
+		desc.width = width;
+		desc.height = height;
+		desc.aspect = aspect;
+		return desc;
+	};
+
+	RenderGraph graph;
+	auto build = [&]()
+	{
+		graph = RenderGraph();
+		const VkPipelineStageFlags FRAGMENT = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		const VkPipelineStageFlags COMPUTE = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		RenderResource backbuffer = graph.importImage("Backbuffer", VK_NULL_HANDLE, VK_NULL_HANDLE, image(VK_FORMAT_B8G8R8A8_UNORM, W, H), ResourceUsage::acquired());
+		RenderResource depth = graph.createImage("Depth", image(VK_FORMAT_D32_SFLOAT, W, H, VK_IMAGE_ASPECT_DEPTH_BIT));
+		RenderResource albedo = graph.createImage("Albedo", image(VK_FORMAT_R8G8B8A8_UNORM, W, H));
+		RenderResource normals = graph.createImage("Normals", image(VK_FORMAT_R16G16B16A16_SFLOAT, W, H));
+		RenderResource ao = graph.createImage("AO", image(VK_FORMAT_R8_UNORM, W, H));
+		RenderResource aoBlurred = graph.createImage("AOBlurred", image(VK_FORMAT_R8_UNORM, W, H));
+		RenderResource hdr = graph.createImage("HDR", image(VK_FORMAT_R16G16B16A16_SFLOAT, W, H));
+		RenderResource debugView = graph.createImage("DebugView", image(VK_FORMAT_R8G8B8A8_UNORM, W, H));
+		const uint32_t BLOOM_LEVELS = 5;
+		RenderResource bloom[BLOOM_LEVELS];
+		for (uint32_t level = 0; level < BLOOM_LEVELS; ++level)
+			bloom[level] = graph.createImage("Bloom", image(VK_FORMAT_R16G16B16A16_SFLOAT, W >> (level + 1), H >> (level + 1)));
+
+		graph.addPass("GBuffer", noop).write(depth, ResourceUsage::depthAttachment())
+			.write(albedo, ResourceUsage::colorAttachment()).write(normals, ResourceUsage::colorAttachment());
+		graph.addPass("SSAO", noop).read(depth, ResourceUsage::sampled(COMPUTE)).read(normals, ResourceUsage::sampled(COMPUTE)).write(ao, ResourceUsage::storageWrite(COMPUTE));
+		graph.addPass("SSAOBlur", noop).read(ao, ResourceUsage::sampled(COMPUTE)).write(aoBlurred, ResourceUsage::storageWrite(COMPUTE));
+		graph.addPass("Lighting", noop).read(albedo, ResourceUsage::sampled()).read(normals, ResourceUsage::sampled()).read(depth, ResourceUsage::sampled())
+			.read(aoBlurred, ResourceUsage::sampled()).write(hdr, ResourceUsage::colorAttachment());
+		graph.addPass("DebugNormals", noop).read(normals, ResourceUsage::sampled()).write(debugView, ResourceUsage::colorAttachment());
+		graph.addPass("DebugOverdraw", noop).read(depth, ResourceUsage::sampled(FRAGMENT)).write(debugView, ResourceUsage::colorAttachment());
+		graph.addPass("BloomDown", noop).read(hdr, ResourceUsage::sampled(COMPUTE)).write(bloom[0], ResourceUsage::storageWrite(COMPUTE));
+		for (uint32_t level = 1; level < BLOOM_LEVELS; ++level)
+			graph.addPass("BloomDown", noop).read(bloom[level - 1], ResourceUsage::sampled(COMPUTE)).write(bloom[level], ResourceUsage::storageWrite(COMPUTE));
+		for (uint32_t level = BLOOM_LEVELS - 1; level > 0; --level)
+			graph.addPass("BloomUp", noop).read(bloom[level], ResourceUsage::sampled(COMPUTE)).write(bloom[level - 1], ResourceUsage::storageWrite(COMPUTE));
+		graph.addPass("Tonemap", noop).read(hdr, ResourceUsage::sampled()).read(bloom[0], ResourceUsage::sampled()).write(backbuffer, ResourceUsage::colorAttachment());
+		graph.addPass("UI", noop).write(backbuffer, ResourceUsage::colorAttachment());
+		graph.exportResource(backbuffer, ResourceUsage::present());
+		graph.compile(requirements);
+	};
+
+	build();
+	const int ITERATIONS = 1000;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int it = 0; it < ITERATIONS; ++it) build();
+	const double compileUs = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count() / ITERATIONS;
+
+	PV_ASSERT(graph.stats.culledPasses == 2, "benchmarkRenderGraph: expected both debug passes to be culled");
+	out << "Render graph benchmark: build + compile " << compileUs << " us" << std::endl;
+	graph.printPlan(out);
+}
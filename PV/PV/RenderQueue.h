@@ -0,0 +1,312 @@
+#pragma once
+
+/*
+	Include dependencies: Vulkan, Macros.h, CpuProfiler.h
+*/
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <ostream>
+#include <cstring>
+#include <stdint.h>
+
+
+// Draws for one pass, sorted by state so binds are only issued when something changes.
+// Pipelines, materials (descriptor sets) and meshes are registered once and get small ids,
+// a draw is then just a 64 bit key built from them plus the caller's instance index:
+//
+//	63          52 51              36 35              20 19          0
+//	|  pipeline   |    material      |      mesh        |    depth    |
+//
+// so sorting by key groups draws by the most expensive state change first and front to back
+// inside every group. build() sorts (LSD radix, stable) and merges runs of equal state into
+// instanced draws, record() binds what changed and draws.
+struct RenderQueue
+{
+	static const uint32_t DEPTH_BITS = 20;
+	static const uint32_t MESH_BITS = 16;
+	static const uint32_t MATERIAL_BITS = 16;
+	static const uint32_t PIPELINE_BITS = 12;
+	static const uint32_t STATE_SHIFT = DEPTH_BITS; // key >> STATE_SHIFT: everything but depth
+
+	struct Pipeline
+	{
+		VkPipeline pipeline;
+		VkPipelineLayout layout;
+	};
+	struct Mesh
+	{
+		VkBuffer vertexBuffer;		// binding 0
+		VkDeviceSize vertexOffset;
+		VkBuffer indexBuffer;
+		VkIndexType indexType;
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		int32_t baseVertex;
+	};
+	struct Draw
+	{
+		uint64_t key;
+		uint32_t instance;	// the caller's, ends up in instances
+	};
+	// one vkCmdDrawIndexed and what has to be bound before it
+	struct Batch
+	{
+		uint32_t pipeline, material, mesh;
+		uint32_t firstInstance;		// into instances
+		uint32_t instanceCount;
+		bool bindPipeline, bindMaterial, bindVertexBuffer, bindIndexBuffer;
+	};
+	struct Stats
+	{
+		uint32_t draws = 0;
+		uint32_t batches = 0;
+		uint32_t naiveBinds = 0;	// pipeline, descriptor set, vertex and index buffer for every draw
+		uint32_t binds = 0;			// what record() issues
+		double sortNs = 0.0;
+	};
+
+	std::vector<Pipeline> pipelines;
+	std::vector<VkDescriptorSet> materials;
+	std::vector<Mesh> meshes;
+
+	std::vector<Draw> draws;
+	std::vector<Batch> batches;		// build() output
+	std::vector<uint32_t> instances;	// draw instance indices in batch order, what the instance buffer has to hold
+	Stats stats;
+
+	uint32_t addPipeline(VkPipeline pipeline, VkPipelineLayout layout)
+	{
+		PV_ASSERT(pipelines.size() < (1u << PIPELINE_BITS), "RenderQueue: out of pipeline ids");
+		pipelines.push_back(Pipeline{ pipeline, layout });
+		return static_cast<uint32_t>(pipelines.size() - 1);
+	}
+	uint32_t addMaterial(VkDescriptorSet descriptorSet)
+	{
+		PV_ASSERT(materials.size() < (1u << MATERIAL_BITS), "RenderQueue: out of material ids");
+		materials.push_back(descriptorSet);
+		return static_cast<uint32_t>(materials.size() - 1);
+	}
+	uint32_t addMesh(const Mesh& mesh)
+	{
+		PV_ASSERT(meshes.size() < (1u << MESH_BITS), "RenderQueue: out of mesh ids");
+		meshes.push_back(mesh);
+		return static_cast<uint32_t>(meshes.size() - 1);
+	}
+
+	// depth in [0, 1], 0 first
+	static uint64_t makeKey(uint32_t pipeline, uint32_t material, uint32_t mesh, float depth)
+	{
+		const float clamped = std::min(std::max(depth, 0.0f), 1.0f);
+		const uint64_t depthBucket = static_cast<uint64_t>(clamped * ((1u << DEPTH_BITS) - 1));
+		return (static_cast<uint64_t>(pipeline) << (DEPTH_BITS + MESH_BITS + MATERIAL_BITS))
+			| (static_cast<uint64_t>(material) << (DEPTH_BITS + MESH_BITS))
+			| (static_cast<uint64_t>(mesh) << DEPTH_BITS)
+			| depthBucket;
+	}
+	static uint32_t keyPipeline(uint64_t key) { return static_cast<uint32_t>(key >> (DEPTH_BITS + MESH_BITS + MATERIAL_BITS)); }
+	static uint32_t keyMaterial(uint64_t key) { return static_cast<uint32_t>(key >> (DEPTH_BITS + MESH_BITS)) & ((1u << MATERIAL_BITS) - 1); }
+	static uint32_t keyMesh(uint64_t key) { return static_cast<uint32_t>(key >> DEPTH_BITS) & ((1u << MESH_BITS) - 1); }
+
+	void clear()
+	{
+		draws.clear();
+		batches.clear();
+		instances.clear();
+	}
+
+	void submit(uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t instance, float depth)
+	{
+		draws.push_back(Draw{ makeKey(pipeline, material, mesh, depth), instance });
+	}
+
+	// Sorts the draws and turns them into batches. With mergeInstances, consecutive draws with the
+	// same pipeline, material and mesh become one instanced draw; otherwise every draw stays its own.
+	void build(bool mergeInstances = true)
+	{
+		PV_PROFILE_FUNCTION();
+		auto start = std::chrono::high_resolution_clock::now();
+		radixSort(draws, scratch);
+		stats = Stats();
+		stats.sortNs = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+
+		batches.clear();
+		instances.resize(draws.size());
+		const Batch* previous = nullptr;
+		for (size_t i = 0; i < draws.size(); ++i)
+		{
+			const uint64_t state = draws[i].key >> STATE_SHIFT;
+			instances[i] = draws[i].instance;
+			if (mergeInstances && !batches.empty() && (draws[i - 1].key >> STATE_SHIFT) == state)
+			{
+				++batches.back().instanceCount;
+				continue;
+			}
+
+			Batch batch;
+			batch.pipeline = keyPipeline(draws[i].key);
+			batch.material = keyMaterial(draws[i].key);
+			batch.mesh = keyMesh(draws[i].key);
+			batch.firstInstance = static_cast<uint32_t>(i);
+			batch.instanceCount = 1;
+
+			// the set stays bound across pipelines as long as the layout is the same
+			const Mesh& mesh = meshes[batch.mesh];
+			batch.bindPipeline = previous == nullptr || previous->pipeline != batch.pipeline;
+			batch.bindMaterial = previous == nullptr || previous->material != batch.material
+				|| pipelines[previous->pipeline].layout != pipelines[batch.pipeline].layout;
+			batch.bindVertexBuffer = previous == nullptr || meshes[previous->mesh].vertexBuffer != mesh.vertexBuffer
+				|| meshes[previous->mesh].vertexOffset != mesh.vertexOffset;
+			batch.bindIndexBuffer = previous == nullptr || meshes[previous->mesh].indexBuffer != mesh.indexBuffer
+				|| meshes[previous->mesh].indexType != mesh.indexType;
+			stats.binds += batch.bindPipeline + batch.bindMaterial + batch.bindVertexBuffer + batch.bindIndexBuffer;
+
+			batches.push_back(batch);
+			previous = &batches.back();
+		}
+		stats.draws = static_cast<uint32_t>(draws.size());
+		stats.batches = static_cast<uint32_t>(batches.size());
+		stats.naiveBinds = 4 * stats.draws;
+	}
+
+	// Binds and draws every batch. Instance vertex buffers (bindings above 0) are the caller's,
+	// laid out in instances order. firstInstanceBase is added to every batch's first instance.
+	void record(VkCommandBuffer commandBuffer, uint32_t firstInstanceBase = 0) const
+	{
+		for (const Batch& batch : batches)
+		{
+			const Pipeline& pipeline = pipelines[batch.pipeline];
+			const Mesh& mesh = meshes[batch.mesh];
+			if (batch.bindPipeline)
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+			if (batch.bindMaterial)
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 0, 1, &materials[batch.material], 0, nullptr);
+			if (batch.bindVertexBuffer)
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, &mesh.vertexBuffer, &mesh.vertexOffset);
+			if (batch.bindIndexBuffer)
+				vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer, 0, mesh.indexType);
+			vkCmdDrawIndexed(commandBuffer, mesh.indexCount, batch.instanceCount, mesh.firstIndex, mesh.baseVertex, firstInstanceBase + batch.firstInstance);
+		}
+	}
+
+	// LSD radix sort on the keys, 8 bits per pass. All histograms come from one read of the keys,
+	// passes where every key has the same byte are skipped. Stable, so equal keys keep submit order.
+	static void radixSort(std::vector<Draw>& values, std::vector<Draw>& temp)
+	{
+		const size_t count = values.size();
+		if (count < 2) return;
+		temp.resize(count);
+
+		uint32_t histograms[8][256];
+		std::memset(histograms, 0, sizeof(histograms));
+		for (const Draw& draw : values)
+		{
+			for (uint32_t pass = 0; pass < 8; ++pass)
+			{
+				++histograms[pass][(draw.key >> (pass * 8)) & 0xFF];
+			}
+		}
+
+		Draw* from = values.data();
+		Draw* to = temp.data();
+		for (uint32_t pass = 0; pass < 8; ++pass)
+		{
+			uint32_t* histogram = histograms[pass];
+			const uint32_t shift = pass * 8;
+			if (histogram[(from[0].key >> shift) & 0xFF] == count) continue;
+
+			uint32_t offset = 0;
+			for (uint32_t digit = 0; digit < 256; ++digit)
+			{
+				uint32_t digitCount = histogram[digit];
+				histogram[digit] = offset;
+				offset += digitCount;
+			}
+			for (size_t i = 0; i < count; ++i)
+			{
+				to[histogram[(from[i].key >> shift) & 0xFF]++] = from[i];
+			}
+			std::swap(from, to);
+		}
+		if (from != values.data())
+			std::memcpy(values.data(), from, count * sizeof(Draw));
+	}
+
+private:
+	std::vector<Draw> scratch;
+};
+
+
+// 100k draws over 16 pipelines, 512 materials and 64 meshes in 4 vertex buffers, submitted in random
+// order. Prints sort ns/draw (radix against std::stable_sort), batches and the binds record() saves.
+inline void benchmarkRenderQueue(std::ostream& out, uint32_t drawCount = 100000)
+{
+	RenderQueue queue;
+	// fake handles, the benchmark never records
+	auto handle = [](uint64_t value) { return value; };
+	for (uint32_t p = 0; p < 16; ++p)
+	{
+		// 4 layouts shared by 4 pipelines each
+		queue.addPipeline(reinterpret_cast<VkPipeline>(handle(0x1000 + p)), reinterpret_cast<VkPipelineLayout>(handle(0x2000 + p / 4)));
+	}
+	for (uint32_t m = 0; m < 512; ++m)
+	{
+		queue.addMaterial(reinterpret_cast<VkDescriptorSet>(handle(0x3000 + m)));
+	}
+	for (uint32_t m = 0; m < 64; ++m)
+	{
+		RenderQueue::Mesh mesh = {};
+		mesh.vertexBuffer = reinterpret_cast<VkBuffer>(handle(0x4000 + m / 16));
+		mesh.indexBuffer = reinterpret_cast<VkBuffer>(handle(0x5000 + m / 16));
+		mesh.indexType = VK_INDEX_TYPE_UINT32;
+		mesh.indexCount = 3 * 64;
+		mesh.firstIndex = (m % 16) * 3 * 64;
+		queue.addMesh(mesh);
+	}
+
+	// every material belongs to one pipeline, objects reuse a few hundred material/mesh pairs
+	std::mt19937 rng(99);
+	std::uniform_int_distribution<uint32_t> object(0, 299);
+	std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+	struct Kind { uint32_t pipeline, material, mesh; };
+	std::vector<Kind> kinds(300);
+	for (Kind& kind : kinds)
+	{
+		kind.material = rng() % 512;
+		kind.pipeline = kind.material % 16;
+		kind.mesh = rng() % 64;
+	}
+	for (uint32_t i = 0; i < drawCount; ++i)
+	{
+		const Kind& kind = kinds[object(rng)];
+		queue.submit(kind.pipeline, kind.material, kind.mesh, i, depth(rng));
+	}
+
+	std::vector<RenderQueue::Draw> reference = queue.draws;
+	auto start = std::chrono::high_resolution_clock::now();
+	std::stable_sort(reference.begin(), reference.end(), [](const RenderQueue::Draw& a, const RenderQueue::Draw& b) { return a.key < b.key; });
+	const double stableSortNs = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+
+	// warm up, then the measured one
+	std::vector<RenderQueue::Draw> submitted = queue.draws;
+	queue.build();
+	queue.draws = submitted;
+	queue.build();
+	for (uint32_t i = 0; i < drawCount; ++i)
+	{
+		PV_ASSERT(queue.draws[i].key == reference[i].key && queue.draws[i].instance == reference[i].instance,
+			"benchmarkRenderQueue: radix sort disagrees with std::stable_sort");
+	}
+	const RenderQueue::Stats merged = queue.stats;
+	queue.draws = submitted;
+	queue.build(false);
+	const RenderQueue::Stats unmerged = queue.stats;
+
+	out << "Render queue benchmark: " << drawCount << " draws" << std::endl;
+	out << "\tsort: radix " << merged.sortNs / drawCount << " ns/draw, std::stable_sort " << stableSortNs / drawCount << " ns/draw" << std::endl;
+	out << "\tinstanced: " << merged.batches << " batches, " << merged.binds << " binds instead of " << merged.naiveBinds
+		<< " (" << 100.0 * (merged.naiveBinds - merged.binds) / merged.naiveBinds << "% saved)" << std::endl;
+	out << "\tunmerged:  " << unmerged.batches << " batches, " << unmerged.binds << " binds instead of " << unmerged.naiveBinds
+		<< " (" << 100.0 * (unmerged.naiveBinds - unmerged.binds) / unmerged.naiveBinds << "% saved)" << std::endl;
+}
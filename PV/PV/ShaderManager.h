@@ -0,0 +1,361 @@
+#pragma once
+
+/*
+	Include dependencies: Macros.h, Misc.hpp, CpuProfiler.h
+*/
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <memory>
+#include <stdint.h>
+
+// Runtime GLSL -> SPIR-V compilation through shaderc (shaderc_shared.lib from the Vulkan SDK).
+// With it disabled we fall back to the .spv files SPV/compileShaders.bat produces.
+#ifndef PV_SHADERC_ENABLED
+#define PV_SHADERC_ENABLED 1
+#endif
+
+#if PV_SHADERC_ENABLED
+#include <shaderc/shaderc.hpp>
+#endif
+
+
+enum ShaderStage
+{
+	SHADER_STAGE_VERTEX,
+	SHADER_STAGE_FRAGMENT,
+	SHADER_STAGE_COMPUTE,
+};
+
+struct ShaderCompileOptions
+{
+	// #define NAME VALUE for every entry
+	std::vector<std::pair<std::string, std::string>> defines;
+	bool optimize = true;
+	bool debugInfo = false;
+};
+
+
+// Compiles shaders at runtime and keeps the SPIR-V around in a cache keyed by a hash of
+// everything that goes into the compile: the source, every file it #includes, the stage,
+// the defines and the options. A warm start never invokes the compiler, and editing one
+// stage only misses the cache for that stage.
+//
+// Entries live in memory for the lifetime of the manager and on disk so they survive restarts.
+// On disk there is one blob per shader file, stage, defines and options, named
+// <spvDir>/<shader file>.<variant hash>.spv: the hash of the inputs it was compiled from, then
+// the SPIR-V. An edit rewrites the variant's blob instead of adding one, so SPV/ stays bounded.
+struct ShaderManager
+{
+	uint32_t cacheHits = 0;
+	uint32_t cacheMisses = 0;
+
+	void init(const std::string& shaderDirectory, const std::string& spvDirectory)
+	{
+		shaderDir = shaderDirectory;
+		spvDir = spvDirectory;
+	}
+
+	// returns SPIR-V words as bytes, ready for createShaderModule
+	std::vector<char> getSpirv(const std::string& fileName, ShaderStage stage, const ShaderCompileOptions& options = ShaderCompileOptions())
+	{
+		PV_PROFILE_FUNCTION();
+
+		const std::string sourcePath = shaderDir + fileName;
+		std::string source;
+		PV_ASSERT(readTextFile(sourcePath, source), "ShaderManager: failed to open shader source " + sourcePath);
+
+		const uint64_t variant = hashVariant(fileName, stage, options);
+		const uint64_t key = hashCompileInputs(variant, fileName, source);
+
+		// memory
+		auto found = memoryCache.find(key);
+		if (found != memoryCache.end())
+		{
+			++cacheHits;
+			return found->second;
+		}
+
+		// disk
+		const std::string cachePath = spvDir + fileName + "." + toHex(variant) + ".spv";
+		std::vector<char> spirv;
+		if (readCachedSpirv(cachePath, key, spirv))
+		{
+			++cacheHits;
+			memoryCache.emplace(key, spirv);
+			return spirv;
+		}
+
+		// compile
+		++cacheMisses;
+		spirv = compile(sourcePath, source, stage, options);
+
+#if PV_SHADERC_ENABLED
+		// the fallback's .spv may be older than the source, never put that under the source's key on disk
+		std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+		if (file.is_open())
+		{
+			file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+			file.write(spirv.data(), spirv.size());
+		}
+#endif
+		memoryCache.emplace(key, spirv);
+		return spirv;
+	}
+
+	void printStats(std::ostream& out) const
+	{
+		out << "Shader cache: " << cacheHits << " hits, " << cacheMisses << " compiles" << std::endl;
+	}
+
+private:
+	std::string shaderDir;
+	std::string spvDir;
+	std::unordered_map<uint64_t, std::vector<char>> memoryCache;
+
+	// bump when the compiler or the way we call it changes, invalidates every cached blob
+	static const uint64_t CACHE_VERSION = 2;
+
+	static bool readTextFile(const std::string& path, std::string& out)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open())
+			return false;
+		std::stringstream buffer;
+		buffer << file.rdbuf();
+		out = buffer.str();
+		return true;
+	}
+
+	// a hit only if the blob was compiled from exactly these inputs, else it is stale and gets rewritten
+	static bool readCachedSpirv(const std::string& path, uint64_t key, std::vector<char>& out)
+	{
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (!file.is_open())
+			return false;
+
+		size_t size = static_cast<size_t>(file.tellg());
+		// the key, then at least the SPIR-V header (5 words) starting with the magic number
+		if (size < sizeof(key) + 20 || (size - sizeof(key)) % 4 != 0)
+			return false;
+
+		uint64_t storedKey = 0;
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(&storedKey), sizeof(storedKey));
+		if (storedKey != key)
+			return false;
+		out.resize(size - sizeof(key));
+		file.read(out.data(), out.size());
+
+		uint32_t magic;
+		std::memcpy(&magic, out.data(), sizeof(magic));
+		return magic == 0x07230203;
+	}
+
+	static std::string directoryOf(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+	}
+
+	static std::string toHex(uint64_t value)
+	{
+		static const char digits[] = "0123456789abcdef";
+		std::string hex(16, '0');
+		for (int i = 15; i >= 0; --i, value >>= 4)
+			hex[i] = digits[value & 0xF];
+		return hex;
+	}
+
+	// FNV-1a, 64 bit
+	static uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ULL;
+		}
+		return hash;
+	}
+	static uint64_t hashString(uint64_t hash, const std::string& str)
+	{
+		uint64_t length = str.size();
+		hash = hashBytes(hash, &length, sizeof(length));
+		return hashBytes(hash, str.data(), str.size());
+	}
+
+	// Every file pulled in by #include "..." / #include <...>, recursively, in the order found.
+	// This is textual, so an include inside an #if that is off still counts. That can only
+	// cause an unneeded recompile, never a stale cache hit.
+	void gatherIncludes(const std::string& source, const std::string& sourceDir, std::vector<std::string>& includePaths, int depth) const
+	{
+		if (depth > 32) return;
+
+		std::istringstream lines(source);
+		std::string line;
+		while (std::getline(lines, line))
+		{
+			size_t pos = line.find_first_not_of(" \t");
+			if (pos == std::string::npos || line.compare(pos, 8, "#include") != 0)
+				continue;
+
+			size_t open = line.find_first_of("\"<", pos + 8);
+			if (open == std::string::npos) continue;
+			size_t close = line.find_first_of("\">", open + 1);
+			if (close == std::string::npos) continue;
+
+			std::string includePath = resolveInclude(line.substr(open + 1, close - open - 1), sourceDir);
+			if (std::find(includePaths.begin(), includePaths.end(), includePath) != includePaths.end())
+				continue;
+			includePaths.push_back(includePath);
+
+			std::string includeSource;
+			if (readTextFile(includePath, includeSource))
+				gatherIncludes(includeSource, directoryOf(includePath), includePaths, depth + 1);
+		}
+	}
+
+	// relative to the including file first, then the shader directory
+	std::string resolveInclude(const std::string& requested, const std::string& requestingDir) const
+	{
+		std::string relative = requestingDir + requested;
+		if (std::ifstream(relative).good())
+			return relative;
+		return shaderDir + requested;
+	}
+
+	// names the blob on disk: the shader file, stage, defines and options, but not the sources
+	static uint64_t hashVariant(const std::string& fileName, ShaderStage stage, const ShaderCompileOptions& options)
+	{
+		uint64_t hash = 0xcbf29ce484222325ULL;
+		uint32_t stageValue = static_cast<uint32_t>(stage);
+		uint32_t flags = (options.optimize ? 1u : 0u) | (options.debugInfo ? 2u : 0u) | (PV_SHADERC_ENABLED ? 4u : 0u);
+
+		hash = hashBytes(hash, &stageValue, sizeof(stageValue));
+		hash = hashBytes(hash, &flags, sizeof(flags));
+		hash = hashString(hash, fileName);
+
+		// order of defines doesn't change the result, so it shouldn't change the key
+		std::vector<std::pair<std::string, std::string>> defines = options.defines;
+		std::sort(defines.begin(), defines.end());
+		for (const auto& define : defines)
+		{
+			hash = hashString(hash, define.first);
+			hash = hashString(hash, define.second);
+		}
+		return hash;
+	}
+
+	// the cache key: the variant and everything compiled into it, the source and every file it includes
+	uint64_t hashCompileInputs(uint64_t variant, const std::string& fileName, const std::string& source) const
+	{
+		uint64_t hash = 0xcbf29ce484222325ULL;
+		uint64_t version = CACHE_VERSION;
+
+		hash = hashBytes(hash, &version, sizeof(version));
+		hash = hashBytes(hash, &variant, sizeof(variant));
+		hash = hashString(hash, source);
+
+		std::vector<std::string> includePaths;
+		gatherIncludes(source, directoryOf(shaderDir + fileName), includePaths, 0);
+		for (const auto& includePath : includePaths)
+		{
+			std::string includeSource;
+			readTextFile(includePath, includeSource);
+			hash = hashString(hash, includePath);
+			hash = hashString(hash, includeSource);
+		}
+		return hash;
+	}
+
+#if PV_SHADERC_ENABLED
+	// resolves #include for shaderc the same way gatherIncludes does for the cache key
+	struct Includer : public shaderc::CompileOptions::IncluderInterface
+	{
+		struct Result
+		{
+			shaderc_include_result result;
+			std::string name;
+			std::string content;
+		};
+
+		const ShaderManager* manager;
+		explicit Includer(const ShaderManager* owner) : manager(owner) { }
+
+		shaderc_include_result* GetInclude(const char* requestedSource, shaderc_include_type type, const char* requestingSource, size_t /*includeDepth*/) override
+		{
+			Result* res = new Result();
+			res->name = manager->resolveInclude(requestedSource, type == shaderc_include_type_relative ? directoryOf(requestingSource) : std::string());
+			if (!readTextFile(res->name, res->content))
+			{
+				// failed include: empty name, the content is the error message
+				res->content = "failed to open include " + res->name;
+				res->name.clear();
+			}
+
+			res->result.source_name = res->name.c_str();
+			res->result.source_name_length = res->name.size();
+			res->result.content = res->content.c_str();
+			res->result.content_length = res->content.size();
+			res->result.user_data = res;
+			return &res->result;
+		}
+
+		void ReleaseInclude(shaderc_include_result* data) override
+		{
+			delete static_cast<Result*>(data->user_data);
+		}
+	};
+
+	std::vector<char> compile(const std::string& sourcePath, const std::string& source, ShaderStage stage, const ShaderCompileOptions& options) const
+	{
+		PV_PROFILE_SCOPE("ShaderCompile");
+
+		shaderc_shader_kind kind = shaderc_glsl_vertex_shader;
+		switch (stage)
+		{
+		case SHADER_STAGE_VERTEX:	kind = shaderc_glsl_vertex_shader; break;
+		case SHADER_STAGE_FRAGMENT: kind = shaderc_glsl_fragment_shader; break;
+		case SHADER_STAGE_COMPUTE:	kind = shaderc_glsl_compute_shader; break;
+		}
+
+		shaderc::CompileOptions compileOptions;
+		for (const auto& define : options.defines)
+		{
+			compileOptions.AddMacroDefinition(define.first, define.second);
+		}
+		compileOptions.SetOptimizationLevel(options.optimize ? shaderc_optimization_level_size : shaderc_optimization_level_zero);
+		if (options.debugInfo)
+		{
+			compileOptions.SetGenerateDebugInfo();
+		}
+		compileOptions.SetIncluder(std::unique_ptr<shaderc::CompileOptions::IncluderInterface>(new Includer(this)));
+
+		shaderc::Compiler compiler;
+		shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source, kind, sourcePath.c_str(), compileOptions);
+
+		PV_ASSERT(result.GetCompilationStatus() == shaderc_compilation_status_success,
+			"ShaderManager: failed to compile " + sourcePath + "\n" + result.GetErrorMessage());
+
+		const uint32_t* begin = result.cbegin();
+		const size_t byteCount = (result.cend() - begin) * sizeof(uint32_t);
+		std::vector<char> spirv(byteCount);
+		std::memcpy(spirv.data(), begin, byteCount);
+		return spirv;
+	}
+#else
+	// No compiler, use what SPV/compileShaders.bat built. glslangValidator -V names its output after the stage.
+	std::vector<char> compile(const std::string& /*sourcePath*/, const std::string&, ShaderStage stage, const ShaderCompileOptions& options) const
+	{
+		PV_ASSERT(options.defines.empty(), "ShaderManager: defines need runtime compilation, build with PV_SHADERC_ENABLED");
+
+		const char* stageNames[] = { "vert", "frag", "comp" };
+		return readBinaryFile(spvDir + stageNames[stage] + ".spv");
+	}
+#endif
+};
@@ -0,0 +1,556 @@
+#pragma once
+
+/*
+	Include dependencies: Vulkan, Macros.h
+*/
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <initializer_list>
+#include <algorithm>
+#include <mutex>
+#include <ostream>
+#include <cstring>
+#include <stdint.h>
+
+#include <vulkan/spirv.hpp>
+
+
+struct ReflectedBinding
+{
+	uint32_t set;
+	uint32_t binding;
+	VkDescriptorType type;
+	uint32_t count;
+	VkShaderStageFlags stages;
+	std::string name;
+};
+
+struct ReflectedVertexInput
+{
+	uint32_t location;
+	VkFormat format;
+	std::string name;
+};
+
+// What one shader stage expects from the pipeline layout and vertex input state
+struct ShaderReflection
+{
+	VkShaderStageFlagBits stage = VK_SHADER_STAGE_ALL;
+	std::vector<ReflectedBinding> bindings;
+	std::vector<VkPushConstantRange> pushConstants;
+	std::vector<ReflectedVertexInput> inputs;	// vertex stage only, sorted by location
+};
+
+
+// Walks the SPIR-V instruction stream once and pulls out every resource variable.
+// Only the parts of the spec needed for layouts are understood, anything else is skipped.
+inline ShaderReflection reflectSpirv(const std::vector<char>& spirv)
+{
+	PV_ASSERT(spirv.size() >= 5 * sizeof(uint32_t) && spirv.size() % sizeof(uint32_t) == 0, "reflectSpirv: not a SPIR-V module");
+
+	std::vector<uint32_t> words(spirv.size() / sizeof(uint32_t));
+	std::memcpy(words.data(), spirv.data(), spirv.size());
+	PV_ASSERT(words[0] == spv::MagicNumber, "reflectSpirv: bad SPIR-V magic number");
+
+	// everything we may need to know about a single result id
+	struct Id
+	{
+		uint32_t opcode = 0;
+		uint32_t typeId = 0;		// pointee / element / component / column type
+		uint32_t storageClass = 0;
+		uint32_t width = 0;			// int, float
+		uint32_t count = 0;			// vector components, matrix columns, array length id
+		bool isSigned = false;
+		uint32_t imageDim = 0;
+		uint32_t imageSampled = 0;
+		uint32_t constant = 0;		// OpConstant value (low word)
+
+		uint32_t set = 0;
+		uint32_t binding = ~0u;
+		uint32_t location = ~0u;
+		uint32_t arrayStride = 0;
+		bool builtIn = false;
+		bool block = false;
+		bool bufferBlock = false;
+		std::string name;
+
+		std::vector<uint32_t> members;
+		std::vector<uint32_t> memberOffsets;
+		std::vector<uint32_t> memberMatrixStrides;
+	};
+
+	const uint32_t bound = words[3];
+	std::vector<Id> ids(bound);
+	std::vector<uint32_t> variables;
+	ShaderReflection reflection;
+
+	auto readString = [&](size_t wordIndex, size_t end)
+	{
+		const char* str = reinterpret_cast<const char*>(&words[wordIndex]);
+		return std::string(str, strnlen(str, (end - wordIndex) * sizeof(uint32_t)));
+	};
+	auto memberSlot = [](std::vector<uint32_t>& values, uint32_t member) -> uint32_t&
+	{
+		if (values.size() <= member) values.resize(member + 1, 0);
+		return values[member];
+	};
+
+	size_t i = 5;
+	while (i < words.size())
+	{
+		const uint32_t opcode = words[i] & 0xFFFF;
+		const uint32_t wordCount = words[i] >> 16;
+		PV_ASSERT(wordCount > 0 && i + wordCount <= words.size(), "reflectSpirv: truncated instruction");
+		const uint32_t* op = &words[i];
+		const size_t end = i + wordCount;
+
+		switch (opcode)
+		{
+		case spv::OpEntryPoint:
+			if (reflection.stage == VK_SHADER_STAGE_ALL)
+			{
+				switch (op[1])
+				{
+				case spv::ExecutionModelVertex:		reflection.stage = VK_SHADER_STAGE_VERTEX_BIT; break;
+				case spv::ExecutionModelFragment:	reflection.stage = VK_SHADER_STAGE_FRAGMENT_BIT; break;
+				case spv::ExecutionModelGLCompute:	reflection.stage = VK_SHADER_STAGE_COMPUTE_BIT; break;
+				case spv::ExecutionModelGeometry:	reflection.stage = VK_SHADER_STAGE_GEOMETRY_BIT; break;
+				case spv::ExecutionModelTessellationControl:	reflection.stage = VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT; break;
+				case spv::ExecutionModelTessellationEvaluation:	reflection.stage = VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT; break;
+				}
+			}
+			break;
+		case spv::OpName:
+			ids[op[1]].name = readString(i + 2, end);
+			break;
+		case spv::OpDecorate:
+		{
+			Id& target = ids[op[1]];
+			switch (op[2])
+			{
+			case spv::DecorationDescriptorSet:	target.set = op[3]; break;
+			case spv::DecorationBinding:		target.binding = op[3]; break;
+			case spv::DecorationLocation:		target.location = op[3]; break;
+			case spv::DecorationArrayStride:	target.arrayStride = op[3]; break;
+			case spv::DecorationBuiltIn:		target.builtIn = true; break;
+			case spv::DecorationBlock:			target.block = true; break;
+			case spv::DecorationBufferBlock:	target.bufferBlock = true; break;
+			}
+			break;
+		}
+		case spv::OpMemberDecorate:
+		{
+			Id& target = ids[op[1]];
+			switch (op[3])
+			{
+			case spv::DecorationOffset:			memberSlot(target.memberOffsets, op[2]) = op[4]; break;
+			case spv::DecorationMatrixStride:	memberSlot(target.memberMatrixStrides, op[2]) = op[4]; break;
+			case spv::DecorationBuiltIn:		target.builtIn = true; break; // gl_PerVertex
+			}
+			break;
+		}
+		case spv::OpTypeBool:
+		case spv::OpTypeSampler:
+			ids[op[1]].opcode = opcode;
+			break;
+		case spv::OpTypeInt:
+			ids[op[1]].opcode = opcode;
+			ids[op[1]].width = op[2];
+			ids[op[1]].isSigned = op[3] != 0;
+			break;
+		case spv::OpTypeFloat:
+			ids[op[1]].opcode = opcode;
+			ids[op[1]].width = op[2];
+			break;
+		case spv::OpTypeVector:
+		case spv::OpTypeMatrix:
+		case spv::OpTypeArray:
+			ids[op[1]].opcode = opcode;
+			ids[op[1]].typeId = op[2];
+			ids[op[1]].count = op[3];
+			break;
+		case spv::OpTypeImage:
+			ids[op[1]].opcode = opcode;
+			ids[op[1]].imageDim = op[3];
+			ids[op[1]].imageSampled = op[7];
+			break;
+		case spv::OpTypeSampledImage:
+		case spv::OpTypeRuntimeArray:
+			ids[op[1]].opcode = opcode;
+			ids[op[1]].typeId = op[2];
+			break;
+		case spv::OpTypeStruct:
+			ids[op[1]].opcode = opcode;
+			ids[op[1]].members.assign(op + 2, op + wordCount);
+			break;
+		case spv::OpTypePointer:
+			ids[op[1]].opcode = opcode;
+			ids[op[1]].storageClass = op[2];
+			ids[op[1]].typeId = op[3];
+			break;
+		case spv::OpConstant:
+			ids[op[2]].opcode = opcode;
+			ids[op[2]].constant = op[3];
+			break;
+		case spv::OpVariable:
+			ids[op[2]].opcode = opcode;
+			ids[op[2]].typeId = op[1];
+			ids[op[2]].storageClass = op[3];
+			variables.push_back(op[2]);
+			break;
+		}
+		i = end;
+	}
+
+	// size in bytes as laid out in a block, uses the explicit strides/offsets the compiler emitted
+	std::function<uint32_t(uint32_t, uint32_t)> typeSize = [&](uint32_t typeId, uint32_t matrixStride) -> uint32_t
+	{
+		const Id& type = ids[typeId];
+		switch (type.opcode)
+		{
+		case spv::OpTypeBool:	return 4;
+		case spv::OpTypeInt:
+		case spv::OpTypeFloat:	return type.width / 8;
+		case spv::OpTypeVector:	return type.count * typeSize(type.typeId, 0);
+		case spv::OpTypeMatrix:	return type.count * (matrixStride ? matrixStride : typeSize(type.typeId, 0));
+		case spv::OpTypeArray:
+		{
+			uint32_t stride = type.arrayStride ? type.arrayStride : typeSize(type.typeId, matrixStride);
+			return ids[type.count].constant * stride;
+		}
+		case spv::OpTypeStruct:
+		{
+			uint32_t size = 0;
+			for (uint32_t m = 0; m < type.members.size(); ++m)
+			{
+				uint32_t offset = m < type.memberOffsets.size() ? type.memberOffsets[m] : 0;
+				uint32_t stride = m < type.memberMatrixStrides.size() ? type.memberMatrixStrides[m] : 0;
+				size = std::max(size, offset + typeSize(type.members[m], stride));
+			}
+			return size;
+		}
+		}
+		return 0;
+	};
+
+	for (uint32_t variableId : variables)
+	{
+		const Id& variable = ids[variableId];
+		uint32_t typeId = ids[variable.typeId].typeId; // variables are always pointers
+
+		switch (variable.storageClass)
+		{
+		case spv::StorageClassUniformConstant:
+		case spv::StorageClassUniform:
+		case spv::StorageClassStorageBuffer:
+		{
+			ReflectedBinding binding;
+			binding.set = variable.set;
+			binding.binding = variable.binding;
+			binding.count = 1;
+			binding.stages = reflection.stage;
+			binding.name = variable.name;
+
+			// arrays of resources take one descriptor per element
+			while (ids[typeId].opcode == spv::OpTypeArray || ids[typeId].opcode == spv::OpTypeRuntimeArray)
+			{
+				PV_ASSERT(ids[typeId].opcode == spv::OpTypeArray, "reflectSpirv: unsized descriptor arrays are not supported (" + variable.name + ")");
+				binding.count *= ids[ids[typeId].count].constant;
+				typeId = ids[typeId].typeId;
+			}
+
+			const Id& type = ids[typeId];
+			if (variable.storageClass == spv::StorageClassStorageBuffer || type.bufferBlock)
+			{
+				binding.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			}
+			else if (variable.storageClass == spv::StorageClassUniform)
+			{
+				binding.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			}
+			else if (type.opcode == spv::OpTypeSampler)
+			{
+				binding.type = VK_DESCRIPTOR_TYPE_SAMPLER;
+			}
+			else if (type.opcode == spv::OpTypeSampledImage)
+			{
+				binding.type = ids[type.typeId].imageDim == spv::DimBuffer ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			}
+			else if (type.opcode == spv::OpTypeImage)
+			{
+				const bool storage = type.imageSampled == 2;
+				if (type.imageDim == spv::DimSubpassData)
+					binding.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+				else if (type.imageDim == spv::DimBuffer)
+					binding.type = storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+				else
+					binding.type = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+			}
+			else
+			{
+				continue; // not a descriptor
+			}
+
+			PV_ASSERT(binding.binding != ~0u, "reflectSpirv: resource " + variable.name + " has no binding decoration");
+			reflection.bindings.push_back(binding);
+			break;
+		}
+		case spv::StorageClassPushConstant:
+		{
+			const Id& block = ids[typeId];
+			uint32_t begin = block.memberOffsets.empty() ? 0 : *std::min_element(block.memberOffsets.begin(), block.memberOffsets.end());
+
+			VkPushConstantRange range = {};
+			range.stageFlags = reflection.stage;
+			range.offset = begin;
+			range.size = typeSize(typeId, 0) - begin;
+			reflection.pushConstants.push_back(range);
+			break;
+		}
+		case spv::StorageClassInput:
+		{
+			if (reflection.stage != VK_SHADER_STAGE_VERTEX_BIT || variable.builtIn || ids[typeId].builtIn)
+				continue;
+
+			const Id* type = &ids[typeId];
+			uint32_t components = 1;
+			if (type->opcode == spv::OpTypeVector)
+			{
+				components = type->count;
+				type = &ids[type->typeId];
+			}
+			PV_ASSERT(type->width == 32 && (type->opcode == spv::OpTypeFloat || type->opcode == spv::OpTypeInt),
+				"reflectSpirv: vertex input " + variable.name + " must be a 32 bit scalar or vector");
+
+			static const VkFormat floatFormats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+			static const VkFormat intFormats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+			static const VkFormat uintFormats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+
+			ReflectedVertexInput input;
+			input.location = variable.location;
+			input.name = variable.name;
+			input.format = type->opcode == spv::OpTypeFloat ? floatFormats[components - 1] :
+				type->isSigned ? intFormats[components - 1] : uintFormats[components - 1];
+			reflection.inputs.push_back(input);
+			break;
+		}
+		}
+	}
+
+	std::sort(reflection.inputs.begin(), reflection.inputs.end(), [](const ReflectedVertexInput& a, const ReflectedVertexInput& b)
+	{
+		return a.location < b.location;
+	});
+	return reflection;
+}
+
+
+// Everything a VkPipelineLayout is made from. sets[n] holds the bindings of set n, sorted by binding.
+struct PipelineLayoutDesc
+{
+	std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets;
+	std::vector<VkPushConstantRange> pushConstants;
+};
+
+// Union of the stages of one pipeline. A binding used by several stages gets all their stage
+// flags, declaring the same binding with a different type in two stages is an error.
+inline PipelineLayoutDesc mergeShaderLayouts(std::initializer_list<const ShaderReflection*> stages)
+{
+	PipelineLayoutDesc desc;
+	for (const ShaderReflection* stage : stages)
+	{
+		for (const ReflectedBinding& binding : stage->bindings)
+		{
+			if (desc.sets.size() <= binding.set)
+				desc.sets.resize(binding.set + 1);
+			auto& set = desc.sets[binding.set];
+
+			auto found = std::find_if(set.begin(), set.end(), [&](const VkDescriptorSetLayoutBinding& b) { return b.binding == binding.binding; });
+			if (found != set.end())
+			{
+				PV_ASSERT(found->descriptorType == binding.type && found->descriptorCount == binding.count,
+					"mergeShaderLayouts: stages disagree on set " + std::to_string(binding.set) + " binding " + std::to_string(binding.binding));
+				found->stageFlags |= binding.stages;
+				continue;
+			}
+
+			VkDescriptorSetLayoutBinding layoutBinding = {};
+			layoutBinding.binding = binding.binding;
+			layoutBinding.descriptorType = binding.type;
+			layoutBinding.descriptorCount = binding.count;
+			layoutBinding.stageFlags = binding.stages;
+			layoutBinding.pImmutableSamplers = nullptr;
+			set.push_back(layoutBinding);
+		}
+
+		for (const VkPushConstantRange& range : stage->pushConstants)
+		{
+			auto found = std::find_if(desc.pushConstants.begin(), desc.pushConstants.end(), [&](const VkPushConstantRange& r)
+			{
+				return r.offset == range.offset && r.size == range.size;
+			});
+			if (found != desc.pushConstants.end())
+				found->stageFlags |= range.stageFlags;
+			else
+				desc.pushConstants.push_back(range);
+		}
+	}
+
+	for (auto& set : desc.sets)
+	{
+		std::sort(set.begin(), set.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b)
+		{
+			return a.binding < b.binding;
+		});
+	}
+	return desc;
+}
+
+// Checks the CPU side vertex layout against what the vertex shader reads.
+// Every shader input needs an attribute at its location with the same format.
+inline void validateVertexInput(const ShaderReflection& vertexStage, const VkVertexInputAttributeDescription* attributes, uint32_t attributeCount)
+{
+	for (const ReflectedVertexInput& input : vertexStage.inputs)
+	{
+		const VkVertexInputAttributeDescription* match = nullptr;
+		for (uint32_t a = 0; a < attributeCount; ++a)
+		{
+			if (attributes[a].location == input.location)
+				match = &attributes[a];
+		}
+		PV_ASSERT(match != nullptr, "validateVertexInput: nothing feeds vertex input " + input.name + " at location " + std::to_string(input.location));
+		PV_ASSERT(match->format == input.format, "validateVertexInput: format mismatch for vertex input " + input.name + " at location " + std::to_string(input.location));
+	}
+}
+
+
+// Owns VkDescriptorSetLayouts and VkPipelineLayouts, keyed by their content. Asking twice for
+// the same bindings hands back the same handle, so any number of shaders sharing a layout
+// create it once and their descriptor sets stay compatible.
+struct LayoutCache
+{
+	uint32_t hits = 0;
+	uint32_t misses = 0;
+
+	void init(VkDevice logicalDevice)
+	{
+		device = logicalDevice;
+	}
+
+	VkDescriptorSetLayout getDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+	{
+		std::vector<uint32_t> key;
+		for (const VkDescriptorSetLayoutBinding& b : bindings)
+		{
+			PV_ASSERT(b.pImmutableSamplers == nullptr, "LayoutCache: immutable samplers are not part of the key");
+			key.insert(key.end(), { b.binding, static_cast<uint32_t>(b.descriptorType), b.descriptorCount, b.stageFlags });
+		}
+
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		auto found = setLayouts.find(key);
+		if (found != setLayouts.end())
+		{
+			++hits;
+			return found->second;
+		}
+		++misses;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		VkDescriptorSetLayout layout;
+		PV_VK_RUN(vkCreateDescriptorSetLayout(device, &layoutInfo, allocnullptr, &layout));
+		setLayouts.emplace(key, layout);
+		return layout;
+	}
+
+	VkPipelineLayout getPipelineLayout(const PipelineLayoutDesc& desc)
+	{
+		// set layouts are deduplicated, so their handles stand in for their content
+		std::vector<VkDescriptorSetLayout> layouts;
+		for (const auto& set : desc.sets)
+		{
+			layouts.push_back(getDescriptorSetLayout(set));
+		}
+
+		std::vector<uint32_t> key;
+		for (VkDescriptorSetLayout layout : layouts)
+		{
+			uint64_t handle = reinterpret_cast<uint64_t>(layout);
+			key.insert(key.end(), { static_cast<uint32_t>(handle), static_cast<uint32_t>(handle >> 32) });
+		}
+		key.push_back(~0u); // separates the sets from the ranges
+		for (const VkPushConstantRange& range : desc.pushConstants)
+		{
+			key.insert(key.end(), { range.stageFlags, range.offset, range.size });
+		}
+
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		auto found = pipelineLayouts.find(key);
+		if (found != pipelineLayouts.end())
+		{
+			++hits;
+			return found->second;
+		}
+		++misses;
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
+		pipelineLayoutInfo.pSetLayouts = layouts.data();
+		pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(desc.pushConstants.size());
+		pipelineLayoutInfo.pPushConstantRanges = desc.pushConstants.data();
+
+		VkPipelineLayout layout;
+		PV_VK_RUN(vkCreatePipelineLayout(device, &pipelineLayoutInfo, allocnullptr, &layout));
+		pipelineLayouts.emplace(key, layout);
+		return layout;
+	}
+
+	void cleanup()
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		for (const auto& entry : pipelineLayouts)
+		{
+			vkDestroyPipelineLayout(device, entry.second, allocnullptr);
+		}
+		for (const auto& entry : setLayouts)
+		{
+			vkDestroyDescriptorSetLayout(device, entry.second, allocnullptr);
+		}
+		pipelineLayouts.clear();
+		setLayouts.clear();
+	}
+
+	void printStats(std::ostream& out)
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		out << "Layout cache: " << setLayouts.size() << " set layouts, " << pipelineLayouts.size() << " pipeline layouts, "
+			<< hits << " hits, " << misses << " misses" << std::endl;
+	}
+
+private:
+	// FNV-1a over the key words
+	struct KeyHasher
+	{
+		size_t operator()(const std::vector<uint32_t>& key) const
+		{
+			uint64_t hash = 0xcbf29ce484222325ULL;
+			for (uint32_t word : key)
+			{
+				hash ^= word;
+				hash *= 0x100000001b3ULL;
+			}
+			return static_cast<size_t>(hash);
+		}
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	std::mutex cacheMutex;
+	std::unordered_map<std::vector<uint32_t>, VkDescriptorSetLayout, KeyHasher> setLayouts;
+	std::unordered_map<std::vector<uint32_t>, VkPipelineLayout, KeyHasher> pipelineLayouts;
+};
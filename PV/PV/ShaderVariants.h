@@ -0,0 +1,230 @@
+#pragma once
+
+/*
+	Include dependencies: Vulkan, Macros.h, CpuProfiler.h, PipelineCache.h, JobSystem.h
+*/
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include <mutex>
+#include <chrono>
+#include <ostream>
+#include <stdint.h>
+
+
+// Feature toggles baked into the shaders as specialization constants. Turning one off lets
+// the driver strip the code behind it when the pipeline is built, without a second copy of
+// the GLSL or a recompile to SPIR-V.
+enum ShaderFeature : uint32_t
+{
+	SHADER_FEATURE_TEXTURE		= 1 << 0,
+	SHADER_FEATURE_VERTEX_COLOR	= 1 << 1,
+	SHADER_FEATURE_ALPHA_TEST	= 1 << 2,
+};
+
+struct ShaderFeatureInfo
+{
+	ShaderFeature feature;
+	uint32_t constantId;	// layout(constant_id = N) in shader.vert/shader.frag
+	const char* name;
+};
+
+static const ShaderFeatureInfo SHADER_FEATURES[] =
+{
+	{ SHADER_FEATURE_TEXTURE,		0, "TEXTURE" },
+	{ SHADER_FEATURE_VERTEX_COLOR,	1, "VERTEX_COLOR" },
+	{ SHADER_FEATURE_ALPHA_TEST,	2, "ALPHA_TEST" },
+};
+static const uint32_t SHADER_FEATURE_COUNT = sizeof(SHADER_FEATURES) / sizeof(SHADER_FEATURES[0]);
+
+
+// Identifies one pipeline variant: the set of enabled ShaderFeature bits
+struct ShaderVariantKey
+{
+	uint32_t features = 0;
+
+	ShaderVariantKey() = default;
+	ShaderVariantKey(uint32_t featureBits) : features(featureBits) { }
+
+	bool has(ShaderFeature feature) const { return (features & feature) != 0; }
+	bool operator==(const ShaderVariantKey& other) const { return features == other.features; }
+
+	// "TEXTURE|ALPHA_TEST", "NONE" without any features
+	std::string name() const
+	{
+		std::string result;
+		for (const ShaderFeatureInfo& info : SHADER_FEATURES)
+		{
+			if (!has(info.feature)) continue;
+			if (!result.empty()) result += "|";
+			result += info.name;
+		}
+		return result.empty() ? "NONE" : result;
+	}
+
+	struct Hasher
+	{
+		size_t operator()(const ShaderVariantKey& key) const
+		{
+			return std::hash<uint32_t>()(key.features);
+		}
+	};
+};
+
+// every combination of SHADER_FEATURES
+inline std::vector<ShaderVariantKey> allShaderVariants()
+{
+	std::vector<ShaderVariantKey> keys;
+	for (uint32_t bits = 0; bits < (1u << SHADER_FEATURE_COUNT); ++bits)
+	{
+		uint32_t features = 0;
+		for (uint32_t i = 0; i < SHADER_FEATURE_COUNT; ++i)
+		{
+			if (bits & (1u << i)) features |= SHADER_FEATURES[i].feature;
+		}
+		keys.push_back(ShaderVariantKey(features));
+	}
+	return keys;
+}
+
+
+// VkSpecializationInfo for one variant, one VkBool32 per feature.
+// Points into itself so it can't be copied, build it where it is used.
+struct ShaderSpecialization
+{
+	VkSpecializationMapEntry entries[SHADER_FEATURE_COUNT];
+	VkBool32 values[SHADER_FEATURE_COUNT];
+	VkSpecializationInfo info;
+
+	explicit ShaderSpecialization(ShaderVariantKey key)
+	{
+		for (uint32_t i = 0; i < SHADER_FEATURE_COUNT; ++i)
+		{
+			entries[i].constantID = SHADER_FEATURES[i].constantId;
+			entries[i].offset = i * sizeof(VkBool32);
+			entries[i].size = sizeof(VkBool32);
+			values[i] = key.has(SHADER_FEATURES[i].feature) ? VK_TRUE : VK_FALSE;
+		}
+		// entries the stage doesn't declare are ignored, so both stages can share this
+		info.mapEntryCount = SHADER_FEATURE_COUNT;
+		info.pMapEntries = entries;
+		info.dataSize = sizeof(values);
+		info.pData = values;
+	}
+
+	ShaderSpecialization(const ShaderSpecialization&) = delete;
+	ShaderSpecialization& operator=(const ShaderSpecialization&) = delete;
+};
+
+
+// Owns every pipeline variant built from one set of shader modules and fixed function state.
+// Variants are built on first use, or up front in parallel with precompile(). Either way a
+// key is only ever built once.
+struct PipelineVariantRegistry
+{
+	// builds the pipeline for one variant into the given cache
+	typedef std::function<VkPipeline(const VkSpecializationInfo* specialization, VkPipelineCache cache)> CreateFunc;
+
+	uint32_t lazyBuilds = 0;
+	uint32_t precompiledBuilds = 0;
+	double precompileMs = 0.0;
+
+	void init(VkDevice logicalDevice, PipelineCache* cache, CreateFunc createFunc)
+	{
+		device = logicalDevice;
+		pipelineCache = cache;
+		create = createFunc;
+	}
+
+	VkPipeline get(ShaderVariantKey key)
+	{
+		std::lock_guard<std::mutex> lock(pipelinesMutex);
+		auto found = pipelines.find(key);
+		if (found != pipelines.end())
+			return found->second;
+
+		PV_PROFILE_SCOPE("PipelineVariantBuild");
+		ShaderSpecialization specialization(key);
+		VkPipeline pipeline = create(&specialization.info, pipelineCache->cache);
+		pipelines.emplace(key, pipeline);
+		++lazyBuilds;
+		return pipeline;
+	}
+
+	// Builds every key that doesn't exist yet across the job system, each thread into its
+	// own VkPipelineCache so the driver never serializes on the main one.
+	void precompile(const std::vector<ShaderVariantKey>& keys, JobSystem& jobs)
+	{
+		PV_PROFILE_FUNCTION();
+		auto start = std::chrono::high_resolution_clock::now();
+
+		std::vector<ShaderVariantKey> missing;
+		{
+			std::lock_guard<std::mutex> lock(pipelinesMutex);
+			for (const ShaderVariantKey& key : keys)
+			{
+				if (pipelines.count(key) == 0 && std::find(missing.begin(), missing.end(), key) == missing.end())
+					missing.push_back(key);
+			}
+		}
+		if (missing.empty()) return;
+
+		std::vector<VkPipeline> built(missing.size(), VK_NULL_HANDLE);
+		std::vector<VkPipelineCache> threadCaches(jobs.threadCount(), VK_NULL_HANDLE);
+
+		jobs.parallelFor(static_cast<uint32_t>(missing.size()), 1, [&](uint32_t begin, uint32_t end)
+		{
+			PV_PROFILE_SCOPE("PipelineVariantPrecompile");
+			VkPipelineCache& threadCache = threadCaches[JobSystem::threadIndex()];
+			if (threadCache == VK_NULL_HANDLE)
+				threadCache = pipelineCache->createThreadCache();
+
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				ShaderSpecialization specialization(missing[i]);
+				built[i] = create(&specialization.info, threadCache);
+			}
+		});
+		pipelineCache->mergeThreadCaches();
+
+		std::lock_guard<std::mutex> lock(pipelinesMutex);
+		for (size_t i = 0; i < missing.size(); ++i)
+		{
+			pipelines.emplace(missing[i], built[i]);
+		}
+		precompiledBuilds += static_cast<uint32_t>(missing.size());
+		precompileMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// destroys every variant, they have to be rebuilt against the new render pass / extent
+	void cleanup()
+	{
+		std::lock_guard<std::mutex> lock(pipelinesMutex);
+		for (const auto& entry : pipelines)
+		{
+			vkDestroyPipeline(device, entry.second, allocnullptr);
+		}
+		pipelines.clear();
+	}
+
+	void printStats(std::ostream& out)
+	{
+		std::lock_guard<std::mutex> lock(pipelinesMutex);
+		out << "Pipeline variants: " << pipelines.size() << " live, " << precompiledBuilds << " precompiled in "
+			<< precompileMs << " ms, " << lazyBuilds << " built on demand" << std::endl;
+		for (const auto& entry : pipelines)
+		{
+			out << "\t" << entry.first.name() << std::endl;
+		}
+	}
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	PipelineCache* pipelineCache = nullptr;
+	CreateFunc create;
+
+	std::mutex pipelinesMutex;
+	std::unordered_map<ShaderVariantKey, VkPipeline, ShaderVariantKey::Hasher> pipelines;
+};
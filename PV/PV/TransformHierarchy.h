@@ -0,0 +1,452 @@
+#pragma once
+
+/*
+	Include dependencies: glm, glm/gtc/quaternion.hpp, Macros.h, MultiArray.h, JobSystem.h, CpuProfiler.h, Instancing.h
+*/
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <chrono>
+#include <ostream>
+#include <cstring>
+#include <cmath>
+#include <stdint.h>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PV_TRANSFORM_SSE 1
+#include <immintrin.h>
+#else
+#define PV_TRANSFORM_SSE 0
+#endif
+
+
+// T * R * S
+inline glm::mat4 composeTransform(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	glm::mat3 r = glm::mat3_cast(rotation);
+	return glm::mat4(
+		glm::vec4(r[0] * scale.x, 0.0f),
+		glm::vec4(r[1] * scale.y, 0.0f),
+		glm::vec4(r[2] * scale.z, 0.0f),
+		glm::vec4(position, 1.0f));
+}
+
+// out = a * b, column major. out may not alias b.
+inline void multiplyTransforms(const glm::mat4& a, const glm::mat4& b, glm::mat4& out)
+{
+#if PV_TRANSFORM_SSE
+	const float* pa = &a[0][0];
+	const float* pb = &b[0][0];
+	float* po = &out[0][0];
+	const __m128 a0 = _mm_loadu_ps(pa), a1 = _mm_loadu_ps(pa + 4), a2 = _mm_loadu_ps(pa + 8), a3 = _mm_loadu_ps(pa + 12);
+	for (int c = 0; c < 4; ++c)
+	{
+		// column c of the result is a's columns weighted by column c of b
+		const float* bc = pb + c * 4;
+		__m128 r = _mm_mul_ps(a0, _mm_set1_ps(bc[0]));
+		r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(bc[1])));
+		r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(bc[2])));
+		r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(bc[3])));
+		_mm_storeu_ps(po + c * 4, r);
+	}
+#else
+	out = a * b;
+#endif
+}
+
+
+// Parent/child transforms, SoA and sorted breadth first: every node comes after its parent, the
+// nodes of one depth are contiguous (a level) and so are the children of one node. World
+// matrices are only recomputed for nodes that changed and everything below them, one level at
+// a time so a node's parent is always done before it, each level split across the job system.
+//
+// Nodes are addressed by the id addNode returned. Ids never change, the slot a node is stored
+// at does whenever nodes are added and the hierarchy is sorted again on the next update().
+struct TransformHierarchy
+{
+	static const uint32_t NO_PARENT = 0xFFFFFFFF;
+
+	// nodes recomputed by the last update()
+	uint32_t lastUpdatedCount = 0;
+
+	explicit TransformHierarchy(uint32_t maxNodes)
+		: data({ maxNodes, maxNodes, maxNodes, maxNodes, maxNodes, maxNodes, maxNodes, maxNodes })
+		, capacity(maxNodes)
+	{
+		slotOfNode.reserve(maxNodes);
+	}
+
+	uint32_t count() const { return nodeCount; }
+	uint32_t levelCount() const { return static_cast<uint32_t>(levelBegin.size()) - 1; }
+
+	// parent is a node id, or NO_PARENT for a root
+	uint32_t addNode(uint32_t parent, const glm::vec3& position = glm::vec3(0.0f),
+		const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f))
+	{
+		PV_ASSERT(nodeCount < capacity, "TransformHierarchy: out of nodes, raise maxNodes");
+		PV_ASSERT(parent == NO_PARENT || parent < nodeCount, "TransformHierarchy: parent has to be added before its children");
+
+		// appended for now, update() moves it where it belongs
+		const uint32_t node = nodeCount++;
+		const uint32_t slot = node;
+		slotOfNode.push_back(slot);
+		parents()[slot] = parent == NO_PARENT ? NO_PARENT : slotOfNode[parent];
+		firstChildren()[slot] = 0;
+		childCounts()[slot] = 0;
+		positions()[slot] = position;
+		rotations()[slot] = rotation;
+		scales()[slot] = scale;
+		dirtyFlags()[slot] = 0;
+		markDirty(slot);
+		sorted = false;
+		return node;
+	}
+
+	void setLocal(uint32_t node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+	{
+		uint32_t slot = slotOfNode[node];
+		positions()[slot] = position;
+		rotations()[slot] = rotation;
+		scales()[slot] = scale;
+		markDirty(slot);
+	}
+	void setLocalPosition(uint32_t node, const glm::vec3& position)
+	{
+		positions()[slotOfNode[node]] = position;
+		markDirty(slotOfNode[node]);
+	}
+	void setLocalRotation(uint32_t node, const glm::quat& rotation)
+	{
+		rotations()[slotOfNode[node]] = rotation;
+		markDirty(slotOfNode[node]);
+	}
+	void setLocalScale(uint32_t node, const glm::vec3& scale)
+	{
+		scales()[slotOfNode[node]] = scale;
+		markDirty(slotOfNode[node]);
+	}
+
+	glm::vec3 localPosition(uint32_t node) { return positions()[slotOfNode[node]]; }
+	glm::quat localRotation(uint32_t node) { return rotations()[slotOfNode[node]]; }
+	glm::vec3 localScale(uint32_t node) { return scales()[slotOfNode[node]]; }
+
+	// as of the last update()
+	const glm::mat4& world(uint32_t node) { return worlds()[slotOfNode[node]]; }
+
+	// Brings every world matrix up to date. Only nodes set since the last update and their
+	// descendants are touched.
+	void update(JobSystem& jobs)
+	{
+		PV_PROFILE_FUNCTION();
+		if (!sorted)
+			sortBreadthFirst();
+
+		// nodes that were set go into their own level's list, the children of every node that
+		// gets recomputed join the next level's list as we go
+		const uint32_t levels = levelCount();
+		levelWork.resize(levels);
+		for (uint32_t slot : pendingDirty)
+		{
+			uint32_t level = static_cast<uint32_t>(std::upper_bound(levelBegin.begin(), levelBegin.end(), slot) - levelBegin.begin()) - 1;
+			levelWork[level].push_back(slot);
+		}
+		pendingDirty.clear();
+
+		lastUpdatedCount = 0;
+		ArrayView<uint8_t> dirty = dirtyFlags();
+		ArrayView<uint32_t> firstChild = firstChildren();
+		ArrayView<uint32_t> childCount = childCounts();
+		for (uint32_t level = 0; level < levels; ++level)
+		{
+			std::vector<uint32_t>& work = levelWork[level];
+			if (work.empty()) continue;
+
+			// slot order, so the loads below walk the arrays forward. Every listed slot is flagged
+			// dirty, once a good part of the level is listed a scan of the flags beats sorting.
+			const uint32_t levelSize = levelBegin[level + 1] - levelBegin[level];
+			if (work.size() * 8 > levelSize)
+			{
+				work.clear();
+				for (uint32_t slot = levelBegin[level]; slot < levelBegin[level + 1]; ++slot)
+				{
+					if (dirty[slot]) work.push_back(slot);
+				}
+			}
+			else
+			{
+				std::sort(work.begin(), work.end());
+			}
+
+			const uint32_t workCount = static_cast<uint32_t>(work.size());
+			jobs.parallelFor(workCount, UPDATE_GRAIN_SIZE, [&](uint32_t begin, uint32_t end)
+			{
+				updateWorlds(work.data() + begin, end - begin);
+			});
+
+			if (level + 1 < levels)
+			{
+				std::vector<uint32_t>& next = levelWork[level + 1];
+				for (uint32_t slot : work)
+				{
+					const uint32_t childEnd = firstChild[slot] + childCount[slot];
+					for (uint32_t child = firstChild[slot]; child < childEnd; ++child)
+					{
+						if (dirty[child]) continue; // set explicitly, already listed
+						dirty[child] = 1;
+						next.push_back(child);
+					}
+				}
+			}
+			for (uint32_t slot : work)
+			{
+				dirty[slot] = 0;
+			}
+			lastUpdatedCount += workCount;
+			work.clear();
+		}
+		PV_PROFILE_COUNTER("TransformsUpdated", lastUpdatedCount);
+	}
+
+private:
+	// parent slot, first child slot, child count, local position, rotation, scale, world matrix, dirty
+	MultiArray<uint32_t, uint32_t, uint32_t, glm::vec3, glm::quat, glm::vec3, glm::mat4, uint8_t> data;
+	uint32_t capacity;
+	uint32_t nodeCount = 0;
+	bool sorted = true;
+
+	std::vector<uint32_t> slotOfNode;
+	std::vector<uint32_t> levelBegin = { 0 };	// first slot of every level, then one past the last node
+	std::vector<uint32_t> pendingDirty;			// slots set since the last update
+	std::vector<std::vector<uint32_t>> levelWork;
+
+	// 64KB of world matrices per job
+	static const uint32_t UPDATE_GRAIN_SIZE = 1024;
+
+	ArrayView<uint32_t> parents() { return data.getView<0, uint32_t>(); }
+	ArrayView<uint32_t> firstChildren() { return data.getView<1, uint32_t>(); }
+	ArrayView<uint32_t> childCounts() { return data.getView<2, uint32_t>(); }
+	ArrayView<glm::vec3> positions() { return data.getView<3, glm::vec3>(); }
+	ArrayView<glm::quat> rotations() { return data.getView<4, glm::quat>(); }
+	ArrayView<glm::vec3> scales() { return data.getView<5, glm::vec3>(); }
+	ArrayView<glm::mat4> worlds() { return data.getView<6, glm::mat4>(); }
+	ArrayView<uint8_t> dirtyFlags() { return data.getView<7, uint8_t>(); }
+
+	void markDirty(uint32_t slot)
+	{
+		uint8_t& dirty = dirtyFlags()[slot];
+		if (dirty) return;
+		dirty = 1;
+		pendingDirty.push_back(slot);
+	}
+
+	void updateWorlds(const uint32_t* slots, uint32_t slotCount)
+	{
+		ArrayView<uint32_t> parent = parents();
+		ArrayView<glm::vec3> position = positions();
+		ArrayView<glm::quat> rotation = rotations();
+		ArrayView<glm::vec3> scale = scales();
+		ArrayView<glm::mat4> world = worlds();
+		for (uint32_t i = 0; i < slotCount; ++i)
+		{
+			const uint32_t slot = slots[i];
+			glm::mat4 local = composeTransform(position[slot], rotation[slot], scale[slot]);
+			if (parent[slot] == NO_PARENT)
+				world[slot] = local;
+			else
+				multiplyTransforms(world[parent[slot]], local, world[slot]);
+		}
+	}
+
+	// Reorders every array breadth first (roots, their children, their children's children, ...)
+	// and rebuilds the level and child ranges. Only needed after nodes were added.
+	void sortBreadthFirst()
+	{
+		PV_PROFILE_FUNCTION();
+		ArrayView<uint32_t> parent = parents();
+
+		// children of every slot, grouped by parent
+		std::vector<uint32_t> childStart(nodeCount + 1, 0);
+		for (uint32_t slot = 0; slot < nodeCount; ++slot)
+		{
+			if (parent[slot] != NO_PARENT) ++childStart[parent[slot] + 1];
+		}
+		for (uint32_t slot = 0; slot < nodeCount; ++slot)
+		{
+			childStart[slot + 1] += childStart[slot];
+		}
+		std::vector<uint32_t> children(nodeCount);
+		std::vector<uint32_t> fill(childStart.begin(), childStart.end() - 1);
+		for (uint32_t slot = 0; slot < nodeCount; ++slot)
+		{
+			if (parent[slot] != NO_PARENT) children[fill[parent[slot]]++] = slot;
+		}
+
+		// breadth first walk, order[new slot] = old slot. Depth never decreases along it.
+		std::vector<uint32_t> order;
+		std::vector<uint32_t> depth(nodeCount, 0);
+		order.reserve(nodeCount);
+		for (uint32_t slot = 0; slot < nodeCount; ++slot)
+		{
+			if (parent[slot] == NO_PARENT) order.push_back(slot);
+		}
+		for (uint32_t i = 0; i < order.size(); ++i)
+		{
+			const uint32_t old = order[i];
+			for (uint32_t c = childStart[old]; c < childStart[old + 1]; ++c)
+			{
+				depth[children[c]] = depth[old] + 1;
+				order.push_back(children[c]);
+			}
+		}
+		PV_ASSERT(order.size() == nodeCount, "TransformHierarchy: nodes without a path to a root");
+
+		std::vector<uint32_t> newSlot(nodeCount);
+		for (uint32_t i = 0; i < nodeCount; ++i)
+		{
+			newSlot[order[i]] = i;
+		}
+
+		auto sortedData = data;
+		ArrayView<uint32_t> outParent = sortedData.getView<0, uint32_t>();
+		ArrayView<uint32_t> outFirstChild = sortedData.getView<1, uint32_t>();
+		ArrayView<uint32_t> outChildCount = sortedData.getView<2, uint32_t>();
+		ArrayView<glm::vec3> outPosition = sortedData.getView<3, glm::vec3>();
+		ArrayView<glm::quat> outRotation = sortedData.getView<4, glm::quat>();
+		ArrayView<glm::vec3> outScale = sortedData.getView<5, glm::vec3>();
+		ArrayView<glm::mat4> outWorld = sortedData.getView<6, glm::mat4>();
+		ArrayView<uint8_t> outDirty = sortedData.getView<7, uint8_t>();
+
+		levelBegin.assign(1, 0);
+		for (uint32_t i = 0; i < nodeCount; ++i)
+		{
+			const uint32_t old = order[i];
+			if (i > 0 && depth[old] != depth[order[i - 1]])
+				levelBegin.push_back(i);
+
+			outParent[i] = parent[old] == NO_PARENT ? NO_PARENT : newSlot[parent[old]];
+			// children were appended together, right after everything queued before them
+			outChildCount[i] = childStart[old + 1] - childStart[old];
+			outFirstChild[i] = outChildCount[i] > 0 ? newSlot[children[childStart[old]]] : 0;
+			outPosition[i] = positions()[old];
+			outRotation[i] = rotations()[old];
+			outScale[i] = scales()[old];
+			outWorld[i] = worlds()[old];
+			outDirty[i] = dirtyFlags()[old];
+		}
+		levelBegin.push_back(nodeCount);
+		data = sortedData;
+
+		for (uint32_t& slot : slotOfNode) slot = newSlot[slot];
+		for (uint32_t& slot : pendingDirty) slot = newSlot[slot];
+		sorted = true;
+	}
+};
+
+
+// World matrices of the given nodes into TransformData, the rows of their upper 3x4 each
+inline void writeWorldTransforms(TransformHierarchy& hierarchy, const uint32_t* nodes, uint32_t nodeCount, TransformData& out)
+{
+	PV_PROFILE_FUNCTION();
+	PV_ASSERT(nodeCount <= out.count, "writeWorldTransforms: more nodes than instances");
+	glm::vec4* row0 = out.row0().data();
+	glm::vec4* row1 = out.row1().data();
+	glm::vec4* row2 = out.row2().data();
+	for (uint32_t i = 0; i < nodeCount; ++i)
+	{
+		const float* m = &hierarchy.world(nodes[i])[0][0];
+#if PV_TRANSFORM_SSE
+		__m128 c0 = _mm_loadu_ps(m), c1 = _mm_loadu_ps(m + 4), c2 = _mm_loadu_ps(m + 8), c3 = _mm_loadu_ps(m + 12);
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+		_mm_storeu_ps(&row0[i][0], c0);
+		_mm_storeu_ps(&row1[i][0], c1);
+		_mm_storeu_ps(&row2[i][0], c2);
+#else
+		row0[i] = glm::vec4(m[0], m[4], m[8], m[12]);
+		row1[i] = glm::vec4(m[1], m[5], m[9], m[13]);
+		row2[i] = glm::vec4(m[2], m[6], m[10], m[14]);
+#endif
+	}
+}
+
+
+// 100k nodes, a few roots with a random number of children per node (about 8 levels), timing
+// update() with 1%, 10% and 100% of the nodes set. Checks the result against a straight
+// recursive evaluation and prints ms and ns per recomputed node.
+inline void benchmarkTransformHierarchy(JobSystem& jobs, std::ostream& out, uint32_t nodeCount = 100000)
+{
+	TransformHierarchy hierarchy(nodeCount);
+	std::mt19937 rng(4321);
+	std::uniform_real_distribution<float> offset(-5.0f, 5.0f);
+	std::uniform_real_distribution<float> angle(-3.14159f, 3.14159f);
+	std::uniform_real_distribution<float> scale(0.8f, 1.25f);
+	auto randomLocal = [&](glm::vec3& p, glm::quat& r, glm::vec3& s)
+	{
+		p = glm::vec3(offset(rng), offset(rng), offset(rng));
+		r = glm::angleAxis(angle(rng), glm::normalize(glm::vec3(offset(rng), offset(rng), offset(rng)) + glm::vec3(0.0f, 0.0f, 0.01f)));
+		s = glm::vec3(scale(rng));
+	};
+
+	// node i hangs off a random node in [i / 8, i / 4], about 6 children per node
+	std::vector<uint32_t> parentOf(nodeCount);
+	const uint32_t ROOTS = 4;
+	for (uint32_t i = 0; i < nodeCount; ++i)
+	{
+		glm::vec3 p, s;
+		glm::quat r;
+		randomLocal(p, r, s);
+		uint32_t parent = TransformHierarchy::NO_PARENT;
+		if (i >= ROOTS)
+		{
+			parent = i / 8 + rng() % (i / 4 - i / 8 + 1);
+		}
+		parentOf[i] = parent;
+		hierarchy.addNode(parent, p, r, s);
+	}
+	hierarchy.update(jobs);
+
+	const float fractions[] = { 0.01f, 0.1f, 1.0f };
+	const int ITERATIONS = 10;
+	std::vector<uint32_t> nodes(nodeCount);
+	for (uint32_t i = 0; i < nodeCount; ++i) nodes[i] = i;
+
+	out << "Transform hierarchy benchmark: " << nodeCount << " nodes, " << hierarchy.levelCount() << " levels, "
+		<< (PV_TRANSFORM_SSE ? "SSE" : "scalar") << ", " << jobs.threadCount() << " threads" << std::endl;
+	for (float fraction : fractions)
+	{
+		const uint32_t setCount = std::max(1u, static_cast<uint32_t>(nodeCount * fraction));
+		double totalMs = 0.0;
+		uint64_t recomputed = 0;
+		for (int it = 0; it < ITERATIONS; ++it)
+		{
+			std::shuffle(nodes.begin(), nodes.end(), rng);
+			for (uint32_t i = 0; i < setCount; ++i)
+			{
+				hierarchy.setLocalRotation(nodes[i], glm::angleAxis(angle(rng), glm::vec3(0.0f, 0.0f, 1.0f)));
+			}
+			auto start = std::chrono::high_resolution_clock::now();
+			hierarchy.update(jobs);
+			totalMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			recomputed += hierarchy.lastUpdatedCount;
+		}
+		const double ms = totalMs / ITERATIONS;
+		out << "\t" << fraction * 100.0f << "% set: " << ms << " ms, " << recomputed / ITERATIONS << " nodes recomputed, "
+			<< totalMs * 1e6 / std::max<uint64_t>(recomputed, 1) << " ns/node" << std::endl;
+	}
+
+	// every world against the parent chain evaluated from scratch
+	std::vector<glm::mat4> reference(nodeCount);
+	float maxError = 0.0f;
+	for (uint32_t i = 0; i < nodeCount; ++i)
+	{
+		glm::mat4 local = composeTransform(hierarchy.localPosition(i), hierarchy.localRotation(i), hierarchy.localScale(i));
+		reference[i] = parentOf[i] == TransformHierarchy::NO_PARENT ? local : reference[parentOf[i]] * local;
+		const glm::mat4& world = hierarchy.world(i);
+		for (int c = 0; c < 4; ++c)
+		{
+			glm::vec4 difference = glm::abs(world[c] - reference[i][c]);
+			maxError = std::max(maxError, std::max(std::max(difference.x, difference.y), std::max(difference.z, difference.w)));
+		}
+	}
+	PV_ASSERT(maxError < 1e-2f, "benchmarkTransformHierarchy: world matrices don't match the reference");
+}
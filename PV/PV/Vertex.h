@@ -1,73 +1,116 @@
 #pragma once
 
 //
-// Pre-Includes required: Vulkan, glm/glm.hpp, Macros.h
+// Pre-Includes required: Vulkan, glm/glm.hpp, glm/gtx/hash.hpp
 //
 #include <array>
+#include <cstddef>
+#include <vector>
 #include <unordered_map>
-#include <typeinfo>
-#include <typeindex>
+#include <unordered_set>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <ostream>
+#include <tuple>
+#include <utility>
+#include <type_traits>
 #include "static_util.h"
 
 
-template <class ... Args>
-struct VertexData
+// VkFormat of a vertex attribute type. A type without a specialization can't be part of a
+// VertexData, add it with PV_VERTEX_FORMAT below.
+template <class T>
+struct VertexFormat
 {
-	static const constexpr int s_num_params = sizeof...(Args);
-	static const constexpr std::array<uint32_t, s_num_params> type_sizes = { sizeof(Args)... };
-	//static const constexpr std::array<size_t, s_num_params>   type_offsets = 
-	static const constexpr size_t type_size =	static_sum<sizeof(Args)...>::value;
-
-	unsigned char data[type_size];
+	static constexpr bool supported = false;
+	static constexpr VkFormat value = VK_FORMAT_UNDEFINED;
+};
 
-	static const std::array<const std::type_info*, s_num_params>& getTypeIds()
+#define PV_VERTEX_FORMAT(TYPE, FORMAT)						\
+template <> struct VertexFormat<TYPE>						\
+{															\
+	static constexpr bool supported = true;					\
+	static constexpr VkFormat value = FORMAT;				\
+};
+PV_VERTEX_FORMAT(float, VK_FORMAT_R32_SFLOAT)
+PV_VERTEX_FORMAT(glm::vec2, VK_FORMAT_R32G32_SFLOAT)
+PV_VERTEX_FORMAT(glm::vec3, VK_FORMAT_R32G32B32_SFLOAT)
+PV_VERTEX_FORMAT(glm::vec4, VK_FORMAT_R32G32B32A32_SFLOAT)
+
+PV_VERTEX_FORMAT(uint32_t, VK_FORMAT_R32_UINT)
+PV_VERTEX_FORMAT(glm::uvec2, VK_FORMAT_R32G32_UINT)
+PV_VERTEX_FORMAT(glm::uvec3, VK_FORMAT_R32G32B32_UINT)
+PV_VERTEX_FORMAT(glm::uvec4, VK_FORMAT_R32G32B32A32_UINT)
+PV_VERTEX_FORMAT(int32_t, VK_FORMAT_R32_SINT)
+PV_VERTEX_FORMAT(glm::ivec2, VK_FORMAT_R32G32_SINT)
+PV_VERTEX_FORMAT(glm::ivec3, VK_FORMAT_R32G32B32_SINT)
+PV_VERTEX_FORMAT(glm::ivec4, VK_FORMAT_R32G32B32A32_SINT)
+PV_VERTEX_FORMAT(glm::quat, VK_FORMAT_R32G32B32A32_SFLOAT)
+
+//@Expansion add more formats for different types
+#undef PV_VERTEX_FORMAT
+
+
+namespace vertex_detail
+{
+	template <class... Args>
+	struct AllSupported : std::true_type { };
+	template <class T, class... Rest>
+	struct AllSupported<T, Rest...>
+		: std::integral_constant<bool, VertexFormat<T>::supported && AllSupported<Rest...>::value> { };
+
+	// sum of the sizes before attribute index
+	template <class... Args>
+	constexpr uint32_t offsetOf(size_t index)
 	{
-		static std::array<const std::type_info*, s_num_params> type_info_array = { &typeid(Args)... };
-		return type_info_array;
+		const uint32_t sizes[] = { static_cast<uint32_t>(sizeof(Args))..., 0 };
+		uint32_t offset = 0;
+		for (size_t i = 0; i < index; ++i)
+			offset += sizes[i];
+		return offset;
 	}
-
-	template<size_t ParameterIndex>
-	static const size_t GetOffsetOfData()
+	template <class... Args, size_t... I>
+	constexpr std::array<uint32_t, sizeof...(Args)> offsets(std::index_sequence<I...>)
 	{
-		size_t partialSum = 0;
-		for (int i = 0; i <= ParameterIndex; ++i)
-		{
-			partialSum += type_sizes[i];
-		}
-		return partialSum;
+		return {{ offsetOf<Args...>(I)... }};
 	}
+}
 
-};
-
-
-
-// @HIDE ME
-#define FORMAT(TYPE, FORMAT) { std::type_index(typeid(TYPE)), FORMAT },
-static const std::unordered_map<std::type_index, VkFormat> TypeIdToVKFormatMap =
+// One vertex made of Args packed back to back, the layout is known at compile time: attribute I
+// is a ItemType<I> at type_offsets[I] with format formats[I], the stride is type_size.
+template <class ... Args>
+struct alignas(alignof(Args)...) VertexData
 {
-	FORMAT(float, VK_FORMAT_R32_SFLOAT)
-	FORMAT(glm::vec2, VK_FORMAT_R32G32_SFLOAT)
-	FORMAT(glm::vec3, VK_FORMAT_R32G32B32_SFLOAT)
-	FORMAT(glm::vec4, VK_FORMAT_R32G32B32A32_SFLOAT)
+	static_assert(vertex_detail::AllSupported<Args...>::value, "VertexData: attribute type without a VertexFormat");
+
+	static const constexpr int s_num_params = sizeof...(Args);
+	static const constexpr std::array<uint32_t, s_num_params> type_sizes = {{ sizeof(Args)... }};
+	static const constexpr std::array<uint32_t, s_num_params> type_offsets = vertex_detail::offsets<Args...>(std::index_sequence_for<Args...>());
+	static const constexpr std::array<VkFormat, s_num_params> formats = {{ VertexFormat<Args>::value... }};
+	static const constexpr size_t type_size =	static_sum<sizeof(Args)...>::value;
 
-	FORMAT(uint32_t, VK_FORMAT_R32_UINT)
-	FORMAT(glm::quat, VK_FORMAT_R32G32B32A32_SFLOAT)
+	template <size_t I>
+	using ItemType = typename std::tuple_element<I, std::tuple<Args...>>::type;
 
+	unsigned char data[type_size];
 
-	//@Expansion add more formats for different types
+	template <size_t I>
+	ItemType<I>& get() {
+		return *reinterpret_cast<ItemType<I>*>(data + type_offsets[I]);
+	}
+	template <size_t I>
+	const ItemType<I>& get() const {
+		return *reinterpret_cast<const ItemType<I>*>(data + type_offsets[I]);
+	}
 };
-#undef FORMAT
 
-
-// returns VK_FORMAT_UNDEFINED if undefined
-static VkFormat TypeIndexToVkFormat(std::type_index index)
-{
-	auto found = TypeIdToVKFormatMap.find(index);
-	if (found == TypeIdToVKFormatMap.end())
-		return VK_FORMAT_UNDEFINED;
-	else
-		return (*found).second;
-}
+template <class ... Args>
+constexpr std::array<uint32_t, VertexData<Args...>::s_num_params> VertexData<Args...>::type_sizes;
+template <class ... Args>
+constexpr std::array<uint32_t, VertexData<Args...>::s_num_params> VertexData<Args...>::type_offsets;
+template <class ... Args>
+constexpr std::array<VkFormat, VertexData<Args...>::s_num_params> VertexData<Args...>::formats;
 
 
 template<int attributeCount>
@@ -77,35 +120,40 @@ struct InputDescription
 	std::array<VkVertexInputAttributeDescription, attributeCount> attributes;
 };
 
-template<class VertexDataType>
-InputDescription<VertexDataType::s_num_params> GetInputDescription(int binding, VkVertexInputRate rate)
+namespace vertex_detail
 {
-	InputDescription<VertexDataType::s_num_params> in;
-	auto typeIds = VertexDataType::getTypeIds();
-		
-	int offset = 0;
-
-	for (int i = 0; i < VertexDataType::s_num_params; ++i)
+	template <class VertexDataType, size_t... I>
+	constexpr InputDescription<VertexDataType::s_num_params> inputDescription(uint32_t binding, VkVertexInputRate rate, uint32_t firstLocation, std::index_sequence<I...>)
 	{
-		in.attributes[i].location = i;
-		in.attributes[i].binding = binding;
-		in.attributes[i].offset = offset;
-		in.attributes[i].format = TypeIndexToVkFormat(std::type_index(*typeIds[i]));
-
-		// See TypeIdToVKFormatMap to add in the new format for you type
-		PV_ASSERT(in.attributes[i].format != VK_FORMAT_UNDEFINED,
-			std::string("TypeIdToVKFormatMap doesn't contain a map for the type of name: ") + std::string(typeIds[i]->name())
-		);
-
-		offset += VertexDataType::type_sizes[i];
+		return InputDescription<VertexDataType::s_num_params>{
+			{ binding, static_cast<uint32_t>(VertexDataType::type_size), rate },
+			{{ { firstLocation + static_cast<uint32_t>(I), binding, VertexDataType::formats[I], VertexDataType::type_offsets[I] }... }}
+		};
 	}
+}
 
-	in.binding.binding = binding;
-	in.binding.inputRate = rate;
-	in.binding.stride = offset;
-	return in;
+// attribute i of VertexDataType gets location firstLocation + i. Everything comes out of the
+// layout's constants, with constant arguments the whole description is a compile time value.
+template<class VertexDataType>
+constexpr InputDescription<VertexDataType::s_num_params> GetInputDescription(uint32_t binding, VkVertexInputRate rate, uint32_t firstLocation = 0)
+{
+	return vertex_detail::inputDescription<VertexDataType>(binding, rate, firstLocation, std::make_index_sequence<VertexDataType::s_num_params>());
 }
 
+// Every binding of a pipeline's vertex input state, gathered from one InputDescription per binding
+struct VertexInputState
+{
+	std::vector<VkVertexInputBindingDescription> bindings;
+	std::vector<VkVertexInputAttributeDescription> attributes;
+
+	template<int attributeCount>
+	void add(const InputDescription<attributeCount>& description)
+	{
+		bindings.push_back(description.binding);
+		attributes.insert(attributes.end(), description.attributes.begin(), description.attributes.end());
+	}
+};
+
 
 
 // colored vertexes
@@ -125,49 +173,90 @@ struct Vertex
 				texCoord == other.texCoord;
 	}
 
-	// @TODO Should be able to generate this information with a 
-	// tag in JAI if we ever port this over...
-	static  std::array<VkVertexInputBindingDescription, 1> getBindingDescription()
-	{
-		std::array<VkVertexInputBindingDescription, 1> bindingDescriptions = {};
-
-		bindingDescriptions[0].binding = 0;
-		bindingDescriptions[0].stride = sizeof(Vertex);
-		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-		return bindingDescriptions;
-	}
-
-	static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions()
-	{
-		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = {};
-
-		// Per Vertex Data
-		attributeDescriptions[0].binding = 0;
-		attributeDescriptions[0].location = 0;
-		attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT; // matches glm::vec2
-		attributeDescriptions[0].offset = offsetof(Vertex, position);
-		
-		attributeDescriptions[1].binding = 0;
-		attributeDescriptions[1].location = 1;
-		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-		attributeDescriptions[2].binding = 0;
-		attributeDescriptions[2].location = 2;
-		attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
-
-		return attributeDescriptions;
-	}
+	// Matches the member order, the vertex input state is built from this and
+	// checked against what shader.vert actually reads (see ShaderReflection.h)
+	typedef VertexData<glm::vec3, glm::vec3, glm::vec2> Layout;
 };
+static_assert(sizeof(Vertex) == Vertex::Layout::type_size &&
+	offsetof(Vertex, color) == Vertex::Layout::type_offsets[1] &&
+	offsetof(Vertex, texCoord) == Vertex::Layout::type_offsets[2], "Vertex::Layout is out of sync with Vertex");
 
+// All eight floats through one glm::hash_state, +0 and -0 hash the same like they compare
 namespace std {
 	template<> struct hash<Vertex> {
 		size_t operator()(Vertex const& vertex) const {
-			return ((hash<glm::vec3>()(vertex.position) ^
-				(hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-				(hash<glm::vec2>()(vertex.texCoord) << 1);
+			return static_cast<size_t>(glm::hash_state().add(vertex.position).add(vertex.color).add(vertex.texCoord).value());
 		}
 	};
-}
\ No newline at end of file
+}
+
+namespace vertex_detail
+{
+	// std::hash<Vertex> as it was: shifted XORs over glm's old hash_combine of std::hash<float>
+	struct LegacyVertexHash
+	{
+		static void combine(size_t& seed, size_t hash)
+		{
+			hash += 0x9e3779b9 + (seed << 6) + (seed >> 2);
+			seed ^= hash;
+		}
+		template <class Vec>
+		static size_t hashVec(const Vec& v)
+		{
+			size_t seed = 0;
+			for (glm::length_t i = 0; i < v.length(); ++i) combine(seed, std::hash<float>()(v[i]));
+			return seed;
+		}
+		size_t operator()(const Vertex& vertex) const
+		{
+			return ((hashVec(vertex.position) ^ (hashVec(vertex.color) << 1)) >> 1) ^ (hashVec(vertex.texCoord) << 1);
+		}
+	};
+
+	template <class Hash>
+	void reportVertexHash(const char* name, const std::vector<Vertex>& corners, std::ostream& out)
+	{
+		typedef std::chrono::high_resolution_clock Clock;
+		const Hash hash;
+
+		// dedup the way loadModel does it
+		auto start = Clock::now();
+		std::unordered_map<Vertex, uint32_t, Hash> unique;
+		unique.reserve(corners.size() / 4);
+		for (const Vertex& corner : corners) unique.emplace(corner, static_cast<uint32_t>(unique.size()));
+		const double dedupMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		// full width collisions, and a power of two table indexed by the low bits like MSVC's
+		std::unordered_set<size_t> hashes;
+		size_t buckets = 1;
+		while (buckets < unique.size()) buckets *= 2;
+		std::vector<uint32_t> load(buckets, 0);
+		for (const auto& entry : unique)
+		{
+			const size_t h = hash(entry.first);
+			hashes.insert(h);
+			++load[h & (buckets - 1)];
+		}
+		uint64_t probes = 0;
+		uint32_t maxLoad = 0, usedBuckets = 0;
+		for (uint32_t l : load)
+		{
+			probes += uint64_t(l) * l;
+			maxLoad = std::max(maxLoad, l);
+			usedBuckets += l > 0 ? 1 : 0;
+		}
+		out << "\t" << name << ": " << unique.size() - hashes.size() << " colliding hashes, " << buckets << " buckets "
+			<< 100.0 * usedBuckets / buckets << "% used, max " << maxLoad << ", " << double(probes) / unique.size()
+			<< " compares per hit, dedup " << dedupMs << " ms" << std::endl;
+	}
+}
+
+// Collisions and bucket spread of std::hash<Vertex> against the old one over a model's face
+// corners (loadModel hands over chalet.obj's with BENCHMARK_VERTEX_HASH). A uniform hash uses
+// 1 - e^-load of the buckets and needs about 1 + load / 2 compares per hit.
+inline void benchmarkVertexHash(const std::vector<Vertex>& corners, std::ostream& out)
+{
+	out << "Vertex hash benchmark: " << corners.size() << " face corners" << std::endl;
+	vertex_detail::reportVertexHash<vertex_detail::LegacyVertexHash>("old hash", corners, out);
+	vertex_detail::reportVertexHash<std::hash<Vertex>>("glm::hash_state", corners, out);
+}
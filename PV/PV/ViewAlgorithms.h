@@ -0,0 +1,702 @@
+#pragma once
+
+/*
+	Include dependencies: glm (+ gtc/matrix_transform), Macros.h, MultiArray.h, Vertex.h, Mesh.h
+*/
+#include <vector>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+#include <functional>
+#include <random>
+#include <chrono>
+#include <ostream>
+#include <limits>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <stdint.h>
+
+// 8 floats per instruction with AVX (/arch:AVX or AVX2, Release|x64 sets AVX2), 4 with SSE, scalar otherwise.
+// The AoS kernels (one vec3 per register) and the transposes only need SSE.
+#if defined(__AVX__)
+#define PV_VIEW_AVX 1
+#else
+#define PV_VIEW_AVX 0
+#endif
+#if PV_VIEW_AVX || defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PV_VIEW_SSE 1
+#include <immintrin.h>
+#else
+#define PV_VIEW_SSE 0
+#endif
+
+
+// Every stride-th byte is a T: one member of an array of structs (Vertex::position), or a plain
+// contiguous array when stride == sizeof(T). The stride is in bytes and has to keep T aligned.
+template <class T>
+struct StridedView
+{
+	typedef typename std::conditional<std::is_const<T>::value, const char, char>::type Byte;
+
+	StridedView() = default;
+	StridedView(T* first, int64_t count, int64_t stride = sizeof(T))
+		: m_base(reinterpret_cast<Byte*>(first))
+		, m_count(count)
+		, m_stride(stride)
+	{ }
+	// a contiguous view of an ArrayView, StridedView<const T> from a StridedView<T>
+	template <class U, class = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+	StridedView(ArrayView<U> view)
+		: StridedView(view.data(), view.size())
+	{ }
+	template <class U, class = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+	StridedView(const StridedView<U>& view)
+		: StridedView(view.data(), view.size(), view.stride())
+	{ }
+
+	T& operator[](int64_t index) const {
+#ifdef DEBUG
+		assert(index >= 0 && index < m_count);
+#endif
+		return *reinterpret_cast<T*>(m_base + index * m_stride);
+	}
+
+	int64_t size() const { return m_count; }
+	int64_t stride() const { return m_stride; }
+	bool contiguous() const { return m_stride == sizeof(T); }
+	// the first element, the whole array when contiguous()
+	T* data() const { return reinterpret_cast<T*>(m_base); }
+
+	// elements [begin, end) of this view
+	StridedView slice(int64_t begin, int64_t end) const {
+		return StridedView(reinterpret_cast<T*>(m_base + begin * m_stride), end - begin, m_stride);
+	}
+
+private:
+	Byte* m_base = nullptr;
+	int64_t m_count = 0;
+	int64_t m_stride = sizeof(T);
+};
+
+// memberView(vertices.data(), vertices.size(), &Vertex::position)
+template <class U, class M>
+StridedView<M> memberView(U* items, int64_t count, M U::* member)
+{
+	return StridedView<M>(count > 0 ? &(items->*member) : nullptr, count, sizeof(U));
+}
+template <class U, class M>
+StridedView<const M> memberView(const U* items, int64_t count, M U::* member)
+{
+	return StridedView<const M>(count > 0 ? &(items->*member) : nullptr, count, sizeof(U));
+}
+
+
+// Several views of the same length walked in lockstep, zip[i] is a tuple of references.
+// zipStreams<0, 1, 2>(multiArray) zips MultiArray streams, which is the SoA way to write
+// a loop over "elements" whose members live in different arrays.
+template <class... Views>
+struct ZipView
+{
+	std::tuple<Views...> views;
+	int64_t count;
+
+	std::tuple<decltype(std::declval<Views&>()[0])...> operator[](int64_t index) {
+		return at(index, std::index_sequence_for<Views...>());
+	}
+	int64_t size() const { return count; }
+
+private:
+	template <size_t... I>
+	std::tuple<decltype(std::declval<Views&>()[0])...> at(int64_t index, std::index_sequence<I...>) {
+		return std::tuple<decltype(std::declval<Views&>()[0])...>(std::get<I>(views)[index]...);
+	}
+};
+
+template <class View, class... Views>
+ZipView<View, Views...> zip(const View& view, const Views&... views)
+{
+	const int64_t sizes[] = { view.size(), views.size()... };
+	for (int64_t size : sizes)
+		PV_ASSERT(size == view.size(), "zip: views of different lengths");
+	return ZipView<View, Views...>{ std::tuple<View, Views...>(view, views...), view.size() };
+}
+
+template <uint32_t... Streams, class MultiArrayType>
+auto zipStreams(MultiArrayType& array)
+{
+	return zip(array.template view<Streams>()...);
+}
+
+namespace view_detail
+{
+	template <class Zip, class Func, size_t... I>
+	void forEachIndexed(Zip& zipped, Func& func, std::index_sequence<I...>)
+	{
+		for (int64_t i = 0; i < zipped.count; ++i)
+			func(std::get<I>(zipped.views)[i]...);
+	}
+}
+
+// func(a[i], b[i], ...) for every i of zip(a, b, ...)
+template <class... Views, class Func>
+void forEach(ZipView<Views...> zipped, Func func)
+{
+	view_detail::forEachIndexed(zipped, func, std::index_sequence_for<Views...>());
+}
+
+
+struct Aabb
+{
+	glm::vec3 min = glm::vec3(std::numeric_limits<float>::infinity());
+	glm::vec3 max = glm::vec3(-std::numeric_limits<float>::infinity());
+};
+
+namespace view_detail
+{
+#if PV_VIEW_SSE
+	inline float horizontalMin(__m128 v)
+	{
+		v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+		v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtss_f32(v);
+	}
+	inline float horizontalMax(__m128 v)
+	{
+		v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+		v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtss_f32(v);
+	}
+	// xyz of a vec3, the fourth lane is whatever follows it in memory. Only safe when something
+	// does, which is why the AoS loops below leave the last element to the scalar tail.
+	inline __m128 loadRow(const glm::vec3& v)
+	{
+		return _mm_loadu_ps(&v.x);
+	}
+	inline void storeRow(glm::vec3& v, __m128 row)
+	{
+		_mm_storel_pi(reinterpret_cast<__m64*>(&v.x), row);
+		_mm_store_ss(&v.z, _mm_movehl_ps(row, row));
+	}
+#endif
+#if PV_VIEW_AVX
+	inline __m128 lowerMin(__m256 v) { return _mm_min_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)); }
+	inline __m128 lowerMax(__m256 v) { return _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)); }
+#endif
+
+	inline glm::vec3 transformPoint(const glm::mat4& m, const glm::vec3& p)
+	{
+		return glm::vec3(m[0]) * p.x + glm::vec3(m[1]) * p.y + (glm::vec3(m[2]) * p.z + glm::vec3(m[3]));
+	}
+}
+
+
+// out[i] = in[i], whichever layouts the two have. Both contiguous is a memcpy.
+template <class T>
+void copyView(StridedView<const T> in, StridedView<T> out)
+{
+	PV_ASSERT(in.size() == out.size(), "copyView: views of different lengths");
+	if (in.contiguous() && out.contiguous())
+	{
+		if (in.size() > 0)
+			std::memmove(out.data(), in.data(), static_cast<size_t>(in.size()) * sizeof(T));
+		return;
+	}
+	for (int64_t i = 0; i < in.size(); ++i)
+		out[i] = in[i];
+}
+
+// vec3 streams are the common case (Vertex::position <-> Mesh::positions). Into a packed array
+// it goes four at a time, four row loads shuffled into three stores. Out of one the scalar loop
+// is as fast: a 12 byte row store is two partial stores either way.
+inline void copyView(StridedView<const glm::vec3> in, StridedView<glm::vec3> out)
+{
+	PV_ASSERT(in.size() == out.size(), "copyView: views of different lengths");
+	const int64_t count = in.size();
+	if (in.contiguous() && out.contiguous())
+	{
+		if (count > 0)
+			std::memmove(out.data(), in.data(), static_cast<size_t>(count) * sizeof(glm::vec3));
+		return;
+	}
+	int64_t i = 0;
+#if PV_VIEW_SSE
+	using namespace view_detail;
+	if (out.contiguous())
+	{
+		float* packed = &out.data()->x;
+		for (; i + 4 < count; i += 4, packed += 12)
+		{
+			__m128 r0 = loadRow(in[i]), r1 = loadRow(in[i + 1]), r2 = loadRow(in[i + 2]), r3 = loadRow(in[i + 3]);
+			__m128 t0 = _mm_shuffle_ps(r0, r1, _MM_SHUFFLE(0, 0, 0, 2));	// z0 x0 x1 x1
+			__m128 t1 = _mm_shuffle_ps(r2, r3, _MM_SHUFFLE(0, 0, 0, 2));	// z2 x2 x3 x3
+			_mm_storeu_ps(packed + 0, _mm_shuffle_ps(r0, t0, _MM_SHUFFLE(2, 0, 1, 0)));	// x0 y0 z0 x1
+			_mm_storeu_ps(packed + 4, _mm_shuffle_ps(r1, r2, _MM_SHUFFLE(1, 0, 2, 1)));	// y1 z1 x2 y2
+			_mm_storeu_ps(packed + 8, _mm_shuffle_ps(t1, r3, _MM_SHUFFLE(2, 1, 2, 0)));	// z2 x3 y3 z3
+		}
+	}
+#endif
+	for (; i < count; ++i)
+		out[i] = in[i];
+}
+
+// AoS -> SoA: x[i], y[i], z[i] = in[i]
+inline void transposeToSoA(StridedView<const glm::vec3> in, ArrayView<float> x, ArrayView<float> y, ArrayView<float> z)
+{
+	const int64_t count = in.size();
+	PV_ASSERT(x.size() == count && y.size() == count && z.size() == count, "transposeToSoA: views of different lengths");
+	int64_t i = 0;
+#if PV_VIEW_SSE
+	using namespace view_detail;
+	for (; i + 4 < count; i += 4)
+	{
+		__m128 r0 = loadRow(in[i]), r1 = loadRow(in[i + 1]), r2 = loadRow(in[i + 2]), r3 = loadRow(in[i + 3]);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(&x[i], r0);
+		_mm_storeu_ps(&y[i], r1);
+		_mm_storeu_ps(&z[i], r2);
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		x[i] = in[i].x;
+		y[i] = in[i].y;
+		z[i] = in[i].z;
+	}
+}
+
+// SoA -> AoS: out[i] = (x[i], y[i], z[i])
+inline void transposeToAoS(const ArrayView<float>& x, const ArrayView<float>& y, const ArrayView<float>& z, StridedView<glm::vec3> out)
+{
+	const int64_t count = out.size();
+	PV_ASSERT(x.size() == count && y.size() == count && z.size() == count, "transposeToAoS: views of different lengths");
+	int64_t i = 0;
+#if PV_VIEW_SSE
+	using namespace view_detail;
+	if (out.contiguous())
+	{
+		float* packed = &out.data()->x;
+		for (; i + 4 <= count; i += 4, packed += 12)
+		{
+			__m128 vx = _mm_loadu_ps(&x[i]), vy = _mm_loadu_ps(&y[i]), vz = _mm_loadu_ps(&z[i]);
+			__m128 xy01 = _mm_unpacklo_ps(vx, vy);									// x0 y0 x1 y1
+			__m128 xy23 = _mm_unpackhi_ps(vx, vy);									// x2 y2 x3 y3
+			__m128 zx = _mm_shuffle_ps(vz, vx, _MM_SHUFFLE(0, 1, 0, 0));			// z0 z0 x1 x0
+			__m128 yz = _mm_shuffle_ps(vy, vz, _MM_SHUFFLE(0, 1, 0, 1));			// y1 y0 z1 z0
+			__m128 zx23 = _mm_shuffle_ps(vz, xy23, _MM_SHUFFLE(0, 2, 0, 2));		// z2 z0 x3 x2
+			__m128 yz3 = _mm_shuffle_ps(xy23, vz, _MM_SHUFFLE(0, 3, 0, 3));			// y3 x2 z3 z0
+			_mm_storeu_ps(packed + 0, _mm_shuffle_ps(xy01, zx, _MM_SHUFFLE(2, 0, 1, 0)));
+			_mm_storeu_ps(packed + 4, _mm_shuffle_ps(yz, xy23, _MM_SHUFFLE(1, 0, 2, 0)));
+			_mm_storeu_ps(packed + 8, _mm_shuffle_ps(zx23, yz3, _MM_SHUFFLE(2, 0, 2, 0)));
+		}
+	}
+	else
+	{
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 r0 = _mm_loadu_ps(&x[i]), r1 = _mm_loadu_ps(&y[i]), r2 = _mm_loadu_ps(&z[i]), r3 = _mm_setzero_ps();
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			storeRow(out[i], r0);
+			storeRow(out[i + 1], r1);
+			storeRow(out[i + 2], r2);
+			storeRow(out[i + 3], r3);
+		}
+	}
+#endif
+	for (; i < count; ++i)
+		out[i] = glm::vec3(x[i], y[i], z[i]);
+}
+
+// Affine point transform of SoA streams, w = 1 and no divide. Any of out may alias the matching in.
+inline void transformPoints(const glm::mat4& m,
+	const ArrayView<float>& x, const ArrayView<float>& y, const ArrayView<float>& z,
+	ArrayView<float> outX, ArrayView<float> outY, ArrayView<float> outZ)
+{
+	const int64_t count = x.size();
+	PV_ASSERT(y.size() == count && z.size() == count && outX.size() == count && outY.size() == count && outZ.size() == count,
+		"transformPoints: views of different lengths");
+	int64_t i = 0;
+#if PV_VIEW_AVX
+	{
+		__m256 c[4][3];
+		for (int col = 0; col < 4; ++col)
+			for (int row = 0; row < 3; ++row)
+				c[col][row] = _mm256_set1_ps(m[col][row]);
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 px = _mm256_loadu_ps(&x[i]), py = _mm256_loadu_ps(&y[i]), pz = _mm256_loadu_ps(&z[i]);
+			__m256 r[3];
+			for (int row = 0; row < 3; ++row)
+			{
+				r[row] = _mm256_add_ps(
+					_mm256_add_ps(_mm256_mul_ps(c[0][row], px), _mm256_mul_ps(c[1][row], py)),
+					_mm256_add_ps(_mm256_mul_ps(c[2][row], pz), c[3][row]));
+			}
+			_mm256_storeu_ps(&outX[i], r[0]);
+			_mm256_storeu_ps(&outY[i], r[1]);
+			_mm256_storeu_ps(&outZ[i], r[2]);
+		}
+	}
+#endif
+#if PV_VIEW_SSE
+	{
+		__m128 c[4][3];
+		for (int col = 0; col < 4; ++col)
+			for (int row = 0; row < 3; ++row)
+				c[col][row] = _mm_set1_ps(m[col][row]);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 px = _mm_loadu_ps(&x[i]), py = _mm_loadu_ps(&y[i]), pz = _mm_loadu_ps(&z[i]);
+			__m128 r[3];
+			for (int row = 0; row < 3; ++row)
+			{
+				r[row] = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(c[0][row], px), _mm_mul_ps(c[1][row], py)),
+					_mm_add_ps(_mm_mul_ps(c[2][row], pz), c[3][row]));
+			}
+			_mm_storeu_ps(&outX[i], r[0]);
+			_mm_storeu_ps(&outY[i], r[1]);
+			_mm_storeu_ps(&outZ[i], r[2]);
+		}
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		glm::vec3 p = view_detail::transformPoint(m, glm::vec3(x[i], y[i], z[i]));
+		outX[i] = p.x;
+		outY[i] = p.y;
+		outZ[i] = p.z;
+	}
+}
+
+// Same on vec3s in any layout, one point per register. in and out may be the same view.
+inline void transformPoints(const glm::mat4& m, StridedView<const glm::vec3> in, StridedView<glm::vec3> out)
+{
+	const int64_t count = in.size();
+	PV_ASSERT(out.size() == count, "transformPoints: views of different lengths");
+	int64_t i = 0;
+#if PV_VIEW_SSE
+	using namespace view_detail;
+	const __m128 c0 = _mm_loadu_ps(&m[0][0]), c1 = _mm_loadu_ps(&m[1][0]), c2 = _mm_loadu_ps(&m[2][0]), c3 = _mm_loadu_ps(&m[3][0]);
+	for (; i + 1 < count; ++i)
+	{
+		__m128 p = loadRow(in[i]);
+		storeRow(out[i], _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(c0, _mm_shuffle_ps(p, p, _MM_SHUFFLE(0, 0, 0, 0))), _mm_mul_ps(c1, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1)))),
+			_mm_add_ps(_mm_mul_ps(c2, _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2))), c3)));
+	}
+#endif
+	for (; i < count; ++i)
+		out[i] = view_detail::transformPoint(m, in[i]);
+}
+
+// smallest and largest value, +inf / -inf for an empty view. NaNs are skipped by the SIMD path
+// only where they happen to land in the second operand, keep them out.
+inline void minMax(const ArrayView<float>& values, float& minValue, float& maxValue)
+{
+	const int64_t count = values.size();
+	minValue = std::numeric_limits<float>::infinity();
+	maxValue = -std::numeric_limits<float>::infinity();
+	int64_t i = 0;
+#if PV_VIEW_SSE
+	using namespace view_detail;
+	__m128 lo = _mm_set1_ps(minValue), hi = _mm_set1_ps(maxValue);
+#if PV_VIEW_AVX
+	{
+		__m256 lo8 = _mm256_set1_ps(minValue), hi8 = _mm256_set1_ps(maxValue);
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 v = _mm256_loadu_ps(&values[i]);
+			lo8 = _mm256_min_ps(lo8, v);
+			hi8 = _mm256_max_ps(hi8, v);
+		}
+		lo = lowerMin(lo8);
+		hi = lowerMax(hi8);
+	}
+#endif
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 v = _mm_loadu_ps(&values[i]);
+		lo = _mm_min_ps(lo, v);
+		hi = _mm_max_ps(hi, v);
+	}
+	minValue = horizontalMin(lo);
+	maxValue = horizontalMax(hi);
+#endif
+	for (; i < count; ++i)
+	{
+		minValue = std::min(minValue, values[i]);
+		maxValue = std::max(maxValue, values[i]);
+	}
+}
+
+// bounds of SoA points, all three streams in one pass
+inline Aabb computeAabb(const ArrayView<float>& x, const ArrayView<float>& y, const ArrayView<float>& z)
+{
+	const int64_t count = x.size();
+	PV_ASSERT(y.size() == count && z.size() == count, "computeAabb: views of different lengths");
+	Aabb box;
+	int64_t i = 0;
+#if PV_VIEW_SSE
+	using namespace view_detail;
+	__m128 lo[3], hi[3];
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		lo[axis] = _mm_set1_ps(box.min[axis]);
+		hi[axis] = _mm_set1_ps(box.max[axis]);
+	}
+	const ArrayView<float>* axes[3] = { &x, &y, &z };
+#if PV_VIEW_AVX
+	{
+		__m256 lo8[3], hi8[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			lo8[axis] = _mm256_set1_ps(box.min[axis]);
+			hi8[axis] = _mm256_set1_ps(box.max[axis]);
+		}
+		for (; i + 8 <= count; i += 8)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				__m256 v = _mm256_loadu_ps(&(*axes[axis])[i]);
+				lo8[axis] = _mm256_min_ps(lo8[axis], v);
+				hi8[axis] = _mm256_max_ps(hi8[axis], v);
+			}
+		}
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			lo[axis] = lowerMin(lo8[axis]);
+			hi[axis] = lowerMax(hi8[axis]);
+		}
+	}
+#endif
+	for (; i + 4 <= count; i += 4)
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			__m128 v = _mm_loadu_ps(&(*axes[axis])[i]);
+			lo[axis] = _mm_min_ps(lo[axis], v);
+			hi[axis] = _mm_max_ps(hi[axis], v);
+		}
+	}
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		box.min[axis] = horizontalMin(lo[axis]);
+		box.max[axis] = horizontalMax(hi[axis]);
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		glm::vec3 p(x[i], y[i], z[i]);
+		box.min = glm::min(box.min, p);
+		box.max = glm::max(box.max, p);
+	}
+	return box;
+}
+
+// bounds of vec3s in any layout, one point per register
+inline Aabb computeAabb(StridedView<const glm::vec3> points)
+{
+	const int64_t count = points.size();
+	Aabb box;
+	int64_t i = 0;
+#if PV_VIEW_SSE
+	using namespace view_detail;
+	if (count > 1)
+	{
+		__m128 lo = loadRow(points[0]), hi = lo;
+		for (i = 1; i + 1 < count; ++i)
+		{
+			__m128 p = loadRow(points[i]);
+			lo = _mm_min_ps(lo, p);
+			hi = _mm_max_ps(hi, p);
+		}
+		alignas(16) float l[4], h[4];
+		_mm_store_ps(l, lo);
+		_mm_store_ps(h, hi);
+		box.min = glm::vec3(l[0], l[1], l[2]);
+		box.max = glm::vec3(h[0], h[1], h[2]);
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		box.min = glm::min(box.min, points[i]);
+		box.max = glm::max(box.max, points[i]);
+	}
+	return box;
+}
+
+
+// Interleaved vertices <-> the Mesh's SoA streams. Vertex has no normals / tangents and Mesh
+// has no colors, those are left alone on either side.
+inline void verticesToMesh(const Vertex* vertices, int64_t count, Mesh& mesh)
+{
+	mesh.preVertData.resize(static_cast<uint64_t>(count));
+	copyView(memberView(vertices, count, &Vertex::position), StridedView<glm::vec3>(mesh.positions()));
+	copyView(memberView(vertices, count, &Vertex::texCoord), StridedView<glm::vec2>(mesh.uvs()));
+}
+inline void meshToVertices(Mesh& mesh, Vertex* vertices)
+{
+	const int64_t count = mesh.positions().size();
+	copyView(StridedView<const glm::vec3>(mesh.positions()), memberView(vertices, count, &Vertex::position));
+	copyView(StridedView<const glm::vec2>(mesh.uvs()), memberView(vertices, count, &Vertex::texCoord));
+}
+
+
+// Each kernel against the loop one would write without this file, on vertexCount random vertices
+inline void benchmarkViewAlgorithms(std::ostream& out, uint32_t vertexCount = 1000000)
+{
+	const int64_t count = vertexCount;
+	std::vector<Vertex> vertices(vertexCount);
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	for (Vertex& v : vertices)
+	{
+		v.position = glm::vec3(position(rng), position(rng), position(rng));
+		v.color = glm::vec3(1.0f);
+		v.texCoord = glm::vec2(position(rng), position(rng));
+	}
+	const glm::mat4 transform = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 2.0f, 3.0f)), 0.5f, glm::vec3(0.0f, 1.0f, 0.0f));
+
+	MultiArray<float, float, float> points({ vertexCount, vertexCount, vertexCount });
+	MultiArray<float, float, float> transformed({ vertexCount, vertexCount, vertexCount });
+	std::vector<glm::vec3> packed(vertexCount), packedReference(vertexCount);
+	std::vector<float> referenceX(vertexCount), referenceY(vertexCount), referenceZ(vertexCount);
+	Mesh mesh(2);
+	std::vector<Vertex> roundTrip(vertices);
+	StridedView<const glm::vec3> vertexPositions = memberView(vertices.data(), count, &Vertex::position);
+
+	const int ITERATIONS = 10;
+	auto timeNs = [&](const std::function<void()>& func)
+	{
+		func(); // warm up caches
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int it = 0; it < ITERATIONS; ++it) func();
+		return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count() / ITERATIONS;
+	};
+	auto close = [](float a, float b) { return std::abs(a - b) <= 1e-4f * std::max(1.0f, std::abs(a)); };
+
+	const char* simdName = PV_VIEW_AVX ? "AVX" : PV_VIEW_SSE ? "SSE" : "scalar";
+	out << "View algorithm benchmark: " << vertexCount << " vertices, " << simdName << " vs scalar loops" << std::endl;
+	auto report = [&](const char* name, double scalarNs, double simdNs)
+	{
+		out << "\t" << name << scalarNs / count << " ns/vertex scalar, " << simdNs / count << " ns/vertex " << simdName
+			<< " (" << scalarNs / simdNs << "x)" << std::endl;
+	};
+
+	{
+		double scalarNs = timeNs([&]() {
+			for (int64_t i = 0; i < count; ++i)
+			{
+				referenceX[i] = vertices[i].position.x;
+				referenceY[i] = vertices[i].position.y;
+				referenceZ[i] = vertices[i].position.z;
+			}
+		});
+		double simdNs = timeNs([&]() { transposeToSoA(vertexPositions, points.view<0>(), points.view<1>(), points.view<2>()); });
+		PV_ASSERT(std::equal(referenceX.begin(), referenceX.end(), points.view<0>().begin()) &&
+			std::equal(referenceY.begin(), referenceY.end(), points.view<1>().begin()) &&
+			std::equal(referenceZ.begin(), referenceZ.end(), points.view<2>().begin()), "benchmarkViewAlgorithms: transposeToSoA disagrees with scalar");
+		report("Vertex -> SoA xyz:      ", scalarNs, simdNs);
+	}
+	{
+		double scalarNs = timeNs([&]() {
+			for (int64_t i = 0; i < count; ++i)
+				packedReference[i] = glm::vec3(referenceX[i], referenceY[i], referenceZ[i]);
+		});
+		double simdNs = timeNs([&]() { transposeToAoS(points.view<0>(), points.view<1>(), points.view<2>(), StridedView<glm::vec3>(packed.data(), count)); });
+		PV_ASSERT(packed == packedReference, "benchmarkViewAlgorithms: transposeToAoS disagrees with scalar");
+		report("SoA xyz -> vec3:        ", scalarNs, simdNs);
+	}
+	{
+		double scalarNs = timeNs([&]() {
+			mesh.preVertData.resize(vertexCount);
+			ArrayView<glm::vec3> positions = mesh.positions();
+			ArrayView<glm::vec2> uvs = mesh.uvs();
+			for (int64_t i = 0; i < count; ++i)
+			{
+				positions[i] = vertices[i].position;
+				uvs[i] = vertices[i].texCoord;
+			}
+		});
+		double simdNs = timeNs([&]() { verticesToMesh(vertices.data(), count, mesh); });
+		PV_ASSERT(std::equal(packedReference.begin(), packedReference.end(), mesh.positions().begin()), "benchmarkViewAlgorithms: verticesToMesh disagrees with scalar");
+		report("Vertex -> Mesh streams: ", scalarNs, simdNs);
+
+		double backScalarNs = timeNs([&]() {
+			ArrayView<glm::vec3> positions = mesh.positions();
+			ArrayView<glm::vec2> uvs = mesh.uvs();
+			for (int64_t i = 0; i < count; ++i)
+			{
+				roundTrip[i].position = positions[i];
+				roundTrip[i].texCoord = uvs[i];
+			}
+		});
+		double backSimdNs = timeNs([&]() { meshToVertices(mesh, roundTrip.data()); });
+		PV_ASSERT(roundTrip == vertices, "benchmarkViewAlgorithms: meshToVertices does not round trip");
+		report("Mesh streams -> Vertex: ", backScalarNs, backSimdNs);
+	}
+	{
+		double scalarNs = timeNs([&]() {
+			auto in = zipStreams<0, 1, 2>(points);
+			auto result = zipStreams<0, 1, 2>(transformed);
+			for (int64_t i = 0; i < count; ++i)
+			{
+				glm::vec4 p = transform * glm::vec4(std::get<0>(in[i]), std::get<1>(in[i]), std::get<2>(in[i]), 1.0f);
+				std::get<0>(result[i]) = p.x;
+				std::get<1>(result[i]) = p.y;
+				std::get<2>(result[i]) = p.z;
+			}
+		});
+		std::vector<float> resultX(transformed.view<0>().begin(), transformed.view<0>().end());
+		double simdNs = timeNs([&]() {
+			transformPoints(transform, points.view<0>(), points.view<1>(), points.view<2>(), transformed.view<0>(), transformed.view<1>(), transformed.view<2>());
+		});
+		PV_ASSERT(std::equal(resultX.begin(), resultX.end(), transformed.view<0>().begin(), close), "benchmarkViewAlgorithms: SoA transformPoints disagrees with scalar");
+		report("transform SoA:          ", scalarNs, simdNs);
+	}
+	{
+		double scalarNs = timeNs([&]() {
+			for (int64_t i = 0; i < count; ++i)
+				packedReference[i] = glm::vec3(transform * glm::vec4(vertices[i].position, 1.0f));
+		});
+		double simdNs = timeNs([&]() { transformPoints(transform, vertexPositions, StridedView<glm::vec3>(packed.data(), count)); });
+		PV_ASSERT(std::equal(packed.begin(), packed.end(), packedReference.begin(),
+			[&](const glm::vec3& a, const glm::vec3& b) { return close(a.x, b.x) && close(a.y, b.y) && close(a.z, b.z); }),
+			"benchmarkViewAlgorithms: AoS transformPoints disagrees with scalar");
+		report("transform Vertex:       ", scalarNs, simdNs);
+	}
+	{
+		float scalarMin = 0.0f, scalarMax = 0.0f, simdMin = 0.0f, simdMax = 0.0f;
+		ArrayView<float> x = points.view<0>();
+		double scalarNs = timeNs([&]() {
+			scalarMin = std::numeric_limits<float>::infinity();
+			scalarMax = -std::numeric_limits<float>::infinity();
+			for (float v : x)
+			{
+				scalarMin = std::min(scalarMin, v);
+				scalarMax = std::max(scalarMax, v);
+			}
+		});
+		double simdNs = timeNs([&]() { minMax(x, simdMin, simdMax); });
+		PV_ASSERT(scalarMin == simdMin && scalarMax == simdMax, "benchmarkViewAlgorithms: minMax disagrees with scalar");
+		report("min/max:                ", scalarNs, simdNs);
+	}
+	{
+		Aabb scalarBox, soaBox, aosBox;
+		double scalarNs = timeNs([&]() {
+			scalarBox = Aabb();
+			for (const Vertex& v : vertices)
+			{
+				scalarBox.min = glm::min(scalarBox.min, v.position);
+				scalarBox.max = glm::max(scalarBox.max, v.position);
+			}
+		});
+		double soaNs = timeNs([&]() { soaBox = computeAabb(points.view<0>(), points.view<1>(), points.view<2>()); });
+		double aosNs = timeNs([&]() { aosBox = computeAabb(vertexPositions); });
+		PV_ASSERT(scalarBox.min == soaBox.min && scalarBox.max == soaBox.max &&
+			scalarBox.min == aosBox.min && scalarBox.max == aosBox.max, "benchmarkViewAlgorithms: computeAabb disagrees with scalar");
+		report("AABB SoA xyz:           ", scalarNs, soaNs);
+		report("AABB Vertex:            ", scalarNs, aosNs);
+	}
+}
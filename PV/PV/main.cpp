@@ -31,13 +31,33 @@
 #include "Macros.h"
 #include "Vertex.h" // has include dependencies
 #include "Mesh.h"	// has include dependencies
+#include "Instancing.h"
 #include "Texture.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+#include "PipelineCache.h"
+#include "ShaderManager.h"
+#include "JobSystem.h"
+#include "Memory.h"
+#include "ShaderVariants.h"
+#include "ShaderReflection.h"
+#include "Descriptors.h"
+#include "Culling.h"
+#include "GpuCulling.h"
+#include "TransformHierarchy.h"
+#include "Bvh.h"
+#include "OcclusionCulling.h"
+#include "RenderQueue.h"
+#include "RenderGraph.h"
+#include "ViewAlgorithms.h"
+#include "variant.h"
+#include "Entities.h"
 
 #include <chrono>
 #include "LoadModel.h"
 
 // @TODO convert indicies and vertices to use this!!!
-Mesh mesh(2, 3);
+Mesh mesh(2);
 /*
 const std::vector<Vertex> vertices = {
 { { -0.5f, -0.5f, 0.0f },{ 1.0f, 0.0f, 0.0f },{ 0.0f, 0.0f } },
@@ -89,6 +109,12 @@ public:
 		initRenderer();
 		runLoop();
 		cleanup();
+
+		if (PRINT_CPU_PROFILE)
+		{
+			CpuProfiler::get().printSummary(std::cout);
+			CpuProfiler::get().writeChromeTrace(CPU_TRACE_PATH);
+		}
 	}
 
 private:
@@ -107,11 +133,17 @@ private:
 		}
 	};
 
+	// the lists live in a frame arena, don't keep them past the frame
 	struct SwapChainSupportDetails
 	{
+		explicit SwapChainSupportDetails(LinearArena& arena)
+			: formats(ArenaAllocator<VkSurfaceFormatKHR>(arena))
+			, presentModes(ArenaAllocator<VkPresentModeKHR>(arena))
+		{ }
+
 		VkSurfaceCapabilitiesKHR capabilities;
-		std::vector<VkSurfaceFormatKHR> formats;
-		std::vector<VkPresentModeKHR> presentModes;
+		ArenaVector<VkSurfaceFormatKHR> formats;
+		ArenaVector<VkPresentModeKHR> presentModes;
 	};
 
 #pragma endregion
@@ -125,6 +157,66 @@ private:
 
 	const bool PRINT_AVAILABLE_VULKAN_EXTENSIONS = true;
 	const bool PRINT_DEBUG_LOGS = true;
+	const bool PRINT_GPU_PROFILE = true;
+	const char* GPU_TRACE_PATH = "gpu_trace.json"; // open in chrome://tracing
+	const bool PRINT_CPU_PROFILE = true;
+	const char* CPU_TRACE_PATH = "cpu_trace.json"; // open in chrome://tracing
+	const char* PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+	// build every shader variant at load on the job system instead of on first use
+	const bool PRECOMPILE_SHADER_VARIANTS = true;
+	const ShaderVariantKey DEFAULT_SHADER_VARIANT = ShaderVariantKey(SHADER_FEATURE_TEXTURE);
+
+	// copies of the model on a grid, all drawn by one instanced vkCmdDrawIndexed
+	const uint32_t INSTANCE_GRID_SIZE = 8;
+	const float INSTANCE_SPACING = 2.0f;
+	// Alternates frames between the instanced command buffers and ones with one draw per
+	// instance, then prints objects/second for both. Only the first BENCHMARK_INDEX_COUNT
+	// indices are drawn so the per draw cost isn't hidden behind rasterization.
+	const bool BENCHMARK_INSTANCING = false;
+	const uint32_t BENCHMARK_INDEX_COUNT = 3 * 64;
+	const uint32_t PER_INSTANCE_PROFILER_SLOT = 16; // + swap chain image index
+	// only upload and draw instances whose bounds touch the view frustum
+	const bool CPU_FRUSTUM_CULLING = true;
+	// prints objects/ns for the culling kernels on 1M random objects at startup
+	const bool BENCHMARK_CULLING = false;
+	// with CPU_FRUSTUM_CULLING, drops instances hidden behind other instances. Each instance occludes
+	// with a box OCCLUDER_BOX_SCALE the size of the model's bounds, it has to stay inside the model
+	const bool CPU_OCCLUSION_CULLING = true;
+	const float OCCLUDER_BOX_SCALE = 0.5f;
+	const uint32_t OCCLUSION_BUFFER_WIDTH = 320;
+	const uint32_t OCCLUSION_BUFFER_HEIGHT = 192;
+	// occluder triangles/ms and culled object rates on a synthetic city at startup
+	const bool BENCHMARK_OCCLUSION = false;
+	// RenderQueue sort ns/draw and binds saved on 100k synthetic draws at startup
+	const bool BENCHMARK_RENDER_QUEUE = false;
+	// compile a deferred style frame graph, print its barriers and transient memory
+	const bool BENCHMARK_RENDER_GRAPH = false;
+	// transposes, transforms, min/max and bounds over 1M vertices against plain loops at startup
+	const bool BENCHMARK_VIEW_ALGORITHMS = false;
+	// build, copy and visit 1M render commands and events as variants (and std::variant with C++17) at startup
+	const bool BENCHMARK_VARIANT = false;
+	// per frame temporaries come out of frameArenas, one arena per job thread per frame in flight
+	const uint32_t FRAME_ARENA_FRAMES = 2;
+	const size_t FRAME_ARENA_BLOCK_SIZE = 1 << 20;
+	// loadModel's temporaries, handed back to the heap once loading is done
+	const size_t IMPORT_ARENA_BLOCK_SIZE = 16 << 20;
+	// frame arenas, a scoped arena and a pool against the heap at startup
+	const bool BENCHMARK_MEMORY = false;
+	// 1M entities in an EntityWorld: batched creation, a movement system, changed-only bounds, batched destroy
+	const bool BENCHMARK_ENTITIES = false;
+	// old and new std::hash<Vertex> over chalet.obj's face corners: collisions, bucket spread, dedup time
+	const bool BENCHMARK_VERTEX_HASH = false;
+	// cull in a compute shader (shaders/cull.comp) instead, the draw's instance count never leaves the GPU.
+	// Takes over from CPU_FRUSTUM_CULLING, off while BENCHMARK_INSTANCING needs every instance in place.
+	const bool GPU_FRUSTUM_CULLING = !BENCHMARK_INSTANCING;
+	// waits for every culled frame and checks it against the CPU culler, runs fine on lavapipe
+	const bool VALIDATE_GPU_CULLING = false;
+	// times TransformHierarchy::update on 100k nodes with 1%, 10% and 100% of them changed at startup
+	const bool BENCHMARK_TRANSFORMS = false;
+	// left click prints the instance and triangle under the cursor, ray cast through sceneBvh
+	const bool PICK_INSTANCES = true;
+	// BVH build, refit and rays/second on a big mesh and on 10k instances at startup
+	const bool BENCHMARK_BVH = false;
 
 	const VkQueueFlagBits PV_VK_QUEUE_FLAGS = VK_QUEUE_GRAPHICS_BIT;
 
@@ -166,11 +258,25 @@ private:
 	VkRenderPass renderPass;
 	VkPipelineLayout pipelineLayout;
 	VkPipeline graphicsPipeline;
-
-
-	VkDescriptorPool descriptorPool;
+	PipelineCache pipelineCache;
+	ShaderManager shaderManager;
+	// kept alive with the pipeline layout so variants can be built on demand
+	VkShaderModule vertShaderModule;
+	VkShaderModule fragShaderModule;
+	PipelineVariantRegistry pipelineVariants;
+	// descriptor set / pipeline layouts derived from the shaders
+	LayoutCache layoutCache;
+	VertexInputState vertexInput;
+
+	JobSystem jobSystem;
+	FrameArenas frameArenas;	// per frame, per job thread temporaries
+	LinearArena importArena;	// asset import temporaries
+
+	DescriptorAllocator descriptorAllocator; // sets that live as long as the device
+	DescriptorSetCache descriptorSetCache; // material and culling sets, shared when they match
 	VkDescriptorSet  descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
+	std::vector<VkDescriptorSetLayoutBinding> descriptorSetBindings; // descriptorSetLayout's, for its update template
 
 	// @TODO make this work with lots of models in loading or somethingVkImage textureImage;
 	VkSampler textureSampler;
@@ -180,9 +286,8 @@ private:
 	uint32_t mipLevels;
 
 
-	VkImage depthImage;
-	VkDeviceMemory depthImageMemory;
-	VkImageView depthImageView;
+	RenderGraphTransients renderTargets; // behind the frame graph's transients, only the depth buffer so far
+	VkImageView depthImageView; // renderTargets', for the framebuffers
 
 	std::vector<Vertex> vertices;
 
@@ -197,12 +302,41 @@ private:
 	VkBuffer uniformBuffer;
 	VkDeviceMemory uniformBufferMemory;
 
+	// a spinning root with every instance below it, their world matrices become instanceTransforms
+	TransformHierarchy sceneTransforms = TransformHierarchy(1 + INSTANCE_GRID_SIZE * INSTANCE_GRID_SIZE);
+	uint32_t sceneRoot;
+	std::vector<uint32_t> instanceNodes;
+	TransformData instanceTransforms = TransformData(INSTANCE_GRID_SIZE * INSTANCE_GRID_SIZE);
+	MappedRingBuffer instanceRing; // one region per swap chain image: TransformData arrays, the indirect draw, GpuCullParams
+	VkDeviceSize instanceIndirectOffset;
+	VkDeviceSize instanceParamsOffset;
+	GpuCulling gpuCulling; // same region layout as instanceRing, what the draw reads with GPU_FRUSTUM_CULLING
+	std::vector<bool> gpuCullSubmitted;
+	GpuCullValidation gpuCullTotals;
+	CullingBounds instanceBounds = CullingBounds(INSTANCE_GRID_SIZE * INSTANCE_GRID_SIZE);
+	std::vector<uint32_t> visibleInstances;
+	OcclusionBuffer occlusionBuffer;
+	glm::vec3 modelBoundsMin;
+	glm::vec3 modelBoundsMax;
+	glm::mat4 viewProjection; // proj * view * model of the current frame
+	MeshBvh modelBvh;	// the model's triangles, in model space
+	SceneBvh sceneBvh;	// one instance of modelBvh per instance, refit as they move
+	bool pickButtonDown = false;
+
 	VkCommandPool commandPool;
 	std::vector<VkCommandBuffer> commandBuffers;
+	// BENCHMARK_INSTANCING only, same frame drawn with a draw call per instance
+	std::vector<VkCommandBuffer> perInstanceCommandBuffers;
+	RenderQueue perInstanceQueue; // their draws, one per instance, binds only issued once
+	double instancedRecordMs = 0.0;
+	double perInstanceRecordMs = 0.0;
+	uint64_t benchmarkFrame = 0;
 
 	VkSemaphore imageAvailableSemaphore;
 	VkSemaphore renderFinishedSemaphore;
 
+	GpuProfiler gpuProfiler;
+
 	std::vector<const char*> validationLayers =
 	{
 		"VK_LAYER_LUNARG_standard_validation",
@@ -215,12 +349,19 @@ private:
 	{
 		VK_KHR_SWAPCHAIN_EXTENSION_NAME
 	};
+	// enabled when the device has them, descriptor writes fall back to vkUpdateDescriptorSets
+	std::vector<const char*> optionalDeviceExtensions =
+	{
+		VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME
+	};
+	bool descriptorUpdateTemplates = false;
 #pragma endregion
 
 	// Methods
 #pragma region Init
 	// Init GLFW window
 	void initWindow() {
+		PV_PROFILE_FUNCTION();
 		
 		pvWindow = nullptr;
 		// initialize GLFW
@@ -236,19 +377,68 @@ private:
 	// init Vulkan
 	void initRenderer() 
 	{
+		PV_PROFILE_FUNCTION();
+		jobSystem.init();
+		frameArenas.init(jobSystem.threadCount(), FRAME_ARENA_FRAMES, FRAME_ARENA_BLOCK_SIZE);
+		importArena.init(IMPORT_ARENA_BLOCK_SIZE, memoryStats("Import"));
+		if (BENCHMARK_CULLING)
+		{
+			benchmarkCulling(jobSystem, std::cout);
+		}
+		if (BENCHMARK_TRANSFORMS)
+		{
+			benchmarkTransformHierarchy(jobSystem, std::cout);
+		}
+		if (BENCHMARK_BVH)
+		{
+			benchmarkBvh(jobSystem, std::cout);
+		}
+		if (BENCHMARK_OCCLUSION)
+		{
+			benchmarkOcclusionCulling(jobSystem, std::cout);
+		}
+		if (BENCHMARK_RENDER_QUEUE)
+		{
+			benchmarkRenderQueue(std::cout);
+		}
+		if (BENCHMARK_RENDER_GRAPH)
+		{
+			benchmarkRenderGraph(std::cout);
+		}
+		if (BENCHMARK_VIEW_ALGORITHMS)
+		{
+			benchmarkViewAlgorithms(std::cout);
+		}
+		if (BENCHMARK_VARIANT)
+		{
+			benchmarkVariant(std::cout);
+		}
+		if (BENCHMARK_MEMORY)
+		{
+			benchmarkMemory(jobSystem, std::cout);
+		}
+		if (BENCHMARK_ENTITIES)
+		{
+			benchmarkEntities(jobSystem, std::cout);
+		}
 		createInstance();
 		setupDebugCallback();
 		createSurface();
 		pickPhysicalDevice();
 		createLogicalDevice();
+		pipelineCache.init(physicalDevice, device, PIPELINE_CACHE_PATH);
+		shaderManager.init(ShaderPath(""), SpvPath(""));
+		layoutCache.init(device);
+		descriptorAllocator.init(device, descriptorUpdateTemplates);
+		descriptorSetCache.init(descriptorAllocator);
 		createSwapChain();
 		createSwapChainImageViews();
 		createRenderPass();
-		createDescriptorSetLayout();
 		createGraphicsPipeline();
 		createCommandPool();
+		gpuProfiler.init(physicalDevice, device, selectedQueueFamily.graphicsFamily);
 
-		createDepthResources();
+		createRenderTargets();
 
 		createFramebuffers();
 
@@ -259,6 +449,7 @@ private:
 
 		// New method
 		{
+			PV_PROFILE_SCOPE("LoadModelData");
 			std::string path = MeshPath("chalet.obj");
 			LoadedModelData loadedData;
 			LoadModelData(path, &loadedData);
@@ -269,11 +460,16 @@ private:
 		}
 		// make buffers
 		loadModel<true>();
+		importArena.release();
 		createVertexBuffer();
 		createIndexBuffer();
 		createUniformBuffer();
+		createInstanceBuffer();
+		if (GPU_FRUSTUM_CULLING)
+		{
+			createGpuCulling();
+		}
 
-		createDescriptorPool();
 		createDescriptorSet();
 
 		createCommandBuffers();
@@ -283,6 +479,7 @@ private:
 	// call for things like window resize
 	void recreateSwapChain()
 	{
+		PV_PROFILE_FUNCTION();
 		// wait till device is idel before changing stuff
 		// @Multi-threaded, this may require a mutex or jobs system flag
 		// at some point to work with multiple threads
@@ -295,13 +492,14 @@ private:
 		createSwapChainImageViews();
 		createRenderPass();
 		createGraphicsPipeline();
-		createDepthResources();
+		createRenderTargets();
 		createFramebuffers();
 		createCommandBuffers();
 	}
 
 	void createInstance()
 	{
+		PV_PROFILE_FUNCTION();
 		// print out all available extensions (DEBUG)
 		if (PRINT_AVAILABLE_VULKAN_EXTENSIONS)
 		{
@@ -367,6 +565,7 @@ private:
 	}
 	void setupDebugCallback()
 	{
+		PV_PROFILE_FUNCTION();
 		if (!enableValidationLayers) return;
 
 		VkDebugReportCallbackCreateInfoEXT createInfo = {};
@@ -392,6 +591,7 @@ private:
 	}
 	void createSurface()
 	{
+		PV_PROFILE_FUNCTION();
 		// we will let glfw handle our surface creation, but we can do this ourself 
 		// more directly by loading in the functions from the instance which has the extensions
 		// to create the surface. These extensions are incuded in the "required extesions for glfw"
@@ -403,6 +603,7 @@ private:
 	}
 	void pickPhysicalDevice()
 	{
+		PV_PROFILE_FUNCTION();
 		uint32_t deviceCount = 0;
 		vkEnumeratePhysicalDevices(pvinstance, &deviceCount, nullptr);
 
@@ -466,6 +667,7 @@ private:
 	}
 	void createLogicalDevice()
 	{
+		PV_PROFILE_FUNCTION();
 		// Create Present AND Graphics Queue. Push onto std::vector and then create them...
 
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
@@ -494,8 +696,26 @@ private:
 		deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 		deviceCreateInfo.pEnabledFeatures = &deviceFeatures;// Device Features Enable
 
-		deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
-		deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+		std::vector<const char*> enabledExtensions = deviceExtensions;
+		{
+			uint32_t extensionCount;
+			vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+			std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+			vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+			for (const char* extension : optionalDeviceExtensions)
+			{
+				for (const VkExtensionProperties& available : availableExtensions)
+				{
+					if (strcmp(available.extensionName, extension) == 0)
+					{
+						enabledExtensions.push_back(extension);
+						descriptorUpdateTemplates |= strcmp(extension, VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME) == 0;
+					}
+				}
+			}
+		}
+		deviceCreateInfo.ppEnabledExtensionNames = enabledExtensions.data();
+		deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
 
 		// Validation Layers
 		if (enableValidationLayers)
@@ -519,6 +739,7 @@ private:
 	}
 	void createSwapChain()
 	{
+		PV_PROFILE_FUNCTION();
 		SwapChainSupportDetails swapChainSupport = QuerySwapChainSupport(physicalDevice);
 
 		// Make choices about the capabilities of our swap chain
@@ -605,6 +826,7 @@ private:
 	}
 	void createSwapChainImageViews()
 	{
+		PV_PROFILE_FUNCTION();
 		swapChainImageViews.resize(swapChainImages.size());
 
 		for (size_t i = 0; i < swapChainImages.size(); ++i)
@@ -614,6 +836,7 @@ private:
 	}
 	void createRenderPass()
 	{
+		PV_PROFILE_FUNCTION();
 		// Attachment Array
 		std::array<VkAttachmentDescription, 2> attachments = {};
 
@@ -629,10 +852,10 @@ private:
 			// apply to stencil data ONLY
 			colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 			colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-			// don't care about initial state, going to clear before drawing
-			colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			// final layout should be ready for the swap chain to present
-			colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+			// the frame graph moves the swap chain image in and out of attachment layout, together
+			// with whatever else has to wait (or be waited on) at that point
+			colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 		}
 		// subpasses reference Color attachments by index
 		// If we wanted to  add another color to our fragment shader
@@ -653,7 +876,7 @@ private:
 			depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 			depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 			depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-			depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; // throw out existing data
+			depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL; // the graph discards it first
 			depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 		}
 		VkAttachmentReference depthAttachmentRef = {};
@@ -672,15 +895,8 @@ private:
 		subpass.pColorAttachments = &colorAttachmentRef;
 		subpass.pDepthStencilAttachment = &depthAttachmentRef; // can only have 1 depth buffer per subpasss
 
-		// Makes the render pass wait for VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BUT
-		// to be finished.. We need to wait for the swap chain to finish reading from the image
-		// before we can access it.
-		VkSubpassDependency dependency = {};
-		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency.dstSubpass = 0;
-		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
+		// No subpass dependencies, waiting for the swap chain image (and the previous frame's depth)
+		// is in the frame graph's barrier in front of the pass.
 
 		VkRenderPassCreateInfo renderPassInfo = {};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -688,77 +904,88 @@ private:
 		renderPassInfo.pAttachments = attachments.data();
 		renderPassInfo.subpassCount = 1;
 		renderPassInfo.pSubpasses = &subpass;
-		renderPassInfo.dependencyCount = 1;
-		renderPassInfo.pDependencies = &dependency;
+		renderPassInfo.dependencyCount = 0;
+		renderPassInfo.pDependencies = nullptr;
 
 
 		PV_VK_RUN(vkCreateRenderPass(device, &renderPassInfo, allocnullptr, &renderPass));
 	}
 
-	void createDescriptorSetLayout()
+	void createGraphicsPipeline()
 	{
-		VkDescriptorSetLayoutBinding uboLayoutBinding = {};
-		uboLayoutBinding.binding = 0;// binding ID: 0
-		uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		uboLayoutBinding.descriptorCount = 1;
-		uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-		uboLayoutBinding.pImmutableSamplers = nullptr;
+		PV_PROFILE_FUNCTION();
+		// compiled at runtime, or straight from the SPIR-V cache if the source didn't change
+		auto vertShaderCode = shaderManager.getSpirv("shader.vert", SHADER_STAGE_VERTEX); //@Speed copy
+		auto fragShaderCode = shaderManager.getSpirv("shader.frag", SHADER_STAGE_FRAGMENT); //@Speed copy
 
-		VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
-		samplerLayoutBinding.binding = 1; // binding ID: 1
-		samplerLayoutBinding.descriptorCount = 1;
-		samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		samplerLayoutBinding.pImmutableSamplers = nullptr;
-		samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		vertShaderModule = createShaderModule(vertShaderCode);
+		fragShaderModule = createShaderModule(fragShaderCode);
 
-		std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerLayoutBinding };
+		// Descriptor bindings and push constants come straight from the shaders. The layout cache
+		// hands back the same handles on recreateSwapChain, so descriptorSet stays valid.
+		ShaderReflection vertReflection = reflectSpirv(vertShaderCode);
+		ShaderReflection fragReflection = reflectSpirv(fragShaderCode);
+		PipelineLayoutDesc layoutDesc = mergeShaderLayouts({ &vertReflection, &fragReflection });
+		PV_ASSERT(layoutDesc.sets.size() == 1, "shader.vert/shader.frag are expected to use descriptor set 0 only");
 
-		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-		layoutInfo.pBindings = bindings.data();
+		descriptorSetLayout = layoutCache.getDescriptorSetLayout(layoutDesc.sets[0]);
+		descriptorSetBindings = layoutDesc.sets[0];
+		pipelineLayout = layoutCache.getPipelineLayout(layoutDesc);
 
-		PV_VK_RUN(vkCreateDescriptorSetLayout(device, &layoutInfo, allocnullptr, &descriptorSetLayout));
+		// binding 0 is per vertex, laid out like Vertex, bindings 1-3 are the instance transforms.
+		// Throws if that doesn't match what the shader reads.
+		vertexInput = VertexInputState();
+		vertexInput.add(GetInputDescription<Vertex::Layout>(0, VK_VERTEX_INPUT_RATE_VERTEX));
+		TransformData::addInputDescriptions(vertexInput, 1, Vertex::Layout::s_num_params);
+		validateVertexInput(vertReflection, vertexInput.attributes.data(), static_cast<uint32_t>(vertexInput.attributes.size()));
 
-	}
+		// every variant shares the modules, layout and fixed function state, only the specialization constants differ
+		pipelineVariants.init(device, &pipelineCache, [this](const VkSpecializationInfo* specialization, VkPipelineCache cache)
+		{
+			return createGraphicsPipelineVariant(specialization, cache);
+		});
+		if (PRECOMPILE_SHADER_VARIANTS)
+		{
+			pipelineVariants.precompile(allShaderVariants(), jobSystem);
+		}
+		graphicsPipeline = pipelineVariants.get(DEFAULT_SHADER_VARIANT);
 
-	void createGraphicsPipeline()
+		if (PRINT_DEBUG_LOGS)
+		{
+			std::cout << "Graphics pipelines ready, " << pipelineCache.creationCount << " created in " << pipelineCache.creationMs
+				<< " ms total (" << (pipelineCache.warm ? "warm" : "cold") << " cache)" << std::endl;
+		}
+	}
+	// Builds one variant of the graphics pipeline. Called from the job system during precompile,
+	// so it may only read state that is fixed until the next cleanupSwapChain.
+	VkPipeline createGraphicsPipelineVariant(const VkSpecializationInfo* specialization, VkPipelineCache cache)
 	{
-		auto vertShaderCode = readBinaryFile("../SPV/vert.spv"); //@Speed copy
-		auto fragShaderCode = readBinaryFile("../SPV/frag.spv"); //@Speed copy
-
-		VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-		VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-
 		VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
 		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
 		vertShaderStageInfo.module = vertShaderModule;
 		vertShaderStageInfo.pName = "main";
-		//vertShaderStageInfo.pSpecializationInfo; // used for setting constants
+		vertShaderStageInfo.pSpecializationInfo = specialization; // feature toggles, see ShaderVariants.h
 
 		VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
 		fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 		fragShaderStageInfo.module = fragShaderModule;
 		fragShaderStageInfo.pName = "main";
-		//vertShaderStageInfo.pSpecializationInfo; // used for setting constants 
+		fragShaderStageInfo.pSpecializationInfo = specialization;
 
 		VkPipelineShaderStageCreateInfo shaderStages[] =
 		{
 			vertShaderStageInfo, fragShaderStageInfo
 		};
 
-		// Get Bindings (shader data layout)
-		auto bindingDescription = Vertex::getBindingDescription();
-		auto attributeDescription = Vertex::getAttributeDescriptions();
-		// Setup vertex Input
+		// Setup vertex Input (validated against the shader in createGraphicsPipeline)
 		VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
 		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescription.size());
-		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescription.size());
-		vertexInputInfo.pVertexBindingDescriptions = bindingDescription.data(); // binding 0 is per tri, binding 1 is per instance
-		vertexInputInfo.pVertexAttributeDescriptions = attributeDescription.data();
+		vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(vertexInput.bindings.size());
+		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInput.attributes.size());
+		vertexInputInfo.pVertexBindingDescriptions = vertexInput.bindings.data(); // binding 0 is per tri, binding 1-3 are per instance
+		vertexInputInfo.pVertexAttributeDescriptions = vertexInput.attributes.data();
 
 		// setup Input Assembly (Draw Mode)
 		VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
@@ -884,21 +1111,6 @@ private:
 		depthStencil.front = {}; // Optional
 		depthStencil.back = {}; // Optional
 
-
-		// make an empty pipeline layout for now. This will later have things like worldViewMatrix
-		// and other constants which are passed on a per graphics pipeline basis
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		// Uniform/Sampler bindings
-		pipelineLayoutInfo.setLayoutCount = 1;
-		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-		// Constant values bindings
-		pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-		pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
-		
-
-		PV_VK_RUN(vkCreatePipelineLayout(device, &pipelineLayoutInfo, allocnullptr, &pipelineLayout));
-
 		// Create Grpahics Pipeline
 		VkGraphicsPipelineCreateInfo pipelineInfo = {};
 		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -931,14 +1143,17 @@ private:
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
 		pipelineInfo.basePipelineIndex = -1; // Optional
 
-		// @SPEED PipelineCache
-		vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, allocnullptr, &graphicsPipeline);
-
-		vkDestroyShaderModule(device, vertShaderModule, allocnullptr);
-		vkDestroyShaderModule(device, fragShaderModule, allocnullptr);
+		// the cache is loaded from disk at startup, so after the first run this (and every
+		// recreateSwapChain) skips most of the driver's shader compilation
+		VkPipeline pipeline;
+		auto pipelineStart = std::chrono::high_resolution_clock::now();
+		PV_VK_RUN(vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo, allocnullptr, &pipeline));
+		pipelineCache.recordCreation(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - pipelineStart).count());
+		return pipeline;
 	}
 	void createFramebuffers()
 	{
+		PV_PROFILE_FUNCTION();
 		// we want a frame buffer per swap chain image view
 		swapChainFramebuffers.resize(swapChainImageViews.size());
 
@@ -966,6 +1181,7 @@ private:
 	}
 	void createCommandPool()
 	{
+		PV_PROFILE_FUNCTION();
 		QueueFamilyIndices queueFamilyIndicies = findQueueFamilies(physicalDevice, PV_VK_QUEUE_FLAGS);
 
 		VkCommandPoolCreateInfo poolInfo = {};
@@ -976,18 +1192,26 @@ private:
 		PV_VK_RUN(vkCreateCommandPool(device, &poolInfo, allocnullptr, &commandPool));
 	}
 
-	void createDepthResources()
+	// Compiling a frame graph once makes its transients for this swap chain size, the graphs
+	// recorded into the command buffers get the same ones back from renderTargets.
+	void createRenderTargets()
 	{
-		VkFormat depthFormat = findDepthFormat();
-		createImage(swapChainExtent.width, swapChainExtent.height, 1, mipLevels, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory);
-		depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, mipLevels);
-		transitionImageLayout(depthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, mipLevels);
+		PV_PROFILE_FUNCTION();
+		renderTargets.init(physicalDevice, device);
+		RenderGraph graph;
+		const FrameGraph frame = buildFrameGraph(graph, 0, 0, "RenderPass", false);
+		depthImageView = graph.imageView(frame.depth);
+		if (PRINT_DEBUG_LOGS)
+		{
+			graph.printPlan(std::cout);
+		}
 	}
 
 
 	// uses command pool
 	void createTextureImage() 
 	{
+		PV_PROFILE_FUNCTION();
 		const char* lunaPath =   "../textures/LunaTooClose.jpg";
 		const char* statuePath = "../textures/statue512.jpg";
 		std::string chaletTex = TexturePath("chalet.jpg");
@@ -1031,111 +1255,19 @@ private:
 
 		createImage(texWidth, texHeight, 1, mipLevels, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
 
-		// transfer from staging buffer into textureImageMemory
-		{
-			// Make image able to recieve staging buffer data
-			transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
-			// transfer staging buffer data
-			copyBufferToImage(stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-
-			// transitioning to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL while generating mipmaps
-			// since the VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL is set on a per mipLevel basis.
-			generateMipmaps(textureImage, VK_FORMAT_R8G8B8A8_UNORM, texWidth, texHeight, mipLevels);
-		}
+		// copy into level 0, blit every level from the one above and leave them all ready to sample
+		uploadTexture(stagingBuffer, textureImage, VK_FORMAT_R8G8B8A8_UNORM, texWidth, texHeight, mipLevels);
 		
 		vkDestroyBuffer(device, stagingBuffer, allocnullptr);
 		vkFreeMemory(device, stagingBufferMemory, allocnullptr);
 
 	}
-	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
-	{
-		VkCommandBuffer singleTimeCommandBuffer = beginSingleTimeCommands();
-
-		VkImageMemoryBarrier barrier = {};
-		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		barrier.oldLayout = oldLayout;
-		barrier.newLayout = newLayout;
-		
-		// Used to change queue family ownership. Set to Ignored
-		// for our purposes of layout transition
-		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-		// image and its layout
-		barrier.image = image;
-		barrier.subresourceRange.baseMipLevel = 0;
-		barrier.subresourceRange.levelCount = mipLevels;
-		barrier.subresourceRange.baseArrayLayer = 0;
-		barrier.subresourceRange.layerCount = 1;
-
-		// depth/stencil buffer
-		if (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-			barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-
-			// Add stencil if its in the format
-			if (hasStencilComponent(format))
-			{
-				barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-			}
-		}
-		// color
-		else
-		{
-			barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		}
-
-		VkPipelineStageFlags sourceStage = 0;
-		VkPipelineStageFlags destinationStage = 0;
-		
-
-
-		// Undef -> Dst
-		if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) 
-		{
-			barrier.srcAccessMask = 0;
-			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-			sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-			destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		}
-		// Dst -> Shader
-		else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) 
-		{
-			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-			sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-			destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-		}
-		// Undef -> Depth/Stencil
-		else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-			barrier.srcAccessMask = 0;
-			barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-			sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-			destinationStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		}
-		else 
-		{
-			throw std::invalid_argument("unsupported layout transition!");
-		}
-
-
-		vkCmdPipelineBarrier(
-			singleTimeCommandBuffer,
-			sourceStage, destinationStage,
-			0,
-			0, nullptr,
-			0, nullptr,
-			1, &barrier
-		);
-
-		endSingleTimeCommands(singleTimeCommandBuffer);
-	}
-
-	// Assumes the the original image have been queues to be put into the image at level 0 mip
-	void generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels)
+	// Upload and mip chain as a render graph: each level is its own pass reading the level above,
+	// the graph transitions one level to TRANSFER_SRC while it moves the next to TRANSFER_DST and
+	// moves the whole chain to SHADER_READ_ONLY at the end.
+	void uploadTexture(VkBuffer stagingBuffer, VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels)
 	{
+		PV_PROFILE_FUNCTION();
 		// @SHIPPING @RELEASE @TODO Usually these are NOT generated at run-time/startup time and
 		// are instead kept as part of the textures on file so that they can instead just be loaded
 		// into the buffers for each level without having to generate them.
@@ -1154,135 +1286,87 @@ private:
 			}
 		}
 
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-		VkImageMemoryBarrier barrier = {};
-		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		barrier.image = image;
-		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		barrier.subresourceRange.baseArrayLayer = 0;
-		barrier.subresourceRange.layerCount = 1;
-		barrier.subresourceRange.levelCount = 1;
-
-		int32_t mipWidth = texWidth;
-		int32_t mipHeight = texHeight;
-
-		// push commands + barriers to make the mipmap levels
+		RenderGraph graph;
+		RenderImageDesc desc;
+		desc.format = imageFormat;
+		desc.width = static_cast<uint32_t>(texWidth);
+		desc.height = static_cast<uint32_t>(texHeight);
+		desc.mipLevels = mipLevels;
+		RenderResource texture = graph.importImage("Texture", image, VK_NULL_HANDLE, desc, ResourceUsage());
+		RenderResource staging = graph.importBuffer("Staging", stagingBuffer, 0, VK_WHOLE_SIZE, ResourceUsage());
+		graph.exportResource(texture, ResourceUsage::sampled());
+
+		graph.addPass("TextureUpload", [&](VkCommandBuffer cmd)
+		{
+			VkBufferImageCopy region = {};
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = 0;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+			region.imageOffset = { 0,0,0 };
+			region.imageExtent = { desc.width, desc.height, 1 };
+
+			GpuScope gpuScope = gpuProfiler.beginScope(cmd, GPU_PROFILER_UPLOAD_SLOT, "TextureUpload");
+			vkCmdCopyBufferToImage(cmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+			gpuProfiler.endScope(cmd, gpuScope);
+		}).read(staging, ResourceUsage::transferSrc()).write(texture, ResourceUsage::transferDst(), 0, 1);
+
+		// one scope over the whole chain, barriers included like before
+		GpuScope mipScope = {};
 		for (uint32_t i = 1; i < mipLevels; i++) 
 		{
-			const uint32_t srcMipLevel = i - 1;
-			const uint32_t dstMipLevel = i;
-			// specialize barrier for level of mipmap generation
-			// This also is used to make sure the original image has
-			// been completely loaded into level 0
-			{
-				barrier.subresourceRange.baseMipLevel = srcMipLevel; // mip level we are waiting on
-				barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-				vkCmdPipelineBarrier(commandBuffer,
-					VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-					0, nullptr,
-					0, nullptr,
-					1, &barrier);
-			}
-
-			// transformation to the next level of the mip map
+			graph.addPass("MipGeneration", [&, i](VkCommandBuffer cmd)
 			{
-				const int32_t newMipWidth = std::max(1, mipWidth / 2);
-				const int32_t newMipHeight = std::max(1, mipHeight / 2);
-
+				if (i == 1)
+				{
+					mipScope = gpuProfiler.beginScope(cmd, GPU_PROFILER_UPLOAD_SLOT, "MipGeneration");
+				}
+				const int32_t mipWidth = std::max(1, texWidth >> (i - 1));
+				const int32_t mipHeight = std::max(1, texHeight >> (i - 1));
 
 				// transformation for the next level of the mip map
 				VkImageBlit blit = {};
 				blit.srcOffsets[0] = { 0, 0, 0 };
 				blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
 				blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				blit.srcSubresource.mipLevel = srcMipLevel;
+				blit.srcSubresource.mipLevel = i - 1;
 				blit.srcSubresource.baseArrayLayer = 0;
 				blit.srcSubresource.layerCount = 1;
 				blit.dstOffsets[0] = { 0, 0, 0 };
-				blit.dstOffsets[1] = { newMipWidth, newMipHeight, 1 };
+				blit.dstOffsets[1] = { std::max(1, mipWidth / 2), std::max(1, mipHeight / 2), 1 };
 				blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				blit.dstSubresource.mipLevel = dstMipLevel;
+				blit.dstSubresource.mipLevel = i;
 				blit.dstSubresource.baseArrayLayer = 0;
 				blit.dstSubresource.layerCount = 1;
 
-				vkCmdBlitImage(commandBuffer,
+				vkCmdBlitImage(cmd,
 					image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
 					image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 					1, &blit,
 					VK_FILTER_LINEAR);
 
-				mipWidth = newMipWidth;
-				mipHeight = newMipHeight;
-			}
-
-			// transition the image to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL after the mip has been made for that level.
-			{
-				// barrier for mip map creation
-				barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-				barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-				barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-				vkCmdPipelineBarrier(commandBuffer,
-					VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-					0, nullptr,
-					0, nullptr,
-					1, &barrier);
-			}
+				if (i == mipLevels - 1)
+				{
+					gpuProfiler.endScope(cmd, mipScope);
+				}
+			}).read(texture, ResourceUsage::transferSrc(), i - 1, 1).write(texture, ResourceUsage::transferDst(), i, 1);
 		}
 
-		// The last mip map transition of image layout to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL is missed in the for loop above so we need to ensure it gets changed.
-		barrier.subresourceRange.baseMipLevel = mipLevels - 1;
-		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-		vkCmdPipelineBarrier(commandBuffer,
-			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-			0, nullptr,
-			0, nullptr,
-			1, &barrier);
-
+		graph.compile(renderTargets.requirementsFunc());
+		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+		graph.execute(commandBuffer);
 		endSingleTimeCommands(commandBuffer);
 	}
-	// Assumes that image in in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
-	{
-		VkCommandBuffer singleTimeCommandBuffer = beginSingleTimeCommands();
-
-		VkBufferImageCopy region = {};
-		region.bufferOffset = 0;
-		region.bufferRowLength = 0;
-		region.bufferImageHeight = 0;
-
-		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		region.imageSubresource.mipLevel = 0; // @MIP
-		region.imageSubresource.baseArrayLayer = 0;
-		region.imageSubresource.layerCount = 1;
-
-		region.imageOffset = { 0,0,0 };
-		region.imageExtent = { width, height, 1 };
-
-		vkCmdCopyBufferToImage(singleTimeCommandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-		endSingleTimeCommands(singleTimeCommandBuffer);
-	}
 	
 	void createTextureImageView()
 	{
+		PV_PROFILE_FUNCTION();
 		textureImageView = createImageView(textureImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
 	}
 
 	void createTextureSampler()
 	{
+		PV_PROFILE_FUNCTION();
 		VkSamplerCreateInfo samplerInfo = {};
 		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 
@@ -1382,6 +1466,7 @@ private:
 	template<bool removeDuplicateVerts>
 	void loadModel()
 	{
+		PV_PROFILE_FUNCTION();
 		const std::string chaletModelPath = MeshPath("chalet.obj");
 
 		tinyobj::attrib_t attrib;
@@ -1394,7 +1479,22 @@ private:
 		}
 
 
-		std::unordered_map<Vertex, uint32_t> uniqueVertices;
+		// the dedup map is gone with the scope and never frees on its own. A unique vertex is a
+		// position + uv pair, so only the corner count bounds it: reserved for that, it never rehashes.
+		size_t cornerCount = 0;
+		for (const auto& shape : shapes)
+		{
+			cornerCount += shape.mesh.indices.size();
+		}
+		ScopedArena importScope(importArena);
+		typedef std::pair<const Vertex, uint32_t> UniqueVertex;
+		std::unordered_map<Vertex, uint32_t, std::hash<Vertex>, std::equal_to<Vertex>, ArenaAllocator<UniqueVertex>> uniqueVertices(
+			0, std::hash<Vertex>(), std::equal_to<Vertex>(), importScope.allocator<UniqueVertex>());
+		if (removeDuplicateVerts)
+		{
+			uniqueVertices.reserve(cornerCount);
+		}
+		std::vector<Vertex> corners;
 
 		for (const auto& shape : shapes)
 		{
@@ -1415,29 +1515,43 @@ private:
 				
 				vertex.color = { 1.0f, 1.0f, 1.0f };
 
-				// remove duplicate verticies and use the indexBuffer to lookup the correct
-				// vertex to draw.
-				if (removeDuplicateVerts && uniqueVertices.count(vertex) == 0) {
-					uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-					vertices.push_back(vertex);
-				}
-				else if(!removeDuplicateVerts)
+				if (BENCHMARK_VERTEX_HASH)
 				{
-					vertices.push_back(vertex);
+					corners.push_back(vertex);
 				}
 
-				if(removeDuplicateVerts)
-					indices.push_back(uniqueVertices[vertex]);
+				// remove duplicate verticies and use the indexBuffer to lookup the correct
+				// vertex to draw, one lookup per corner
+				if (removeDuplicateVerts)
+				{
+					auto inserted = uniqueVertices.emplace(vertex, static_cast<uint32_t>(vertices.size()));
+					if (inserted.second)
+					{
+						vertices.push_back(vertex);
+					}
+					indices.push_back(inserted.first->second);
+				}
 				else
+				{
+					vertices.push_back(vertex);
 					indices.push_back(indices.size());
+				}
 			}
 		}
 
+		if (BENCHMARK_VERTEX_HASH)
+		{
+			benchmarkVertexHash(corners, std::cout);
+		}
+
 		std::cout << "UniqueVerts: " << uniqueVertices.size() << std::endl;
+		PV_PROFILE_COUNTER("UniqueVerts", uniqueVertices.size());
+		PV_PROFILE_COUNTER("Indices", indices.size());
 	}
 
 	void createVertexBuffer()
 	{
+		PV_PROFILE_FUNCTION();
 		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
 
 		// @SPEED treated as a temporary, this may we wasteful on startup
@@ -1470,6 +1584,7 @@ private:
 	}
 	void createIndexBuffer()
 	{
+		PV_PROFILE_FUNCTION();
 		VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
 
 		// @SPEED treated as a temporary, this may we wasteful on startup
@@ -1495,6 +1610,7 @@ private:
 	
 	void createUniformBuffer()
 	{
+		PV_PROFILE_FUNCTION();
 		VkDeviceSize bufferSize = sizeof(UniformBufferObject);
 		createBuffer(
 			bufferSize,
@@ -1503,6 +1619,97 @@ private:
 			uniformBuffer,
 			uniformBufferMemory);
 	}
+	void createInstanceBuffer()
+	{
+		PV_PROFILE_FUNCTION();
+		// centered grid on the xy plane of the root
+		sceneRoot = sceneTransforms.addNode(TransformHierarchy::NO_PARENT);
+		const float gridCenter = (INSTANCE_GRID_SIZE - 1) * 0.5f;
+		for (uint32_t i = 0; i < instanceTransforms.count; ++i)
+		{
+			float x = (i % INSTANCE_GRID_SIZE - gridCenter) * INSTANCE_SPACING;
+			float y = (i / INSTANCE_GRID_SIZE - gridCenter) * INSTANCE_SPACING;
+			instanceNodes.push_back(sceneTransforms.addNode(sceneRoot, glm::vec3(x, y, 0.0f)));
+		}
+		sceneTransforms.update(jobSystem);
+		writeWorldTransforms(sceneTransforms, instanceNodes.data(), instanceTransforms.count, instanceTransforms);
+
+		// model space bounds, every instance's culling bounds are derived from these
+		modelBoundsMin = glm::vec3(std::numeric_limits<float>::max());
+		modelBoundsMax = glm::vec3(-std::numeric_limits<float>::max());
+		for (const Vertex& vertex : vertices)
+		{
+			modelBoundsMin = glm::min(modelBoundsMin, vertex.position);
+			modelBoundsMax = glm::max(modelBoundsMax, vertex.position);
+		}
+		if (PICK_INSTANCES)
+		{
+			modelBvh.build(&vertices[0].position, sizeof(Vertex), indices.data(), static_cast<uint32_t>(indices.size() / 3), &jobSystem);
+			for (uint32_t i = 0; i < instanceTransforms.count; ++i)
+			{
+				sceneBvh.addInstance(&modelBvh, instanceTransforms.world(i));
+			}
+			sceneBvh.build(&jobSystem);
+		}
+
+		// rewritten every frame, so keep it host visible and mapped instead of staging into device local memory.
+		// 256 is the largest min*BufferOffsetAlignment Vulkan allows, cull.comp binds the draw and the params directly
+		const VkDeviceSize transformBytes = instanceTransforms.data.totalMemory();
+		instanceIndirectOffset = MappedRingBuffer::alignUp(transformBytes, 256);
+		instanceParamsOffset = MappedRingBuffer::alignUp(instanceIndirectOffset + sizeof(VkDrawIndexedIndirectCommand), 256);
+		const VkDeviceSize regionSize = MappedRingBuffer::alignUp(instanceParamsOffset + sizeof(GpuCullParams), 256);
+		const uint32_t regionCount = static_cast<uint32_t>(swapChainImages.size());
+
+		VkBuffer buffer;
+		VkDeviceMemory memory;
+		createBuffer(regionSize * regionCount,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, memory);
+		instanceRing.init(device, buffer, memory, regionSize, regionCount);
+
+		for (uint32_t i = 0; i < regionCount; ++i)
+		{
+			memcpy(instanceRing.region(i), instanceTransforms.data.data(), static_cast<size_t>(transformBytes));
+			writeInstanceDraw(i, instanceTransforms.count);
+		}
+	}
+	void createGpuCulling()
+	{
+		PV_PROFILE_FUNCTION();
+		GpuCullRegionLayout layout;
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			layout.arrayOffsets[i] = instanceTransforms.data.arrayOffset(i);
+		}
+		layout.indirectOffset = instanceIndirectOffset;
+		layout.paramsOffset = instanceParamsOffset;
+		layout.regionSize = instanceRing.regionSize;
+
+		// only ever touched by the GPU, unless it has to be read back for validation
+		const VkMemoryPropertyFlags properties = VALIDATE_GPU_CULLING ?
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		VkBuffer buffer;
+		VkDeviceMemory memory;
+		createBuffer(layout.regionSize * instanceRing.regionCount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			properties, buffer, memory);
+
+		gpuCulling.init(device, shaderManager.getSpirv("cull.comp", SHADER_STAGE_COMPUTE), layoutCache, descriptorSetCache, descriptorAllocator, pipelineCache.cache,
+			instanceRing, buffer, memory, VALIDATE_GPU_CULLING, layout);
+		gpuCullSubmitted.assign(instanceRing.regionCount, false);
+	}
+	void writeInstanceDraw(uint32_t region, uint32_t instanceCount)
+	{
+		VkDrawIndexedIndirectCommand draw = {};
+		draw.indexCount = drawIndexCount();
+		draw.instanceCount = instanceCount;
+		memcpy(static_cast<char*>(instanceRing.region(region)) + instanceIndirectOffset, &draw, sizeof(draw));
+	}
+	uint32_t drawIndexCount() const
+	{
+		return BENCHMARK_INSTANCING ?
+			std::min(BENCHMARK_INDEX_COUNT, static_cast<uint32_t>(indices.size())) : static_cast<uint32_t>(indices.size());
+	}
 	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemeory)
 	{
 		VkBufferCreateInfo bufferInfo = {};
@@ -1538,82 +1745,29 @@ private:
 		copyRegion.srcOffset = 0;
 		copyRegion.dstOffset = 0;
 		copyRegion.size = size;
+		GpuScope gpuScope = gpuProfiler.beginScope(singleUseCommandBuffer, GPU_PROFILER_UPLOAD_SLOT, "BufferUpload");
 		vkCmdCopyBuffer(singleUseCommandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+		gpuProfiler.endScope(singleUseCommandBuffer, gpuScope);
 
 		endSingleTimeCommands(singleUseCommandBuffer);
 	}
 
-	void createDescriptorPool()
-	{
-		const VkDescriptorPoolSize poolSizes[] = 
-		{ 
-			// Type , Count
-			{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1},
-			{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1},
-		};
-		
-		VkDescriptorPoolCreateInfo poolInfo = {};
-		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		poolInfo.poolSizeCount = sizeof(poolSizes)/sizeof(poolSizes[0]);
-		poolInfo.pPoolSizes = poolSizes;
-		poolInfo.maxSets = 1;
-
-		PV_VK_RUN(vkCreateDescriptorPool(device, &poolInfo, allocnullptr, &descriptorPool));
-	}
+	// binding 0 the UBO, binding 1 the texture. Another object with the same buffer and texture
+	// gets this very set back from the cache.
 	void createDescriptorSet()
 	{
-		// allocate Descriptor Sets
+		PV_PROFILE_FUNCTION();
+		const DescriptorTemplate& setTemplate = descriptorAllocator.getTemplate(descriptorSetLayout, descriptorSetBindings);
+		descriptorSet = descriptorSetCache.get(setTemplate,
 		{
-			VkDescriptorSetLayout layouts[] = { descriptorSetLayout };
-			VkDescriptorSetAllocateInfo allocInfo = {};
-			allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-			allocInfo.descriptorPool = descriptorPool;
-			allocInfo.descriptorSetCount = 1;
-			allocInfo.pSetLayouts = layouts;
-
-			PV_VK_RUN(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
-		}
-
-		std::array<VkWriteDescriptorSet, 2> descWrite = {};
-		// UBO Description
-
-		VkDescriptorBufferInfo bufferInfo = {};
-		{
-			VkWriteDescriptorSet& desc = descWrite[0];
-			bufferInfo.buffer = uniformBuffer;
-			bufferInfo.offset = 0;
-			bufferInfo.range = sizeof(UniformBufferObject);
-
-			desc.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			desc.dstSet = descriptorSet;
-			desc.dstBinding = 0;
-			desc.dstArrayElement = 0;
-			desc.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			desc.descriptorCount = 1;
-			desc.pBufferInfo = &bufferInfo;
-		}
-		VkDescriptorImageInfo imageInfo = {};
-		// Sampler Description
-		{
-			VkWriteDescriptorSet& desc = descWrite[1];
-			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfo.imageView = textureImageView;
-			imageInfo.sampler = textureSampler;
-
-			desc.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			desc.dstSet = descriptorSet;
-			desc.dstBinding = 1;
-			desc.dstArrayElement = 0;
-			desc.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			desc.descriptorCount = 1;
-			desc.pImageInfo = &imageInfo;
-		}
-
-		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descWrite.size()), descWrite.data(), 0, nullptr);
+			DescriptorInfo(uniformBuffer, 0, sizeof(UniformBufferObject)),
+			DescriptorInfo(textureSampler, textureImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		});
 	}
 
 	void createCommandBuffers()
 	{
+		PV_PROFILE_FUNCTION();
 		commandBuffers.resize(swapChainFramebuffers.size());
 
 		VkCommandBufferAllocateInfo allocInfo = {};
@@ -1624,26 +1778,131 @@ private:
 
 		PV_VK_RUN(vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()));
 
-		// @FUN, make opacity less than 1.0f and see what happens... Blur effect?
-		// clear values for the Color and Depth Attachements
-		std::array<VkClearValue, 2> clearValues = {};
-		clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
-		clearValues[1].depthStencil = { 1.0f, 0 };
-
+		auto recordStart = std::chrono::high_resolution_clock::now();
 		for (size_t i = 0; i < commandBuffers.size(); ++i)
 		{
-			VkCommandBufferBeginInfo beginInfo = {};
-			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-			beginInfo.pInheritanceInfo = nullptr; // Optional, for secondary command buffers
-			
-			PV_VK_RUN(vkBeginCommandBuffer(commandBuffers[i], &beginInfo));
+			recordCommandBuffer(commandBuffers[i], static_cast<uint32_t>(i), static_cast<uint32_t>(i), "RenderPass", false);
+		}
+		instancedRecordMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
+
+		if (BENCHMARK_INSTANCING)
+		{
+			perInstanceCommandBuffers.resize(commandBuffers.size());
+			PV_VK_RUN(vkAllocateCommandBuffers(device, &allocInfo, perInstanceCommandBuffers.data()));
+			buildPerInstanceQueue();
+
+			recordStart = std::chrono::high_resolution_clock::now();
+			for (size_t i = 0; i < perInstanceCommandBuffers.size(); ++i)
+			{
+				recordCommandBuffer(perInstanceCommandBuffers[i], static_cast<uint32_t>(i), PER_INSTANCE_PROFILER_SLOT + static_cast<uint32_t>(i), "RenderPassPerInstance", true);
+			}
+			perInstanceRecordMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
+		}
+	}
+	// Every instance as its own draw of the model. Same key for all of them, so the stable sort
+	// keeps instance order and batch i draws instance i straight out of the ring.
+	void buildPerInstanceQueue()
+	{
+		perInstanceQueue = RenderQueue();
+		const uint32_t pipeline = perInstanceQueue.addPipeline(graphicsPipeline, pipelineLayout);
+		const uint32_t material = perInstanceQueue.addMaterial(descriptorSet);
+		RenderQueue::Mesh model = {};
+		model.vertexBuffer = vertexBuffer;
+		model.indexBuffer = indexBuffer;
+		model.indexType = VK_INDEX_TYPE_UINT32;
+		model.indexCount = drawIndexCount();
+		const uint32_t mesh = perInstanceQueue.addMesh(model);
+		for (uint32_t instance = 0; instance < instanceTransforms.count; ++instance)
+		{
+			perInstanceQueue.submit(pipeline, material, mesh, instance, 0.0f);
+		}
+		perInstanceQueue.build(false);
+		if (PRINT_DEBUG_LOGS)
+		{
+			std::cout << "Per instance queue: " << perInstanceQueue.stats.draws << " draws, " << perInstanceQueue.stats.binds << " binds instead of "
+				<< perInstanceQueue.stats.naiveBinds << ", sorted in " << perInstanceQueue.stats.sortNs << " ns" << std::endl;
+		}
+	}
+	struct FrameGraph
+	{
+		RenderResource swapChainImage;
+		RenderResource depth;
+		RenderResource instances;	// this image's region of the instance ring, or of the culled output
+	};
+	RenderImageDesc depthDesc()
+	{
+		RenderImageDesc desc;
+		desc.format = findDepthFormat();
+		desc.width = swapChainExtent.width;
+		desc.height = swapChainExtent.height;
+		desc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT | (hasStencilComponent(desc.format) ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+		return desc;
+	}
+	// One frame into the swap chain image imageIndex: with GPU culling the draw is reset and culled
+	// into the culled output's region first, then the scene pass reads it. Compiled, with renderTargets
+	// behind its transients. drawPerInstance: one vkCmdDrawIndexed per instance instead of a single
+	// instanced one (BENCHMARK_INSTANCING)
+	FrameGraph buildFrameGraph(RenderGraph& graph, uint32_t imageIndex, uint32_t profilerSlot, const char* scopeName, bool drawPerInstance)
+	{
+		// no ring yet when createRenderTargets runs at startup, only the transients matter then
+		const uint32_t instanceRegionIndex = instanceRing.regionCount > 0 ? imageIndex % instanceRing.regionCount : 0;
+		const bool gpuCulled = GPU_FRUSTUM_CULLING && !drawPerInstance;
+		const VkBuffer instanceBuffer = gpuCulled ? gpuCulling.outputBuffer : instanceRing.buffer;
+		const VkDeviceSize instanceRegion = instanceRing.regionOffset(instanceRegionIndex);
+
+		FrameGraph frame;
+		RenderImageDesc swapChainDesc;
+		swapChainDesc.format = swapChainImageFormat;
+		swapChainDesc.width = swapChainExtent.width;
+		swapChainDesc.height = swapChainExtent.height;
+		frame.swapChainImage = graph.importImage("SwapChainImage", imageIndex < swapChainImages.size() ? swapChainImages[imageIndex] : VK_NULL_HANDLE,
+			VK_NULL_HANDLE, swapChainDesc, ResourceUsage::acquired());
+		graph.exportResource(frame.swapChainImage, ResourceUsage::present());
+		frame.depth = graph.createImage("Depth", depthDesc());
+
+		const ResourceUsage drawRead = ResourceUsage::vertexInput() | ResourceUsage::drawIndirect();
+		if (gpuCulled)
+		{
+			// the ring is written by the host before the submit, the culled output was last read by this region's previous draw
+			RenderResource ring = graph.importBuffer("InstanceRing", instanceRing.buffer, instanceRegion, instanceRing.regionSize, ResourceUsage());
+			frame.instances = graph.importBuffer("CulledInstances", instanceBuffer, instanceRegion, instanceRing.regionSize, drawRead);
+			if (VALIDATE_GPU_CULLING)
+			{
+				graph.exportResource(frame.instances, ResourceUsage::hostRead());
+			}
+
+			graph.addPass("GpuCullReset", [=](VkCommandBuffer cmd)
+			{
+				gpuCulling.recordReset(cmd, instanceRegionIndex, drawIndexCount());
+			}).write(frame.instances, ResourceUsage::transferDst());
+			graph.addPass("GpuCulling", [=](VkCommandBuffer cmd)
+			{
+				GpuScope cullScope = gpuProfiler.beginScope(cmd, profilerSlot, "GpuCulling");
+				gpuCulling.recordDispatch(cmd, instanceRegionIndex, instanceTransforms.count);
+				gpuProfiler.endScope(cmd, cullScope);
+			}).read(ring, ResourceUsage::storageRead(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT))
+				.write(frame.instances, ResourceUsage::storageWrite(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT));
+		}
+		else
+		{
+			frame.instances = graph.importBuffer("InstanceRing", instanceBuffer, instanceRegion, instanceRing.regionSize, ResourceUsage());
+		}
+
+		graph.addPass("Scene", [=](VkCommandBuffer commandBuffer)
+		{
+			GpuScope renderPassScope = gpuProfiler.beginScope(commandBuffer, profilerSlot, scopeName);
+
+			// @FUN, make opacity less than 1.0f and see what happens... Blur effect?
+			// clear values for the Color and Depth Attachements
+			std::array<VkClearValue, 2> clearValues = {};
+			clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+			clearValues[1].depthStencil = { 1.0f, 0 };
 
 			VkRenderPassBeginInfo renderPassInfo = {};
 			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 			// setup frame buffer data
 			renderPassInfo.renderPass = renderPass;
-			renderPassInfo.framebuffer = swapChainFramebuffers[i];
+			renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
 			renderPassInfo.renderArea.offset = {0,0};
 			renderPassInfo.renderArea.extent = swapChainExtent; // @TODO, make it so that we dont' need to remake all our command buffers on resize
 			// Set Clear Color
@@ -1653,35 +1912,78 @@ private:
 			renderPassInfo.pClearValues = clearValues.data();
 
 			// begin render pass!
-			vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-			// bind the graphics pipeline to the command buffer!
-			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-			const VkBuffer vertexbuffers[] = { vertexBuffer };
-			const VkDeviceSize offsets[] = { 0 };
+			// binding 0: mesh, bindings 1-3: this image's region of the instance ring, one binding per TransformData array.
+			// With GPU culling the same region of the culled output instead.
+			const VkBuffer vertexbuffers[] = { vertexBuffer, instanceBuffer, instanceBuffer, instanceBuffer };
+			const VkDeviceSize offsets[] =
+			{
+				0,
+				instanceRegion + instanceTransforms.data.arrayOffset(0),
+				instanceRegion + instanceTransforms.data.arrayOffset(1),
+				instanceRegion + instanceTransforms.data.arrayOffset(2),
+			};
 			const uint32_t vertexBufferCount = (sizeof(vertexbuffers) / sizeof(vertexbuffers[0]));
-			uint32_t bindingCounter = 0;
-			vkCmdBindVertexBuffers(commandBuffers[i], bindingCounter++, vertexBufferCount, vertexbuffers, offsets);
 
-			// VK_INDEX_TYPE_UINT16 should be a field of the warpper since we don't need it for
-			// models which are less than 65000 verticies which should be most things
-			vkCmdBindIndexBuffer(commandBuffers[i], indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+			if (drawPerInstance)
+			{
+				// the queue binds the pipeline, descriptor set and model, the instance arrays are ours
+				vkCmdBindVertexBuffers(commandBuffer, 1, vertexBufferCount - 1, vertexbuffers + 1, offsets + 1);
+				perInstanceQueue.record(commandBuffer);
+			}
+			else
+			{
+				// bind the graphics pipeline to the command buffer!
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+
+				uint32_t bindingCounter = 0;
+				vkCmdBindVertexBuffers(commandBuffer, bindingCounter, vertexBufferCount, vertexbuffers, offsets);
 
-			vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+				// VK_INDEX_TYPE_UINT16 should be a field of the warpper since we don't need it for
+				// models which are less than 65000 verticies which should be most things
+				vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
 
-			vkCmdDrawIndexed(commandBuffers[i], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+				// the instance count changes with culling every frame, updateInstanceData or cull.comp writes it
+				vkCmdDrawIndexedIndirect(commandBuffer, instanceBuffer, instanceRegion + instanceIndirectOffset, 1, sizeof(VkDrawIndexedIndirectCommand));
+			}
 
 			// end the render pass
-			vkCmdEndRenderPass(commandBuffers[i]);
-			// end the command buffer, hopefully everythign worked...
-			PV_VK_RUN(vkEndCommandBuffer(commandBuffers[i]));
-		}
+			vkCmdEndRenderPass(commandBuffer);
+			gpuProfiler.endScope(commandBuffer, renderPassScope);
+		}).write(frame.swapChainImage, ResourceUsage::colorAttachment())
+			.write(frame.depth, ResourceUsage::depthAttachment())
+			.read(frame.instances, drawRead);
 
+		graph.compile(renderTargets.requirementsFunc());
+		renderTargets.realize(graph);
+		return frame;
+	}
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t profilerSlot, const char* scopeName, bool drawPerInstance)
+	{
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+		beginInfo.pInheritanceInfo = nullptr; // Optional, for secondary command buffers
+		
+		PV_VK_RUN(vkBeginCommandBuffer(commandBuffer, &beginInfo));
 
+		// one profiler slot per swap chain image, these command buffers are resubmitted every frame
+		gpuProfiler.clearSlot(profilerSlot);
+
+		// the barriers between culling, the draw and present come from the graph
+		RenderGraph graph;
+		buildFrameGraph(graph, imageIndex, profilerSlot, scopeName, drawPerInstance);
+		graph.execute(commandBuffer);
+
+		// end the command buffer, hopefully everythign worked...
+		PV_VK_RUN(vkEndCommandBuffer(commandBuffer));
 	}
 	void createSemaphores()
 	{
+		PV_PROFILE_FUNCTION();
 		VkSemaphoreCreateInfo semaphoreInfo = {};
 		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
@@ -1756,6 +2058,7 @@ private:
 	// so that it doesn't block for so long OR we make a proper job system.
 	void endSingleTimeCommands(VkCommandBuffer commandBuffer)
 	{
+		PV_PROFILE_FUNCTION();
 		vkEndCommandBuffer(commandBuffer);
 
 		VkSubmitInfo submitInfo = {};
@@ -1764,13 +2067,14 @@ private:
 		submitInfo.pCommandBuffers = &commandBuffer;
 
 		vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+		gpuProfiler.markSubmitted(GPU_PROFILER_UPLOAD_SLOT);
 		vkQueueWaitIdle(graphicsQueue);
 
 		vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 	}
 
 	// helpers for swap chain creation
-	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats)
+	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const ArenaVector<VkSurfaceFormatKHR>& availableFormats)
 	{
 		// surface has 1 format, which is to say no requirements on the format.
 		// we then will use our prefered VK_FORMAT_B8G8R8A8
@@ -1788,7 +2092,7 @@ private:
 		// prefered not given, lets just settle with the first (probably best) format given to us
 		return availableFormats[0];
 	}
-	VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR> availablePresentModes) 
+	VkPresentModeKHR chooseSwapPresentMode(const ArenaVector<VkPresentModeKHR>& availablePresentModes) 
 	{
 		VkPresentModeKHR bestMode = VK_PRESENT_MODE_FIFO_KHR;
 
@@ -2025,7 +2329,7 @@ private:
 
 	SwapChainSupportDetails QuerySwapChainSupport(VkPhysicalDevice device)
 	{
-		SwapChainSupportDetails details;
+		SwapChainSupportDetails details(frameArenas.current());
 
 		// Get Capabilities
 		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
@@ -2110,34 +2414,246 @@ private:
 	{
 		while (glfwWindowShouldClose(pvWindow) == false)
 		{
+			PV_PROFILE_FRAME();
+			PV_PROFILE_SCOPE("Frame");
 
-			glfwPollEvents();
+			{
+				PV_PROFILE_SCOPE("PollEvents");
+				glfwPollEvents();
+			}
 			glfwGetWindowSize(this->pvWindow, &pvWindowWidth, &pvWindowHeight);
 			updateUniformBuffer();
+			if (PICK_INSTANCES)
+			{
+				pickInstance();
+			}
 			drawFrame();
 		}
 
 		// wait for the device to finish so that we can clean it up properly!
 		vkDeviceWaitIdle(device);
+
+		if (PRINT_GPU_PROFILE && gpuProfiler.enabled)
+		{
+			for (uint32_t i = 0; i < swapChainImages.size(); ++i)
+			{
+				gpuProfiler.collect(i);
+				if (BENCHMARK_INSTANCING)
+					gpuProfiler.collect(PER_INSTANCE_PROFILER_SLOT + i);
+			}
+			gpuProfiler.collect(GPU_PROFILER_UPLOAD_SLOT);
+
+			gpuProfiler.printSummary(std::cout);
+			gpuProfiler.writeChromeTrace(GPU_TRACE_PATH);
+		}
+
+		if (PRINT_DEBUG_LOGS)
+		{
+			pipelineCache.printStats(std::cout);
+			shaderManager.printStats(std::cout);
+			pipelineVariants.printStats(std::cout);
+			layoutCache.printStats(std::cout);
+			descriptorAllocator.printStats(std::cout);
+			descriptorSetCache.printStats(std::cout);
+			printMemoryStats(std::cout);
+		}
+
+		if (VALIDATE_GPU_CULLING && GPU_FRUSTUM_CULLING)
+		{
+			std::cout << "GPU culling validation: " << gpuCullTotals.gpuVisible << " visible on the GPU, " << gpuCullTotals.cpuVisible
+				<< " on the CPU, " << gpuCullTotals.borderline << " borderline differences" << std::endl;
+		}
+
+		if (BENCHMARK_INSTANCING)
+		{
+			printInstancingBenchmark();
+		}
 	}
 
-	const float fieldOfView = 45.0f;
-	void updateUniformBuffer()
+	void printInstancingBenchmark()
+	{
+		const uint32_t objects = instanceTransforms.count;
+		const uint32_t commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+		std::cout << "Instancing benchmark: " << objects << " objects, "
+			<< std::min(BENCHMARK_INDEX_COUNT, static_cast<uint32_t>(indices.size())) << " indices each" << std::endl;
+
+		auto report = [&](const char* label, uint32_t drawCalls, double recordMs, const GpuScopeStats* gpu)
+		{
+			double recordMsPerBuffer = recordMs / commandBufferCount;
+			std::cout << "\t" << label << ": " << drawCalls << " draw calls, recording " << recordMsPerBuffer << " ms ("
+				<< drawCalls / (recordMsPerBuffer / 1000.0) << " draws/s CPU)";
+			if (gpu != nullptr && gpu->averageMs > 0.0)
+			{
+				std::cout << ", GPU " << gpu->averageMs << " ms (" << objects / (gpu->averageMs / 1000.0) << " objects/s)";
+			}
+			std::cout << std::endl;
+		};
+		report("Instanced   ", 1, instancedRecordMs, gpuProfiler.findScope("RenderPass"));
+		report("Per instance", objects, perInstanceRecordMs, gpuProfiler.findScope("RenderPassPerInstance"));
+	}
+
+	// Spins the scene root and every instance around their own z axis, culls the instances against
+	// the frustum and writes the visible ones (packed to the front of each array) and the indirect
+	// draw into this image's ring region
+	void updateInstanceData(uint32_t imageIndex)
 	{
+		PV_PROFILE_FUNCTION();
 		// @TODO make this into a more robust time tracking system. @TODO @ROBUST
 		static auto firstFrameOfProgram = std::chrono::high_resolution_clock::now();
-		auto currentTime = std::chrono::high_resolution_clock::now();
-		float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - firstFrameOfProgram).count();
-		
+		float time = std::chrono::duration<float, std::chrono::seconds::period>(std::chrono::high_resolution_clock::now() - firstFrameOfProgram).count();
+
+		sceneTransforms.setLocalRotation(sceneRoot, glm::angleAxis(time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
+		for (uint32_t i = 0; i < instanceTransforms.count; ++i)
+		{
+			float speed = 0.5f + (i % 7) * 0.25f;
+			sceneTransforms.setLocalRotation(instanceNodes[i], glm::angleAxis(time * speed, glm::vec3(0.0f, 0.0f, 1.0f)));
+		}
+		sceneTransforms.update(jobSystem);
+		writeWorldTransforms(sceneTransforms, instanceNodes.data(), instanceTransforms.count, instanceTransforms);
+		if (PICK_INSTANCES)
+		{
+			// everything only spins in place, the tree from createInstanceBuffer stays good
+			for (uint32_t i = 0; i < instanceTransforms.count; ++i)
+			{
+				sceneBvh.setTransform(i, instanceTransforms.world(i));
+			}
+			sceneBvh.refit();
+		}
+
+		const uint32_t region = imageIndex % instanceRing.regionCount;
+		char* regionMemory = static_cast<char*>(instanceRing.region(region));
+
+		// everything goes up as is, cull.comp picks out the visible ones
+		if (GPU_FRUSTUM_CULLING)
+		{
+			memcpy(regionMemory, instanceTransforms.data.data(), static_cast<size_t>(instanceTransforms.data.totalMemory()));
+			gpuCulling.writeParams(region, Frustum::fromViewProjection(viewProjection),
+				(modelBoundsMin + modelBoundsMax) * 0.5f, (modelBoundsMax - modelBoundsMin) * 0.5f, instanceTransforms.count);
+			return;
+		}
+
+		// the per instance benchmark draws every instance by index, it needs them all in place
+		if (!CPU_FRUSTUM_CULLING || BENCHMARK_INSTANCING)
+		{
+			memcpy(regionMemory, instanceTransforms.data.data(), static_cast<size_t>(instanceTransforms.data.totalMemory()));
+			writeInstanceDraw(region, instanceTransforms.count);
+			return;
+		}
+
+		// world space bounds: the model's box through every instance's world matrix
+		const glm::vec3 modelCenter = (modelBoundsMin + modelBoundsMax) * 0.5f;
+		const glm::vec3 modelExtent = (modelBoundsMax - modelBoundsMin) * 0.5f;
+		for (uint32_t i = 0; i < instanceTransforms.count; ++i)
+		{
+			instanceBounds.setTransformedBox(i, modelCenter, modelExtent, instanceTransforms.world(i));
+		}
+		cullBoundsParallel(instanceBounds, Frustum::fromViewProjection(viewProjection), visibleInstances, jobSystem);
+		if (CPU_OCCLUSION_CULLING)
+		{
+			cullOccludedInstances();
+		}
+
+		// write straight into the mapped ring, sequential so write combining stays happy
+		const uint32_t visibleCount = static_cast<uint32_t>(visibleInstances.size());
+		ArrayView<glm::vec4> rows[] = { instanceTransforms.row0(), instanceTransforms.row1(), instanceTransforms.row2() };
+		for (uint32_t row = 0; row < 3; ++row)
+		{
+			glm::vec4* outRow = reinterpret_cast<glm::vec4*>(regionMemory + instanceTransforms.data.arrayOffset(row));
+			for (uint32_t v = 0; v < visibleCount; ++v) outRow[v] = rows[row][visibleInstances[v]];
+		}
+
+		writeInstanceDraw(region, visibleCount);
+		PV_PROFILE_COUNTER("VisibleInstances", visibleCount);
+	}
+
+	// On left click, casts a ray from the cursor through the frustum and prints what it hits first
+	void pickInstance()
+	{
+		const bool down = glfwGetMouseButton(pvWindow, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+		const bool clicked = down && !pickButtonDown;
+		pickButtonDown = down;
+		if (!clicked) return;
+
+		PV_PROFILE_FUNCTION();
+		double cursorX, cursorY;
+		glfwGetCursorPos(pvWindow, &cursorX, &cursorY);
+		// Vulkan's NDC y points down like the cursor's, depth is 0..1 (GLM_FORCE_DEPTH_ZERO_TO_ONE)
+		const float ndcX = static_cast<float>(2.0 * cursorX / std::max(pvWindowWidth, 1) - 1.0);
+		const float ndcY = static_cast<float>(2.0 * cursorY / std::max(pvWindowHeight, 1) - 1.0);
+		const glm::mat4 toWorld = glm::inverse(viewProjection);
+		glm::vec4 nearPoint = toWorld * glm::vec4(ndcX, ndcY, 0.0f, 1.0f);
+		glm::vec4 farPoint = toWorld * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+		nearPoint /= nearPoint.w;
+		farPoint /= farPoint.w;
+
+		// t goes from the near to the far plane over 0..1
+		RayHit hit;
+		if (sceneBvh.intersect(BvhRay(glm::vec3(nearPoint), glm::vec3(farPoint - nearPoint), 1.0f), hit))
+		{
+			std::cout << "Picked instance " << hit.instance << ", triangle " << hit.triangle << std::endl;
+		}
+		else
+		{
+			std::cout << "Picked nothing" << std::endl;
+		}
+	}
+
+	// Every instance in the frustum draws its occluder box, then the ones hidden behind them are removed from visibleInstances
+	void cullOccludedInstances()
+	{
+		PV_PROFILE_FUNCTION();
+		if (occlusionBuffer.width == 0)
+		{
+			occlusionBuffer.init(OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT);
+		}
+		const glm::vec3 modelCenter = (modelBoundsMin + modelBoundsMax) * 0.5f;
+		const glm::vec3 occluderExtent = (modelBoundsMax - modelBoundsMin) * (0.5f * OCCLUDER_BOX_SCALE);
+
+		occlusionBuffer.clear();
+		occlusionBuffer.setViewProjection(viewProjection);
+		for (uint32_t instance : visibleInstances)
+		{
+			occlusionBuffer.addOccluderBox(modelCenter - occluderExtent, modelCenter + occluderExtent, instanceTransforms.world(instance));
+		}
+		occlusionBuffer.rasterize(&jobSystem);
+
+		const uint32_t frustumVisible = static_cast<uint32_t>(visibleInstances.size());
+		visibleInstances.resize(occlusionBuffer.cullOccluded(instanceBounds, visibleInstances.data(), frustumVisible, visibleInstances.data()));
+		PV_PROFILE_COUNTER("OccludedInstances", frustumVisible - static_cast<uint32_t>(visibleInstances.size()));
+	}
+
+	// What cull.comp made of this region last time against the CPU culler, before the region is overwritten
+	void validateGpuCulling(uint32_t region)
+	{
+		PV_PROFILE_FUNCTION();
+		if (!gpuCullSubmitted[region]) return;
+
+		vkQueueWaitIdle(graphicsQueue);
+		GpuCullValidation result = gpuCulling.validate(region);
+		gpuCullTotals.cpuVisible += result.cpuVisible;
+		gpuCullTotals.gpuVisible += result.gpuVisible;
+		gpuCullTotals.mismatches += result.mismatches;
+		gpuCullTotals.borderline += result.borderline;
+		PV_ASSERT(result.passed(), "GPU culling disagrees with the CPU culler: CPU " + std::to_string(result.cpuVisible) + " visible, GPU "
+			+ std::to_string(result.gpuVisible) + ", " + std::to_string(result.mismatches - result.borderline) + " not explained by rounding");
+	}
+
+	const float fieldOfView = 45.0f;
+	void updateUniformBuffer()
+	{
+		PV_PROFILE_FUNCTION();
 		// create Update UniformBufferObject
 		UniformBufferObject ubo = {};
 
 		float width =  std::max(static_cast<float>(swapChainExtent.width), 5.0f);
 		float height = std::max(static_cast<float>(swapChainExtent.height), 5.0f);
-		ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-		ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-		ubo.proj = glm::perspective(glm::radians(fieldOfView), width / height, 0.1f, 100.0f);
+		ubo.model = glm::mat4(1.0f); // the scene root's rotation in sceneTransforms does this now
+		// pull the camera back far enough to see the whole instance grid
+		float cameraScale = std::max(1.0f, INSTANCE_GRID_SIZE * INSTANCE_SPACING * 0.5f);
+		ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f) * cameraScale, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		ubo.proj = glm::perspective(glm::radians(fieldOfView), width / height, 0.1f, 100.0f * cameraScale);
 		ubo.proj[1][1] *= -1.0f; // Invert Y coordinate for Vuklan, glm was made for OpenGL orginally
+		viewProjection = ubo.proj * ubo.view * ubo.model;
 
 		// move ubo into GPUs
 		void* gpuDataPtr;
@@ -2149,6 +2665,7 @@ private:
 
 	void drawFrame()
 	{
+		PV_PROFILE_FUNCTION();
 		// @ TODO, UPDATE THE PROGRAM/GAME the rest of the stuff goes before here!
 
 		// @TODO GAME!!
@@ -2157,7 +2674,10 @@ private:
 
 
 		// Should do this once everything else is setup in our world/graphics pipeline
-		vkQueueWaitIdle(presentQueue);
+		{
+			PV_PROFILE_SCOPE("WaitPresentQueue");
+			vkQueueWaitIdle(presentQueue);
+		}
 
 		// STEP 1
 		// aquire an image from the swap chain
@@ -2184,6 +2704,31 @@ private:
 		} while (false);
 
 
+		// read back the GPU timings of the last time this image's command buffer ran.
+		// That submit is a few frames old and collect never waits on unfinished queries.
+		if (imageIndex < commandBuffers.size())
+		{
+			gpuProfiler.collect(imageIndex);
+		}
+		if (imageIndex < perInstanceCommandBuffers.size())
+		{
+			gpuProfiler.collect(PER_INSTANCE_PROFILER_SLOT + imageIndex);
+		}
+		gpuProfiler.collect(GPU_PROFILER_UPLOAD_SLOT);
+
+		if (VALIDATE_GPU_CULLING && GPU_FRUSTUM_CULLING)
+		{
+			validateGpuCulling(imageIndex % instanceRing.regionCount);
+		}
+
+		// present queue was waited on above, nothing reads this image's ring region any more
+		updateInstanceData(imageIndex);
+
+		// odd frames of the benchmark draw the same thing with a draw call per instance
+		const bool perInstanceFrame = BENCHMARK_INSTANCING && (benchmarkFrame++ & 1) == 1;
+		VkCommandBuffer* frameCommandBuffer = perInstanceFrame ? &perInstanceCommandBuffers[imageIndex] : &commandBuffers[imageIndex];
+		const uint32_t frameProfilerSlot = perInstanceFrame ? PER_INSTANCE_PROFILER_SLOT + imageIndex : imageIndex;
+
 		// STEP 2
 		// execute the command buffers with an image attachment in the framebuffer
 		VkSubmitInfo submitInfo = {};
@@ -2199,7 +2744,7 @@ private:
 
 		// command buffers to execute
 		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+		submitInfo.pCommandBuffers = frameCommandBuffer;
 
 		// Once finished with command buffer, trigger this semaphore
 		VkSemaphore signalSemaphores[] = { renderFinishedSemaphore };
@@ -2207,6 +2752,11 @@ private:
 		submitInfo.pSignalSemaphores = signalSemaphores;
 
 		PV_VK_RUN(vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE));
+		gpuProfiler.markSubmitted(frameProfilerSlot);
+		if (GPU_FRUSTUM_CULLING && !perInstanceFrame)
+		{
+			gpuCullSubmitted[imageIndex % instanceRing.regionCount] = true;
+		}
 
 		// STEP 3
 		// return the image to the swap chian for presentation
@@ -2223,7 +2773,10 @@ private:
 
 
 		// Present the frame!
-		res = vkQueuePresentKHR(presentQueue, &presentInfo);
+		{
+			PV_PROFILE_SCOPE("QueuePresent");
+			res = vkQueuePresentKHR(presentQueue, &presentInfo);
+		}
 
 		// if our swapChain is out of date OR suboptimal, recreate the swap chain
 		if (VK_ERROR_OUT_OF_DATE_KHR == res || VK_SUBOPTIMAL_KHR == res)
@@ -2234,17 +2787,22 @@ private:
 		{
 			throw std::runtime_error("failed to present swap chain image. Code: " + std::to_string(res));
 		}
+
+		frameArenas.endFrame();
 	}
 
 #pragma region Cleanup
 	void cleanup() 
 	{
+		PV_PROFILE_FUNCTION();
 		// vulkan cleanup
 		{
 			// cleanup all resources related to the swap chain
 			cleanupSwapChain();
 
-			vkDestroyDescriptorPool(device, descriptorPool, allocnullptr);
+			// every descriptor set goes with the allocator's pools
+			descriptorSetCache.clear();
+			descriptorAllocator.cleanup();
 			
 			// free buffers
 			{
@@ -2256,7 +2814,6 @@ private:
 				vkDestroyImage(device, textureImage, allocnullptr);
 				vkFreeMemory(device, textureImageMemory, allocnullptr);
 
-				vkDestroyDescriptorSetLayout(device, descriptorSetLayout, allocnullptr);
 				vkDestroyBuffer(device, uniformBuffer, allocnullptr);
 				vkFreeMemory(device, uniformBufferMemory, allocnullptr);
 
@@ -2265,6 +2822,9 @@ private:
 				
 				vkDestroyBuffer(device, vertexBuffer, allocnullptr);
 				vkFreeMemory(device, vertexBufferMemory, allocnullptr);
+
+				gpuCulling.cleanup();
+				instanceRing.cleanup();
 			}
 
 			// clean up semaphores
@@ -2274,6 +2834,14 @@ private:
 			// clean up command pool
 			vkDestroyCommandPool(device, commandPool, allocnullptr);
 
+			gpuProfiler.cleanup();
+
+			// every descriptor set layout and pipeline layout
+			layoutCache.cleanup();
+
+			// saves the pipeline cache to disk for the next run
+			pipelineCache.cleanup();
+
 			// destroy logical device
 			vkDestroyDevice(device, allocnullptr);
 
@@ -2294,6 +2862,9 @@ private:
 			// close down glfw
 			glfwTerminate();
 		}
+
+		jobSystem.shutdown();
+		frameArenas.cleanup();
 	}
 	static void DestroyDebugReportCallbackEXT(VkInstance instance, VkDebugReportCallbackEXT callback, const VkAllocationCallbacks* pAllocator)
 	{
@@ -2309,10 +2880,9 @@ private:
 
 	void cleanupSwapChain()
 	{
+		PV_PROFILE_FUNCTION();
 		// cleanup depth buffer
-		vkDestroyImageView(device, depthImageView, nullptr);
-		vkDestroyImage(device, depthImage, nullptr);
-		vkFreeMemory(device, depthImageMemory, nullptr);
+		renderTargets.cleanup();
 
 		// cleanup framebuffer
 		for (auto framebuffer : swapChainFramebuffers)
@@ -2324,11 +2894,17 @@ private:
 		// destroy the command buffers for every swap chain
 		vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
 		commandBuffers.clear();
+		if (!perInstanceCommandBuffers.empty())
+		{
+			vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(perInstanceCommandBuffers.size()), perInstanceCommandBuffers.data());
+			perInstanceCommandBuffers.clear();
+		}
 
-		// destroy graphics Pipeline
-		vkDestroyPipeline(device, graphicsPipeline, allocnullptr);
-		// Cleanup  PipelineLayout
-		vkDestroyPipelineLayout(device, pipelineLayout, allocnullptr);
+		// destroy graphics Pipeline (every variant of it) and the modules they were built from
+		pipelineVariants.cleanup();
+		graphicsPipeline = VK_NULL_HANDLE;
+		vkDestroyShaderModule(device, vertShaderModule, allocnullptr);
+		vkDestroyShaderModule(device, fragShaderModule, allocnullptr);
 		// clenaup renderPass object
 		vkDestroyRenderPass(device, renderPass, allocnullptr);
 
@@ -2361,6 +2937,16 @@ private:
 	{
 		return std::string("../meshes/").append(textureName);
 	}
+
+	static std::string ShaderPath(const std::string& shaderName)
+	{
+		return std::string("../shaders/").append(shaderName);
+	}
+
+	static std::string SpvPath(const std::string& spvName)
+	{
+		return std::string("../SPV/").append(spvName);
+	}
 #pragma endregion
 };
 
@@ -2387,28 +2973,11 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
 #pragma endregion
 
 
-struct TransformData
-{
-	MultiArray<glm::vec3, glm::vec3, glm::quat> data;
-	TransformData(unsigned int instanceCount)
-		: data({ instanceCount, instanceCount, instanceCount })
-	{
-	}
-
-};
-
 int main() {
 	PVWindow app;
 
-	VertexData<glm::vec3, glm::vec2> data;
-	VertexData<glm::vec3> transformData;
-
 	try 
 	{
-
-		auto inputDescript = GetInputDescription<decltype(data)>(0, VK_VERTEX_INPUT_RATE_VERTEX);
-		auto transformInstanceData = GetInputDescription<decltype(transformData)>(1, VK_VERTEX_INPUT_RATE_INSTANCE);
-
 		app.run();
 	}
 	catch (const std::runtime_error& e) {
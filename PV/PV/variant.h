@@ -1,158 +1,406 @@
-#include <iostream>
+#pragma once
+
+/*
+	Include dependencies: none
+*/
+#include <new>
 #include <utility>
 #include <typeinfo>
 #include <type_traits>
+#include <functional>
+#include <vector>
 #include <string>
+#include <random>
+#include <chrono>
+#include <ostream>
+#include <stdexcept>
+#include <cstring>
+#include <stdint.h>
 #include "static_util.h"
 
-template<typename... Ts>
-struct variant_helper;
+// std::variant exists from C++17 on, only the benchmark compares against it
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#define PV_HAS_STD_VARIANT 1
+#include <variant>
+#else
+#define PV_HAS_STD_VARIANT 0
+#endif
+
+
+// A tagged union of Ts. The tag is the index of the held type in Ts (one byte for up to 255
+// types), copy / move / destroy / visit go through one table of function pointers indexed by it.
+// When every T is trivially copyable so is the variant: no tables, copies are a memcpy and a
+// std::vector of them moves with one.
 
-template<typename F, typename... Ts>
-struct variant_helper<F, Ts...> {
-	inline static void destroy(size_t id, void * data) 
+namespace variant_detail
+{
+	template <typename T, typename... Ts>
+	struct index_of;
+	template <typename T, typename... Ts>
+	struct index_of<T, T, Ts...> : std::integral_constant<size_t, 0> { };
+	template <typename T, typename F, typename... Ts>
+	struct index_of<T, F, Ts...> : std::integral_constant<size_t, 1 + index_of<T, Ts...>::value> { };
+	template <typename T>
+	struct index_of<T> : std::integral_constant<size_t, 0>
 	{
-		if (id == typeid(F).hash_code())
-			reinterpret_cast<F*>(data)->~F();
-		else
-			variant_helper<Ts...>::destroy(id, data);
-	}
+		static_assert(sizeof(T) == 0, "variant: type is not one of the alternatives");
+	};
+
+	template <typename T, typename... Ts>
+	struct contains : std::false_type { };
+	template <typename T, typename F, typename... Ts>
+	struct contains<T, F, Ts...> : std::integral_constant<bool, std::is_same<T, F>::value || contains<T, Ts...>::value> { };
+
+	template <typename... Ts>
+	struct all_trivially_copyable : std::true_type { };
+	template <typename F, typename... Ts>
+	struct all_trivially_copyable<F, Ts...>
+		: std::integral_constant<bool, std::is_trivially_copyable<F>::value && all_trivially_copyable<Ts...>::value> { };
+
+	template <typename T> void destroy(void* data) { static_cast<T*>(data)->~T(); }
+	template <typename T> void copy(const void* from, void* to) { new (to) T(*static_cast<const T*>(from)); }
+	template <typename T> void move(void* from, void* to) { new (to) T(std::move(*static_cast<T*>(from))); }
 
-	inline static void move(size_t old_t, void * old_v, void * new_v)
+	template <typename... Ts>
+	struct tables
 	{
-		if (old_t == typeid(F).hash_code())
-			new (new_v) F(std::move(*reinterpret_cast<F*>(old_v)));
-		else
-			variant_helper<Ts...>::move(old_t, old_v, new_v);       
-	}
+		static constexpr void (*destroy[sizeof...(Ts)])(void*) = { &variant_detail::destroy<Ts>... };
+		static constexpr void (*copy[sizeof...(Ts)])(const void*, void*) = { &variant_detail::copy<Ts>... };
+		static constexpr void (*move[sizeof...(Ts)])(void*, void*) = { &variant_detail::move<Ts>... };
+	};
+	template <typename... Ts> constexpr void (*tables<Ts...>::destroy[sizeof...(Ts)])(void*);
+	template <typename... Ts> constexpr void (*tables<Ts...>::copy[sizeof...(Ts)])(const void*, void*);
+	template <typename... Ts> constexpr void (*tables<Ts...>::move[sizeof...(Ts)])(void*, void*);
 
-	inline static void copy(size_t old_t, const void * old_v, void * new_v)
+	// Data is void or const void, the visitor sees T& or const T&
+	template <typename R, typename F, typename Data, typename... Ts>
+	struct visit_table
 	{
-		if (old_t == typeid(F).hash_code())
-			new (new_v) F(*reinterpret_cast<const F*>(old_v));
-		else
-			variant_helper<Ts...>::copy(old_t, old_v, new_v);       
-	}   
-};
+		template <typename T>
+		static R invoke(F& visitor, Data* data)
+		{
+			typedef typename std::conditional<std::is_const<Data>::value, const T, T>::type Held;
+			return visitor(*static_cast<Held*>(data));
+		}
+		static constexpr R (*table[sizeof...(Ts)])(F&, Data*) = { &invoke<Ts>... };
+	};
+	template <typename R, typename F, typename Data, typename... Ts>
+	constexpr R (*visit_table<R, F, Data, Ts...>::table[sizeof...(Ts)])(F&, Data*);
 
-template<> struct variant_helper<>  {
-inline static void destroy(size_t id, void * data) { }
-inline static void move(size_t old_t, void * old_v, void * new_v) { }
-inline static void copy(size_t old_t, const void * old_v, void * new_v) { }
-};
+	template <typename... Ts>
+	struct layout
+	{
+		typedef typename std::conditional<(sizeof...(Ts) < 255), uint8_t, uint16_t>::type index_t;
+		static constexpr index_t npos = static_cast<index_t>(~index_t(0));
+		typedef typename std::aligned_storage<static_max<sizeof(Ts)...>::value, static_max<alignof(Ts)...>::value>::type data_t;
+	};
+
+	// owns the value, the special members are the table driven ones
+	template <bool Trivial, typename... Ts>
+	struct storage
+	{
+		typedef layout<Ts...> layout_t;
+		typename layout_t::index_t type_index;
+		typename layout_t::data_t data;
+
+		storage() : type_index(layout_t::npos) { }
+		storage(const storage& other) : type_index(layout_t::npos)
+		{
+			if (other.type_index != layout_t::npos)
+				tables<Ts...>::copy[other.type_index](&other.data, &data);
+			type_index = other.type_index;
+		}
+		storage(storage&& other) : type_index(layout_t::npos)
+		{
+			if (other.type_index != layout_t::npos)
+				tables<Ts...>::move[other.type_index](&other.data, &data);
+			type_index = other.type_index;
+		}
+		// the old value goes first, a throwing copy leaves the variant empty
+		storage& operator=(const storage& other)
+		{
+			if (this != &other)
+			{
+				reset();
+				if (other.type_index != layout_t::npos)
+					tables<Ts...>::copy[other.type_index](&other.data, &data);
+				type_index = other.type_index;
+			}
+			return *this;
+		}
+		storage& operator=(storage&& other)
+		{
+			if (this != &other)
+			{
+				reset();
+				if (other.type_index != layout_t::npos)
+					tables<Ts...>::move[other.type_index](&other.data, &data);
+				type_index = other.type_index;
+			}
+			return *this;
+		}
+		~storage() { reset(); }
+
+		void reset()
+		{
+			if (type_index != layout_t::npos)
+				tables<Ts...>::destroy[type_index](&data);
+			type_index = layout_t::npos;
+		}
+	};
+
+	// every T trivially copyable: the implicit special members, so is the variant
+	template <typename... Ts>
+	struct storage<true, Ts...>
+	{
+		typedef layout<Ts...> layout_t;
+		typename layout_t::index_t type_index;
+		typename layout_t::data_t data;
+
+		storage() : type_index(layout_t::npos) { }
+
+		void reset() { type_index = layout_t::npos; }
+	};
+}
 
 template<typename... Ts>
-struct variant {
-private: 
-	static const size_t data_size = static_max<sizeof(Ts)...>::value;
-	static const size_t data_align = static_max<alignof(Ts)...>::value;
+struct variant : private variant_detail::storage<variant_detail::all_trivially_copyable<Ts...>::value, Ts...>
+{
+private:
+	typedef variant_detail::storage<variant_detail::all_trivially_copyable<Ts...>::value, Ts...> storage_t;
+	typedef variant_detail::layout<Ts...> layout_t;
 
-	using data_t = typename std::aligned_storage<data_size, data_align>::type;
+	template <typename T>
+	using enable_if_alternative = typename std::enable_if<variant_detail::contains<typename std::decay<T>::type, Ts...>::value>::type;
 
-	using helper_t = variant_helper<Ts...>;
-	
-	static inline size_t invalid_type() {
-		return typeid(void).hash_code();
-	}
+	using storage_t::type_index;
+	using storage_t::data;
 
-	size_t type_id;
-	data_t data;
-public: 
-	variant() : type_id(invalid_type()) {   }
+public:
+	typedef typename layout_t::index_t index_t;
+	static constexpr index_t npos = layout_t::npos;
 
-	variant(const variant<Ts...>& old) : type_id(old.type_id)
-	{
-		helper_t::copy(old.type_id, &old.data, &data);
-	}
+	template <typename T>
+	static constexpr index_t index_of() { return static_cast<index_t>(variant_detail::index_of<T, Ts...>::value); }
 
-	variant(variant<Ts...>&& old) : type_id(old.type_id)
-	{
-		helper_t::move(old.type_id, &old.data, &data);
-	}
+	variant() = default;
 
-	// Serves as both the move and the copy asignment operator.
-	variant<Ts...>& operator= (variant<Ts...> old)
+	template <typename T, typename = enable_if_alternative<T>>
+	variant(T&& value)
 	{
-		std::swap(type_id, old.type_id);
-		std::swap(data, old.data);
+		set<typename std::decay<T>::type>(std::forward<T>(value));
+	}
 
-		return *this;
+	// position of the held type in Ts, npos when empty
+	index_t index() const {
+		return type_index;
 	}
 
 	template<typename T>
-	void is() {
-		return (type_id == typeid(T).hash_code());
+	bool is() const {
+		return type_index == index_of<T>();
 	}
 
-	void valid() {
-		return (type_id != invalid_type());
+	bool valid() const {
+		return type_index != npos;
 	}
 
 	template<typename T, typename... Args>
-	void set(Args&&... args)
+	T& set(Args&&... args)
 	{
-		// First we destroy the current contents    
-		helper_t::destroy(type_id, &data);      
-		new (&data) T(std::forward<Args>(args)...);
-		type_id = typeid(T).hash_code();
+		// First we destroy the current contents
+		storage_t::reset();
+		T* value = new (&data) T(std::forward<Args>(args)...);
+		type_index = index_of<T>();
+		return *value;
+	}
+
+	void reset()
+	{
+		storage_t::reset();
 	}
 
 	template<typename T>
 	T& get()
 	{
 		// It is a dynamic_cast-like behaviour
-		if (type_id == typeid(T).hash_code())
-			return *reinterpret_cast<T*>(&data);
-		else
+		if (!is<T>())
 			throw std::bad_cast();
-	}   
+		return *reinterpret_cast<T*>(&data);
+	}
+	template<typename T>
+	const T& get() const
+	{
+		if (!is<T>())
+			throw std::bad_cast();
+		return *reinterpret_cast<const T*>(&data);
+	}
 
-	~variant() {
-		helper_t::destroy(type_id, &data);
+	// nullptr unless it holds a T
+	template<typename T>
+	T* get_if() {
+		return is<T>() ? reinterpret_cast<T*>(&data) : nullptr;
+	}
+	template<typename T>
+	const T* get_if() const {
+		return is<T>() ? reinterpret_cast<const T*>(&data) : nullptr;
+	}
+
+	// visitor(held value), one indirect call. Every overload has to return the same type as the
+	// one for the first alternative. Throws on an empty variant.
+	template <typename F>
+	auto visit(F&& visitor) -> decltype(visitor(std::declval<typename std::tuple_element<0, std::tuple<Ts...>>::type&>()))
+	{
+		typedef decltype(visitor(std::declval<typename std::tuple_element<0, std::tuple<Ts...>>::type&>())) R;
+		if (!valid())
+			throw std::bad_cast();
+		return variant_detail::visit_table<R, typename std::remove_reference<F>::type, void, Ts...>::table[type_index](visitor, &data);
+	}
+	template <typename F>
+	auto visit(F&& visitor) const -> decltype(visitor(std::declval<const typename std::tuple_element<0, std::tuple<Ts...>>::type&>()))
+	{
+		typedef decltype(visitor(std::declval<const typename std::tuple_element<0, std::tuple<Ts...>>::type&>())) R;
+		if (!valid())
+			throw std::bad_cast();
+		return variant_detail::visit_table<R, typename std::remove_reference<F>::type, const void, Ts...>::table[type_index](visitor, &data);
 	}
 };
 
+template <typename... Ts>
+constexpr typename variant<Ts...>::index_t variant<Ts...>::npos;
 
-struct test{
-	int * holder;
-	test() {
-		std::cout << "test()" << std::endl;
-		holder = new int();
-	}
 
-	test(test&& old) : holder(nullptr) {
-		std::cout << "test(test&&)" << std::endl;
-		std::swap(holder,old.holder);
-	}
-	test(const test& old) {
-		std::cout << "test(const test&)" << std::endl;
-		holder = new int(*old.holder);
+namespace variant_detail
+{
+	// render command payloads, all trivially copyable
+	struct DrawCommand { uint32_t pipeline, mesh, firstInstance, instanceCount; };
+	struct ScissorCommand { int32_t x, y; uint32_t width, height; };
+	struct BindSetCommand { uint64_t set; uint32_t slot; };
+	struct PushConstantsCommand { float values[16]; };
+
+	// window / input event payloads, text makes them non trivial
+	struct KeyEvent { int key, action; };
+	struct MouseMoveEvent { double x, y; };
+	struct ResizeEvent { uint32_t width, height; };
+	struct TextEvent { std::string text; };
+
+	struct CommandChecksum
+	{
+		uint64_t operator()(const DrawCommand& c) const { return c.pipeline * 31u + c.mesh + c.instanceCount; }
+		uint64_t operator()(const ScissorCommand& c) const { return static_cast<uint64_t>(c.x + c.y) + c.width * c.height; }
+		uint64_t operator()(const BindSetCommand& c) const { return c.set ^ c.slot; }
+		uint64_t operator()(const PushConstantsCommand& c) const { return static_cast<uint64_t>(c.values[0] + c.values[15]); }
+	};
+	struct EventChecksum
+	{
+		uint64_t operator()(const KeyEvent& e) const { return static_cast<uint64_t>(e.key * 3 + e.action); }
+		uint64_t operator()(const MouseMoveEvent& e) const { return static_cast<uint64_t>(e.x + e.y); }
+		uint64_t operator()(const ResizeEvent& e) const { return e.width + e.height; }
+		uint64_t operator()(const TextEvent& e) const { return e.text.size(); }
+	};
+
+	template <typename Command>
+	Command makeCommand(uint32_t kind, uint32_t i)
+	{
+		switch (kind)
+		{
+		case 0: return Command(DrawCommand{ i & 15, i & 255, i, 1 + (i & 7) });
+		case 1: return Command(ScissorCommand{ 0, 0, 1280 + (i & 3), 720 });
+		case 2: return Command(BindSetCommand{ 0x1000ull + i, i & 3 });
+		default:
+		{
+			PushConstantsCommand push = {};
+			push.values[0] = static_cast<float>(i & 1023);
+			push.values[15] = 1.0f;
+			return Command(push);
+		}
+		}
 	}
-	~test()
+	template <typename Event>
+	Event makeEvent(uint32_t kind, uint32_t i)
 	{
-		std::cout << "~test()" << std::endl;
-		delete holder;
+		switch (kind)
+		{
+		case 0: return Event(KeyEvent{ static_cast<int>(i & 127), static_cast<int>(i & 1) });
+		case 1: return Event(MouseMoveEvent{ static_cast<double>(i & 2047), static_cast<double>(i & 1023) });
+		case 2: return Event(ResizeEvent{ 1280, 720 });
+		default: return Event(TextEvent{ std::string("typed text that doesn't fit in SSO", 1 + (i & 31)) });
+		}
 	}
-};
 
+	struct VariantTimes { double fillNs, copyNs, visitNs; uint64_t checksum; };
+
+	// fill a vector with count payloads of random kinds, copy it, visit every element
+	template <typename Payload, typename Make, typename Visit>
+	VariantTimes timePayloads(const std::vector<uint32_t>& kinds, Make make, Visit visit)
+	{
+		typedef std::chrono::high_resolution_clock Clock;
+		auto elapsed = [](Clock::time_point start) { return std::chrono::duration<double, std::nano>(Clock::now() - start).count(); };
+		const int ITERATIONS = 5;
+		VariantTimes times = {};
+		for (int it = 0; it < ITERATIONS; ++it)
+		{
+			std::vector<Payload> payloads;
+			payloads.reserve(kinds.size());
+			auto start = Clock::now();
+			for (size_t i = 0; i < kinds.size(); ++i)
+				payloads.push_back(make(kinds[i], static_cast<uint32_t>(i)));
+			times.fillNs += elapsed(start);
 
-int main() {
-	using my_var = variant<std::string, test>;
-	
-	my_var d;
-	
-	d.set<std::string>("First string");
-	std::cout << d.get<std::string>() << std::endl;
+			start = Clock::now();
+			std::vector<Payload> copied(payloads);
+			times.copyNs += elapsed(start);
 
-	d.set<test>();
-	*d.get<test>().holder = 42;
+			start = Clock::now();
+			uint64_t checksum = 0;
+			for (const Payload& payload : copied)
+				checksum += visit(payload);
+			times.visitNs += elapsed(start);
+			times.checksum = checksum;
+		}
+		const double perItem = 1.0 / (ITERATIONS * static_cast<double>(kinds.size()));
+		times.fillNs *= perItem;
+		times.copyNs *= perItem;
+		times.visitNs *= perItem;
+		return times;
+	}
+
+	inline void printTimes(std::ostream& out, const char* name, const VariantTimes& times)
+	{
+		out << "\t" << name << times.fillNs << " ns fill, " << times.copyNs << " ns copy, " << times.visitNs << " ns visit" << std::endl;
+	}
+}
 
-	my_var e(std::move(d));
-	std::cout << *e.get<test>().holder << std::endl;    
+// ns per element to build, copy and visit 1M render commands and 1M events, against std::variant
+// when it is there
+inline void benchmarkVariant(std::ostream& out, uint32_t count = 1000000)
+{
+	using namespace variant_detail;
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<uint32_t> kind(0, 3);
+	std::vector<uint32_t> kinds(count);
+	for (uint32_t& k : kinds) k = kind(rng);
 
-	*e.get<test>().holder = 43;
+	typedef variant<DrawCommand, ScissorCommand, BindSetCommand, PushConstantsCommand> Command;
+	typedef variant<KeyEvent, MouseMoveEvent, ResizeEvent, TextEvent> Event;
+	static_assert(std::is_trivially_copyable<Command>::value, "benchmarkVariant: commands should take the trivial path");
+	static_assert(!std::is_trivially_copyable<Event>::value, "benchmarkVariant: events should take the table path");
 
-	d = e;
-	
-	std::cout << *d.get<test>().holder << std::endl;    
-}
\ No newline at end of file
+	out << "Variant benchmark: " << count << " payloads of 4 kinds, sizeof " << sizeof(Command) << " / " << sizeof(Event) << std::endl;
+	VariantTimes commands = timePayloads<Command>(kinds, makeCommand<Command>, [](const Command& c) { return c.visit(CommandChecksum()); });
+	VariantTimes events = timePayloads<Event>(kinds, makeEvent<Event>, [](const Event& e) { return e.visit(EventChecksum()); });
+	printTimes(out, "commands variant:      ", commands);
+	printTimes(out, "events variant:        ", events);
+#if PV_HAS_STD_VARIANT
+	typedef std::variant<DrawCommand, ScissorCommand, BindSetCommand, PushConstantsCommand> StdCommand;
+	typedef std::variant<KeyEvent, MouseMoveEvent, ResizeEvent, TextEvent> StdEvent;
+	VariantTimes stdCommands = timePayloads<StdCommand>(kinds, makeCommand<StdCommand>, [](const StdCommand& c) { return std::visit(CommandChecksum(), c); });
+	VariantTimes stdEvents = timePayloads<StdEvent>(kinds, makeEvent<StdEvent>, [](const StdEvent& e) { return std::visit(EventChecksum(), e); });
+	if (stdCommands.checksum != commands.checksum || stdEvents.checksum != events.checksum)
+		throw std::runtime_error("benchmarkVariant: variant and std::variant visits disagree");
+	printTimes(out, "commands std::variant: ", stdCommands);
+	printTimes(out, "events std::variant:   ", stdEvents);
+#else
+	out << "\tstd::variant needs C++17, not compared" << std::endl;
+#endif
+}
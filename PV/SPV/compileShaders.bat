@@ -3,4 +3,5 @@ set "shadersDir=%~dp0..\shaders\"
 
 for /R %shadersDir% %%f in (*.vert) do %vulkanBinDir%\glslangValidator.exe -V %%f
 for /R %shadersDir% %%f in (*.frag) do %vulkanBinDir%\glslangValidator.exe -V %%f
+for /R %shadersDir% %%f in (*.comp) do %vulkanBinDir%\glslangValidator.exe -V %%f
 
@@ -1,6 +1,13 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+// feature toggles, set per pipeline variant (ShaderVariants.h)
+layout(constant_id = 0) const bool USE_TEXTURE = true;
+layout(constant_id = 1) const bool USE_VERTEX_COLOR = false;
+layout(constant_id = 2) const bool USE_ALPHA_TEST = false;
+
+const float ALPHA_CUTOFF = 0.5;
+
 layout(binding = 1) uniform sampler2D texSampler;
 
 layout(location = 0) in vec3 fragColor;
@@ -10,5 +17,17 @@ layout(location = 0) out vec4 outColor;
 
 void main() 
 {
-    outColor = texture(texSampler, fragTexCoord);
-}
\ No newline at end of file
+    outColor = vec4(1.0);
+    if (USE_TEXTURE)
+    {
+        outColor = texture(texSampler, fragTexCoord);
+    }
+    if (USE_VERTEX_COLOR)
+    {
+        outColor.rgb *= fragColor;
+    }
+    if (USE_ALPHA_TEST && outColor.a < ALPHA_CUTOFF)
+    {
+        discard;
+    }
+}
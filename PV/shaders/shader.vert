@@ -12,6 +12,11 @@ layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 
+// per instance, one binding per TransformData array: rows of the world matrix's upper 3x4
+layout(location = 3) in vec4 instanceRow0;
+layout(location = 4) in vec4 instanceRow1;
+layout(location = 5) in vec4 instanceRow2;
+
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 
@@ -20,7 +25,9 @@ out gl_PerVertex {
 };
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    vec4 position = vec4(inPosition, 1.0);
+    vec3 worldPosition = vec3(dot(instanceRow0, position), dot(instanceRow1, position), dot(instanceRow2, position));
+    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(worldPosition, 1.0);
     fragColor = inColor;
     fragTexCoord = inTexCoord;
 }
\ No newline at end of file